@@ -19,6 +19,7 @@
 #include <linux/highmem.h>
 #include <linux/sched/sysctl.h>
 #include <linux/blk-crypto.h>
+#include <linux/cpuhotplug.h>
 
 #include <trace/events/block.h>
 #include "blk.h"
@@ -48,6 +49,19 @@ static struct biovec_slab bvec_slabs[BVEC_POOL_NR] __read_mostly = {
 struct bio_set fs_bio_set;
 EXPORT_SYMBOL(fs_bio_set);
 
+/*
+ * Per-cpu cache of freed bios, for bio_sets created with
+ * BIOSET_PERCPU_CACHE.  Bios are only put here when they complete from task
+ * context, so the lists only ever need preemption disabled.
+ */
+#define ALLOC_CACHE_MAX		512
+#define ALLOC_CACHE_SLACK	 64
+
+struct bio_alloc_cache {
+	struct bio_list		free_list;
+	unsigned int		nr;
+};
+
 /*
  * Our slab pool management
  */
@@ -527,6 +541,43 @@ struct bio *bio_alloc_bioset(gfp_t gfp_mask, unsigned int nr_iovecs,
 }
 EXPORT_SYMBOL(bio_alloc_bioset);
 
+/**
+ * bio_alloc_kiocb - allocate a bio from bio_set based on kiocb
+ * @kiocb:	kiocb describing the IO
+ * @nr_vecs:	number of iovecs to pre-allocate
+ * @bs:		bio_set to allocate from
+ *
+ * Description:
+ *    Like bio_alloc_bioset, but pass in the kiocb.  If the kiocb is set up
+ *    with IOCB_ALLOC_CACHE and @bs was created with BIOSET_PERCPU_CACHE, the
+ *    bio is taken from the per-cpu cache of recycled bios when possible.
+ *    Polled I/O is the only user for now, as its completions run in task
+ *    context and bios can go back to the cache without irq protection.
+ */
+struct bio *bio_alloc_kiocb(struct kiocb *kiocb, unsigned int nr_vecs,
+			    struct bio_set *bs)
+{
+	struct bio_alloc_cache *cache;
+	struct bio *bio;
+
+	if (!(kiocb->ki_flags & IOCB_ALLOC_CACHE) || !bs->cache ||
+	    nr_vecs > BIO_INLINE_VECS)
+		return bio_alloc_bioset(GFP_KERNEL, nr_vecs, bs);
+
+	cache = per_cpu_ptr(bs->cache, get_cpu());
+	bio = bio_list_pop(&cache->free_list);
+	if (bio) {
+		cache->nr--;
+		put_cpu();
+		bio_init(bio, nr_vecs ? bio->bi_inline_vecs : NULL, nr_vecs);
+		bio->bi_pool = bs;
+		return bio;
+	}
+	put_cpu();
+	return bio_alloc_bioset(GFP_KERNEL, nr_vecs, bs);
+}
+EXPORT_SYMBOL_GPL(bio_alloc_kiocb);
+
 void zero_fill_bio_iter(struct bio *bio, struct bvec_iter start)
 {
 	unsigned long flags;
@@ -642,19 +693,57 @@ void guard_bio_eod(struct bio *bio)
  *   Put a reference to a &struct bio, either one you have gotten with
  *   bio_alloc, bio_get or bio_clone_*. The last put of a bio will free it.
  **/
-void bio_put(struct bio *bio)
+static void bio_alloc_cache_prune(struct bio_alloc_cache *cache,
+				  unsigned int nr)
 {
-	if (!bio_flagged(bio, BIO_REFFED))
+	unsigned int i = 0;
+	struct bio *bio;
+
+	while ((bio = bio_list_pop(&cache->free_list)) != NULL) {
+		cache->nr--;
 		bio_free(bio);
-	else {
+		if (++i == nr)
+			break;
+	}
+}
+
+/*
+ * Recycle @bio into the per-cpu cache of its bio_set.  Only bios that came
+ * from bio_alloc_kiocb() and were submitted to a polled queue are marked
+ * REQ_ALLOC_CACHE, and only inline bvecs are cached.
+ */
+static bool bio_put_percpu_cache(struct bio *bio)
+{
+	struct bio_set *bs = bio->bi_pool;
+	struct bio_alloc_cache *cache;
+
+	if (!bs || !bs->cache || BVEC_POOL_IDX(bio) || in_interrupt())
+		return false;
+
+	bio_uninit(bio);
+	cache = per_cpu_ptr(bs->cache, get_cpu());
+	bio_list_add_head(&cache->free_list, bio);
+	if (++cache->nr > ALLOC_CACHE_MAX + ALLOC_CACHE_SLACK)
+		bio_alloc_cache_prune(cache, ALLOC_CACHE_SLACK);
+	put_cpu();
+	return true;
+}
+
+void bio_put(struct bio *bio)
+{
+	if (bio_flagged(bio, BIO_REFFED)) {
 		BIO_BUG_ON(!atomic_read(&bio->__bi_cnt));
 
 		/*
 		 * last put frees it
 		 */
-		if (atomic_dec_and_test(&bio->__bi_cnt))
-			bio_free(bio);
+		if (!atomic_dec_and_test(&bio->__bi_cnt))
+			return;
 	}
+
+	if ((bio->bi_opf & REQ_ALLOC_CACHE) && bio_put_percpu_cache(bio))
+		return;
+	bio_free(bio);
 }
 EXPORT_SYMBOL(bio_put);
 
@@ -1533,8 +1622,40 @@ int biovec_init_pool(mempool_t *pool, int pool_entries)
  * May be called on a zeroed but uninitialized bioset (i.e. allocated with
  * kzalloc()).
  */
+static int bio_cpu_dead(unsigned int cpu, struct hlist_node *node)
+{
+	struct bio_set *bs;
+
+	bs = hlist_entry_safe(node, struct bio_set, cpuhp_dead);
+	if (bs->cache) {
+		struct bio_alloc_cache *cache = per_cpu_ptr(bs->cache, cpu);
+
+		bio_alloc_cache_prune(cache, -1U);
+	}
+	return 0;
+}
+
+static void bio_alloc_cache_destroy(struct bio_set *bs)
+{
+	int cpu;
+
+	if (!bs->cache)
+		return;
+
+	cpuhp_state_remove_instance_nocalls(CPUHP_BIO_DEAD, &bs->cpuhp_dead);
+	for_each_possible_cpu(cpu) {
+		struct bio_alloc_cache *cache;
+
+		cache = per_cpu_ptr(bs->cache, cpu);
+		bio_alloc_cache_prune(cache, -1U);
+	}
+	free_percpu(bs->cache);
+	bs->cache = NULL;
+}
+
 void bioset_exit(struct bio_set *bs)
 {
+	bio_alloc_cache_destroy(bs);
 	if (bs->rescue_workqueue)
 		destroy_workqueue(bs->rescue_workqueue);
 	bs->rescue_workqueue = NULL;
@@ -1554,8 +1675,8 @@ EXPORT_SYMBOL(bioset_exit);
  * @bs:		pool to initialize
  * @pool_size:	Number of bio and bio_vecs to cache in the mempool
  * @front_pad:	Number of bytes to allocate in front of the returned bio
- * @flags:	Flags to modify behavior, currently %BIOSET_NEED_BVECS
- *              and %BIOSET_NEED_RESCUER
+ * @flags:	Flags to modify behavior, currently %BIOSET_NEED_BVECS,
+ *              %BIOSET_NEED_RESCUER and %BIOSET_PERCPU_CACHE
  *
  * Description:
  *    Set up a bio_set to be used with @bio_alloc_bioset. Allows the caller
@@ -1568,6 +1689,8 @@ EXPORT_SYMBOL(bioset_exit);
  *    for allocating iovecs.  This pool is not needed e.g. for bio_clone_fast().
  *    If %BIOSET_NEED_RESCUER is set, a workqueue is created which can be used to
  *    dispatch queued requests when the mempool runs out of space.
+ *    If %BIOSET_PERCPU_CACHE is set, bios freed from task context after
+ *    polled I/O are kept in a per-cpu cache for bio_alloc_kiocb().
  *
  */
 int bioset_init(struct bio_set *bs,
@@ -1594,12 +1717,19 @@ int bioset_init(struct bio_set *bs,
 	    biovec_init_pool(&bs->bvec_pool, pool_size))
 		goto bad;
 
-	if (!(flags & BIOSET_NEED_RESCUER))
-		return 0;
+	if (flags & BIOSET_NEED_RESCUER) {
+		bs->rescue_workqueue = alloc_workqueue("bioset",
+							WQ_MEM_RECLAIM, 0);
+		if (!bs->rescue_workqueue)
+			goto bad;
+	}
 
-	bs->rescue_workqueue = alloc_workqueue("bioset", WQ_MEM_RECLAIM, 0);
-	if (!bs->rescue_workqueue)
-		goto bad;
+	if (flags & BIOSET_PERCPU_CACHE) {
+		bs->cache = alloc_percpu(struct bio_alloc_cache);
+		if (!bs->cache)
+			goto bad;
+		cpuhp_state_add_instance_nocalls(CPUHP_BIO_DEAD, &bs->cpuhp_dead);
+	}
 
 	return 0;
 bad:
@@ -1621,6 +1751,8 @@ int bioset_init_from_src(struct bio_set *bs, struct bio_set *src)
 		flags |= BIOSET_NEED_BVECS;
 	if (src->rescue_workqueue)
 		flags |= BIOSET_NEED_RESCUER;
+	if (src->cache)
+		flags |= BIOSET_PERCPU_CACHE;
 
 	return bioset_init(bs, src->bio_pool.min_nr, src->front_pad, flags);
 }
@@ -1795,6 +1927,9 @@ static int __init init_bio(void)
 	bio_integrity_init();
 	biovec_init_slabs();
 
+	cpuhp_setup_state_multi(CPUHP_BIO_DEAD, "block/bio:dead", NULL,
+					bio_cpu_dead);
+
 	if (bioset_init(&fs_bio_set, BIO_POOL_SIZE, 0, BIOSET_NEED_BVECS))
 		panic("bio: can't allocate bios\n");
 
@@ -1005,8 +1005,12 @@ generic_make_request_checks(struct bio *bio)
 		}
 	}
 
+	/*
+	 * Bios are only recycled into the per-cpu cache when they complete
+	 * from task context, which is only guaranteed for polled queues.
+	 */
 	if (!test_bit(QUEUE_FLAG_POLL, &q->queue_flags))
-		bio->bi_opf &= ~REQ_HIPRI;
+		bio->bi_opf &= ~(REQ_HIPRI | REQ_ALLOC_CACHE);
 
 	switch (bio_op(bio)) {
 	case REQ_OP_DISCARD:
@@ -1787,6 +1791,23 @@ EXPORT_SYMBOL(kblockd_mod_delayed_work_on);
  *   this kind of deadlock.
  */
 void blk_start_plug(struct blk_plug *plug)
+{
+	blk_start_plug_nr_ios(plug, 1);
+}
+EXPORT_SYMBOL(blk_start_plug);
+
+/**
+ * blk_start_plug_nr_ios - start a plug for a known number of I/Os
+ * @plug:	The &struct blk_plug that needs to be initialized
+ * @nr_ios:	Number of I/Os the caller is about to submit
+ *
+ * Description:
+ *   Like blk_start_plug(), but also tells the block layer how many I/Os
+ *   will be submitted under the plug.  blk-mq uses this to allocate the
+ *   requests for the whole batch with a single tag allocation, the ones
+ *   that end up unused are freed when the plug is flushed.
+ */
+void blk_start_plug_nr_ios(struct blk_plug *plug, unsigned short nr_ios)
 {
 	struct task_struct *tsk = current;
 
@@ -1798,7 +1819,9 @@ void blk_start_plug(struct blk_plug *plug)
 
 	INIT_LIST_HEAD(&plug->mq_list);
 	INIT_LIST_HEAD(&plug->cb_list);
+	INIT_LIST_HEAD(&plug->cached_rqs);
 	plug->rq_count = 0;
+	plug->nr_ios = min_t(unsigned short, nr_ios, BLK_MAX_REQUEST_COUNT);
 	plug->multiple_queues = false;
 
 	/*
@@ -1807,7 +1830,7 @@ void blk_start_plug(struct blk_plug *plug)
 	 */
 	tsk->plug = plug;
 }
-EXPORT_SYMBOL(blk_start_plug);
+EXPORT_SYMBOL(blk_start_plug_nr_ios);
 
 static void flush_plug_callbacks(struct blk_plug *plug, bool from_schedule)
 {
@@ -1857,6 +1880,8 @@ void blk_flush_plug_list(struct blk_plug *plug, bool from_schedule)
 
 	if (!list_empty(&plug->mq_list))
 		blk_mq_flush_plug_list(plug, from_schedule);
+	if (unlikely(!list_empty(&plug->cached_rqs)))
+		blk_mq_free_plug_rqs(plug);
 }
 
 /**
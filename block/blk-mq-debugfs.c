@@ -281,6 +281,7 @@ static const char *const cmd_flag_name[] = {
 	CMD_FLAG_NAME(NOWAIT),
 	CMD_FLAG_NAME(NOUNMAP),
 	CMD_FLAG_NAME(HIPRI),
+	CMD_FLAG_NAME(ALLOC_CACHE),
 };
 #undef CMD_FLAG_NAME
 
@@ -545,6 +546,53 @@ static ssize_t hctx_io_poll_write(void *data, const char __user *buf,
 	return count;
 }
 
+static void print_poll_hist(struct seq_file *m, unsigned int *bins)
+{
+	unsigned int i, total = 0;
+
+	for (i = 0; i < BLK_MQ_POLL_HIST_BINS; i++)
+		total += bins[i];
+	seq_printf(m, "samples=%u", total);
+	/* lowest latency of each bin in nsecs, and its count */
+	for (i = 0; i < BLK_MQ_POLL_HIST_BINS; i++) {
+		if (bins[i])
+			seq_printf(m, " %llu:%u",
+				   blk_mq_poll_hist_bin_start(i), bins[i]);
+	}
+}
+
+static int hctx_poll_hist_show(void *data, struct seq_file *m)
+{
+	struct blk_mq_hw_ctx *hctx = data;
+	struct blk_mq_poll_hist *hist = READ_ONCE(hctx->poll_hist);
+	int bucket;
+
+	if (!hist)
+		return 0;
+
+	for (bucket = 0; bucket < (BLK_MQ_POLL_STATS_BKTS / 2); bucket++) {
+		seq_printf(m, "read  (%d Bytes): ", 1 << (9 + bucket));
+		print_poll_hist(m, hist->bins[2 * bucket]);
+		seq_puts(m, "\n");
+
+		seq_printf(m, "write (%d Bytes): ",  1 << (9 + bucket));
+		print_poll_hist(m, hist->bins[2 * bucket + 1]);
+		seq_puts(m, "\n");
+	}
+	return 0;
+}
+
+static ssize_t hctx_poll_hist_write(void *data, const char __user *buf,
+				    size_t count, loff_t *ppos)
+{
+	struct blk_mq_hw_ctx *hctx = data;
+	struct blk_mq_poll_hist *hist = READ_ONCE(hctx->poll_hist);
+
+	if (hist)
+		memset(hist, 0, sizeof(*hist));
+	return count;
+}
+
 static int hctx_dispatched_show(void *data, struct seq_file *m)
 {
 	struct blk_mq_hw_ctx *hctx = data;
@@ -787,6 +835,7 @@ static const struct blk_mq_debugfs_attr blk_mq_debugfs_hctx_attrs[] = {
 	{"sched_tags", 0400, hctx_sched_tags_show},
 	{"sched_tags_bitmap", 0400, hctx_sched_tags_bitmap_show},
 	{"io_poll", 0600, hctx_io_poll_show, hctx_io_poll_write},
+	{"poll_hist", 0600, hctx_poll_hist_show, hctx_poll_hist_write},
 	{"dispatched", 0600, hctx_dispatched_show, hctx_dispatched_write},
 	{"queued", 0600, hctx_queued_show, hctx_queued_write},
 	{"run", 0600, hctx_run_show, hctx_run_write},
@@ -191,6 +191,39 @@ unsigned int blk_mq_get_tag(struct blk_mq_alloc_data *data)
 	return tag + tag_offset;
 }
 
+/*
+ * Grab up to @nr_tags driver tags at once for a plugged batch of requests.
+ * Returns a mask of the tags obtained relative to @offset, or 0 if the
+ * caller should fall back to allocating one tag at a time.
+ */
+unsigned long blk_mq_get_tags(struct blk_mq_alloc_data *data, int nr_tags,
+			      unsigned int *offset)
+{
+	struct blk_mq_tags *tags = blk_mq_tags_from_data(data);
+	struct sbitmap_queue *bt = &tags->bitmap_tags;
+	unsigned long ret;
+	int i;
+
+	/* shared tags need their fair share checked for each tag */
+	if (data->shallow_depth ||
+	    data->flags & (BLK_MQ_REQ_RESERVED | BLK_MQ_REQ_INTERNAL) ||
+	    data->hctx->flags & BLK_MQ_F_TAG_SHARED)
+		return 0;
+
+	ret = __sbitmap_queue_get_batch(bt, nr_tags, offset);
+	if (!ret)
+		return 0;
+	*offset += tags->nr_reserved_tags;
+
+	/* see the comment at the end of blk_mq_get_tag() */
+	if (unlikely(test_bit(BLK_MQ_S_INACTIVE, &data->hctx->state))) {
+		for_each_set_bit(i, &ret, BITS_PER_LONG)
+			blk_mq_put_tag(tags, data->ctx, *offset + i);
+		return 0;
+	}
+	return ret;
+}
+
 void blk_mq_put_tag(struct blk_mq_tags *tags, struct blk_mq_ctx *ctx,
 		    unsigned int tag)
 {
@@ -205,6 +238,15 @@ void blk_mq_put_tag(struct blk_mq_tags *tags, struct blk_mq_ctx *ctx,
 	}
 }
 
+/*
+ * Free a batch of (non-reserved) driver tags of the same tag map.
+ */
+void blk_mq_put_tags(struct blk_mq_tags *tags, int *tag_array, int nr_tags)
+{
+	sbitmap_queue_clear_batch(&tags->bitmap_tags, tags->nr_reserved_tags,
+				  tag_array, nr_tags);
+}
+
 struct bt_iter_data {
 	struct blk_mq_hw_ctx *hctx;
 	busy_iter_fn *fn;
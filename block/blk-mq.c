@@ -61,6 +61,80 @@ static int blk_mq_poll_stats_bkt(const struct request *rq)
 	return bucket;
 }
 
+/* Age a size class once it has this many samples */
+#define BLK_MQ_POLL_HIST_DECAY	4096
+/* and don't trust it before it has this many */
+#define BLK_MQ_POLL_HIST_MIN	64
+
+static unsigned int blk_mq_poll_hist_bin(u64 nsecs)
+{
+	unsigned int msb, bin;
+
+	if (nsecs < (1ULL << BLK_MQ_POLL_HIST_SHIFT))
+		return 0;
+
+	msb = fls64(nsecs) - 1;
+	bin = ((msb - BLK_MQ_POLL_HIST_SHIFT) << BLK_MQ_POLL_HIST_SUB) +
+	      ((nsecs >> (msb - BLK_MQ_POLL_HIST_SUB)) &
+	       ((1U << BLK_MQ_POLL_HIST_SUB) - 1)) + 1;
+	return min_t(unsigned int, bin, BLK_MQ_POLL_HIST_BINS - 1);
+}
+
+/* Lowest latency in nsecs that is counted in @bin */
+u64 blk_mq_poll_hist_bin_start(unsigned int bin)
+{
+	unsigned int msb;
+
+	if (!bin)
+		return 0;
+
+	bin--;
+	msb = (bin >> BLK_MQ_POLL_HIST_SUB) + BLK_MQ_POLL_HIST_SHIFT;
+	return (1ULL << msb) +
+	       ((u64)(bin & ((1U << BLK_MQ_POLL_HIST_SUB) - 1)) <<
+		(msb - BLK_MQ_POLL_HIST_SUB));
+}
+
+static void blk_mq_poll_hist_add(struct request *rq, u64 now)
+{
+	struct blk_mq_poll_hist *hist = READ_ONCE(rq->mq_hctx->poll_hist);
+	unsigned int *bins, bin, wake_bin;
+	int bucket, i;
+
+	if (!hist || now < rq->io_start_time_ns)
+		return;
+
+	bucket = blk_mq_poll_stats_bkt(rq);
+	if (bucket < 0)
+		return;
+
+	bin = blk_mq_poll_hist_bin(now - rq->io_start_time_ns);
+	if ((rq->rq_flags & RQF_MQ_POLL_SLEPT) &&
+	    rq->poll_wake_time_ns > rq->io_start_time_ns) {
+		/*
+		 * If the poller found the request done as soon as it woke up,
+		 * the latency only tells us how long it slept: the request
+		 * completed at some point during the sleep. Count it just
+		 * below the sleep instead, so that the sleep keeps shrinking
+		 * until the poller wakes up before the completion again.
+		 */
+		wake_bin = blk_mq_poll_hist_bin(rq->poll_wake_time_ns -
+						rq->io_start_time_ns);
+		if (bin <= wake_bin + 1)
+			bin = wake_bin ? wake_bin - 1 : 0;
+	}
+
+	bins = hist->bins[bucket];
+	bins[bin]++;
+	if (++hist->nr_samples[bucket] < BLK_MQ_POLL_HIST_DECAY)
+		return;
+
+	/* halve the old samples so that we follow changes in the workload */
+	for (i = 0; i < BLK_MQ_POLL_HIST_BINS; i++)
+		bins[i] >>= 1;
+	hist->nr_samples[bucket] >>= 1;
+}
+
 /*
  * Check if any of the ctx, dispatch list or elevator
  * have pending work in this hardware queue.
@@ -347,6 +421,37 @@ static struct request *blk_mq_rq_ctx_init(struct blk_mq_alloc_data *data,
 	return rq;
 }
 
+/*
+ * Allocate data->nr_tags requests with one tag allocation.  The first one is
+ * returned, the rest are queued on data->cached_rqs for the following bios of
+ * the plug.  Each request owns a queue usage reference, the caller already
+ * holds the one for the returned request.
+ */
+static struct request *
+__blk_mq_alloc_requests_batch(struct blk_mq_alloc_data *data,
+			      u64 alloc_time_ns)
+{
+	struct request *rq, *first = NULL;
+	unsigned int tag_offset;
+	unsigned long tags;
+	int i, nr = 0;
+
+	tags = blk_mq_get_tags(data, data->nr_tags, &tag_offset);
+	if (unlikely(!tags))
+		return NULL;
+
+	for_each_set_bit(i, &tags, BITS_PER_LONG) {
+		rq = blk_mq_rq_ctx_init(data, tag_offset + i, alloc_time_ns);
+		if (!first)
+			first = rq;
+		else
+			list_add_tail(&rq->queuelist, data->cached_rqs);
+		nr++;
+	}
+	percpu_ref_get_many(&data->q->q_usage_counter, nr - 1);
+	return first;
+}
+
 static struct request *__blk_mq_alloc_request(struct blk_mq_alloc_data *data)
 {
 	struct request_queue *q = data->q;
@@ -381,6 +486,15 @@ static struct request *__blk_mq_alloc_request(struct blk_mq_alloc_data *data)
 	if (!(data->flags & BLK_MQ_REQ_INTERNAL))
 		blk_mq_tag_busy(data->hctx);
 
+	if (data->nr_tags > 1) {
+		struct request *rq;
+
+		rq = __blk_mq_alloc_requests_batch(data, alloc_time_ns);
+		if (rq)
+			return rq;
+		data->nr_tags = 1;
+	}
+
 	/*
 	 * Waiting allocations only fail because of an inactive hctx.  In that
 	 * case just retry the hctx assignment and tag allocation as CPU hotplug
@@ -540,6 +654,21 @@ void blk_mq_free_request(struct request *rq)
 }
 EXPORT_SYMBOL_GPL(blk_mq_free_request);
 
+/*
+ * Free the requests a plug allocated ahead of use but never issued.
+ */
+void blk_mq_free_plug_rqs(struct blk_plug *plug)
+{
+	struct request *rq;
+
+	while (!list_empty(&plug->cached_rqs)) {
+		rq = list_first_entry(&plug->cached_rqs, struct request,
+				      queuelist);
+		list_del_init(&rq->queuelist);
+		blk_mq_free_request(rq);
+	}
+}
+
 inline void __blk_mq_end_request(struct request *rq, blk_status_t error)
 {
 	u64 now = 0;
@@ -550,6 +679,7 @@ inline void __blk_mq_end_request(struct request *rq, blk_status_t error)
 	if (rq->rq_flags & RQF_STATS) {
 		blk_mq_poll_stats_start(rq->q);
 		blk_stat_add(rq, now);
+		blk_mq_poll_hist_add(rq, now);
 	}
 
 	if (rq->internal_tag != BLK_MQ_NO_TAG)
@@ -574,6 +704,118 @@ void blk_mq_end_request(struct request *rq, blk_status_t error)
 }
 EXPORT_SYMBOL(blk_mq_end_request);
 
+/**
+ * blk_mq_add_to_batch - gather a completed request into a completion batch
+ * @rq:		the completed request
+ * @iob:	batch to add @rq to, may be %NULL
+ * @ioerror:	non-zero if @rq completed with an error
+ * @complete:	driver function that ends the batch
+ *
+ * Description:
+ *    Called by drivers from their completion path instead of
+ *    blk_mq_complete_request().  Only successful requests without an I/O
+ *    scheduler, reserved tag or ->end_io callback are batched, and they
+ *    are completed in the context of the caller.  All requests of a batch
+ *    must be ended by the same @complete, which does the driver specific
+ *    teardown of each request and then calls blk_mq_end_request_batch().
+ *
+ *    Returns %false if @rq was not added, in which case the driver must
+ *    complete it the usual way.
+ */
+bool blk_mq_add_to_batch(struct request *rq, struct io_comp_batch *iob,
+			 int ioerror, void (*complete)(struct io_comp_batch *))
+{
+	if (!iob || ioerror || rq->end_io || rq->q->elevator ||
+	    blk_mq_tag_is_reserved(rq->mq_hctx->tags, rq->tag))
+		return false;
+
+	if (!iob->complete)
+		iob->complete = complete;
+	else if (iob->complete != complete)
+		return false;
+
+	WRITE_ONCE(rq->state, MQ_RQ_COMPLETE);
+	iob->need_ts |= blk_mq_need_time_stamp(rq);
+	list_add_tail(&rq->queuelist, &iob->req_list);
+	return true;
+}
+EXPORT_SYMBOL_GPL(blk_mq_add_to_batch);
+
+#define TAG_COMP_BATCH		32
+
+static void blk_mq_flush_tag_batch(struct blk_mq_hw_ctx *hctx,
+				   int *tag_array, int nr_tags)
+{
+	struct request_queue *q = hctx->queue;
+
+	blk_mq_put_tags(hctx->tags, tag_array, nr_tags);
+	blk_mq_sched_restart(hctx);
+	percpu_ref_put_many(&q->q_usage_counter, nr_tags);
+}
+
+/**
+ * blk_mq_end_request_batch - end all requests of a completion batch
+ * @iob:	the batch, filled by blk_mq_add_to_batch()
+ *
+ * Description:
+ *    Like blk_mq_end_request() with %BLK_STS_OK for every request of @iob,
+ *    but the timestamp is read once, and the driver tags and queue usage
+ *    references are returned in bulk for each hardware queue.
+ */
+void blk_mq_end_request_batch(struct io_comp_batch *iob)
+{
+	int tags[TAG_COMP_BATCH], nr_tags = 0;
+	struct blk_mq_hw_ctx *cur_hctx = NULL;
+	struct request *rq, *next;
+	u64 now = 0;
+
+	if (iob->need_ts)
+		now = ktime_get_ns();
+
+	list_for_each_entry_safe(rq, next, &iob->req_list, queuelist) {
+		struct blk_mq_hw_ctx *hctx = rq->mq_hctx;
+		struct request_queue *q = rq->q;
+
+		list_del_init(&rq->queuelist);
+		if (blk_update_request(rq, BLK_STS_OK, blk_rq_bytes(rq)))
+			BUG();
+
+		if (rq->rq_flags & RQF_STATS) {
+			blk_mq_poll_stats_start(q);
+			blk_stat_add(rq, now);
+			blk_mq_poll_hist_add(rq, now);
+		}
+		blk_account_io_done(rq, now);
+
+		rq->mq_ctx->rq_completed[rq_is_sync(rq)]++;
+		if (rq->rq_flags & RQF_MQ_INFLIGHT)
+			atomic_dec(&hctx->nr_active);
+		if (unlikely(laptop_mode && !blk_rq_is_passthrough(rq)))
+			laptop_io_completion(q->backing_dev_info);
+		rq_qos_done(q, rq);
+
+		WRITE_ONCE(rq->state, MQ_RQ_IDLE);
+		if (!refcount_dec_and_test(&rq->ref))
+			continue;
+
+		blk_crypto_free_request(rq);
+		blk_pm_mark_last_busy(rq);
+		rq->mq_hctx = NULL;
+
+		if (nr_tags == TAG_COMP_BATCH || cur_hctx != hctx) {
+			if (cur_hctx)
+				blk_mq_flush_tag_batch(cur_hctx, tags, nr_tags);
+			nr_tags = 0;
+			cur_hctx = hctx;
+		}
+		tags[nr_tags++] = rq->tag;
+	}
+
+	if (nr_tags)
+		blk_mq_flush_tag_batch(cur_hctx, tags, nr_tags);
+}
+EXPORT_SYMBOL_GPL(blk_mq_end_request_batch);
+
 static void __blk_mq_complete_request_remote(void *data)
 {
 	struct request *rq = data;
@@ -2033,6 +2275,33 @@ static void blk_add_rq_to_plug(struct blk_plug *plug, struct request *rq)
 	}
 }
 
+/*
+ * Use a request the plug allocated ahead of time, if it was set up for the
+ * same queue and hardware queue type the bio maps to.
+ */
+static struct request *blk_mq_get_cached_request(struct request_queue *q,
+		struct blk_plug *plug, struct bio *bio)
+{
+	struct request *rq;
+
+	if (!plug || list_empty(&plug->cached_rqs))
+		return NULL;
+
+	rq = list_first_entry(&plug->cached_rqs, struct request, queuelist);
+	if (rq->q != q || op_is_flush(bio->bi_opf) ||
+	    blk_mq_map_queue(q, bio->bi_opf, rq->mq_ctx) != rq->mq_hctx)
+		return NULL;
+
+	list_del_init(&rq->queuelist);
+	rq->cmd_flags = bio->bi_opf;
+	if (blk_mq_need_time_stamp(rq))
+		rq->start_time_ns = ktime_get_ns();
+
+	/* the cached request holds its own queue reference */
+	blk_queue_exit(q);
+	return rq;
+}
+
 /**
  * blk_mq_make_request - Create and send a request to block device.
  * @q: Request queue pointer.
@@ -2078,13 +2347,24 @@ blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 
 	rq_qos_throttle(q, bio);
 
-	data.cmd_flags = bio->bi_opf;
-	rq = __blk_mq_alloc_request(&data);
-	if (unlikely(!rq)) {
-		rq_qos_cleanup(q, bio);
-		if (bio->bi_opf & REQ_NOWAIT)
-			bio_wouldblock_error(bio);
-		goto queue_exit;
+	plug = blk_mq_plug(q, bio);
+	rq = blk_mq_get_cached_request(q, plug, bio);
+	if (rq) {
+		data.hctx = rq->mq_hctx;
+	} else {
+		data.cmd_flags = bio->bi_opf;
+		if (plug && !is_flush_fua) {
+			data.nr_tags = plug->nr_ios;
+			data.cached_rqs = &plug->cached_rqs;
+			plug->nr_ios = 1;
+		}
+		rq = __blk_mq_alloc_request(&data);
+		if (unlikely(!rq)) {
+			rq_qos_cleanup(q, bio);
+			if (bio->bi_opf & REQ_NOWAIT)
+				bio_wouldblock_error(bio);
+			goto queue_exit;
+		}
 	}
 
 	trace_block_getrq(q, bio, bio->bi_opf);
@@ -2103,7 +2383,6 @@ blk_qc_t blk_mq_make_request(struct request_queue *q, struct bio *bio)
 		return BLK_QC_T_NONE;
 	}
 
-	plug = blk_mq_plug(q, bio);
 	if (unlikely(is_flush_fua)) {
 		/* Bypass scheduler for flush requests */
 		blk_insert_flush(rq);
@@ -3131,6 +3410,7 @@ struct request_queue *blk_mq_init_allocated_queue(struct blk_mq_tag_set *set,
 	 * Default to classic polling
 	 */
 	q->poll_nsec = BLK_MQ_POLL_CLASSIC;
+	q->poll_percentile = BLK_MQ_POLL_DEF_PERCENTILE;
 
 	blk_mq_init_cpu_queues(q, set->nr_hw_queues);
 	blk_mq_add_queue_tag_set(set, q);
@@ -3603,6 +3883,44 @@ static void blk_mq_poll_stats_fn(struct blk_stat_callback *cb)
 	}
 }
 
+/*
+ * Sleep time from the completion latency histogram of @bucket on @hctx:
+ * poll_percentile percent of recent completions took less than this.
+ * Returns false if there are not enough samples yet.
+ */
+static bool blk_mq_poll_hist_nsecs(struct request_queue *q,
+				   struct blk_mq_hw_ctx *hctx, int bucket,
+				   unsigned long *nsecs)
+{
+	struct blk_mq_poll_hist *hist = READ_ONCE(hctx->poll_hist);
+	unsigned int total = 0, sum = 0, target, *bins;
+	int i;
+
+	if (!hist) {
+		hist = kzalloc_node(sizeof(*hist), GFP_NOWAIT | __GFP_NOWARN,
+				    hctx->numa_node);
+		if (hist && cmpxchg(&hctx->poll_hist, NULL, hist))
+			kfree(hist);
+		return false;
+	}
+
+	bins = hist->bins[bucket];
+	for (i = 0; i < BLK_MQ_POLL_HIST_BINS; i++)
+		total += READ_ONCE(bins[i]);
+	if (total < BLK_MQ_POLL_HIST_MIN)
+		return false;
+
+	target = DIV_ROUND_UP(total * q->poll_percentile, 100);
+	for (i = 0; i < BLK_MQ_POLL_HIST_BINS - 1; i++) {
+		sum += READ_ONCE(bins[i]);
+		if (sum >= target)
+			break;
+	}
+
+	*nsecs = blk_mq_poll_hist_bin_start(i);
+	return true;
+}
+
 static unsigned long blk_mq_poll_nsecs(struct request_queue *q,
 				       struct request *rq)
 {
@@ -3616,19 +3934,23 @@ static unsigned long blk_mq_poll_nsecs(struct request_queue *q,
 	if (!blk_poll_stats_enable(q))
 		return 0;
 
-	/*
-	 * As an optimistic guess, use half of the mean service time
-	 * for this type of request. We can (and should) make this smarter.
-	 * For instance, if the completion latencies are tight, we can
-	 * get closer than just half the mean. This is especially
-	 * important on devices where the completion latencies are longer
-	 * than ~10 usec. We do use the stats for the relevant IO size
-	 * if available which does lead to better estimates.
-	 */
 	bucket = blk_mq_poll_stats_bkt(rq);
 	if (bucket < 0)
 		return ret;
 
+	/*
+	 * Sleep until a low percentile of the completion latencies seen for
+	 * this type and size of request on this hardware queue, and spin
+	 * from there. Unlike a fraction of the mean, this stays put for
+	 * devices with bimodal latencies and for mixed read and write sizes.
+	 */
+	if (blk_mq_poll_hist_nsecs(q, rq->mq_hctx, bucket, &ret))
+		return ret;
+
+	/*
+	 * Until the histogram has filled up, use half of the mean service
+	 * time for this type of request as an optimistic guess.
+	 */
 	if (q->poll_stat[bucket].nr_samples)
 		ret = (q->poll_stat[bucket].mean + 1) / 2;
 
@@ -3649,7 +3971,7 @@ static bool blk_mq_poll_hybrid_sleep(struct request_queue *q,
 	/*
 	 * If we get here, hybrid polling is enabled. Hence poll_nsec can be:
 	 *
-	 *  0:	use half of prev avg
+	 *  0:	use the completion latency histograms
 	 * >0:	use this specific value
 	 */
 	if (q->poll_nsec > 0)
@@ -3661,11 +3983,8 @@ static bool blk_mq_poll_hybrid_sleep(struct request_queue *q,
 		return false;
 
 	rq->rq_flags |= RQF_MQ_POLL_SLEPT;
+	rq->poll_wake_time_ns = ktime_get_ns() + nsecs;
 
-	/*
-	 * This will be replaced with the stats tracking code, using
-	 * 'avg_completion_time / 2' as the pre-sleep target.
-	 */
 	kt = nsecs;
 
 	mode = HRTIMER_MODE_REL;
@@ -3753,11 +4072,14 @@ int blk_poll(struct request_queue *q, blk_qc_t cookie, bool spin)
 
 	state = current->state;
 	do {
+		DEFINE_IO_COMP_BATCH(iob);
 		int ret;
 
 		hctx->poll_invoked++;
 
-		ret = q->mq_ops->poll(hctx);
+		ret = q->mq_ops->poll(hctx, &iob);
+		if (!list_empty(&iob.req_list))
+			iob.complete(&iob);
 		if (ret > 0) {
 			hctx->poll_success++;
 			__set_current_state(TASK_RUNNING);
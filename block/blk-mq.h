@@ -37,6 +37,29 @@ struct blk_mq_ctx {
 	struct kobject		kobj;
 } ____cacheline_aligned_in_smp;
 
+/*
+ * Completion latency histograms for hybrid polling. Bin 0 counts
+ * completions under 1us, above that each power of two is split into
+ * 1 << BLK_MQ_POLL_HIST_SUB bins.
+ */
+#define BLK_MQ_POLL_HIST_SHIFT	10
+#define BLK_MQ_POLL_HIST_SUB	2
+#define BLK_MQ_POLL_HIST_BINS	64
+
+/**
+ * struct blk_mq_poll_hist - Per hardware queue completion latencies
+ * @nr_samples: Samples per size class since the class was last aged.
+ * @bins: Latency histogram per size class, see blk_mq_poll_stats_bkt().
+ *
+ * Updates are not serialized, so the counts are approximate.
+ */
+struct blk_mq_poll_hist {
+	unsigned int	nr_samples[BLK_MQ_POLL_STATS_BKTS];
+	unsigned int	bins[BLK_MQ_POLL_STATS_BKTS][BLK_MQ_POLL_HIST_BINS];
+};
+
+u64 blk_mq_poll_hist_bin_start(unsigned int bin);
+
 void blk_mq_exit_queue(struct request_queue *q);
 int blk_mq_update_nr_requests(struct request_queue *q, unsigned int nr);
 void blk_mq_wake_waiters(struct request_queue *q);
@@ -45,6 +68,7 @@ void blk_mq_add_to_requeue_list(struct request *rq, bool at_head,
 				bool kick_requeue_list);
 void blk_mq_flush_busy_ctxs(struct blk_mq_hw_ctx *hctx, struct list_head *list);
 bool blk_mq_get_driver_tag(struct request *rq);
+void blk_mq_free_plug_rqs(struct blk_plug *plug);
 struct request *blk_mq_dequeue_from_ctx(struct blk_mq_hw_ctx *hctx,
 					struct blk_mq_ctx *start);
 
@@ -153,6 +177,10 @@ struct blk_mq_alloc_data {
 	unsigned int shallow_depth;
 	unsigned int cmd_flags;
 
+	/* allocate multiple requests, the extra ones go to @cached_rqs */
+	unsigned int nr_tags;
+	struct list_head *cached_rqs;
+
 	/* input & output parameter */
 	struct blk_mq_ctx *ctx;
 	struct blk_mq_hw_ctx *hctx;
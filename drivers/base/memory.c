@@ -796,6 +796,55 @@ int walk_memory_blocks(unsigned long start, unsigned long size,
 	return ret;
 }
 
+static int memory_block_check_offline(struct memory_block *mem, void *arg)
+{
+	return mem->state == MEM_OFFLINE ? 0 : -EBUSY;
+}
+
+static int memory_block_set_online(struct memory_block *mem, void *arg)
+{
+	device_lock(&mem->dev);
+	mem->state = MEM_ONLINE;
+	mem->dev.offline = false;
+	device_unlock(&mem->dev);
+	kobject_uevent(&mem->dev.kobj, KOBJ_ONLINE);
+	return 0;
+}
+
+/**
+ * online_memory_block_range - online the memory blocks of a range at once
+ *
+ * @start: start address of the memory range
+ * @size: size of the memory range
+ * @online_type: MMOP_* to online the memory with
+ * @nid: node the memory range belongs to
+ *
+ * Online the offline memory blocks covering [start, start + size) with a
+ * single online_pages() call rather than one per block: the memmap of the
+ * whole range is initialized in one go, and the zone, zonelist and
+ * watermark updates and the memory notifiers run once.  This is what
+ * freshly hot-added memory goes through.
+ *
+ * Returns 0 on success.  On failure, no block was onlined.
+ *
+ * Called under device_hotplug_lock.
+ */
+int online_memory_block_range(unsigned long start, unsigned long size,
+			      int online_type, int nid)
+{
+	int ret;
+
+	ret = walk_memory_blocks(start, size, NULL, memory_block_check_offline);
+	if (ret)
+		return ret;
+
+	ret = online_pages(PFN_DOWN(start), PFN_DOWN(size), online_type, nid);
+	if (ret)
+		return ret;
+
+	return walk_memory_blocks(start, size, NULL, memory_block_set_online);
+}
+
 struct for_each_memory_block_cb_data {
 	walk_memory_blocks_func_t func;
 	void *arg;
@@ -207,6 +207,34 @@ void node_set_perf_attrs(unsigned int nid, struct node_hmem_attrs *hmem_attrs,
 	}
 }
 
+/**
+ * node_get_perf_attrs - Get the performance values for given access class
+ * @nid: Node identifier to be queried
+ * @hmem_attrs: Filled with the node's heterogeneous memory attributes
+ * @access: The access class the attributes were registered for
+ *
+ * Returns 0 on success, or -ENODEV if no attributes have been registered
+ * for @access on @nid.
+ */
+int node_get_perf_attrs(unsigned int nid, struct node_hmem_attrs *hmem_attrs,
+			unsigned access)
+{
+	struct node_access_nodes *c;
+	struct node *node;
+
+	if (!node_online(nid) || !node_devices[nid])
+		return -ENODEV;
+
+	node = node_devices[nid];
+	list_for_each_entry(c, &node->access_list, list_node) {
+		if (c->access != access)
+			continue;
+		*hmem_attrs = c->hmem_attrs;
+		return 0;
+	}
+	return -ENODEV;
+}
+
 /**
  * struct node_cache_info - Internal tracking for memory node caches
  * @dev:	Device represeting the cache level
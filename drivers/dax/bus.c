@@ -1,5 +1,6 @@
 // SPDX-License-Identifier: GPL-2.0
 /* Copyright(c) 2017-2018 Intel Corporation. All rights reserved. */
+#include <linux/memory_hotplug.h>
 #include <linux/memremap.h>
 #include <linux/device.h>
 #include <linux/mutex.h>
@@ -329,6 +330,128 @@ static ssize_t numa_node_show(struct device *dev,
 }
 static DEVICE_ATTR_RO(numa_node);
 
+/*
+ * The kmem attributes are consumed when kmem binds to the device, so they
+ * can only change while the device is unbound.
+ */
+static int dev_dax_lock_unbound(struct device *dev)
+{
+	device_lock(dev);
+	if (dev->driver) {
+		device_unlock(dev);
+		return -EBUSY;
+	}
+	return 0;
+}
+
+static const char *const dev_dax_online_types[] = {
+	[MMOP_OFFLINE] = "offline",
+	[MMOP_ONLINE] = "online",
+	[MMOP_ONLINE_KERNEL] = "online_kernel",
+	[MMOP_ONLINE_MOVABLE] = "online_movable",
+};
+
+static ssize_t online_type_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct dev_dax *dev_dax = to_dev_dax(dev);
+
+	if (dev_dax->online_type == DEV_DAX_ONLINE_DEFAULT)
+		return sprintf(buf, "default\n");
+	return sprintf(buf, "%s\n",
+		       dev_dax_online_types[dev_dax->online_type]);
+}
+
+static ssize_t online_type_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct dev_dax *dev_dax = to_dev_dax(dev);
+	int online_type, rc;
+
+	if (sysfs_streq(buf, "default")) {
+		online_type = DEV_DAX_ONLINE_DEFAULT;
+	} else {
+		online_type = sysfs_match_string(dev_dax_online_types, buf);
+		if (online_type < 0)
+			return online_type;
+	}
+
+	rc = dev_dax_lock_unbound(dev);
+	if (rc)
+		return rc;
+	dev_dax->online_type = online_type;
+	device_unlock(dev);
+
+	return len;
+}
+static DEVICE_ATTR_RW(online_type);
+
+static ssize_t adistance_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct dev_dax *dev_dax = to_dev_dax(dev);
+
+	return sprintf(buf, "%d\n", dev_dax->adistance);
+}
+
+static ssize_t adistance_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct dev_dax *dev_dax = to_dev_dax(dev);
+	int adistance, rc;
+
+	rc = kstrtoint(buf, 0, &adistance);
+	if (rc)
+		return rc;
+	if (adistance < 0)
+		return -EINVAL;
+
+	rc = dev_dax_lock_unbound(dev);
+	if (rc)
+		return rc;
+	dev_dax->adistance = adistance;
+	device_unlock(dev);
+
+	return len;
+}
+static DEVICE_ATTR_RW(adistance);
+
+static ssize_t default_fallback_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct dev_dax *dev_dax = to_dev_dax(dev);
+
+	return sprintf(buf, "%d\n", dev_dax->default_fallback);
+}
+
+static ssize_t default_fallback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct dev_dax *dev_dax = to_dev_dax(dev);
+	bool fallback;
+	int rc;
+
+	rc = kstrtobool(buf, &fallback);
+	if (rc)
+		return rc;
+
+	rc = dev_dax_lock_unbound(dev);
+	if (rc)
+		return rc;
+	dev_dax->default_fallback = fallback;
+	device_unlock(dev);
+
+	return len;
+}
+static DEVICE_ATTR_RW(default_fallback);
+
+static bool dev_dax_is_kmem_attr(struct attribute *a)
+{
+	return a == &dev_attr_online_type.attr ||
+	       a == &dev_attr_adistance.attr ||
+	       a == &dev_attr_default_fallback.attr;
+}
+
 static umode_t dev_dax_visible(struct kobject *kobj, struct attribute *a, int n)
 {
 	struct device *dev = container_of(kobj, struct device, kobj);
@@ -338,6 +461,10 @@ static umode_t dev_dax_visible(struct kobject *kobj, struct attribute *a, int n)
 		return 0;
 	if (a == &dev_attr_numa_node.attr && !IS_ENABLED(CONFIG_NUMA))
 		return 0;
+	/* Only devices on the dax bus can be bound to kmem */
+	if (dev_dax_is_kmem_attr(a) &&
+	    (!IS_ENABLED(CONFIG_DEV_DAX_KMEM) || dev->bus != &dax_bus_type))
+		return 0;
 	return a->mode;
 }
 
@@ -347,6 +474,9 @@ static struct attribute *dev_dax_attributes[] = {
 	&dev_attr_target_node.attr,
 	&dev_attr_resource.attr,
 	&dev_attr_numa_node.attr,
+	&dev_attr_online_type.attr,
+	&dev_attr_adistance.attr,
+	&dev_attr_default_fallback.attr,
 	NULL,
 };
 
@@ -436,6 +566,8 @@ struct dev_dax *__devm_create_dev_dax(struct dax_region *dax_region, int id,
 	dev_dax->dax_dev = dax_dev;
 	dev_dax->region = dax_region;
 	dev_dax->target_node = dax_region->target_node;
+	dev_dax->online_type = DEV_DAX_ONLINE_DEFAULT;
+	dev_dax->default_fallback = true;
 	kref_get(&dax_region->kref);
 
 	inode = dax_inode(dax_dev);
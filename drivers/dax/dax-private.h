@@ -45,6 +45,12 @@ struct dax_region {
  * @pgmap - pgmap for memmap setup / lifetime (driver owned)
  * @dax_mem_res: physical address range of hotadded DAX memory
  * @dax_mem_name: name for hotadded DAX memory via add_memory_driver_managed()
+ * @online_type: MMOP_* the kmem driver onlines the memory with, or
+ *	DEV_DAX_ONLINE_DEFAULT to follow the memory hotplug default
+ * @adistance: abstract distance kmem registers the memory with, 0 to
+ *	derive it from platform data
+ * @default_fallback: whether kmem lets the target node serve allocations
+ *	that don't ask for it
  */
 struct dev_dax {
 	struct dax_region *region;
@@ -53,8 +59,13 @@ struct dev_dax {
 	struct device dev;
 	struct dev_pagemap pgmap;
 	struct resource *dax_kmem_res;
+	int online_type;
+	int adistance;
+	bool default_fallback;
 };
 
+#define DEV_DAX_ONLINE_DEFAULT	(-1)
+
 static inline struct dev_dax *to_dev_dax(struct device *dev)
 {
 	return container_of(dev, struct dev_dax, dev);
@@ -11,6 +11,8 @@
 #include <linux/fs.h>
 #include <linux/mm.h>
 #include <linux/mman.h>
+#include <linux/memory-tiers.h>
+#include <linux/memory_hotplug.h>
 #include "dax-private.h"
 #include "bus.h"
 
@@ -19,6 +21,28 @@ static const char *kmem_name;
 /* Set if any memory will remain added when the driver will be unloaded. */
 static bool any_hotremove_failed;
 
+/* Memory types of the nodes this driver hot-added memory to */
+static LIST_HEAD(kmem_memory_types);
+static DEFINE_MUTEX(kmem_memory_type_lock);
+
+static struct memory_dev_type *kmem_find_alloc_memory_type(int adist)
+{
+	struct memory_dev_type *mtype;
+
+	mutex_lock(&kmem_memory_type_lock);
+	mtype = mt_find_alloc_memory_type(adist, &kmem_memory_types);
+	mutex_unlock(&kmem_memory_type_lock);
+
+	return mtype;
+}
+
+static void kmem_put_memory_types(void)
+{
+	mutex_lock(&kmem_memory_type_lock);
+	mt_put_memory_types(&kmem_memory_types);
+	mutex_unlock(&kmem_memory_type_lock);
+}
+
 int dev_dax_kmem_probe(struct device *dev)
 {
 	struct dev_dax *dev_dax = to_dev_dax(dev);
@@ -28,7 +52,10 @@ int dev_dax_kmem_probe(struct device *dev)
 	resource_size_t kmem_end;
 	struct resource *new_res;
 	const char *new_res_name;
+	struct memory_dev_type *mtype;
 	int numa_node;
+	int adist = MEMTIER_DEFAULT_DAX_ADISTANCE;
+	int online_type;
 	int rc;
 
 	/*
@@ -44,6 +71,18 @@ int dev_dax_kmem_probe(struct device *dev)
 		return -EINVAL;
 	}
 
+	/*
+	 * An abstract distance set on the device wins.  Otherwise, without
+	 * platform performance data, place the memory in a tier below DRAM.
+	 */
+	if (dev_dax->adistance)
+		adist = dev_dax->adistance;
+	else
+		mt_calc_adistance(numa_node, &adist);
+	mtype = kmem_find_alloc_memory_type(adist);
+	if (IS_ERR(mtype))
+		return PTR_ERR(mtype);
+
 	/* Hotplug starting at the beginning of the next block: */
 	kmem_start = ALIGN(res->start, memory_block_size_bytes());
 
@@ -67,6 +106,20 @@ int dev_dax_kmem_probe(struct device *dev)
 		return -EBUSY;
 	}
 
+	/* The memory type has to be known by the time the node is onlined */
+	init_node_memory_type(numa_node, mtype);
+
+	/*
+	 * Keep the node out of the default fallback before any of its memory
+	 * is onlined, so that no kernel allocation lands there by accident.
+	 */
+	if (!dev_dax->default_fallback)
+		node_set_default_alloc(numa_node, false);
+
+	online_type = dev_dax->online_type;
+	if (online_type == DEV_DAX_ONLINE_DEFAULT)
+		online_type = mhp_get_default_online_type();
+
 	/*
 	 * Set flags appropriate for System RAM.  Leave ..._BUSY clear
 	 * so that add_memory() can add a child resource.  Do not
@@ -80,8 +133,12 @@ int dev_dax_kmem_probe(struct device *dev)
 	 * automatically.
 	 */
 	rc = add_memory_driver_managed(numa_node, new_res->start,
-				       resource_size(new_res), kmem_name);
+				       resource_size(new_res), kmem_name,
+				       online_type);
 	if (rc) {
+		if (!node_state(numa_node, N_MEMORY))
+			node_set_default_alloc(numa_node, true);
+		clear_node_memory_type(numa_node, mtype);
 		release_resource(new_res);
 		kfree(new_res);
 		kfree(new_res_name);
@@ -117,6 +174,11 @@ static int dev_dax_kmem_remove(struct device *dev)
 		return rc;
 	}
 
+	clear_node_memory_type(dev_dax->target_node, NULL);
+	/* A node with no memory left goes back to the default fallback */
+	if (!node_state(dev_dax->target_node, N_MEMORY))
+		node_set_default_alloc(dev_dax->target_node, true);
+
 	/* Release and free dax resources */
 	release_resource(res);
 	kfree(res);
@@ -157,8 +219,10 @@ static int __init dax_kmem_init(void)
 		return -ENOMEM;
 
 	rc = dax_driver_register(&device_dax_kmem_driver);
-	if (rc)
+	if (rc) {
+		kmem_put_memory_types();
 		kfree_const(kmem_name);
+	}
 	return rc;
 }
 
@@ -167,6 +231,7 @@ static void __exit dax_kmem_exit(void)
 	dax_driver_unregister(&device_dax_kmem_driver);
 	if (!any_hotremove_failed)
 		kfree_const(kmem_name);
+	kmem_put_memory_types();
 }
 
 MODULE_AUTHOR("Intel Corporation");
@@ -10,6 +10,7 @@
 #include <linux/delay.h>
 #include <linux/errno.h>
 #include <linux/hdreg.h>
+#include <linux/io_uring.h>
 #include <linux/kernel.h>
 #include <linux/module.h>
 #include <linux/backing-dev.h>
@@ -91,6 +92,7 @@ static struct class *nvme_subsys_class;
 
 static int nvme_revalidate_disk(struct gendisk *disk);
 static void nvme_put_subsystem(struct nvme_subsystem *subsys);
+static struct nvme_ns *nvme_find_get_ns(struct nvme_ctrl *ctrl, unsigned nsid);
 static void nvme_remove_invalid_namespaces(struct nvme_ctrl *ctrl,
 					   unsigned nsid);
 
@@ -294,6 +296,20 @@ void nvme_complete_rq(struct request *req)
 }
 EXPORT_SYMBOL_GPL(nvme_complete_rq);
 
+/*
+ * The successful path of nvme_complete_rq() for a request of a completion
+ * batch, the block layer part is done by blk_mq_end_request_batch().
+ */
+void nvme_complete_batch_req(struct request *req)
+{
+	trace_nvme_complete_rq(req);
+	nvme_cleanup_cmd(req);
+	if (nvme_req(req)->ctrl->kas)
+		nvme_req(req)->ctrl->comp_seen = true;
+	nvme_trace_bio_complete(req, BLK_STS_OK);
+}
+EXPORT_SYMBOL_GPL(nvme_complete_batch_req);
+
 bool nvme_cancel_request(struct request *req, void *data, bool reserved)
 {
 	dev_dbg_ratelimited(((struct nvme_ctrl *) data)->device,
@@ -1502,6 +1518,203 @@ static int nvme_user_cmd64(struct nvme_ctrl *ctrl, struct nvme_ns *ns,
 	return status;
 }
 
+/*
+ * Per-command state of NVME_URING_CMD_IO, kept in io_uring_cmd->pdu.  The
+ * bio is only needed until the request completes, the request after that.
+ */
+struct nvme_uring_cmd_pdu {
+	union {
+		struct bio *bio;
+		struct request *req;
+	};
+	void *meta; /* kernel copy of the metadata */
+	void __user *meta_buffer;
+	u32 meta_len;
+	blk_qc_t cookie;
+	struct request_queue *q; /* where to poll for the cookie */
+};
+
+static inline struct nvme_uring_cmd_pdu *nvme_uring_cmd_pdu(
+		struct io_uring_cmd *ioucmd)
+{
+	BUILD_BUG_ON(sizeof(struct nvme_uring_cmd_pdu) > sizeof(ioucmd->pdu));
+	return (struct nvme_uring_cmd_pdu *)&ioucmd->pdu;
+}
+
+static void nvme_uring_task_cb(struct io_uring_cmd *ioucmd)
+{
+	struct nvme_uring_cmd_pdu *pdu = nvme_uring_cmd_pdu(ioucmd);
+	struct request *req = pdu->req;
+	u64 result;
+	int status;
+
+	/* with the submitter gone, there is nobody to copy back to */
+	if ((nvme_req(req)->flags & NVME_REQ_CANCELLED) ||
+	    (ioucmd->flags & IO_URING_CMD_TASK_DEAD))
+		status = -EINTR;
+	else
+		status = nvme_req(req)->status;
+	result = le64_to_cpu(nvme_req(req)->result.u64);
+
+	if (pdu->meta && !status && req_op(req) == REQ_OP_DRV_IN) {
+		if (copy_to_user(pdu->meta_buffer, pdu->meta, pdu->meta_len))
+			status = -EFAULT;
+	}
+	kfree(pdu->meta);
+
+	if (req->bio)
+		blk_rq_unmap_user(req->bio);
+	blk_mq_free_request(req);
+
+	io_uring_cmd_done(ioucmd, status, result);
+}
+
+static void nvme_uring_cmd_end_io(struct request *req, blk_status_t err)
+{
+	struct io_uring_cmd *ioucmd = req->end_io_data;
+	struct nvme_uring_cmd_pdu *pdu = nvme_uring_cmd_pdu(ioucmd);
+	struct bio *bio = pdu->bio;
+
+	/* the command was copied into the sqe of the queue by now */
+	kfree(nvme_req(req)->cmd);
+	nvme_req(req)->cmd = NULL;
+
+	/* hand the bio back for unmapping, the pdu tracks the request now */
+	req->bio = bio;
+	pdu->req = req;
+
+	/* copying data and metadata back needs the submitter's context */
+	io_uring_cmd_complete_in_task(ioucmd, nvme_uring_task_cb);
+}
+
+static int nvme_uring_cmd_io(struct nvme_ctrl *ctrl, struct nvme_ns *ns,
+		struct io_uring_cmd *ioucmd, unsigned int issue_flags)
+{
+	struct nvme_uring_cmd_pdu *pdu = nvme_uring_cmd_pdu(ioucmd);
+	const struct nvme_uring_cmd *cmd = ioucmd->cmd;
+	struct request_queue *q = ns->queue;
+	blk_mq_req_flags_t blk_flags = 0;
+	struct nvme_command *c;
+	struct request *req;
+	void __user *ubuffer;
+	unsigned int op, timeout;
+	u32 bufflen;
+	int ret;
+
+	if (!capable(CAP_SYS_ADMIN))
+		return -EACCES;
+	if (READ_ONCE(cmd->flags))
+		return -EINVAL;
+
+	/* the request outlives this call, so the command can't be on stack */
+	c = kzalloc(sizeof(*c), GFP_KERNEL);
+	if (!c)
+		return -ENOMEM;
+	c->common.opcode = READ_ONCE(cmd->opcode);
+	c->common.nsid = cpu_to_le32(READ_ONCE(cmd->nsid));
+	c->common.cdw2[0] = cpu_to_le32(READ_ONCE(cmd->cdw2));
+	c->common.cdw2[1] = cpu_to_le32(READ_ONCE(cmd->cdw3));
+	c->common.cdw10 = cpu_to_le32(READ_ONCE(cmd->cdw10));
+	c->common.cdw11 = cpu_to_le32(READ_ONCE(cmd->cdw11));
+	c->common.cdw12 = cpu_to_le32(READ_ONCE(cmd->cdw12));
+	c->common.cdw13 = cpu_to_le32(READ_ONCE(cmd->cdw13));
+	c->common.cdw14 = cpu_to_le32(READ_ONCE(cmd->cdw14));
+	c->common.cdw15 = cpu_to_le32(READ_ONCE(cmd->cdw15));
+
+	ubuffer = nvme_to_user_ptr(READ_ONCE(cmd->addr));
+	bufflen = READ_ONCE(cmd->data_len);
+	pdu->meta = NULL;
+	pdu->meta_buffer = nvme_to_user_ptr(READ_ONCE(cmd->metadata));
+	pdu->meta_len = READ_ONCE(cmd->metadata_len);
+	timeout = msecs_to_jiffies(READ_ONCE(cmd->timeout_ms));
+
+	/* I/O commands only, nothing to quiesce around them */
+	nvme_passthru_start(ctrl, ns, c->common.opcode);
+
+	op = nvme_is_write(c) ? REQ_OP_DRV_OUT : REQ_OP_DRV_IN;
+	if ((issue_flags & IO_URING_F_IOPOLL) &&
+	    test_bit(QUEUE_FLAG_POLL, &q->queue_flags))
+		op |= REQ_HIPRI;
+	if (issue_flags & IO_URING_F_NONBLOCK)
+		blk_flags |= BLK_MQ_REQ_NOWAIT;
+
+	req = blk_mq_alloc_request(q, op, blk_flags);
+	if (IS_ERR(req)) {
+		ret = PTR_ERR(req);
+		goto out_free_cmd;
+	}
+	req->cmd_flags |= REQ_FAILFAST_DRIVER;
+	nvme_clear_nvme_request(req);
+	nvme_req(req)->cmd = c;
+	nvme_req(req)->flags |= NVME_REQ_USERCMD;
+	req->timeout = timeout ? timeout : ADMIN_TIMEOUT;
+
+	pdu->bio = NULL;
+	if (ubuffer && bufflen) {
+		ret = blk_rq_map_user(q, req, NULL, ubuffer, bufflen,
+				GFP_KERNEL);
+		if (ret)
+			goto out_free_req;
+		pdu->bio = req->bio;
+		pdu->bio->bi_disk = ns->disk;
+		if (pdu->meta_buffer && pdu->meta_len) {
+			pdu->meta = nvme_add_user_metadata(pdu->bio,
+					pdu->meta_buffer, pdu->meta_len, 0,
+					nvme_is_write(c));
+			if (IS_ERR(pdu->meta)) {
+				ret = PTR_ERR(pdu->meta);
+				goto out_unmap;
+			}
+			req->cmd_flags |= REQ_INTEGRITY;
+		}
+	}
+
+	/* the request may be gone once it is issued, polling uses the tag */
+	pdu->q = q;
+	WRITE_ONCE(pdu->cookie, request_to_qc_t(req->mq_hctx, req));
+	req->end_io_data = ioucmd;
+	blk_execute_rq_nowait(q, ns->disk, req, 0, nvme_uring_cmd_end_io);
+	return -EIOCBQUEUED;
+
+out_unmap:
+	blk_rq_unmap_user(pdu->bio);
+out_free_req:
+	blk_mq_free_request(req);
+out_free_cmd:
+	kfree(c);
+	return ret;
+}
+
+static int nvme_uring_cmd(struct block_device *bdev,
+		struct io_uring_cmd *ioucmd, unsigned int issue_flags)
+{
+	struct nvme_ns *ns = bdev->bd_disk->private_data;
+
+	/* struct nvme_uring_cmd doesn't fit into a regular sqe */
+	if (!(issue_flags & IO_URING_F_SQE128))
+		return -EOPNOTSUPP;
+
+	switch (ioucmd->cmd_op) {
+	case NVME_URING_CMD_IO:
+		return nvme_uring_cmd_io(ns->ctrl, ns, ioucmd, issue_flags);
+	default:
+		return -ENOTTY;
+	}
+}
+
+static int nvme_uring_cmd_poll(struct io_uring_cmd *ioucmd, bool spin)
+{
+	struct nvme_uring_cmd_pdu *pdu = nvme_uring_cmd_pdu(ioucmd);
+
+	return blk_poll(pdu->q, READ_ONCE(pdu->cookie), spin);
+}
+
+static int nvme_uring_cmd_iopoll(struct block_device *bdev,
+		struct io_uring_cmd *ioucmd, bool spin)
+{
+	return nvme_uring_cmd_poll(ioucmd, spin);
+}
+
 /*
  * Issue ioctl requests on the first available path.  Note that unlike normal
  * block layer requests we will not retry failed request on another controller.
@@ -2158,6 +2371,8 @@ static const struct block_device_operations nvme_fops = {
 	.release	= nvme_release,
 	.getgeo		= nvme_getgeo,
 	.revalidate_disk= nvme_revalidate_disk,
+	.uring_cmd	= nvme_uring_cmd,
+	.uring_cmd_iopoll = nvme_uring_cmd_iopoll,
 	.pr_ops		= &nvme_pr_ops,
 };
 
@@ -3089,6 +3304,33 @@ static int nvme_dev_user_cmd(struct nvme_ctrl *ctrl, void __user *argp)
 	return ret;
 }
 
+/*
+ * Unlike NVME_IOCTL_IO_CMD, the controller node takes the namespace from the
+ * command, so this also works with several namespaces and with multipath,
+ * which hides the per-controller namespace block devices.
+ */
+static int nvme_dev_uring_cmd(struct io_uring_cmd *ioucmd,
+		unsigned int issue_flags)
+{
+	struct nvme_ctrl *ctrl = ioucmd->file->private_data;
+	const struct nvme_uring_cmd *cmd = ioucmd->cmd;
+	struct nvme_ns *ns;
+	int ret;
+
+	if (!(issue_flags & IO_URING_F_SQE128))
+		return -EOPNOTSUPP;
+	if (ioucmd->cmd_op != NVME_URING_CMD_IO)
+		return -ENOTTY;
+
+	ns = nvme_find_get_ns(ctrl, READ_ONCE(cmd->nsid));
+	if (!ns)
+		return -EINVAL;
+	/* an issued request holds off namespace removal by itself */
+	ret = nvme_uring_cmd_io(ctrl, ns, ioucmd, issue_flags);
+	nvme_put_ns(ns);
+	return ret;
+}
+
 static long nvme_dev_ioctl(struct file *file, unsigned int cmd,
 		unsigned long arg)
 {
@@ -3120,6 +3362,8 @@ static const struct file_operations nvme_dev_fops = {
 	.open		= nvme_dev_open,
 	.unlocked_ioctl	= nvme_dev_ioctl,
 	.compat_ioctl	= compat_ptr_ioctl,
+	.uring_cmd	= nvme_dev_uring_cmd,
+	.uring_cmd_iopoll = nvme_uring_cmd_poll,
 };
 
 static ssize_t nvme_sysfs_reset(struct device *dev,
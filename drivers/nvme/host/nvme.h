@@ -472,8 +472,13 @@ static inline u32 nvme_bytes_to_numd(size_t len)
 	return (len >> 2) - 1;
 }
 
-static inline void nvme_end_request(struct request *req, __le16 status,
-		union nvme_result result)
+/*
+ * Like nvme_end_request(), but a successful completion is added to @iob and
+ * finished later by @complete, together with the rest of the batch.
+ */
+static inline void nvme_end_request_batch(struct request *req, __le16 status,
+		union nvme_result result, struct io_comp_batch *iob,
+		void (*complete)(struct io_comp_batch *))
 {
 	struct nvme_request *rq = nvme_req(req);
 
@@ -481,7 +486,14 @@ static inline void nvme_end_request(struct request *req, __le16 status,
 	rq->result = result;
 	/* inject error when permitted by fault injection framework */
 	nvme_should_fail(req);
-	blk_mq_complete_request(req);
+	if (!blk_mq_add_to_batch(req, iob, rq->status, complete))
+		blk_mq_complete_request(req);
+}
+
+static inline void nvme_end_request(struct request *req, __le16 status,
+		union nvme_result result)
+{
+	nvme_end_request_batch(req, status, result, NULL, NULL);
 }
 
 static inline void nvme_get_ctrl(struct nvme_ctrl *ctrl)
@@ -500,6 +512,23 @@ static inline bool nvme_is_aen_req(u16 qid, __u16 command_id)
 }
 
 void nvme_complete_rq(struct request *req);
+void nvme_complete_batch_req(struct request *req);
+
+/*
+ * End a completion batch gathered by nvme_end_request_batch().  @fn does the
+ * transport specific teardown of each request.
+ */
+static __always_inline void nvme_complete_batch(struct io_comp_batch *iob,
+						void (*fn)(struct request *rq))
+{
+	struct request *req;
+
+	list_for_each_entry(req, &iob->req_list, queuelist) {
+		fn(req);
+		nvme_complete_batch_req(req);
+	}
+	blk_mq_end_request_batch(iob);
+}
 bool nvme_cancel_request(struct request *req, void *data, bool reserved);
 bool nvme_change_ctrl_state(struct nvme_ctrl *ctrl,
 		enum nvme_ctrl_state new_state);
@@ -34,6 +34,7 @@
 #include <linux/falloc.h>
 #include <linux/uaccess.h>
 #include <linux/suspend.h>
+#include <linux/io_uring.h>
 #include "internal.h"
 
 struct bdev_inode {
@@ -295,6 +296,29 @@ static int blkdev_iopoll(struct kiocb *kiocb, bool wait)
 	return blk_poll(q, READ_ONCE(kiocb->ki_cookie), wait);
 }
 
+/*
+ * Passthrough commands are device specific, hand them to the driver.
+ */
+static int blkdev_uring_cmd(struct io_uring_cmd *ioucmd,
+			    unsigned int issue_flags)
+{
+	struct block_device *bdev = I_BDEV(ioucmd->file->f_mapping->host);
+	const struct block_device_operations *ops = bdev->bd_disk->fops;
+
+	if (!ops->uring_cmd)
+		return -EOPNOTSUPP;
+	if ((issue_flags & IO_URING_F_IOPOLL) && !ops->uring_cmd_iopoll)
+		return -EOPNOTSUPP;
+	return ops->uring_cmd(bdev, ioucmd, issue_flags);
+}
+
+static int blkdev_uring_cmd_iopoll(struct io_uring_cmd *ioucmd, bool spin)
+{
+	struct block_device *bdev = I_BDEV(ioucmd->file->f_mapping->host);
+
+	return bdev->bd_disk->fops->uring_cmd_iopoll(bdev, ioucmd, spin);
+}
+
 static void blkdev_bio_end_io(struct bio *bio)
 {
 	struct blkdev_dio *dio = bio->bi_private;
@@ -353,7 +377,7 @@ __blkdev_direct_IO(struct kiocb *iocb, struct iov_iter *iter, int nr_pages)
 	    (bdev_logical_block_size(bdev) - 1))
 		return -EINVAL;
 
-	bio = bio_alloc_bioset(GFP_KERNEL, nr_pages, &blkdev_dio_pool);
+	bio = bio_alloc_kiocb(iocb, nr_pages, &blkdev_dio_pool);
 
 	dio = container_of(bio, struct blkdev_dio, bio);
 	dio->is_sync = is_sync = is_sync_kiocb(iocb);
@@ -478,7 +502,8 @@ blkdev_direct_IO(struct kiocb *iocb, struct iov_iter *iter)
 
 static __init int blkdev_init(void)
 {
-	return bioset_init(&blkdev_dio_pool, 4, offsetof(struct blkdev_dio, bio), BIOSET_NEED_BVECS);
+	return bioset_init(&blkdev_dio_pool, 4, offsetof(struct blkdev_dio, bio),
+			   BIOSET_NEED_BVECS | BIOSET_PERCPU_CACHE);
 }
 module_init(blkdev_init);
 
@@ -1850,7 +1875,7 @@ static int blkdev_open(struct inode * inode, struct file * filp)
 	 */
 	filp->f_flags |= O_LARGEFILE;
 
-	filp->f_mode |= FMODE_NOWAIT;
+	filp->f_mode |= FMODE_NOWAIT | FMODE_BUF_RASYNC;
 
 	if (filp->f_flags & O_NDELAY)
 		filp->f_mode |= FMODE_NDELAY;
@@ -2153,6 +2178,8 @@ const struct file_operations def_blk_fops = {
 	.read_iter	= blkdev_read_iter,
 	.write_iter	= blkdev_write_iter,
 	.iopoll		= blkdev_iopoll,
+	.uring_cmd	= blkdev_uring_cmd,
+	.uring_cmd_iopoll = blkdev_uring_cmd_iopoll,
 	.mmap		= generic_file_mmap,
 	.fsync		= blkdev_fsync,
 	.unlocked_ioctl	= block_ioctl,
@@ -96,6 +96,8 @@ struct io_wqe {
 
 	int node;
 	struct io_wqe_acct acct[2];
+	/* workers io_worker_over_limit() took out of acct[] that still exist */
+	unsigned nr_exiting;
 
 	struct hlist_nulls_head free_list;
 	struct list_head all_list;
@@ -115,6 +117,8 @@ struct io_wq {
 
 	struct task_struct *manager;
 	struct user_struct *user;
+	/* RLIMIT_NPROC of the creator, unbounded workers count against it */
+	unsigned long nproc_limit;
 	refcount_t refs;
 	struct completion done;
 
@@ -201,6 +205,7 @@ static void io_worker_exit(struct io_worker *worker)
 {
 	struct io_wqe *wqe = worker->wqe;
 	struct io_wqe_acct *acct = io_wqe_get_acct(wqe, worker);
+	bool accounted = !(worker->flags & IO_WORKER_F_EXITING);
 	unsigned nr_workers;
 
 	/*
@@ -222,15 +227,20 @@ static void io_worker_exit(struct io_worker *worker)
 	preempt_enable();
 
 	spin_lock_irq(&wqe->lock);
-	hlist_nulls_del_rcu(&worker->nulls_node);
+	hlist_nulls_del_init_rcu(&worker->nulls_node);
 	list_del_rcu(&worker->all_list);
 	if (__io_worker_unuse(wqe, worker)) {
 		__release(&wqe->lock);
 		spin_lock_irq(&wqe->lock);
 	}
-	acct->nr_workers--;
+	/* io_worker_over_limit() already dropped it from the pool */
+	if (accounted)
+		acct->nr_workers--;
+	else
+		wqe->nr_exiting--;
 	nr_workers = wqe->acct[IO_WQ_ACCT_BOUND].nr_workers +
-			wqe->acct[IO_WQ_ACCT_UNBOUND].nr_workers;
+			wqe->acct[IO_WQ_ACCT_UNBOUND].nr_workers +
+			wqe->nr_exiting;
 	spin_unlock_irq(&wqe->lock);
 
 	/* all workers gone, wq exit can proceed */
@@ -559,6 +569,35 @@ static void io_worker_handle_work(struct io_worker *worker)
 	} while (1);
 }
 
+/*
+ * If io_wq_max_workers() lowered the limit below the current pool size,
+ * take this worker out of the accounting right away, under the lock, so
+ * the next idle worker to check sees the smaller pool and only the excess
+ * workers exit.
+ */
+static bool io_worker_over_limit(struct io_wqe *wqe, struct io_worker *worker)
+	__must_hold(wqe->lock)
+{
+	struct io_wqe_acct *acct = io_wqe_get_acct(wqe, worker);
+
+	if (worker->flags & IO_WORKER_F_FIXED)
+		return false;
+	if (acct->nr_workers <= acct->max_workers)
+		return false;
+
+	acct->nr_workers--;
+	wqe->nr_exiting++;
+	if (worker->flags & IO_WORKER_F_FREE) {
+		worker->flags &= ~IO_WORKER_F_FREE;
+		hlist_nulls_del_init_rcu(&worker->nulls_node);
+	}
+	if (worker->flags & IO_WORKER_F_RUNNING)
+		atomic_dec(&acct->nr_running);
+	worker->flags &= ~(IO_WORKER_F_UP | IO_WORKER_F_RUNNING);
+	worker->flags |= IO_WORKER_F_EXITING;
+	return true;
+}
+
 static int io_wqe_worker(void *data)
 {
 	struct io_worker *worker = data;
@@ -581,6 +620,12 @@ static int io_wqe_worker(void *data)
 			__release(&wqe->lock);
 			goto loop;
 		}
+		/* io_wq_max_workers() lowered the limit, trim the pool */
+		if (io_worker_over_limit(wqe, worker)) {
+			spin_unlock_irq(&wqe->lock);
+			__set_current_state(TASK_RUNNING);
+			break;
+		}
 		spin_unlock_irq(&wqe->lock);
 		if (signal_pending(current))
 			flush_signals(current);
@@ -662,6 +707,9 @@ static bool create_io_worker(struct io_wq *wq, struct io_wqe *wqe, int index)
 		kfree(worker);
 		return false;
 	}
+	/* work is queued on the node it was submitted from, run it there */
+	if (wqe->node != NUMA_NO_NODE)
+		set_cpus_allowed_ptr(worker->task, cpumask_of_node(wqe->node));
 
 	spin_lock_irq(&wqe->lock);
 	hlist_nulls_add_head_rcu(&worker->nulls_node, &wqe->free_list);
@@ -770,7 +818,7 @@ static bool io_wq_can_queue(struct io_wqe *wqe, struct io_wqe_acct *acct,
 	if (free_worker)
 		return true;
 
-	if (atomic_read(&wqe->wq->user->processes) >= acct->max_workers &&
+	if (atomic_read(&wqe->wq->user->processes) >= wqe->wq->nproc_limit &&
 	    !(capable(CAP_SYS_RESOURCE) || capable(CAP_SYS_ADMIN)))
 		return false;
 
@@ -1040,6 +1088,7 @@ struct io_wq *io_wq_create(unsigned bounded, struct io_wq_data *data)
 
 	/* caller must already hold a reference to this */
 	wq->user = data->user;
+	wq->nproc_limit = task_rlimit(current, RLIMIT_NPROC);
 
 	for_each_node(node) {
 		struct io_wqe *wqe;
@@ -1056,7 +1105,7 @@ struct io_wq *io_wq_create(unsigned bounded, struct io_wq_data *data)
 		atomic_set(&wqe->acct[IO_WQ_ACCT_BOUND].nr_running, 0);
 		if (wq->user) {
 			wqe->acct[IO_WQ_ACCT_UNBOUND].max_workers =
-					task_rlimit(current, RLIMIT_NPROC);
+					wq->nproc_limit;
 		}
 		atomic_set(&wqe->acct[IO_WQ_ACCT_UNBOUND].nr_running, 0);
 		wqe->wq = wq;
@@ -1091,6 +1140,52 @@ struct io_wq *io_wq_create(unsigned bounded, struct io_wq_data *data)
 	return ERR_PTR(ret);
 }
 
+static bool io_wq_worker_wake(struct io_worker *worker, void *data)
+{
+	wake_up_process(worker->task);
+	return false;
+}
+
+/*
+ * Set the max number of bounded and unbounded workers per node. A zero
+ * count leaves that limit alone, and the previous limits are returned in
+ * @new_count.
+ */
+void io_wq_max_workers(struct io_wq *wq, int *new_count)
+{
+	int prev[2] = { -1, -1 };
+	int i, node;
+
+	for (i = 0; i < 2; i++) {
+		if (new_count[i] > wq->nproc_limit)
+			new_count[i] = wq->nproc_limit;
+	}
+
+	for_each_node(node) {
+		struct io_wqe *wqe = wq->wqes[node];
+
+		spin_lock_irq(&wqe->lock);
+		for (i = 0; i < 2; i++) {
+			struct io_wqe_acct *acct = &wqe->acct[i];
+
+			if (prev[i] == -1)
+				prev[i] = acct->max_workers;
+			if (new_count[i])
+				acct->max_workers = new_count[i];
+		}
+		spin_unlock_irq(&wqe->lock);
+	}
+
+	/* let idle workers above a lowered limit exit */
+	rcu_read_lock();
+	for_each_node(node)
+		io_wq_for_each_worker(wq->wqes[node], io_wq_worker_wake, NULL);
+	rcu_read_unlock();
+
+	for (i = 0; i < 2; i++)
+		new_count[i] = prev[i];
+}
+
 bool io_wq_get(struct io_wq *wq, struct io_wq_data *data)
 {
 	if (data->free_work != wq->free_work)
@@ -1099,12 +1194,6 @@ bool io_wq_get(struct io_wq *wq, struct io_wq_data *data)
 	return refcount_inc_not_zero(&wq->use_refs);
 }
 
-static bool io_wq_worker_wake(struct io_worker *worker, void *data)
-{
-	wake_up_process(worker->task);
-	return false;
-}
-
 static void __io_wq_destroy(struct io_wq *wq)
 {
 	int node;
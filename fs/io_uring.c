@@ -79,6 +79,8 @@
 #include <linux/fs_struct.h>
 #include <linux/splice.h>
 #include <linux/task_work.h>
+#include <linux/pagemap.h>
+#include <linux/io_uring.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/io_uring.h>
@@ -219,6 +221,44 @@ struct io_buffer {
 	__u16 bid;
 };
 
+/*
+ * A provided buffer ring registered with IORING_REGISTER_PBUF_RING.  The
+ * ring memory is shared with the application through mmap, so it stays
+ * allocated until the ctx goes away even after it is unregistered.
+ */
+struct io_buffer_ring {
+	struct io_uring_buf_ring	*br;
+	/* the registration and each mapping hold a reference */
+	refcount_t			refs;
+	struct rcu_head			rcu;
+	__u16				bgid;
+	__u16				head;
+	__u16				mask;
+};
+
+/*
+ * The SQPOLL thread and the rings it services.  A ring set up with
+ * IORING_SETUP_SQPOLL | IORING_SETUP_ATTACH_WQ joins the thread of the ring
+ * it attaches to instead of starting its own, so one thread can drive many
+ * rings.  The thread walks ->ctx_list round-robin under ->lock.
+ */
+struct io_sq_data {
+	refcount_t		refs;
+	struct mutex		lock;
+	struct list_head	ctx_list;
+
+	struct task_struct	*thread;
+	struct wait_queue_head	wait;
+	struct completion	startup;
+
+	/* longest idle period asked for by the attached rings, in jiffies */
+	unsigned		sq_thread_idle;
+	/* average gap between bursts of work, in jiffies << IO_SQ_IDLE_SHIFT */
+	unsigned long		idle_gap_avg;
+	unsigned long		last_busy;
+	bool			was_idle;
+};
+
 struct io_ring_ctx {
 	struct {
 		struct percpu_ref	refs;
@@ -264,9 +304,11 @@ struct io_ring_ctx {
 
 	/* IO offload */
 	struct io_wq		*io_wq;
-	struct task_struct	*sqo_thread;	/* if using sq thread polling */
+	struct io_sq_data	*sq_data;	/* if using sq thread polling */
+	struct list_head	sqd_list;
 	struct mm_struct	*sqo_mm;
-	wait_queue_head_t	sqo_wait;
+	/* last SQPOLL submission hit -EBUSY on a CQ overflow backlog */
+	bool			sq_busy;
 
 	/*
 	 * If used, fixed file set. Writers must ensure that ->refs is dead,
@@ -287,7 +329,6 @@ struct io_ring_ctx {
 	const struct cred	*creds;
 
 	struct completion	ref_comp;
-	struct completion	sq_thread_comp;
 
 	/* if all else fails... */
 	struct io_kiocb		*fallback_req;
@@ -298,6 +339,9 @@ struct io_ring_ctx {
 
 	struct idr		io_buffer_idr;
 
+	/* provided buffer rings, indexed by bgid */
+	struct xarray		io_buf_rings;
+
 	struct idr		personality_idr;
 
 	struct {
@@ -418,9 +462,17 @@ struct io_sr_msg {
 		void __user		*buf;
 	};
 	int				msg_flags;
+	/* also the registered buffer for IORING_RECV_FIXED_BUF */
 	int				bgid;
+	bool				fixed_buf;
+	/* where the last fixed buffer receive landed in it */
+	u32				fixed_off;
 	size_t				len;
-	struct io_buffer		*kbuf;
+	union {
+		struct io_buffer	*kbuf;
+		/* selected from a provided buffer ring */
+		void __user		*ring_buf;
+	};
 };
 
 struct io_open {
@@ -504,14 +556,20 @@ struct io_async_rw {
 	struct iovec			*iov;
 	ssize_t				nr_segs;
 	ssize_t				size;
+	struct wait_page_queue		wpq;
 };
 
+/* IORING_OP_URING_CMD payload of a 128 byte sqe */
+#define IO_URING_CMD_MAX_SIZE	\
+	(2 * sizeof(struct io_uring_sqe) - offsetof(struct io_uring_sqe, cmd))
+
 struct io_async_ctx {
 	union {
 		struct io_async_rw	rw;
 		struct io_async_msghdr	msg;
 		struct io_async_connect	connect;
 		struct io_timeout_data	timeout;
+		u8			uring_cmd[IO_URING_CMD_MAX_SIZE];
 	};
 };
 
@@ -540,7 +598,9 @@ enum {
 	REQ_F_OVERFLOW_BIT,
 	REQ_F_POLLED_BIT,
 	REQ_F_BUFFER_SELECTED_BIT,
+	REQ_F_BUFFER_RING_BIT,
 	REQ_F_NO_FILE_TABLE_BIT,
+	REQ_F_MULTISHOT_BIT,
 
 	/* not a real bit, just to check we're not overflowing the space */
 	__REQ_F_LAST_BIT,
@@ -594,8 +654,12 @@ enum {
 	REQ_F_POLLED		= BIT(REQ_F_POLLED_BIT),
 	/* buffer already selected */
 	REQ_F_BUFFER_SELECTED	= BIT(REQ_F_BUFFER_SELECTED_BIT),
+	/* selected buffer came from a buffer ring, bid is in buf_index */
+	REQ_F_BUFFER_RING	= BIT(REQ_F_BUFFER_RING_BIT),
 	/* doesn't need file table for this request */
 	REQ_F_NO_FILE_TABLE	= BIT(REQ_F_NO_FILE_TABLE_BIT),
+	/* stays armed on async poll, posting a cqe per completion */
+	REQ_F_MULTISHOT		= BIT(REQ_F_MULTISHOT_BIT),
 };
 
 struct async_poll {
@@ -629,6 +693,7 @@ struct io_kiocb {
 		struct io_splice	splice;
 		struct io_provide_buf	pbuf;
 		struct io_statx		statx;
+		struct io_uring_cmd	uring_cmd;
 	};
 
 	struct io_async_ctx		*io;
@@ -867,6 +932,12 @@ static const struct io_op_def io_op_defs[] = {
 		.hash_reg_file		= 1,
 		.unbound_nonreg_file	= 1,
 	},
+	[IORING_OP_URING_CMD] = {
+		.async_ctx		= 1,
+		.needs_mm		= 1,
+		.needs_file		= 1,
+		.unbound_nonreg_file	= 1,
+	},
 };
 
 static void io_wq_submit_work(struct io_wq_work **workptr);
@@ -949,12 +1020,12 @@ static struct io_ring_ctx *io_ring_ctx_alloc(struct io_uring_params *p)
 		goto err;
 
 	ctx->flags = p->flags;
-	init_waitqueue_head(&ctx->sqo_wait);
+	INIT_LIST_HEAD(&ctx->sqd_list);
 	init_waitqueue_head(&ctx->cq_wait);
 	INIT_LIST_HEAD(&ctx->cq_overflow_list);
 	init_completion(&ctx->ref_comp);
-	init_completion(&ctx->sq_thread_comp);
 	idr_init(&ctx->io_buffer_idr);
+	xa_init(&ctx->io_buf_rings);
 	idr_init(&ctx->personality_idr);
 	mutex_init(&ctx->uring_lock);
 	init_waitqueue_head(&ctx->wait);
@@ -1161,7 +1232,31 @@ static struct io_uring_cqe *io_get_cqring(struct io_ring_ctx *ctx)
 		return NULL;
 
 	ctx->cached_cq_tail++;
-	return &rings->cqes[tail & ctx->cq_mask];
+	tail &= ctx->cq_mask;
+	/* double index for 32 byte cqes, they take up two slots */
+	if (ctx->flags & IORING_SETUP_CQE32)
+		tail <<= 1;
+	return &rings->cqes[tail];
+}
+
+static void io_fill_cqe(struct io_kiocb *req, struct io_uring_cqe *cqe,
+			long res, long cflags)
+{
+	WRITE_ONCE(cqe->user_data, req->user_data);
+	WRITE_ONCE(cqe->res, res);
+	WRITE_ONCE(cqe->flags, cflags);
+
+	if (req->ctx->flags & IORING_SETUP_CQE32) {
+		u64 res2 = 0;
+
+		if (req->opcode == IORING_OP_URING_CMD)
+			res2 = req->uring_cmd.res2;
+		else if (req->opcode == IORING_OP_RECV && req->sr_msg.fixed_buf)
+			res2 = (u64) req->sr_msg.bgid << 32 |
+				req->sr_msg.fixed_off;
+		WRITE_ONCE(cqe->big_cqe[0], res2);
+		WRITE_ONCE(cqe->big_cqe[1], 0);
+	}
 }
 
 static inline bool io_should_trigger_evfd(struct io_ring_ctx *ctx)
@@ -1179,8 +1274,8 @@ static void io_cqring_ev_posted(struct io_ring_ctx *ctx)
 {
 	if (waitqueue_active(&ctx->wait))
 		wake_up(&ctx->wait);
-	if (waitqueue_active(&ctx->sqo_wait))
-		wake_up(&ctx->sqo_wait);
+	if (ctx->sq_data && waitqueue_active(&ctx->sq_data->wait))
+		wake_up(&ctx->sq_data->wait);
 	if (io_should_trigger_evfd(ctx))
 		eventfd_signal(ctx->cq_ev_fd, 1);
 }
@@ -1219,9 +1314,7 @@ static bool io_cqring_overflow_flush(struct io_ring_ctx *ctx, bool force)
 		list_move(&req->list, &list);
 		req->flags &= ~REQ_F_OVERFLOW;
 		if (cqe) {
-			WRITE_ONCE(cqe->user_data, req->user_data);
-			WRITE_ONCE(cqe->res, req->result);
-			WRITE_ONCE(cqe->flags, req->cflags);
+			io_fill_cqe(req, cqe, req->result, req->cflags);
 		} else {
 			WRITE_ONCE(ctx->rings->cq_overflow,
 				atomic_inc_return(&ctx->cached_cq_overflow));
@@ -1259,9 +1352,7 @@ static void __io_cqring_fill_event(struct io_kiocb *req, long res, long cflags)
 	 */
 	cqe = io_get_cqring(ctx);
 	if (likely(cqe)) {
-		WRITE_ONCE(cqe->user_data, req->user_data);
-		WRITE_ONCE(cqe->res, res);
-		WRITE_ONCE(cqe->flags, cflags);
+		io_fill_cqe(req, cqe, res, cflags);
 	} else if (ctx->cq_overflow_flushed) {
 		WRITE_ONCE(ctx->rings->cq_overflow,
 				atomic_inc_return(&ctx->cached_cq_overflow));
@@ -1301,6 +1392,34 @@ static void io_cqring_add_event(struct io_kiocb *req, long res)
 	__io_cqring_add_event(req, res, 0);
 }
 
+/*
+ * Post a cqe for a multishot request that stays armed.  The overflow list
+ * can hold a request only once, so this fails instead of overflowing, and
+ * the caller then completes the request with a final cqe.
+ */
+static bool io_cqring_post_more(struct io_kiocb *req, long res, long cflags)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	struct io_uring_cqe *cqe = NULL;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ctx->completion_lock, flags);
+	/* don't overtake cqes that already overflowed */
+	if (list_empty(&ctx->cq_overflow_list))
+		cqe = io_get_cqring(ctx);
+	if (cqe) {
+		trace_io_uring_complete(ctx, req->user_data, res);
+		io_fill_cqe(req, cqe, res, cflags | IORING_CQE_F_MORE);
+		io_commit_cqring(ctx);
+	}
+	spin_unlock_irqrestore(&ctx->completion_lock, flags);
+
+	if (!cqe)
+		return false;
+	io_cqring_ev_posted(ctx);
+	return true;
+}
+
 static inline bool io_is_fallback_req(struct io_kiocb *req)
 {
 	return req == (struct io_kiocb *)
@@ -1700,19 +1819,44 @@ static inline bool io_req_multi_free(struct req_batch *rb, struct io_kiocb *req)
 	return true;
 }
 
+/* Buffers selected from a buffer ring belong to the application */
+static void io_kbuf_free(struct io_kiocb *req, struct io_buffer *kbuf)
+{
+	if (!(req->flags & REQ_F_BUFFER_RING))
+		kfree(kbuf);
+}
+
 static int io_put_kbuf(struct io_kiocb *req)
 {
 	struct io_buffer *kbuf;
 	int cflags;
 
-	kbuf = (struct io_buffer *) (unsigned long) req->rw.addr;
-	cflags = kbuf->bid << IORING_CQE_BUFFER_SHIFT;
+	if (req->flags & REQ_F_BUFFER_RING) {
+		cflags = req->buf_index << IORING_CQE_BUFFER_SHIFT;
+	} else {
+		kbuf = (struct io_buffer *) (unsigned long) req->rw.addr;
+		cflags = kbuf->bid << IORING_CQE_BUFFER_SHIFT;
+		kfree(kbuf);
+	}
 	cflags |= IORING_CQE_F_BUFFER;
 	req->rw.addr = 0;
-	kfree(kbuf);
 	return cflags;
 }
 
+/*
+ * Run the command owner's completion callback.  Without an mm, as in the
+ * io-wq manager or a task that is exiting, the submitter's memory is gone,
+ * and the callback is told not to copy anything back.
+ */
+static void io_uring_cmd_run_task_cb(struct io_kiocb *req)
+{
+	struct io_uring_cmd *ioucmd = &req->uring_cmd;
+
+	if (!current->mm)
+		ioucmd->flags |= IO_URING_CMD_TASK_DEAD;
+	ioucmd->task_work_cb(ioucmd);
+}
+
 /*
  * Find and free completed poll iocbs
  */
@@ -1731,6 +1875,10 @@ static void io_iopoll_complete(struct io_ring_ctx *ctx, unsigned int *nr_events,
 
 		if (req->flags & REQ_F_BUFFER_SELECTED)
 			cflags = io_put_kbuf(req);
+		/* see io_uring_cmd_complete_in_task() */
+		if (req->opcode == IORING_OP_URING_CMD &&
+		    req->uring_cmd.task_work_cb)
+			io_uring_cmd_run_task_cb(req);
 
 		__io_cqring_fill_event(req, req->result, cflags);
 		(*nr_events)++;
@@ -1775,8 +1923,6 @@ static int io_do_iopoll(struct io_ring_ctx *ctx, unsigned int *nr_events,
 
 	ret = 0;
 	list_for_each_entry_safe(req, tmp, &ctx->poll_list, list) {
-		struct kiocb *kiocb = &req->rw.kiocb;
-
 		/*
 		 * Move completed and retryable entries to our local lists.
 		 * If we find a request that requires polling, break out
@@ -1796,7 +1942,14 @@ static int io_do_iopoll(struct io_ring_ctx *ctx, unsigned int *nr_events,
 		if (!list_empty(&again))
 			break;
 
-		ret = kiocb->ki_filp->f_op->iopoll(kiocb, spin);
+		if (req->opcode == IORING_OP_URING_CMD) {
+			ret = req->file->f_op->uring_cmd_iopoll(&req->uring_cmd,
+								spin);
+		} else {
+			struct kiocb *kiocb = &req->rw.kiocb;
+
+			ret = kiocb->ki_filp->f_op->iopoll(kiocb, spin);
+		}
 		if (ret < 0)
 			break;
 
@@ -2002,8 +2155,8 @@ static void io_iopoll_req_issued(struct io_kiocb *req)
 		list_add_tail(&req->list, &ctx->poll_list);
 
 	if ((ctx->flags & IORING_SETUP_SQPOLL) &&
-	    wq_has_sleeper(&ctx->sqo_wait))
-		wake_up(&ctx->sqo_wait);
+	    wq_has_sleeper(&ctx->sq_data->wait))
+		wake_up(&ctx->sq_data->wait);
 }
 
 static void __io_state_file_put(struct io_submit_state *state)
@@ -2118,7 +2271,7 @@ static int io_prep_rw(struct io_kiocb *req, const struct io_uring_sqe *sqe,
 		    !kiocb->ki_filp->f_op->iopoll)
 			return -EOPNOTSUPP;
 
-		kiocb->ki_flags |= IOCB_HIPRI;
+		kiocb->ki_flags |= IOCB_HIPRI | IOCB_ALLOC_CACHE;
 		kiocb->ki_complete = io_complete_rw_iopoll;
 		req->result = 0;
 	} else {
@@ -2166,27 +2319,11 @@ static void kiocb_done(struct kiocb *kiocb, ssize_t ret)
 		io_rw_done(kiocb, ret);
 }
 
-static ssize_t io_import_fixed(struct io_kiocb *req, int rw,
-			       struct iov_iter *iter)
+static ssize_t __io_import_fixed(struct io_mapped_ubuf *imu, int rw,
+				 u64 buf_addr, size_t len,
+				 struct iov_iter *iter)
 {
-	struct io_ring_ctx *ctx = req->ctx;
-	size_t len = req->rw.len;
-	struct io_mapped_ubuf *imu;
-	u16 index, buf_index;
 	size_t offset;
-	u64 buf_addr;
-
-	/* attempt to use fixed buffers without having provided iovecs */
-	if (unlikely(!ctx->user_bufs))
-		return -EFAULT;
-
-	buf_index = req->buf_index;
-	if (unlikely(buf_index >= ctx->nr_user_bufs))
-		return -EFAULT;
-
-	index = array_index_nospec(buf_index, ctx->nr_user_bufs);
-	imu = &ctx->user_bufs[index];
-	buf_addr = req->rw.addr;
 
 	/* overflow */
 	if (buf_addr + len < buf_addr)
@@ -2240,6 +2377,25 @@ static ssize_t io_import_fixed(struct io_kiocb *req, int rw,
 	return len;
 }
 
+static ssize_t io_import_fixed(struct io_kiocb *req, int rw,
+			       struct iov_iter *iter)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	u16 index, buf_index;
+
+	/* attempt to use fixed buffers without having provided iovecs */
+	if (unlikely(!ctx->user_bufs))
+		return -EFAULT;
+
+	buf_index = req->buf_index;
+	if (unlikely(buf_index >= ctx->nr_user_bufs))
+		return -EFAULT;
+
+	index = array_index_nospec(buf_index, ctx->nr_user_bufs);
+	return __io_import_fixed(&ctx->user_bufs[index], rw, req->rw.addr,
+				 req->rw.len, iter);
+}
+
 static void io_ring_submit_unlock(struct io_ring_ctx *ctx, bool needs_lock)
 {
 	if (needs_lock)
@@ -2258,54 +2414,100 @@ static void io_ring_submit_lock(struct io_ring_ctx *ctx, bool needs_lock)
 		mutex_lock(&ctx->uring_lock);
 }
 
-static struct io_buffer *io_buffer_select(struct io_kiocb *req, size_t *len,
-					  int bgid, struct io_buffer *kbuf,
-					  bool needs_lock)
+/*
+ * Take the next buffer the application published in the ring.  No
+ * allocation and no list manipulation: the entry is consumed by moving
+ * the kernel's private head, and the bid is returned in the cqe.
+ */
+static void __user *io_ring_buffer_select(struct io_kiocb *req, size_t *len,
+					  struct io_buffer_ring *bl)
 {
+	struct io_uring_buf_ring *br = bl->br;
+	struct io_uring_buf *buf;
+	__u32 buf_len;
+	__u16 tail;
+
+	/* pairs with the store-release of the tail by the application */
+	tail = smp_load_acquire(&br->tail);
+	if (tail == bl->head)
+		return ERR_PTR(-ENOBUFS);
+
+	buf = &br->bufs[bl->head & bl->mask];
+	bl->head++;
+
+	buf_len = READ_ONCE(buf->len);
+	if (*len > buf_len)
+		*len = buf_len;
+	req->buf_index = READ_ONCE(buf->bid);
+	req->flags |= REQ_F_BUFFER_SELECTED | REQ_F_BUFFER_RING;
+	return u64_to_user_ptr(READ_ONCE(buf->addr));
+}
+
+static void __user *io_buffer_select(struct io_kiocb *req, size_t *len,
+				     int bgid, struct io_buffer **kbuf,
+				     bool needs_lock)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	struct io_buffer_ring *bl;
 	struct io_buffer *head;
+	void __user *buf;
 
-	if (req->flags & REQ_F_BUFFER_SELECTED)
-		return kbuf;
+	io_ring_submit_lock(ctx, needs_lock);
 
-	io_ring_submit_lock(req->ctx, needs_lock);
+	lockdep_assert_held(&ctx->uring_lock);
 
-	lockdep_assert_held(&req->ctx->uring_lock);
+	bl = xa_load(&ctx->io_buf_rings, bgid);
+	if (bl) {
+		buf = io_ring_buffer_select(req, len, bl);
+		goto out;
+	}
 
-	head = idr_find(&req->ctx->io_buffer_idr, bgid);
+	head = idr_find(&ctx->io_buffer_idr, bgid);
 	if (head) {
 		if (!list_empty(&head->list)) {
-			kbuf = list_last_entry(&head->list, struct io_buffer,
+			*kbuf = list_last_entry(&head->list, struct io_buffer,
 							list);
-			list_del(&kbuf->list);
+			list_del(&(*kbuf)->list);
 		} else {
-			kbuf = head;
-			idr_remove(&req->ctx->io_buffer_idr, bgid);
+			*kbuf = head;
+			idr_remove(&ctx->io_buffer_idr, bgid);
 		}
-		if (*len > kbuf->len)
-			*len = kbuf->len;
+		if (*len > (*kbuf)->len)
+			*len = (*kbuf)->len;
+		req->flags |= REQ_F_BUFFER_SELECTED;
+		buf = u64_to_user_ptr((*kbuf)->addr);
 	} else {
-		kbuf = ERR_PTR(-ENOBUFS);
+		buf = ERR_PTR(-ENOBUFS);
 	}
+out:
+	io_ring_submit_unlock(ctx, needs_lock);
 
-	io_ring_submit_unlock(req->ctx, needs_lock);
-
-	return kbuf;
+	return buf;
 }
 
 static void __user *io_rw_buffer_select(struct io_kiocb *req, size_t *len,
 					bool needs_lock)
 {
 	struct io_buffer *kbuf;
-	u16 bgid;
+	void __user *buf;
 
-	kbuf = (struct io_buffer *) (unsigned long) req->rw.addr;
-	bgid = req->buf_index;
-	kbuf = io_buffer_select(req, len, bgid, kbuf, needs_lock);
-	if (IS_ERR(kbuf))
-		return kbuf;
-	req->rw.addr = (u64) (unsigned long) kbuf;
-	req->flags |= REQ_F_BUFFER_SELECTED;
-	return u64_to_user_ptr(kbuf->addr);
+	if (req->flags & REQ_F_BUFFER_SELECTED) {
+		if (req->flags & REQ_F_BUFFER_RING)
+			return u64_to_user_ptr(req->rw.addr);
+		kbuf = (struct io_buffer *) (unsigned long) req->rw.addr;
+		if (*len > kbuf->len)
+			*len = kbuf->len;
+		return u64_to_user_ptr(kbuf->addr);
+	}
+
+	buf = io_buffer_select(req, len, req->buf_index, &kbuf, needs_lock);
+	if (IS_ERR(buf))
+		return buf;
+	if (req->flags & REQ_F_BUFFER_RING)
+		req->rw.addr = (u64) (unsigned long) buf;
+	else
+		req->rw.addr = (u64) (unsigned long) kbuf;
+	return buf;
 }
 
 #ifdef CONFIG_COMPAT
@@ -2571,6 +2773,152 @@ static int io_read_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe,
 	return 0;
 }
 
+static void io_async_buf_cancel(struct callback_head *cb)
+{
+	struct io_kiocb *req = container_of(cb, struct io_kiocb, task_work);
+	struct io_ring_ctx *ctx = req->ctx;
+
+	spin_lock_irq(&ctx->completion_lock);
+	io_cqring_fill_event(req, -ECANCELED);
+	io_commit_cqring(ctx);
+	spin_unlock_irq(&ctx->completion_lock);
+
+	io_cqring_ev_posted(ctx);
+	req_set_fail_links(req);
+	io_double_put_req(req);
+}
+
+static inline void io_sq_thread_drop_mm(void)
+{
+	struct mm_struct *mm = current->mm;
+
+	if (mm) {
+		unuse_mm(mm);
+		mmput(mm);
+	}
+}
+
+/*
+ * A shared SQPOLL thread may hold another ring's mm, or none at all.  Switch
+ * to @ctx's before touching its user memory.  If the owner's mm is already
+ * gone, the thread is left without one and -EFAULT is returned.
+ */
+static int io_sq_thread_acquire_mm(struct io_ring_ctx *ctx)
+{
+	if (current->mm == ctx->sqo_mm)
+		return 0;
+
+	io_sq_thread_drop_mm();
+	if (unlikely(!mmget_not_zero(ctx->sqo_mm)))
+		return -EFAULT;
+	use_mm(ctx->sqo_mm);
+	return 0;
+}
+
+static void io_async_buf_retry(struct callback_head *cb)
+{
+	struct io_kiocb *req = container_of(cb, struct io_kiocb, task_work);
+	struct io_ring_ctx *ctx = req->ctx;
+	const struct cred *old_cred = NULL;
+
+	__set_current_state(TASK_RUNNING);
+
+	if (ctx->flags & IORING_SETUP_SQPOLL) {
+		if (unlikely(io_sq_thread_acquire_mm(ctx))) {
+			io_async_buf_cancel(cb);
+			return;
+		}
+		old_cred = override_creds(ctx->creds);
+	}
+
+	mutex_lock(&ctx->uring_lock);
+	__io_queue_sqe(req, NULL);
+	mutex_unlock(&ctx->uring_lock);
+
+	if (old_cred)
+		revert_creds(old_cred);
+}
+
+static int io_async_buf_func(struct wait_queue_entry *wait, unsigned mode,
+			     int sync, void *arg)
+{
+	struct wait_page_queue *wpq;
+	struct io_kiocb *req = wait->private;
+	struct wait_page_key *key = arg;
+	struct task_struct *tsk;
+	int ret;
+
+	wpq = container_of(wait, struct wait_page_queue, wait);
+
+	ret = wake_page_match(wpq, key);
+	if (ret != 1)
+		return ret;
+
+	list_del_init(&wait->entry);
+
+	/* the retry is a fresh attempt, which arms its own waiter if needed */
+	req->rw.kiocb.ki_flags &= ~IOCB_WAITQ;
+	req->rw.kiocb.ki_waitq = NULL;
+
+	init_task_work(&req->task_work, io_async_buf_retry);
+	/* submit ref gets dropped, acquire a new one */
+	refcount_inc(&req->refs);
+	tsk = req->task;
+	ret = task_work_add(tsk, &req->task_work, true);
+	if (unlikely(ret)) {
+		/* the task is exiting, queue just for cancelation */
+		init_task_work(&req->task_work, io_async_buf_cancel);
+		tsk = io_wq_get_task(req->ctx->io_wq);
+		task_work_add(tsk, &req->task_work, true);
+	}
+	wake_up_process(tsk);
+	return 1;
+}
+
+/*
+ * A buffered read that would block on a page being read in doesn't need an
+ * io-wq worker: with IOCB_WAITQ set, the page cache queues ->wpq on the page
+ * and returns -EIOCBQUEUED, and the unlock callback has the read retried
+ * from task_work in the submitting task.
+ */
+static bool io_rw_should_retry(struct io_kiocb *req)
+{
+	struct kiocb *kiocb = &req->rw.kiocb;
+	struct wait_page_queue *wait;
+
+	/* never retry for NOWAIT, we just complete with -EAGAIN */
+	if (req->flags & REQ_F_NOWAIT)
+		return false;
+
+	/* already tried, or we're doing O_DIRECT */
+	if (kiocb->ki_flags & (IOCB_DIRECT | IOCB_WAITQ))
+		return false;
+	/*
+	 * just use poll if we can, and don't attempt if the fs doesn't
+	 * support callback based unlocks
+	 */
+	if (file_can_poll(req->file) || !(req->file->f_mode & FMODE_BUF_RASYNC))
+		return false;
+	/* the wait entry has to outlive this submission */
+	if (!req->io)
+		return false;
+
+	wait = &req->io->rw.wpq;
+	wait->wait.func = io_async_buf_func;
+	wait->wait.private = req;
+	wait->wait.flags = 0;
+	INIT_LIST_HEAD(&wait->wait.entry);
+	kiocb->ki_flags |= IOCB_WAITQ;
+	kiocb->ki_flags &= ~IOCB_NOWAIT;
+	kiocb->ki_waitq = wait;
+
+	if (!req->task) {
+		get_task_struct(current);
+		req->task = current;
+	}
+	return true;
+}
+
 static int io_read(struct io_kiocb *req, bool force_nonblock)
 {
 	struct iovec inline_vecs[UIO_FASTIOV], *iovec = inline_vecs;
@@ -2586,6 +2934,8 @@ static int io_read(struct io_kiocb *req, bool force_nonblock)
 	/* Ensure we clear previously set non-block flag */
 	if (!force_nonblock)
 		kiocb->ki_flags &= ~IOCB_NOWAIT;
+	else
+		kiocb->ki_flags |= IOCB_NOWAIT;
 
 	req->result = 0;
 	io_size = ret;
@@ -2612,12 +2962,26 @@ static int io_read(struct io_kiocb *req, bool force_nonblock)
 		/* Catch -EAGAIN return for forced non-blocking submission */
 		if (!force_nonblock || ret2 != -EAGAIN) {
 			kiocb_done(kiocb, ret2);
+			/* waiting on a page, the retry still needs ->io */
+			if (ret2 == -EIOCBQUEUED &&
+			    (kiocb->ki_flags & IOCB_WAITQ))
+				return 0;
 		} else {
 copy_iov:
 			ret = io_setup_async_rw(req, io_size, iovec,
 						inline_vecs, &iter);
 			if (ret)
 				goto out_free;
+			/* if we can retry, do so with the callbacks armed */
+			if (io_rw_should_retry(req)) {
+				ret2 = call_read_iter(req->file, kiocb, &iter);
+				if (ret2 != -EAGAIN) {
+					/* ->io owns the iovec now */
+					kiocb_done(kiocb, ret2);
+					return 0;
+				}
+				kiocb->ki_flags &= ~IOCB_WAITQ;
+			}
 			/* any defer here is final, must blocking retry */
 			if (!(req->flags & REQ_F_NOWAIT) &&
 			    !file_can_poll(req->file))
@@ -2850,6 +3214,158 @@ static int io_splice(struct io_kiocb *req, bool force_nonblock)
 	return 0;
 }
 
+static size_t io_uring_cmd_size(struct io_ring_ctx *ctx)
+{
+	if (ctx->flags & IORING_SETUP_SQE128)
+		return IO_URING_CMD_MAX_SIZE;
+	return sizeof(struct io_uring_sqe) - offsetof(struct io_uring_sqe, cmd);
+}
+
+static void io_uring_cmd_work(struct callback_head *cb)
+{
+	struct io_kiocb *req = container_of(cb, struct io_kiocb, task_work);
+	struct io_ring_ctx *ctx = req->ctx;
+	const struct cred *old_cred = NULL;
+
+	/* on a SQPOLL ring, this runs in the thread it shares with others */
+	if ((ctx->flags & IORING_SETUP_SQPOLL) && req->task == current) {
+		io_sq_thread_acquire_mm(ctx);
+		old_cred = override_creds(ctx->creds);
+	}
+
+	io_uring_cmd_run_task_cb(req);
+
+	if (old_cred)
+		revert_creds(old_cred);
+}
+
+/*
+ * Have @task_work_cb called in the context of the submitting task, which is
+ * where the command owner can touch user memory to finish the command.  On
+ * polled rings, the task reaping completions calls it instead.
+ */
+void io_uring_cmd_complete_in_task(struct io_uring_cmd *ioucmd,
+			void (*task_work_cb)(struct io_uring_cmd *))
+{
+	struct io_kiocb *req = container_of(ioucmd, struct io_kiocb, uring_cmd);
+	struct task_struct *tsk = req->task;
+
+	ioucmd->task_work_cb = task_work_cb;
+	if (req->ctx->flags & IORING_SETUP_IOPOLL) {
+		req->flags |= REQ_F_IOPOLL_COMPLETED;
+		return;
+	}
+
+	init_task_work(&req->task_work, io_uring_cmd_work);
+	/*
+	 * If this fails, the task is exiting.  The command has to be finished
+	 * regardless, so leave that to the io-wq manager like poll does, and
+	 * have it completed with -EINTR without copying anything back.
+	 */
+	if (unlikely(task_work_add(tsk, &req->task_work, true))) {
+		ioucmd->flags |= IO_URING_CMD_TASK_DEAD;
+		tsk = io_wq_get_task(req->ctx->io_wq);
+		task_work_add(tsk, &req->task_work, true);
+	}
+	wake_up_process(tsk);
+}
+EXPORT_SYMBOL_GPL(io_uring_cmd_complete_in_task);
+
+/*
+ * Called by the command owner when the command is done.  @res2 is posted in
+ * the second half of the cqe if the ring uses 32 byte cqes.
+ */
+void io_uring_cmd_done(struct io_uring_cmd *ioucmd, ssize_t ret, ssize_t res2)
+{
+	struct io_kiocb *req = container_of(ioucmd, struct io_kiocb, uring_cmd);
+
+	if (ret < 0)
+		req_set_fail_links(req);
+	ioucmd->res2 = res2;
+
+	if (req->ctx->flags & IORING_SETUP_IOPOLL) {
+		req->result = ret;
+		req->flags |= REQ_F_IOPOLL_COMPLETED;
+		return;
+	}
+	io_cqring_add_event(req, ret);
+	io_put_req(req);
+}
+EXPORT_SYMBOL_GPL(io_uring_cmd_done);
+
+static int io_uring_cmd_prep(struct io_kiocb *req,
+			     const struct io_uring_sqe *sqe)
+{
+	struct io_uring_cmd *ioucmd = &req->uring_cmd;
+	struct io_ring_ctx *ctx = req->ctx;
+
+	if (sqe->ioprio || sqe->rw_flags || READ_ONCE(sqe->__pad1))
+		return -EINVAL;
+
+	ioucmd->cmd = sqe->cmd;
+	ioucmd->cmd_op = READ_ONCE(sqe->cmd_op);
+	ioucmd->flags = 0;
+	ioucmd->task_work_cb = NULL;
+	ioucmd->res2 = 0;
+	req->result = 0;
+
+	/* completions are finished off in the submitter's context */
+	if (!req->task) {
+		get_task_struct(current);
+		req->task = current;
+	}
+
+	if (!req->io)
+		return 0;
+
+	/* the sqe is gone by the time a deferred command is issued */
+	memcpy(req->io->uring_cmd, sqe->cmd, io_uring_cmd_size(ctx));
+	ioucmd->cmd = req->io->uring_cmd;
+	return 0;
+}
+
+static int io_uring_cmd(struct io_kiocb *req, bool force_nonblock)
+{
+	struct io_uring_cmd *ioucmd = &req->uring_cmd;
+	struct io_ring_ctx *ctx = req->ctx;
+	struct file *file = req->file;
+	unsigned int issue_flags = 0;
+	int ret;
+
+	if (!file->f_op->uring_cmd)
+		return -EOPNOTSUPP;
+
+	if (ctx->flags & IORING_SETUP_IOPOLL) {
+		if (!file->f_op->uring_cmd_iopoll)
+			return -EOPNOTSUPP;
+		issue_flags |= IO_URING_F_IOPOLL;
+	}
+	if (ctx->flags & IORING_SETUP_SQE128)
+		issue_flags |= IO_URING_F_SQE128;
+	if (ctx->flags & IORING_SETUP_CQE32)
+		issue_flags |= IO_URING_F_CQE32;
+	if (force_nonblock)
+		issue_flags |= IO_URING_F_NONBLOCK;
+
+	ret = file->f_op->uring_cmd(ioucmd, issue_flags);
+	if (ret == -EAGAIN && force_nonblock) {
+		if (req->io)
+			return -EAGAIN;
+		if (__io_alloc_async_ctx(req)) {
+			ret = -ENOMEM;
+			goto done;
+		}
+		memcpy(req->io->uring_cmd, ioucmd->cmd, io_uring_cmd_size(ctx));
+		ioucmd->cmd = req->io->uring_cmd;
+		return -EAGAIN;
+	}
+	if (ret == -EIOCBQUEUED)
+		return 0;
+done:
+	io_uring_cmd_done(ioucmd, ret, 0);
+	return 0;
+}
+
 /*
  * IORING_OP_NOP just posts a completion event, nothing else.
  */
@@ -3230,6 +3746,12 @@ static int io_provide_buffers(struct io_kiocb *req, bool force_nonblock)
 
 	lockdep_assert_held(&ctx->uring_lock);
 
+	/* a group is either provided here or through a buffer ring */
+	if (xa_load(&ctx->io_buf_rings, p->bgid)) {
+		ret = -EINVAL;
+		goto out;
+	}
+
 	list = head = idr_find(&ctx->io_buffer_idr, p->bgid);
 
 	ret = io_add_buffers(p, &head);
@@ -3322,7 +3844,7 @@ static int io_madvise(struct io_kiocb *req, bool force_nonblock)
 	if (force_nonblock)
 		return -EAGAIN;
 
-	ret = do_madvise(ma->addr, ma->len, ma->advice);
+	ret = do_madvise(current->mm, ma->addr, ma->len, ma->advice);
 	if (ret < 0)
 		req_set_fail_links(req);
 	io_cqring_add_event(req, ret);
@@ -3758,25 +4280,36 @@ static int io_recvmsg_copy_hdr(struct io_kiocb *req, struct io_async_ctx *io)
 	return __io_recvmsg_copy_hdr(req, io);
 }
 
-static struct io_buffer *io_recv_buffer_select(struct io_kiocb *req,
-					       int *cflags, bool needs_lock)
+static void __user *io_recv_buffer_select(struct io_kiocb *req,
+					  int *cflags, bool needs_lock)
 {
 	struct io_sr_msg *sr = &req->sr_msg;
 	struct io_buffer *kbuf;
+	void __user *buf;
 
 	if (!(req->flags & REQ_F_BUFFER_SELECT))
 		return NULL;
 
-	kbuf = io_buffer_select(req, &sr->len, sr->bgid, sr->kbuf, needs_lock);
-	if (IS_ERR(kbuf))
-		return kbuf;
-
-	sr->kbuf = kbuf;
-	req->flags |= REQ_F_BUFFER_SELECTED;
+	if (!(req->flags & REQ_F_BUFFER_SELECTED)) {
+		buf = io_buffer_select(req, &sr->len, sr->bgid, &kbuf,
+				       needs_lock);
+		if (IS_ERR(buf))
+			return buf;
+		if (req->flags & REQ_F_BUFFER_RING)
+			sr->ring_buf = buf;
+		else
+			sr->kbuf = kbuf;
+	}
 
-	*cflags = kbuf->bid << IORING_CQE_BUFFER_SHIFT;
+	if (req->flags & REQ_F_BUFFER_RING) {
+		*cflags = req->buf_index << IORING_CQE_BUFFER_SHIFT;
+		buf = sr->ring_buf;
+	} else {
+		*cflags = sr->kbuf->bid << IORING_CQE_BUFFER_SHIFT;
+		buf = u64_to_user_ptr(sr->kbuf->addr);
+	}
 	*cflags |= IORING_CQE_F_BUFFER;
-	return kbuf;
+	return buf;
 }
 
 static int io_recvmsg_prep(struct io_kiocb *req,
@@ -3790,6 +4323,26 @@ static int io_recvmsg_prep(struct io_kiocb *req,
 	sr->msg = u64_to_user_ptr(READ_ONCE(sqe->addr));
 	sr->len = READ_ONCE(sqe->len);
 	sr->bgid = READ_ONCE(sqe->buf_group);
+	sr->fixed_buf = false;
+	sr->fixed_off = 0;
+
+	if (req->opcode == IORING_OP_RECV) {
+		/*
+		 * Recv has always ignored sqe->ioprio, so only look at the
+		 * bits that mean something and leave the rest alone.
+		 */
+		unsigned ioprio = READ_ONCE(sqe->ioprio);
+
+		if (ioprio & IORING_RECV_FIXED_BUF)
+			sr->fixed_buf = true;
+		if (ioprio & IORING_RECV_MULTISHOT) {
+			if (!(req->flags & REQ_F_BUFFER_SELECT) || sr->len)
+				return -EINVAL;
+			if (req->flags & (REQ_F_LINK | REQ_F_HARDLINK))
+				return -EINVAL;
+			req->flags |= REQ_F_MULTISHOT;
+		}
+	}
 
 #ifdef CONFIG_COMPAT
 	if (req->ctx->compat)
@@ -3819,8 +4372,8 @@ static int io_recvmsg(struct io_kiocb *req, bool force_nonblock)
 
 	sock = sock_from_file(req->file, &ret);
 	if (sock) {
-		struct io_buffer *kbuf;
 		struct io_async_ctx io;
+		void __user *buf;
 		unsigned flags;
 
 		if (req->io) {
@@ -3839,11 +4392,11 @@ static int io_recvmsg(struct io_kiocb *req, bool force_nonblock)
 				return ret;
 		}
 
-		kbuf = io_recv_buffer_select(req, &cflags, !force_nonblock);
-		if (IS_ERR(kbuf)) {
-			return PTR_ERR(kbuf);
-		} else if (kbuf) {
-			kmsg->fast_iov[0].iov_base = u64_to_user_ptr(kbuf->addr);
+		buf = io_recv_buffer_select(req, &cflags, !force_nonblock);
+		if (IS_ERR(buf)) {
+			return PTR_ERR(buf);
+		} else if (buf) {
+			kmsg->fast_iov[0].iov_base = buf;
 			iov_iter_init(&kmsg->msg.msg_iter, READ, kmsg->iov,
 					1, req->sr_msg.len);
 		}
@@ -3872,9 +4425,60 @@ static int io_recvmsg(struct io_kiocb *req, bool force_nonblock)
 	return 0;
 }
 
+/*
+ * Post the cqe for one receive of a multishot request and give up its
+ * buffer, so that the next receive selects a new one.  Returns false if the
+ * request has to complete instead.
+ */
+static bool io_recv_post_more(struct io_kiocb *req, int ret, int cflags,
+			      bool force_nonblock)
+{
+	if (!(req->flags & REQ_F_MULTISHOT) || !force_nonblock || ret <= 0)
+		return false;
+	if (!io_cqring_post_more(req, ret, cflags))
+		return false;
+
+	io_kbuf_free(req, req->sr_msg.kbuf);
+	req->flags &= ~(REQ_F_BUFFER_SELECTED | REQ_F_BUFFER_RING |
+			REQ_F_NEED_CLEANUP);
+	return true;
+}
+
+/*
+ * Set up a receive into a registered buffer.  The pages are pinned and
+ * mapped already, so the payload is copied straight out of the skb without
+ * going through the user copy and fault handling of a plain receive.
+ * sqe->buf_index names the registered buffer, and with buffer select that
+ * is also the group, so the provided buffer is looked up in it directly.
+ */
+static int io_recv_import_fixed(struct io_kiocb *req, void __user *buf,
+				struct iov_iter *iter)
+{
+	struct io_ring_ctx *ctx = req->ctx;
+	struct io_sr_msg *sr = &req->sr_msg;
+	u64 addr = (u64) (unsigned long) buf;
+	struct io_mapped_ubuf *imu;
+	ssize_t ret;
+	u16 index;
+
+	if (unlikely(!ctx->user_bufs))
+		return -EFAULT;
+	if (unlikely(sr->bgid >= ctx->nr_user_bufs))
+		return -EFAULT;
+
+	index = array_index_nospec(sr->bgid, ctx->nr_user_bufs);
+	imu = &ctx->user_bufs[index];
+	ret = __io_import_fixed(imu, READ, addr, sr->len, iter);
+	if (ret < 0)
+		return ret;
+
+	/* registered buffers are at most 1G, so the offset fits */
+	sr->fixed_off = addr - imu->ubuf;
+	return 0;
+}
+
 static int io_recv(struct io_kiocb *req, bool force_nonblock)
 {
-	struct io_buffer *kbuf = NULL;
 	struct socket *sock;
 	int ret, cflags = 0;
 
@@ -3885,20 +4489,31 @@ static int io_recv(struct io_kiocb *req, bool force_nonblock)
 	if (sock) {
 		struct io_sr_msg *sr = &req->sr_msg;
 		void __user *buf = sr->buf;
+		void __user *kbuf;
 		struct msghdr msg;
 		struct iovec iov;
 		unsigned flags;
 
+retry:
+		/* multishot receives fill whole buffers */
+		if ((req->flags & REQ_F_MULTISHOT) &&
+		    !(req->flags & REQ_F_BUFFER_SELECTED))
+			sr->len = MAX_RW_COUNT;
+
 		kbuf = io_recv_buffer_select(req, &cflags, !force_nonblock);
 		if (IS_ERR(kbuf))
 			return PTR_ERR(kbuf);
 		else if (kbuf)
-			buf = u64_to_user_ptr(kbuf->addr);
+			buf = kbuf;
 
-		ret = import_single_range(READ, buf, sr->len, &iov,
-						&msg.msg_iter);
+		if (sr->fixed_buf)
+			ret = io_recv_import_fixed(req, buf, &msg.msg_iter);
+		else
+			ret = import_single_range(READ, buf, sr->len, &iov,
+							&msg.msg_iter);
 		if (ret) {
-			kfree(kbuf);
+			if (req->flags & REQ_F_BUFFER_SELECTED)
+				io_kbuf_free(req, sr->kbuf);
 			return ret;
 		}
 
@@ -3917,13 +4532,22 @@ static int io_recv(struct io_kiocb *req, bool force_nonblock)
 			flags |= MSG_DONTWAIT;
 
 		ret = sock_recvmsg(sock, &msg, flags);
-		if (force_nonblock && ret == -EAGAIN)
+		if (force_nonblock && ret == -EAGAIN) {
+			/* multishot waits on the poll handler again */
+			if (req->flags & REQ_F_MULTISHOT)
+				req->flags &= ~REQ_F_POLLED;
 			return -EAGAIN;
+		}
 		if (ret == -ERESTARTSYS)
 			ret = -EINTR;
+		if (io_recv_post_more(req, ret, cflags, force_nonblock)) {
+			cflags = 0;
+			goto retry;
+		}
 	}
 
-	kfree(kbuf);
+	if (req->flags & REQ_F_BUFFER_SELECTED)
+		io_kbuf_free(req, req->sr_msg.kbuf);
 	req->flags &= ~REQ_F_NEED_CLEANUP;
 	__io_cqring_add_event(req, ret, cflags);
 	if (ret < 0)
@@ -3935,11 +4559,21 @@ static int io_recv(struct io_kiocb *req, bool force_nonblock)
 static int io_accept_prep(struct io_kiocb *req, const struct io_uring_sqe *sqe)
 {
 	struct io_accept *accept = &req->accept;
+	unsigned ioprio;
 
 	if (unlikely(req->ctx->flags & (IORING_SETUP_IOPOLL|IORING_SETUP_SQPOLL)))
 		return -EINVAL;
-	if (sqe->ioprio || sqe->len || sqe->buf_index)
+	if (sqe->len || sqe->buf_index)
+		return -EINVAL;
+
+	ioprio = READ_ONCE(sqe->ioprio);
+	if (ioprio & ~IORING_ACCEPT_MULTISHOT)
 		return -EINVAL;
+	if (ioprio & IORING_ACCEPT_MULTISHOT) {
+		if (req->flags & (REQ_F_LINK | REQ_F_HARDLINK))
+			return -EINVAL;
+		req->flags |= REQ_F_MULTISHOT;
+	}
 
 	accept->addr = u64_to_user_ptr(READ_ONCE(sqe->addr));
 	accept->addr_len = u64_to_user_ptr(READ_ONCE(sqe->addr2));
@@ -3955,13 +4589,25 @@ static int __io_accept(struct io_kiocb *req, bool force_nonblock)
 	int ret;
 
 	file_flags = force_nonblock ? O_NONBLOCK : 0;
+retry:
 	ret = __sys_accept4_file(req->file, file_flags, accept->addr,
 					accept->addr_len, accept->flags,
 					accept->nofile);
-	if (ret == -EAGAIN && force_nonblock)
+	if (ret == -EAGAIN && force_nonblock) {
+		/* multishot waits on the poll handler again */
+		if (req->flags & REQ_F_MULTISHOT)
+			req->flags &= ~REQ_F_POLLED;
 		return -EAGAIN;
+	}
 	if (ret == -ERESTARTSYS)
 		ret = -EINTR;
+	/*
+	 * Accept everything that is pending.  From io-wq a multishot
+	 * request can't go back to polling and completes as a single shot.
+	 */
+	if (ret >= 0 && (req->flags & REQ_F_MULTISHOT) && force_nonblock &&
+	    io_cqring_post_more(req, ret, 0))
+		goto retry;
 	if (ret < 0)
 		req_set_fail_links(req);
 	io_cqring_add_event(req, ret);
@@ -4429,8 +5075,11 @@ static bool io_arm_poll_handler(struct io_kiocb *req)
 	memcpy(&apoll->work, &req->work, sizeof(req->work));
 	had_io = req->io != NULL;
 
-	get_task_struct(current);
-	req->task = current;
+	/* multishot requests re-arm from the task they were armed by */
+	if (!req->task) {
+		get_task_struct(current);
+		req->task = current;
+	}
 	req->apoll = apoll;
 	INIT_HLIST_NODE(&req->hash_node);
 
@@ -5043,6 +5692,9 @@ static int io_req_defer_prep(struct io_kiocb *req,
 	case IORING_OP_TEE:
 		ret = io_tee_prep(req, sqe);
 		break;
+	case IORING_OP_URING_CMD:
+		ret = io_uring_cmd_prep(req, sqe);
+		break;
 	default:
 		printk_once(KERN_WARNING "io_uring: unhandled opcode %d\n",
 				req->opcode);
@@ -5091,7 +5743,7 @@ static void io_cleanup_req(struct io_kiocb *req)
 	case IORING_OP_READ_FIXED:
 	case IORING_OP_READ:
 		if (req->flags & REQ_F_BUFFER_SELECTED)
-			kfree((void *)(unsigned long)req->rw.addr);
+			io_kbuf_free(req, (void *)(unsigned long)req->rw.addr);
 		/* fallthrough */
 	case IORING_OP_WRITEV:
 	case IORING_OP_WRITE_FIXED:
@@ -5101,7 +5753,7 @@ static void io_cleanup_req(struct io_kiocb *req)
 		break;
 	case IORING_OP_RECVMSG:
 		if (req->flags & REQ_F_BUFFER_SELECTED)
-			kfree(req->sr_msg.kbuf);
+			io_kbuf_free(req, req->sr_msg.kbuf);
 		/* fallthrough */
 	case IORING_OP_SENDMSG:
 		if (io->msg.iov != io->msg.fast_iov)
@@ -5109,7 +5761,7 @@ static void io_cleanup_req(struct io_kiocb *req)
 		break;
 	case IORING_OP_RECV:
 		if (req->flags & REQ_F_BUFFER_SELECTED)
-			kfree(req->sr_msg.kbuf);
+			io_kbuf_free(req, req->sr_msg.kbuf);
 		break;
 	case IORING_OP_OPENAT:
 	case IORING_OP_OPENAT2:
@@ -5354,6 +6006,14 @@ static int io_issue_sqe(struct io_kiocb *req, const struct io_uring_sqe *sqe,
 		}
 		ret = io_tee(req, force_nonblock);
 		break;
+	case IORING_OP_URING_CMD:
+		if (sqe) {
+			ret = io_uring_cmd_prep(req, sqe);
+			if (ret)
+				break;
+		}
+		ret = io_uring_cmd(req, force_nonblock);
+		break;
 	default:
 		ret = -EINVAL;
 		break;
@@ -5778,7 +6438,7 @@ static void io_submit_state_end(struct io_submit_state *state)
 static void io_submit_state_start(struct io_submit_state *state,
 				  unsigned int max_ios)
 {
-	blk_start_plug(&state->plug);
+	blk_start_plug_nr_ios(&state->plug, max_ios);
 	state->free_reqs = 0;
 	state->file = NULL;
 	state->ios_left = max_ios;
@@ -5818,8 +6478,12 @@ static const struct io_uring_sqe *io_get_sqe(struct io_ring_ctx *ctx)
 	 *    though the application is the one updating it.
 	 */
 	head = READ_ONCE(sq_array[ctx->cached_sq_head & ctx->sq_mask]);
-	if (likely(head < ctx->sq_entries))
+	if (likely(head < ctx->sq_entries)) {
+		/* double index for 128 byte sqes, they take up two slots */
+		if (ctx->flags & IORING_SETUP_SQE128)
+			head <<= 1;
 		return &ctx->sq_sqes[head];
+	}
 
 	/* drop invalid entries */
 	ctx->cached_sq_dropped++;
@@ -5976,80 +6640,170 @@ static int io_submit_sqes(struct io_ring_ctx *ctx, unsigned int nr,
 	return submitted;
 }
 
-static inline void io_sq_thread_drop_mm(struct io_ring_ctx *ctx)
+/*
+ * With more than one ring on the thread, each ring gets at most this many
+ * sqes per pass so that a busy ring can't starve the others.
+ */
+#define IORING_SQPOLL_CAP_ENTRIES_VALUE	8
+
+enum {
+	SQT_IDLE	= 1,	/* nothing to do */
+	SQT_SPIN	= 2,	/* polled IO in flight, don't go to sleep */
+	SQT_DID_WORK	= 4,	/* submitted or reaped something */
+};
+
+/*
+ * A ring whose submission hit -EBUSY waits for the application to reap
+ * completions until its CQ overflow backlog has been flushed.
+ */
+static bool io_sq_ring_busy(struct io_ring_ctx *ctx)
+{
+	if (ctx->sq_busy && list_empty_careful(&ctx->cq_overflow_list))
+		ctx->sq_busy = false;
+	return ctx->sq_busy;
+}
+
+static int __io_sq_thread(struct io_ring_ctx *ctx, bool cap_entries)
 {
-	struct mm_struct *mm = current->mm;
+	unsigned int to_submit;
+	int ret = SQT_IDLE;
 
-	if (mm) {
-		unuse_mm(mm);
-		mmput(mm);
+	if (!list_empty(&ctx->poll_list)) {
+		unsigned nr_events = 0;
+
+		/*
+		 * Reaping may finish commands that copy to user memory, so
+		 * it has to happen in this ring's mm, never in the one of
+		 * the ring serviced before.
+		 */
+		io_sq_thread_acquire_mm(ctx);
+		mutex_lock(&ctx->uring_lock);
+		if (!list_empty(&ctx->poll_list))
+			io_iopoll_getevents(ctx, &nr_events, 0);
+		ret = list_empty(&ctx->poll_list) ? SQT_DID_WORK : SQT_SPIN;
+		mutex_unlock(&ctx->uring_lock);
+	}
+
+	to_submit = io_sqring_entries(ctx);
+	if (!to_submit || io_sq_ring_busy(ctx))
+		return ret;
+	/* a dying ring's sqes are never submitted, don't spin on them */
+	if (percpu_ref_is_dying(&ctx->refs))
+		return ret;
+	if (cap_entries && to_submit > IORING_SQPOLL_CAP_ENTRIES_VALUE)
+		to_submit = IORING_SQPOLL_CAP_ENTRIES_VALUE;
+
+	/* requests are issued against the mm of the ring they came from */
+	if (current->mm && current->mm != ctx->sqo_mm)
+		io_sq_thread_drop_mm();
+
+	mutex_lock(&ctx->uring_lock);
+	if (io_submit_sqes(ctx, to_submit, NULL, -1) == -EBUSY)
+		ctx->sq_busy = true;
+	mutex_unlock(&ctx->uring_lock);
+
+	return ctx->sq_busy ? ret : SQT_DID_WORK;
+}
+
+#define IO_SQ_IDLE_SHIFT	3
+
+static void io_sq_thread_busy(struct io_sq_data *sqd)
+{
+	unsigned long now = jiffies;
+
+	if (sqd->was_idle) {
+		unsigned long gap = now - sqd->last_busy;
+
+		sqd->idle_gap_avg += gap - (sqd->idle_gap_avg >> IO_SQ_IDLE_SHIFT);
+		sqd->was_idle = false;
 	}
+	sqd->last_busy = now;
+}
+
+/*
+ * How long to spin without work before going to sleep.  Spinning for twice
+ * the usual gap between bursts of submissions catches the next burst without
+ * burning a CPU once the application has gone quiet.  If bursts are further
+ * apart than the rings' sq_thread_idle, spinning would rarely catch one, so
+ * give the CPU back almost right away.
+ */
+static unsigned long io_sq_thread_idle(struct io_sq_data *sqd)
+{
+	unsigned long gap = sqd->idle_gap_avg >> IO_SQ_IDLE_SHIFT;
+	unsigned long min_idle = msecs_to_jiffies(1);
+
+	if (gap >= sqd->sq_thread_idle)
+		return min_idle;
+	return clamp(2 * gap, min_idle, (unsigned long) sqd->sq_thread_idle);
 }
 
 static int io_sq_thread(void *data)
 {
-	struct io_ring_ctx *ctx = data;
-	const struct cred *old_cred;
+	struct io_sq_data *sqd = data;
+	struct io_ring_ctx *ctx;
 	mm_segment_t old_fs;
 	DEFINE_WAIT(wait);
-	unsigned long timeout;
-	int ret = 0;
 
-	complete(&ctx->sq_thread_comp);
+	complete(&sqd->startup);
 
 	old_fs = get_fs();
 	set_fs(USER_DS);
-	old_cred = override_creds(ctx->creds);
 
-	timeout = jiffies + ctx->sq_thread_idle;
+	mutex_lock(&sqd->lock);
+	sqd->last_busy = jiffies;
+	mutex_unlock(&sqd->lock);
+
 	while (!kthread_should_park()) {
-		unsigned int to_submit;
+		bool cap_entries, needs_sched = true;
+		int ret = 0;
 
-		if (!list_empty(&ctx->poll_list)) {
-			unsigned nr_events = 0;
+		mutex_lock(&sqd->lock);
+		cap_entries = !list_is_singular(&sqd->ctx_list);
+		list_for_each_entry(ctx, &sqd->ctx_list, sqd_list) {
+			const struct cred *old_cred;
 
-			mutex_lock(&ctx->uring_lock);
-			if (!list_empty(&ctx->poll_list))
-				io_iopoll_getevents(ctx, &nr_events, 0);
-			else
-				timeout = jiffies + ctx->sq_thread_idle;
-			mutex_unlock(&ctx->uring_lock);
+			old_cred = override_creds(ctx->creds);
+			ret |= __io_sq_thread(ctx, cap_entries);
+			revert_creds(old_cred);
 		}
-
-		to_submit = io_sqring_entries(ctx);
+		/* let the next ring go first on the following pass */
+		list_rotate_left(&sqd->ctx_list);
+
+		if (ret & SQT_DID_WORK) {
+			io_sq_thread_busy(sqd);
+			mutex_unlock(&sqd->lock);
+			if (current->task_works)
+				task_work_run();
+			cond_resched();
+			continue;
+		}
+		sqd->was_idle = true;
 
 		/*
-		 * If submit got -EBUSY, flag us as needing the application
-		 * to enter the kernel to reap and flush events.
+		 * Drop cur_mm before scheduling, we can't hold it for
+		 * long periods (or over schedule()). Do this before
+		 * adding ourselves to the waitqueue, as the unuse/drop
+		 * may sleep.
 		 */
-		if (!to_submit || ret == -EBUSY) {
-			/*
-			 * Drop cur_mm before scheduling, we can't hold it for
-			 * long periods (or over schedule()). Do this before
-			 * adding ourselves to the waitqueue, as the unuse/drop
-			 * may sleep.
-			 */
-			io_sq_thread_drop_mm(ctx);
-
-			/*
-			 * We're polling. If we're within the defined idle
-			 * period, then let us spin without work before going
-			 * to sleep. The exception is if we got EBUSY doing
-			 * more IO, we should wait for the application to
-			 * reap events and wake us up.
-			 */
-			if (!list_empty(&ctx->poll_list) ||
-			    (!time_after(jiffies, timeout) && ret != -EBUSY &&
-			    !percpu_ref_is_dying(&ctx->refs))) {
-				if (current->task_works)
-					task_work_run();
-				cond_resched();
-				continue;
-			}
+		io_sq_thread_drop_mm();
 
-			prepare_to_wait(&ctx->sqo_wait, &wait,
-						TASK_INTERRUPTIBLE);
+		/*
+		 * We're polling. If we're within the idle period, then let us
+		 * spin without work before going to sleep. Rings that got
+		 * EBUSY doing more IO don't count, they wait for the
+		 * application to reap events and wake us up.
+		 */
+		if ((ret & SQT_SPIN) ||
+		    !time_after(jiffies, sqd->last_busy + io_sq_thread_idle(sqd))) {
+			mutex_unlock(&sqd->lock);
+			if (current->task_works)
+				task_work_run();
+			cond_resched();
+			continue;
+		}
 
+		prepare_to_wait(&sqd->wait, &wait, TASK_INTERRUPTIBLE);
+		list_for_each_entry(ctx, &sqd->ctx_list, sqd_list) {
 			/*
 			 * While doing polled IO, before going to sleep, we need
 			 * to check if there are new reqs added to poll_list, it
@@ -6059,8 +6813,8 @@ static int io_sq_thread(void *data)
 			 */
 			if ((ctx->flags & IORING_SETUP_IOPOLL) &&
 			    !list_empty_careful(&ctx->poll_list)) {
-				finish_wait(&ctx->sqo_wait, &wait);
-				continue;
+				needs_sched = false;
+				break;
 			}
 
 			/* Tell userspace we may need a wakeup call */
@@ -6068,44 +6822,36 @@ static int io_sq_thread(void *data)
 			/* make sure to read SQ tail after writing flags */
 			smp_mb();
 
-			to_submit = io_sqring_entries(ctx);
-			if (!to_submit || ret == -EBUSY) {
-				if (kthread_should_park()) {
-					finish_wait(&ctx->sqo_wait, &wait);
-					break;
-				}
-				if (current->task_works) {
-					task_work_run();
-					finish_wait(&ctx->sqo_wait, &wait);
-					continue;
-				}
-				if (signal_pending(current))
-					flush_signals(current);
-				schedule();
-				finish_wait(&ctx->sqo_wait, &wait);
-
-				ctx->rings->sq_flags &= ~IORING_SQ_NEED_WAKEUP;
-				ret = 0;
-				continue;
+			if (io_sqring_entries(ctx) && !io_sq_ring_busy(ctx) &&
+			    !percpu_ref_is_dying(&ctx->refs)) {
+				needs_sched = false;
+				break;
 			}
-			finish_wait(&ctx->sqo_wait, &wait);
+		}
+		mutex_unlock(&sqd->lock);
 
-			ctx->rings->sq_flags &= ~IORING_SQ_NEED_WAKEUP;
+		if (needs_sched && !kthread_should_park() &&
+		    !current->task_works) {
+			if (signal_pending(current))
+				flush_signals(current);
+			schedule();
 		}
+		finish_wait(&sqd->wait, &wait);
 
-		mutex_lock(&ctx->uring_lock);
-		if (likely(!percpu_ref_is_dying(&ctx->refs)))
-			ret = io_submit_sqes(ctx, to_submit, NULL, -1);
-		mutex_unlock(&ctx->uring_lock);
-		timeout = jiffies + ctx->sq_thread_idle;
+		if (current->task_works)
+			task_work_run();
+
+		mutex_lock(&sqd->lock);
+		list_for_each_entry(ctx, &sqd->ctx_list, sqd_list)
+			ctx->rings->sq_flags &= ~IORING_SQ_NEED_WAKEUP;
+		mutex_unlock(&sqd->lock);
 	}
 
 	if (current->task_works)
 		task_work_run();
 
 	set_fs(old_fs);
-	io_sq_thread_drop_mm(ctx);
-	revert_creds(old_cred);
+	io_sq_thread_drop_mm();
 
 	kthread_parkme();
 
@@ -6273,18 +7019,45 @@ static int io_sqe_files_unregister(struct io_ring_ctx *ctx)
 	return 0;
 }
 
+static void io_put_sq_data(struct io_sq_data *sqd)
+{
+	if (refcount_dec_and_test(&sqd->refs)) {
+		if (sqd->thread) {
+			wait_for_completion(&sqd->startup);
+			/*
+			 * The park is a bit of a work-around, without it we get
+			 * warning spews on shutdown with SQPOLL set and affinity
+			 * set to a single CPU.
+			 */
+			kthread_park(sqd->thread);
+			kthread_stop(sqd->thread);
+		}
+		kfree(sqd);
+	}
+}
+
+static void io_sq_thread_update_idle(struct io_sq_data *sqd)
+{
+	struct io_ring_ctx *ctx;
+	unsigned sq_thread_idle = 0;
+
+	list_for_each_entry(ctx, &sqd->ctx_list, sqd_list)
+		sq_thread_idle = max(sq_thread_idle, ctx->sq_thread_idle);
+	sqd->sq_thread_idle = sq_thread_idle;
+}
+
 static void io_sq_thread_stop(struct io_ring_ctx *ctx)
 {
-	if (ctx->sqo_thread) {
-		wait_for_completion(&ctx->sq_thread_comp);
-		/*
-		 * The park is a bit of a work-around, without it we get
-		 * warning spews on shutdown with SQPOLL set and affinity
-		 * set to a single CPU.
-		 */
-		kthread_park(ctx->sqo_thread);
-		kthread_stop(ctx->sqo_thread);
-		ctx->sqo_thread = NULL;
+	struct io_sq_data *sqd = ctx->sq_data;
+
+	if (sqd) {
+		mutex_lock(&sqd->lock);
+		list_del_init(&ctx->sqd_list);
+		io_sq_thread_update_idle(sqd);
+		mutex_unlock(&sqd->lock);
+
+		io_put_sq_data(sqd);
+		ctx->sq_data = NULL;
 	}
 }
 
@@ -6914,6 +7687,52 @@ static int io_init_wq_offload(struct io_ring_ctx *ctx,
 	return ret;
 }
 
+static struct io_sq_data *io_attach_sq_data(struct io_uring_params *p)
+{
+	struct io_ring_ctx *ctx_attach;
+	struct io_sq_data *sqd;
+	struct fd f;
+
+	f = fdget(p->wq_fd);
+	if (!f.file)
+		return ERR_PTR(-EBADF);
+	if (f.file->f_op != &io_uring_fops) {
+		fdput(f);
+		return ERR_PTR(-EINVAL);
+	}
+
+	ctx_attach = f.file->private_data;
+	/* @sq_data is protected by holding the fd */
+	sqd = ctx_attach->sq_data;
+	if (sqd)
+		refcount_inc(&sqd->refs);
+	fdput(f);
+	return sqd;
+}
+
+static struct io_sq_data *io_get_sq_data(struct io_uring_params *p)
+{
+	struct io_sq_data *sqd;
+
+	/* share the SQPOLL thread too if the ring we attach to has one */
+	if (p->flags & IORING_SETUP_ATTACH_WQ) {
+		sqd = io_attach_sq_data(p);
+		if (sqd)
+			return sqd;
+	}
+
+	sqd = kzalloc(sizeof(*sqd), GFP_KERNEL);
+	if (!sqd)
+		return ERR_PTR(-ENOMEM);
+
+	refcount_set(&sqd->refs, 1);
+	mutex_init(&sqd->lock);
+	INIT_LIST_HEAD(&sqd->ctx_list);
+	init_waitqueue_head(&sqd->wait);
+	init_completion(&sqd->startup);
+	return sqd;
+}
+
 static int io_sq_offload_start(struct io_ring_ctx *ctx,
 			       struct io_uring_params *p)
 {
@@ -6923,14 +7742,41 @@ static int io_sq_offload_start(struct io_ring_ctx *ctx,
 	ctx->sqo_mm = current->mm;
 
 	if (ctx->flags & IORING_SETUP_SQPOLL) {
+		struct io_sq_data *sqd;
+
 		ret = -EPERM;
 		if (!capable(CAP_SYS_ADMIN))
 			goto err;
 
+		sqd = io_get_sq_data(p);
+		if (IS_ERR(sqd)) {
+			ret = PTR_ERR(sqd);
+			goto err;
+		}
+		ctx->sq_data = sqd;
+
 		ctx->sq_thread_idle = msecs_to_jiffies(p->sq_thread_idle);
 		if (!ctx->sq_thread_idle)
 			ctx->sq_thread_idle = HZ;
 
+		mutex_lock(&sqd->lock);
+		list_add(&ctx->sqd_list, &sqd->ctx_list);
+		io_sq_thread_update_idle(sqd);
+		/* start out spinning for as long as the rings asked for */
+		sqd->idle_gap_avg = (unsigned long) sqd->sq_thread_idle <<
+					(IO_SQ_IDLE_SHIFT - 1);
+		mutex_unlock(&sqd->lock);
+
+		/*
+		 * An attached ring shares the existing thread, whose CPU was
+		 * picked by the ring that created it. Kick it so that it
+		 * notices the new ring before going back to sleep.
+		 */
+		if (sqd->thread) {
+			wake_up_process(sqd->thread);
+			goto done;
+		}
+
 		if (p->flags & IORING_SETUP_SQ_AFF) {
 			int cpu = p->sq_thread_cpu;
 
@@ -6940,25 +7786,25 @@ static int io_sq_offload_start(struct io_ring_ctx *ctx,
 			if (!cpu_online(cpu))
 				goto err;
 
-			ctx->sqo_thread = kthread_create_on_cpu(io_sq_thread,
-							ctx, cpu,
-							"io_uring-sq");
+			sqd->thread = kthread_create_on_cpu(io_sq_thread, sqd,
+							cpu, "io_uring-sq");
 		} else {
-			ctx->sqo_thread = kthread_create(io_sq_thread, ctx,
+			sqd->thread = kthread_create(io_sq_thread, sqd,
 							"io_uring-sq");
 		}
-		if (IS_ERR(ctx->sqo_thread)) {
-			ret = PTR_ERR(ctx->sqo_thread);
-			ctx->sqo_thread = NULL;
+		if (IS_ERR(sqd->thread)) {
+			ret = PTR_ERR(sqd->thread);
+			sqd->thread = NULL;
 			goto err;
 		}
-		wake_up_process(ctx->sqo_thread);
+		wake_up_process(sqd->thread);
 	} else if (p->flags & IORING_SETUP_SQ_AFF) {
 		/* Can't have SQ_AFF without SQPOLL */
 		ret = -EINVAL;
 		goto err;
 	}
 
+done:
 	ret = io_init_wq_offload(ctx, p);
 	if (ret)
 		goto err;
@@ -7014,12 +7860,17 @@ static void *io_mem_alloc(size_t size)
 	return (void *) __get_free_pages(gfp_flags, get_order(size));
 }
 
-static unsigned long rings_size(unsigned sq_entries, unsigned cq_entries,
-				size_t *sq_offset)
+static unsigned long rings_size(unsigned int flags, unsigned sq_entries,
+				unsigned cq_entries, size_t *sq_offset)
 {
 	struct io_rings *rings;
 	size_t off, sq_array_size;
 
+	if (flags & IORING_SETUP_CQE32) {
+		if (check_shl_overflow(cq_entries, 1, &cq_entries))
+			return SIZE_MAX;
+	}
+
 	off = struct_size(rings, cqes, cq_entries);
 	if (off == SIZE_MAX)
 		return SIZE_MAX;
@@ -7043,14 +7894,23 @@ static unsigned long rings_size(unsigned sq_entries, unsigned cq_entries,
 	return off;
 }
 
-static unsigned long ring_pages(unsigned sq_entries, unsigned cq_entries)
+static size_t sqes_size(unsigned int flags, unsigned sq_entries)
+{
+	size_t sqe_size = sizeof(struct io_uring_sqe);
+
+	if (flags & IORING_SETUP_SQE128)
+		sqe_size *= 2;
+	return array_size(sqe_size, sq_entries);
+}
+
+static unsigned long ring_pages(unsigned int flags, unsigned sq_entries,
+				unsigned cq_entries)
 {
 	size_t pages;
 
 	pages = (size_t)1 << get_order(
-		rings_size(sq_entries, cq_entries, NULL));
-	pages += (size_t)1 << get_order(
-		array_size(sizeof(struct io_uring_sqe), sq_entries));
+		rings_size(flags, sq_entries, cq_entries, NULL));
+	pages += (size_t)1 << get_order(sqes_size(flags, sq_entries));
 
 	return pages;
 }
@@ -7288,10 +8148,28 @@ static int __io_destroy_buffers(int id, void *p, void *data)
 	return 0;
 }
 
+static void io_put_buf_ring(struct io_buffer_ring *bl)
+{
+	if (refcount_dec_and_test(&bl->refs)) {
+		io_mem_free(bl->br);
+		/* mmap looks rings up without the uring_lock */
+		kfree_rcu(bl, rcu);
+	}
+}
+
 static void io_destroy_buffers(struct io_ring_ctx *ctx)
 {
+	struct io_buffer_ring *bl;
+	unsigned long index;
+
 	idr_for_each(&ctx->io_buffer_idr, __io_destroy_buffers, ctx);
 	idr_destroy(&ctx->io_buffer_idr);
+
+	xa_for_each(&ctx->io_buf_rings, index, bl) {
+		xa_erase(&ctx->io_buf_rings, index);
+		io_put_buf_ring(bl);
+	}
+	xa_destroy(&ctx->io_buf_rings);
 }
 
 static void io_ring_ctx_free(struct io_ring_ctx *ctx)
@@ -7320,7 +8198,8 @@ static void io_ring_ctx_free(struct io_ring_ctx *ctx)
 	percpu_ref_exit(&ctx->refs);
 	if (ctx->account_mem)
 		io_unaccount_mem(ctx->user,
-				ring_pages(ctx->sq_entries, ctx->cq_entries));
+				ring_pages(ctx->flags, ctx->sq_entries,
+					   ctx->cq_entries));
 	free_uid(ctx->user);
 	put_cred(ctx->creds);
 	kfree(ctx->cancel_hash);
@@ -7481,11 +8360,60 @@ static int io_uring_flush(struct file *file, void *data)
 	return 0;
 }
 
+/* Returns the buffer ring mapped at @offset with a reference held */
+static struct io_buffer_ring *io_pbuf_ring_get(struct io_ring_ctx *ctx,
+					       loff_t offset)
+{
+	struct io_buffer_ring *bl;
+	unsigned long bgid;
+
+	if (offset < IORING_OFF_PBUF_RING)
+		return NULL;
+	offset -= IORING_OFF_PBUF_RING;
+	if (offset & ((1ULL << IORING_OFF_PBUF_SHIFT) - 1))
+		return NULL;
+	bgid = offset >> IORING_OFF_PBUF_SHIFT;
+	if (bgid > USHRT_MAX)
+		return NULL;
+
+	/* Can't take the uring_lock under mmap_sem */
+	rcu_read_lock();
+	bl = xa_load(&ctx->io_buf_rings, bgid);
+	if (bl && !refcount_inc_not_zero(&bl->refs))
+		bl = NULL;
+	rcu_read_unlock();
+	return bl;
+}
+
+static void io_pbuf_ring_vm_open(struct vm_area_struct *vma)
+{
+	struct io_buffer_ring *bl = vma->vm_private_data;
+
+	refcount_inc(&bl->refs);
+}
+
+static void io_pbuf_ring_vm_close(struct vm_area_struct *vma)
+{
+	io_put_buf_ring(vma->vm_private_data);
+}
+
+/* An unregistered buffer ring is freed once it is no longer mapped */
+static const struct vm_operations_struct io_pbuf_ring_vm_ops = {
+	.open	= io_pbuf_ring_vm_open,
+	.close	= io_pbuf_ring_vm_close,
+};
+
+/*
+ * For a provided buffer ring, *@blp is set to it with a reference held,
+ * which the caller passes on to the mapping or drops.
+ */
 static void *io_uring_validate_mmap_request(struct file *file,
-					    loff_t pgoff, size_t sz)
+					    loff_t pgoff, size_t sz,
+					    struct io_buffer_ring **blp)
 {
 	struct io_ring_ctx *ctx = file->private_data;
 	loff_t offset = pgoff << PAGE_SHIFT;
+	struct io_buffer_ring *bl = NULL;
 	struct page *page;
 	void *ptr;
 
@@ -7498,13 +8426,21 @@ static void *io_uring_validate_mmap_request(struct file *file,
 		ptr = ctx->sq_sqes;
 		break;
 	default:
-		return ERR_PTR(-EINVAL);
+		bl = io_pbuf_ring_get(ctx, offset);
+		if (!bl)
+			return ERR_PTR(-EINVAL);
+		ptr = bl->br;
+		break;
 	}
 
 	page = virt_to_head_page(ptr);
-	if (sz > page_size(page))
+	if (sz > page_size(page)) {
+		if (bl)
+			io_put_buf_ring(bl);
 		return ERR_PTR(-EINVAL);
+	}
 
+	*blp = bl;
 	return ptr;
 }
 
@@ -7513,22 +8449,44 @@ static void *io_uring_validate_mmap_request(struct file *file,
 static int io_uring_mmap(struct file *file, struct vm_area_struct *vma)
 {
 	size_t sz = vma->vm_end - vma->vm_start;
+	struct io_buffer_ring *bl;
 	unsigned long pfn;
 	void *ptr;
+	int ret;
 
-	ptr = io_uring_validate_mmap_request(file, vma->vm_pgoff, sz);
+	ptr = io_uring_validate_mmap_request(file, vma->vm_pgoff, sz, &bl);
 	if (IS_ERR(ptr))
 		return PTR_ERR(ptr);
 
 	pfn = virt_to_phys(ptr) >> PAGE_SHIFT;
-	return remap_pfn_range(vma, vma->vm_start, pfn, sz, vma->vm_page_prot);
+	ret = remap_pfn_range(vma, vma->vm_start, pfn, sz, vma->vm_page_prot);
+	if (bl) {
+		if (ret) {
+			io_put_buf_ring(bl);
+		} else {
+			vma->vm_ops = &io_pbuf_ring_vm_ops;
+			vma->vm_private_data = bl;
+		}
+	}
+	return ret;
 }
 
 #else /* !CONFIG_MMU */
 
 static int io_uring_mmap(struct file *file, struct vm_area_struct *vma)
 {
-	return vma->vm_flags & (VM_SHARED | VM_MAYSHARE) ? 0 : -EINVAL;
+	struct io_buffer_ring *bl;
+
+	if (!(vma->vm_flags & (VM_SHARED | VM_MAYSHARE)))
+		return -EINVAL;
+
+	bl = io_pbuf_ring_get(file->private_data,
+			      (loff_t) vma->vm_pgoff << PAGE_SHIFT);
+	if (bl) {
+		vma->vm_ops = &io_pbuf_ring_vm_ops;
+		vma->vm_private_data = bl;
+	}
+	return 0;
 }
 
 static unsigned int io_uring_nommu_mmap_capabilities(struct file *file)
@@ -7540,11 +8498,15 @@ static unsigned long io_uring_nommu_get_unmapped_area(struct file *file,
 	unsigned long addr, unsigned long len,
 	unsigned long pgoff, unsigned long flags)
 {
+	struct io_buffer_ring *bl;
 	void *ptr;
 
-	ptr = io_uring_validate_mmap_request(file, pgoff, len);
+	ptr = io_uring_validate_mmap_request(file, pgoff, len, &bl);
 	if (IS_ERR(ptr))
 		return PTR_ERR(ptr);
+	/* io_uring_mmap() takes the reference for the mapping */
+	if (bl)
+		io_put_buf_ring(bl);
 
 	return (unsigned long) ptr;
 }
@@ -7589,7 +8551,7 @@ SYSCALL_DEFINE6(io_uring_enter, unsigned int, fd, u32, to_submit,
 		if (!list_empty_careful(&ctx->cq_overflow_list))
 			io_cqring_overflow_flush(ctx, false);
 		if (flags & IORING_ENTER_SQ_WAKEUP)
-			wake_up(&ctx->sqo_wait);
+			wake_up(&ctx->sq_data->wait);
 		submitted = to_submit;
 	} else if (to_submit) {
 		mutex_lock(&ctx->uring_lock);
@@ -7733,7 +8695,8 @@ static int io_allocate_scq_urings(struct io_ring_ctx *ctx,
 	struct io_rings *rings;
 	size_t size, sq_array_offset;
 
-	size = rings_size(p->sq_entries, p->cq_entries, &sq_array_offset);
+	size = rings_size(p->flags, p->sq_entries, p->cq_entries,
+			  &sq_array_offset);
 	if (size == SIZE_MAX)
 		return -EOVERFLOW;
 
@@ -7752,7 +8715,7 @@ static int io_allocate_scq_urings(struct io_ring_ctx *ctx,
 	ctx->sq_entries = rings->sq_ring_entries;
 	ctx->cq_entries = rings->cq_ring_entries;
 
-	size = array_size(sizeof(struct io_uring_sqe), p->sq_entries);
+	size = sqes_size(p->flags, p->sq_entries);
 	if (size == SIZE_MAX) {
 		io_mem_free(ctx->rings);
 		ctx->rings = NULL;
@@ -7860,7 +8823,8 @@ static int io_uring_create(unsigned entries, struct io_uring_params *p,
 
 	if (account_mem) {
 		ret = io_account_mem(user,
-				ring_pages(p->sq_entries, p->cq_entries));
+				ring_pages(p->flags, p->sq_entries,
+					   p->cq_entries));
 		if (ret) {
 			free_uid(user);
 			return ret;
@@ -7870,8 +8834,8 @@ static int io_uring_create(unsigned entries, struct io_uring_params *p,
 	ctx = io_ring_ctx_alloc(p);
 	if (!ctx) {
 		if (account_mem)
-			io_unaccount_mem(user, ring_pages(p->sq_entries,
-								p->cq_entries));
+			io_unaccount_mem(user, ring_pages(p->flags,
+						p->sq_entries, p->cq_entries));
 		free_uid(user);
 		return -ENOMEM;
 	}
@@ -7948,7 +8912,8 @@ static long io_uring_setup(u32 entries, struct io_uring_params __user *params)
 
 	if (p.flags & ~(IORING_SETUP_IOPOLL | IORING_SETUP_SQPOLL |
 			IORING_SETUP_SQ_AFF | IORING_SETUP_CQSIZE |
-			IORING_SETUP_CLAMP | IORING_SETUP_ATTACH_WQ))
+			IORING_SETUP_CLAMP | IORING_SETUP_ATTACH_WQ |
+			IORING_SETUP_SQE128 | IORING_SETUP_CQE32))
 		return -EINVAL;
 
 	return  io_uring_create(entries, &p, params);
@@ -8024,6 +8989,86 @@ static int io_unregister_personality(struct io_ring_ctx *ctx, unsigned id)
 	return -EINVAL;
 }
 
+static int io_register_pbuf_ring(struct io_ring_ctx *ctx, void __user *arg)
+{
+	struct io_uring_buf_reg reg;
+	struct io_buffer_ring *bl;
+	int ret;
+
+	if (copy_from_user(&reg, arg, sizeof(reg)))
+		return -EFAULT;
+	if (reg.pad || reg.resv[0] || reg.resv[1] || reg.resv[2])
+		return -EINVAL;
+	if (!is_power_of_2(reg.ring_entries) || reg.ring_entries > 32768)
+		return -EINVAL;
+	if (idr_find(&ctx->io_buffer_idr, reg.bgid))
+		return -EEXIST;
+
+	bl = kzalloc(sizeof(*bl), GFP_KERNEL);
+	if (!bl)
+		return -ENOMEM;
+	bl->br = io_mem_alloc(reg.ring_entries * sizeof(struct io_uring_buf));
+	if (!bl->br) {
+		kfree(bl);
+		return -ENOMEM;
+	}
+	refcount_set(&bl->refs, 1);
+	bl->bgid = reg.bgid;
+	bl->mask = reg.ring_entries - 1;
+
+	ret = xa_insert(&ctx->io_buf_rings, reg.bgid, bl, GFP_KERNEL);
+	if (ret) {
+		io_put_buf_ring(bl);
+		return ret == -EBUSY ? -EEXIST : ret;
+	}
+	return 0;
+}
+
+static int io_unregister_pbuf_ring(struct io_ring_ctx *ctx, void __user *arg)
+{
+	struct io_uring_buf_reg reg;
+	struct io_buffer_ring *bl;
+
+	if (copy_from_user(&reg, arg, sizeof(reg)))
+		return -EFAULT;
+	if (reg.pad || reg.resv[0] || reg.resv[1] || reg.resv[2])
+		return -EINVAL;
+
+	bl = xa_erase(&ctx->io_buf_rings, reg.bgid);
+	if (!bl)
+		return -ENOENT;
+
+	/* the application may still have it mapped */
+	io_put_buf_ring(bl);
+	return 0;
+}
+
+/*
+ * Limit the bounded and unbounded io-wq workers, per NUMA node. The limits
+ * apply to the io-wq, so rings sharing it through IORING_SETUP_ATTACH_WQ
+ * share them too. The previous limits are copied back.
+ */
+static int io_register_iowq_max_workers(struct io_ring_ctx *ctx,
+					void __user *arg)
+{
+	int new_count[2];
+	int i;
+
+	if (!ctx->io_wq)
+		return -EINVAL;
+	if (copy_from_user(new_count, arg, sizeof(new_count)))
+		return -EFAULT;
+	for (i = 0; i < ARRAY_SIZE(new_count); i++)
+		if (new_count[i] < 0)
+			return -EINVAL;
+
+	io_wq_max_workers(ctx->io_wq, new_count);
+
+	if (copy_to_user(arg, new_count, sizeof(new_count)))
+		return -EFAULT;
+	return 0;
+}
+
 static bool io_register_op_must_quiesce(int op)
 {
 	switch (op) {
@@ -8032,6 +9077,9 @@ static bool io_register_op_must_quiesce(int op)
 	case IORING_REGISTER_PROBE:
 	case IORING_REGISTER_PERSONALITY:
 	case IORING_UNREGISTER_PERSONALITY:
+	case IORING_REGISTER_PBUF_RING:
+	case IORING_UNREGISTER_PBUF_RING:
+	case IORING_REGISTER_IOWQ_MAX_WORKERS:
 		return false;
 	default:
 		return true;
@@ -8133,6 +9181,24 @@ static int __io_uring_register(struct io_ring_ctx *ctx, unsigned opcode,
 			break;
 		ret = io_unregister_personality(ctx, nr_args);
 		break;
+	case IORING_REGISTER_PBUF_RING:
+		ret = -EINVAL;
+		if (!arg || nr_args != 1)
+			break;
+		ret = io_register_pbuf_ring(ctx, arg);
+		break;
+	case IORING_UNREGISTER_PBUF_RING:
+		ret = -EINVAL;
+		if (!arg || nr_args != 1)
+			break;
+		ret = io_unregister_pbuf_ring(ctx, arg);
+		break;
+	case IORING_REGISTER_IOWQ_MAX_WORKERS:
+		ret = -EINVAL;
+		if (!arg || nr_args != 2)
+			break;
+		ret = io_register_iowq_max_workers(ctx, arg);
+		break;
 	default:
 		ret = -EINVAL;
 		break;
@@ -8211,6 +9277,9 @@ static int __init io_uring_init(void)
 	BUILD_BUG_SQE_ELEM(40, __u16,  buf_index);
 	BUILD_BUG_SQE_ELEM(42, __u16,  personality);
 	BUILD_BUG_SQE_ELEM(44, __s32,  splice_fd_in);
+	BUILD_BUG_SQE_ELEM(8,  __u32,  cmd_op);
+	BUILD_BUG_SQE_ELEM(48, __u8,   cmd[0]);
+	BUILD_BUG_ON(sizeof(struct io_uring_cqe) != 16);
 
 	BUILD_BUG_ON(ARRAY_SIZE(io_op_defs) != IORING_OP_LAST);
 	BUILD_BUG_ON(__REQ_F_LAST_BIT >= 8 * sizeof(int));
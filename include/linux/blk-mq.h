@@ -8,6 +8,7 @@
 
 struct blk_mq_tags;
 struct blk_flush_queue;
+struct blk_mq_poll_hist;
 
 /**
  * struct blk_mq_hw_ctx - State for a hardware queue facing the hardware
@@ -153,6 +154,11 @@ struct blk_mq_hw_ctx {
 	unsigned long		poll_invoked;
 	/** @poll_success: Count how many polled requests were completed. */
 	unsigned long		poll_success;
+	/**
+	 * @poll_hist: Completion latencies used to size hybrid polling
+	 * sleeps. Allocated the first time hybrid polling needs it.
+	 */
+	struct blk_mq_poll_hist	*poll_hist;
 
 #ifdef CONFIG_BLK_DEBUG_FS
 	/**
@@ -283,7 +289,7 @@ typedef void (exit_request_fn)(struct blk_mq_tag_set *set, struct request *,
 typedef bool (busy_iter_fn)(struct blk_mq_hw_ctx *, struct request *, void *,
 		bool);
 typedef bool (busy_tag_iter_fn)(struct request *, void *, bool);
-typedef int (poll_fn)(struct blk_mq_hw_ctx *);
+typedef int (poll_fn)(struct blk_mq_hw_ctx *, struct io_comp_batch *);
 typedef int (map_queues_fn)(struct blk_mq_tag_set *set);
 typedef bool (busy_fn)(struct request_queue *);
 typedef void (complete_fn)(struct request *);
@@ -499,6 +505,9 @@ static inline int blk_mq_request_completed(struct request *rq)
 void blk_mq_start_request(struct request *rq);
 void blk_mq_end_request(struct request *rq, blk_status_t error);
 void __blk_mq_end_request(struct request *rq, blk_status_t error);
+bool blk_mq_add_to_batch(struct request *rq, struct io_comp_batch *iob,
+			 int ioerror, void (*complete)(struct io_comp_batch *));
+void blk_mq_end_request_batch(struct io_comp_batch *iob);
 
 void blk_mq_requeue_request(struct request *rq, bool kick_requeue_list);
 void blk_mq_kick_requeue_list(struct request_queue *q);
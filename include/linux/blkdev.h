@@ -44,6 +44,7 @@ struct rq_qos;
 struct blk_queue_stats;
 struct blk_stat_callback;
 struct blk_keyslot_manager;
+struct io_uring_cmd;
 
 #define BLKDEV_MIN_RQ	4
 #define BLKDEV_MAX_RQ	128	/* Default maximum */
@@ -54,6 +55,9 @@ struct blk_keyslot_manager;
 /* Doing classic polling */
 #define BLK_MQ_POLL_CLASSIC -1
 
+/* Adaptive hybrid polling sleeps until this percentile of completions */
+#define BLK_MQ_POLL_DEF_PERCENTILE 10
+
 /*
  * Maximum number of blkcg policies allowed to be registered concurrently.
  * Defined here to simplify include dependency.
@@ -201,6 +205,13 @@ struct request {
 	u64 start_time_ns;
 	/* Time that I/O was submitted to the device. */
 	u64 io_start_time_ns;
+	/*
+	 * Time that a hybrid poller sleeping on this request is due to wake.
+	 * On a poll queue the request is only reaped after that, so neither
+	 * timestamp above can tell an oversleep from device latency, and the
+	 * sleep it was given depends on histograms that have moved on since.
+	 */
+	u64 poll_wake_time_ns;
 
 #ifdef CONFIG_BLK_WBT
 	unsigned short wbt_flags;
@@ -481,6 +492,7 @@ struct request_queue {
 
 	unsigned int		rq_timeout;
 	int			poll_nsec;
+	unsigned int		poll_percentile;
 
 	struct blk_stat_callback	*poll_cb;
 	struct blk_rq_stat	poll_stat[BLK_MQ_POLL_STATS_BKTS];
@@ -910,6 +922,22 @@ blk_status_t errno_to_blk_status(int errno);
 
 int blk_poll(struct request_queue *q, blk_qc_t cookie, bool spin);
 
+/*
+ * Requests a driver found completed in one pass over its completion queue.
+ * Successful completions are gathered here by blk_mq_add_to_batch() and
+ * ended together through ->complete, which frees their tags in bulk.
+ */
+struct io_comp_batch {
+	struct list_head req_list;
+	bool need_ts;
+	void (*complete)(struct io_comp_batch *);
+};
+
+#define DEFINE_IO_COMP_BATCH(name)					\
+	struct io_comp_batch name = {					\
+		.req_list = LIST_HEAD_INIT(name.req_list),		\
+	}
+
 static inline struct request_queue *bdev_get_queue(struct block_device *bdev)
 {
 	return bdev->bd_disk->queue;	/* this is never NULL */
@@ -1187,7 +1215,9 @@ extern void blk_set_queue_dying(struct request_queue *);
 struct blk_plug {
 	struct list_head mq_list; /* blk-mq requests */
 	struct list_head cb_list; /* md requires an unplug callback */
+	struct list_head cached_rqs; /* requests allocated ahead of use */
 	unsigned short rq_count;
+	unsigned short nr_ios; /* requests the plug owner expects to issue */
 	bool multiple_queues;
 };
 #define BLK_MAX_REQUEST_COUNT 16
@@ -1203,6 +1233,7 @@ struct blk_plug_cb {
 extern struct blk_plug_cb *blk_check_plugged(blk_plug_cb_fn unplug,
 					     void *data, int size);
 extern void blk_start_plug(struct blk_plug *);
+extern void blk_start_plug_nr_ios(struct blk_plug *, unsigned short);
 extern void blk_finish_plug(struct blk_plug *);
 extern void blk_flush_plug_list(struct blk_plug *, bool);
 
@@ -1228,7 +1259,8 @@ static inline bool blk_needs_flush_plug(struct task_struct *tsk)
 
 	return plug &&
 		 (!list_empty(&plug->mq_list) ||
-		 !list_empty(&plug->cb_list));
+		 !list_empty(&plug->cb_list) ||
+		 !list_empty(&plug->cached_rqs));
 }
 
 extern void blk_io_schedule(void);
@@ -1762,6 +1794,10 @@ struct block_device_operations {
 	int (*report_zones)(struct gendisk *, sector_t sector,
 			unsigned int nr_zones, report_zones_cb cb, void *data);
 	char *(*devnode)(struct gendisk *disk, umode_t *mode);
+	int (*uring_cmd)(struct block_device *, struct io_uring_cmd *,
+			 unsigned int issue_flags);
+	int (*uring_cmd_iopoll)(struct block_device *, struct io_uring_cmd *,
+				bool spin);
 	struct module *owner;
 	const struct pr_ops *pr_ops;
 };
@@ -1854,6 +1890,11 @@ static inline void blk_start_plug(struct blk_plug *plug)
 {
 }
 
+static inline void blk_start_plug_nr_ios(struct blk_plug *plug,
+					 unsigned short nr_ios)
+{
+}
+
 static inline void blk_finish_plug(struct blk_plug *plug)
 {
 }
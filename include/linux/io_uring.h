@@ -0,0 +1,63 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+#ifndef _LINUX_IO_URING_H
+#define _LINUX_IO_URING_H
+
+#include <linux/types.h>
+
+struct file;
+
+/*
+ * Flags passed to ->uring_cmd() in @issue_flags.
+ */
+enum io_uring_cmd_flags {
+	/* the command must not block, return -EAGAIN instead */
+	IO_URING_F_NONBLOCK		= (1U << 0),
+	/* ring uses 128 byte sqes, ->cmd has 80 bytes of payload */
+	IO_URING_F_SQE128		= (1U << 1),
+	/* ring uses 32 byte cqes, res2 is posted to userspace */
+	IO_URING_F_CQE32		= (1U << 2),
+	/* ring is polled, completions are reaped by ->uring_cmd_iopoll() */
+	IO_URING_F_IOPOLL		= (1U << 3),
+};
+
+/*
+ * io_uring_cmd->flags
+ */
+enum {
+	/* no user context left, ->task_work_cb must not touch user memory */
+	IO_URING_CMD_TASK_DEAD		= (1U << 0),
+};
+
+/*
+ * IORING_OP_URING_CMD as seen by the file that implements it.  @cmd points
+ * to the command payload of the sqe and is only valid until ->uring_cmd()
+ * returns, so the command must be copied if it is needed later.
+ */
+struct io_uring_cmd {
+	struct file	*file;
+	const void	*cmd;
+	/* callback to defer completions to task context */
+	void (*task_work_cb)(struct io_uring_cmd *cmd);
+	u32		cmd_op;
+	u32		flags;
+	/* second result, posted in the big cqe of IORING_SETUP_CQE32 rings */
+	u64		res2;
+	u8		pdu[40]; /* available inline for free use */
+};
+
+#if defined(CONFIG_IO_URING)
+void io_uring_cmd_done(struct io_uring_cmd *cmd, ssize_t ret, ssize_t res2);
+void io_uring_cmd_complete_in_task(struct io_uring_cmd *ioucmd,
+			void (*task_work_cb)(struct io_uring_cmd *));
+#else
+static inline void io_uring_cmd_done(struct io_uring_cmd *cmd, ssize_t ret,
+		ssize_t res2)
+{
+}
+static inline void io_uring_cmd_complete_in_task(struct io_uring_cmd *ioucmd,
+			void (*task_work_cb)(struct io_uring_cmd *))
+{
+}
+#endif
+
+#endif /* _LINUX_IO_URING_H */
@@ -21,6 +21,7 @@
 #include <linux/vmstat.h>
 #include <linux/writeback.h>
 #include <linux/page-flags.h>
+#include <linux/zswap.h>
 
 struct mem_cgroup;
 struct page;
@@ -78,6 +79,7 @@ struct mem_cgroup_id {
 enum mem_cgroup_events_target {
 	MEM_CGROUP_TARGET_THRESH,
 	MEM_CGROUP_TARGET_SOFTLIMIT,
+	MEM_CGROUP_TARGET_TIER,
 	MEM_CGROUP_NTARGETS,
 };
 
@@ -218,6 +220,18 @@ struct mem_cgroup {
 
 	unsigned long soft_limit;
 
+	/* Top tier memory limits, enforced by demotion */
+	unsigned long tier0_high;
+	unsigned long tier0_max;
+	struct work_struct tier_work;
+
+#ifdef CONFIG_ZSWAP
+	/* Compressed bytes in zswap, hierarchical, and their limit */
+	atomic_long_t zswap_size;
+	unsigned long zswap_max;
+	struct zswap_lru zswap_lru;
+#endif
+
 	/* vmpressure notifications */
 	struct vmpressure vmpressure;
 
@@ -1462,4 +1476,41 @@ static inline struct mem_cgroup *mem_cgroup_from_obj(void *p)
 
 #endif /* CONFIG_MEMCG_KMEM */
 
+#if defined(CONFIG_MEMCG) && defined(CONFIG_ZSWAP)
+struct mem_cgroup *mem_cgroup_zswap_get(struct page *page);
+bool mem_cgroup_may_zswap(struct mem_cgroup *memcg);
+void mem_cgroup_charge_zswap(struct mem_cgroup *memcg, size_t size);
+void mem_cgroup_uncharge_zswap(struct mem_cgroup *memcg, size_t size);
+
+static inline struct zswap_lru *mem_cgroup_zswap_lru(struct mem_cgroup *memcg)
+{
+	return &memcg->zswap_lru;
+}
+#else
+static inline struct mem_cgroup *mem_cgroup_zswap_get(struct page *page)
+{
+	return NULL;
+}
+
+static inline bool mem_cgroup_may_zswap(struct mem_cgroup *memcg)
+{
+	return true;
+}
+
+static inline void mem_cgroup_charge_zswap(struct mem_cgroup *memcg,
+					   size_t size)
+{
+}
+
+static inline void mem_cgroup_uncharge_zswap(struct mem_cgroup *memcg,
+					     size_t size)
+{
+}
+
+static inline struct zswap_lru *mem_cgroup_zswap_lru(struct mem_cgroup *memcg)
+{
+	return NULL;
+}
+#endif /* CONFIG_MEMCG && CONFIG_ZSWAP */
+
 #endif /* _LINUX_MEMCONTROL_H */
@@ -0,0 +1,150 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_MEMORY_TIERS_H
+#define _LINUX_MEMORY_TIERS_H
+
+#include <linux/types.h>
+#include <linux/nodemask.h>
+#include <linux/kref.h>
+#include <linux/jump_label.h>
+#include <linux/mmzone.h>
+/*
+ * Each tier covers an abstract distance chunk of size 128
+ */
+#define MEMTIER_CHUNK_BITS	7
+#define MEMTIER_CHUNK_SIZE	(1 << MEMTIER_CHUNK_BITS)
+/*
+ * Smaller abstract distance values imply faster (higher) memory tiers. Offset
+ * the DRAM adistance so that we can accommodate devices with a slightly lower
+ * adistance value (slightly faster) than default DRAM adistance to be part of
+ * the same memory tier.
+ */
+#define MEMTIER_ADISTANCE_DRAM	((4 * MEMTIER_CHUNK_SIZE) + (MEMTIER_CHUNK_SIZE >> 1))
+/* Used by dax/kmem when the platform does not describe the memory */
+#define MEMTIER_DEFAULT_DAX_ADISTANCE	(MEMTIER_ADISTANCE_DRAM * 5)
+
+struct memory_tier;
+struct memory_dev_type {
+	/* list of memory types that are part of same tier as this type */
+	struct list_head tier_sibling;
+	/* list of memory types that are managed by one driver */
+	struct list_head list;
+	/* abstract distance for this specific memory type */
+	int adistance;
+	/* Nodes of same abstract distance */
+	nodemask_t nodes;
+	struct kref kref;
+};
+
+#ifdef CONFIG_NUMA
+extern bool numa_demotion_enabled;
+struct memory_dev_type *alloc_memory_type(int adistance);
+void put_memory_type(struct memory_dev_type *memtype);
+void init_node_memory_type(int node, struct memory_dev_type *default_type);
+void clear_node_memory_type(int node, struct memory_dev_type *memtype);
+struct memory_dev_type *mt_find_alloc_memory_type(int adist,
+						  struct list_head *memory_types);
+void mt_put_memory_types(struct list_head *memory_types);
+int mt_calc_adistance(int node, int *adist);
+int node_tier_penalty(int node, int target);
+extern nodemask_t node_default_alloc_nodes;
+DECLARE_STATIC_KEY_FALSE(node_default_alloc_restricted);
+void node_set_default_alloc(int node, bool enable);
+#ifdef CONFIG_MIGRATION
+bool node_is_toptier(int node);
+int next_demotion_node(int node);
+int next_promotion_node(int node);
+void node_get_allowed_targets(pg_data_t *pgdat, nodemask_t *targets);
+#else
+static inline bool node_is_toptier(int node)
+{
+	return true;
+}
+
+static inline int next_demotion_node(int node)
+{
+	return NUMA_NO_NODE;
+}
+
+static inline int next_promotion_node(int node)
+{
+	return NUMA_NO_NODE;
+}
+
+static inline void node_get_allowed_targets(pg_data_t *pgdat,
+					    nodemask_t *targets)
+{
+	*targets = NODE_MASK_NONE;
+}
+#endif /* CONFIG_MIGRATION */
+
+#else
+
+#define numa_demotion_enabled	false
+/*
+ * CONFIG_NUMA implementation returns non NULL error.
+ */
+static inline struct memory_dev_type *alloc_memory_type(int adistance)
+{
+	return NULL;
+}
+
+static inline void put_memory_type(struct memory_dev_type *memtype)
+{
+}
+
+static inline void init_node_memory_type(int node,
+					 struct memory_dev_type *default_type)
+{
+}
+
+static inline void clear_node_memory_type(int node,
+					  struct memory_dev_type *memtype)
+{
+}
+
+static inline struct memory_dev_type *
+mt_find_alloc_memory_type(int adist, struct list_head *memory_types)
+{
+	return NULL;
+}
+
+static inline void mt_put_memory_types(struct list_head *memory_types)
+{
+}
+
+static inline int mt_calc_adistance(int node, int *adist)
+{
+	return -ENODATA;
+}
+
+static inline int node_tier_penalty(int node, int target)
+{
+	return 0;
+}
+
+static inline void node_set_default_alloc(int node, bool enable)
+{
+}
+
+static inline bool node_is_toptier(int node)
+{
+	return true;
+}
+
+static inline int next_demotion_node(int node)
+{
+	return NUMA_NO_NODE;
+}
+
+static inline int next_promotion_node(int node)
+{
+	return NUMA_NO_NODE;
+}
+
+static inline void node_get_allowed_targets(pg_data_t *pgdat,
+					    nodemask_t *targets)
+{
+	*targets = NODE_MASK_NONE;
+}
+#endif	/* CONFIG_NUMA */
+#endif  /* _LINUX_MEMORY_TIERS_H */
@@ -17,6 +17,7 @@
 #include <uapi/linux/mempolicy.h>
 
 struct mm_struct;
+struct mempolicy_weights;
 
 #ifdef CONFIG_NUMA
 
@@ -55,6 +56,8 @@ struct mempolicy {
 		nodemask_t cpuset_mems_allowed;	/* relative to these nodes */
 		nodemask_t user_nodemask;	/* nodemask passed by user */
 	} w;
+	/* weighted interleave weights set by the task, if any */
+	struct mempolicy_weights *il_weights;
 };
 
 /*
@@ -178,6 +181,11 @@ extern bool vma_migratable(struct vm_area_struct *vma);
 extern int mpol_misplaced(struct page *, struct vm_area_struct *, unsigned long);
 extern void mpol_put_task_policy(struct task_struct *);
 
+static inline bool mpol_is_preferred_many(struct mempolicy *pol)
+{
+	return pol->mode == MPOL_PREFERRED_MANY;
+}
+
 #else
 
 struct mempolicy {};
@@ -281,5 +289,10 @@ static inline int mpol_misplaced(struct page *page, struct vm_area_struct *vma,
 static inline void mpol_put_task_policy(struct task_struct *task)
 {
 }
+
+static inline bool mpol_is_preferred_many(struct mempolicy *pol)
+{
+	return false;
+}
 #endif /* CONFIG_NUMA */
 #endif
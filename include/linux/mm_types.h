@@ -11,6 +11,7 @@
 #include <linux/rwsem.h>
 #include <linux/completion.h>
 #include <linux/cpumask.h>
+#include <linux/nodemask.h>
 #include <linux/uprobes.h>
 #include <linux/page-flags-layout.h>
 #include <linux/workqueue.h>
@@ -538,6 +539,18 @@ struct mm_struct {
 		atomic_long_t hugetlb_usage;
 #endif
 		struct work_struct async_put_work;
+#ifdef CONFIG_LRU_GEN
+		struct {
+			/* link in the list walked by multi-gen LRU aging */
+			struct list_head list;
+			/*
+			 * bit nid % BITS_PER_LONG is set if the mm ran since
+			 * node nid's aging last walked its page tables; nodes
+			 * sharing a bit only cost an extra walk
+			 */
+			unsigned long bitmap;
+		} lru_gen;
+#endif
 	} __randomize_layout;
 
 	/*
@@ -564,6 +577,34 @@ static inline cpumask_t *mm_cpumask(struct mm_struct *mm)
 	return (struct cpumask *)&mm->cpu_bitmap;
 }
 
+#ifdef CONFIG_LRU_GEN
+void lru_gen_add_mm(struct mm_struct *mm);
+void lru_gen_del_mm(struct mm_struct *mm);
+
+/*
+ * Called on context switch, aging skips page tables of idle mms.  Only a
+ * load while the bits are still set, so the mm's cacheline isn't dirtied
+ * on every switch.
+ */
+static inline void lru_gen_use_mm(struct mm_struct *mm)
+{
+	if (READ_ONCE(mm->lru_gen.bitmap) != ~0UL)
+		WRITE_ONCE(mm->lru_gen.bitmap, ~0UL);
+}
+#else
+static inline void lru_gen_add_mm(struct mm_struct *mm)
+{
+}
+
+static inline void lru_gen_del_mm(struct mm_struct *mm)
+{
+}
+
+static inline void lru_gen_use_mm(struct mm_struct *mm)
+{
+}
+#endif
+
 struct mmu_gather;
 extern void tlb_gather_mmu(struct mmu_gather *tlb, struct mm_struct *mm,
 				unsigned long start, unsigned long end);
@@ -203,6 +203,10 @@ enum node_stat_item {
 	NR_KERNEL_MISC_RECLAIMABLE,	/* reclaimable non-slab kernel pages */
 	NR_FOLL_PIN_ACQUIRED,	/* via: pin_user_page(), gup flag: FOLL_PIN */
 	NR_FOLL_PIN_RELEASED,	/* pages returned via unpin_user_page() */
+#ifdef CONFIG_NUMA_BALANCING
+	PGPROMOTE_SUCCESS,	/* promote successfully */
+	PGPROMOTE_CANDIDATE,	/* candidate pages to promote */
+#endif
 	NR_VM_NODE_STAT_ITEMS
 };
 
@@ -248,6 +252,46 @@ enum lruvec_flags {
 					 */
 };
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * The multi-gen LRU keeps evictable pages in generations instead of the
+ * active and inactive lists.  A page enters the youngest generation when it
+ * is found accessed, either by mark_page_accessed() or by a walk of the
+ * page tables that clears accessed bits in bulk, and reclaim evicts from
+ * the oldest one.  Sequence numbers only grow; a page's generation is its
+ * sequence number modulo MAX_NR_GENS and is stored in page->flags.  The
+ * two youngest generations are accounted as active.
+ */
+#define ANON_AND_FILE		2
+#define MIN_NR_GENS		2
+#define MAX_NR_GENS		4
+
+#if MAX_NR_GENS >= (1 << LRU_GEN_WIDTH)
+#error "LRU_GEN_WIDTH too small for MAX_NR_GENS"
+#endif
+
+struct lru_gen_struct {
+	/* the youngest generation */
+	unsigned long			max_seq;
+	/* the oldest generation of anon and file pages */
+	unsigned long			min_seq[ANON_AND_FILE];
+	/* when each generation was created, in jiffies */
+	unsigned long			timestamps[MAX_NR_GENS];
+	struct list_head		lists[MAX_NR_GENS][ANON_AND_FILE]
+					     [MAX_NR_ZONES];
+	long				nr_pages[MAX_NR_GENS][ANON_AND_FILE]
+						[MAX_NR_ZONES];
+};
+
+struct lruvec;
+void lru_gen_init_lruvec(struct lruvec *lruvec);
+#else
+struct lruvec;
+static inline void lru_gen_init_lruvec(struct lruvec *lruvec)
+{
+}
+#endif
+
 struct lruvec {
 	struct list_head		lists[NR_LRU_LISTS];
 	/*
@@ -263,6 +307,10 @@ struct lruvec {
 	unsigned long			refaults;
 	/* Various lruvec state flags (enum lruvec_flags) */
 	unsigned long			flags;
+#ifdef CONFIG_LRU_GEN
+	/* protected by pgdat->lru_lock */
+	struct lru_gen_struct		lrugen;
+#endif
 #ifdef CONFIG_MEMCG
 	struct pglist_data *pgdat;
 #endif
@@ -718,6 +766,13 @@ typedef struct pglist_data {
 	unsigned long		min_slab_pages;
 #endif /* CONFIG_NUMA */
 
+#ifdef CONFIG_NUMA_BALANCING
+	/* start time in ms of current promote rate limit period */
+	unsigned int nbp_rl_start;
+	/* number of promote candidate pages at start time of current rate limit period */
+	unsigned long nbp_rl_nr_cand;
+#endif
+
 	/* Write-intensive fields used by page reclaim */
 	ZONE_PADDING(_pad1_)
 	spinlock_t		lru_lock;
@@ -68,6 +68,8 @@ struct node_cache_attrs {
 void node_add_cache(unsigned int nid, struct node_cache_attrs *cache_attrs);
 void node_set_perf_attrs(unsigned int nid, struct node_hmem_attrs *hmem_attrs,
 			 unsigned access);
+int node_get_perf_attrs(unsigned int nid, struct node_hmem_attrs *hmem_attrs,
+			unsigned access);
 #else
 static inline void node_add_cache(unsigned int nid,
 				  struct node_cache_attrs *cache_attrs)
@@ -79,6 +81,13 @@ static inline void node_set_perf_attrs(unsigned int nid,
 				       unsigned access)
 {
 }
+
+static inline int node_get_perf_attrs(unsigned int nid,
+				      struct node_hmem_attrs *hmem_attrs,
+				      unsigned access)
+{
+	return -ENODEV;
+}
 #endif
 
 struct node {
@@ -364,6 +364,17 @@ extern unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
 						  unsigned long nr_pages,
 						  gfp_t gfp_mask,
 						  bool may_swap);
+
+#define MEMCG_RECLAIM_MAY_SWAP	(1 << 0)
+#define MEMCG_RECLAIM_ANON_ONLY	(1 << 1)
+extern unsigned long try_to_free_mem_cgroup_pages_mask(struct mem_cgroup *memcg,
+						       unsigned long nr_pages,
+						       gfp_t gfp_mask,
+						       unsigned int reclaim_options,
+						       nodemask_t *nodemask);
+extern unsigned long try_to_demote_mem_cgroup_pages(struct mem_cgroup *memcg,
+						    unsigned long nr_pages,
+						    gfp_t gfp_mask);
 extern unsigned long mem_cgroup_shrink_node(struct mem_cgroup *mem,
 						gfp_t gfp_mask, bool noswap,
 						pg_data_t *pgdat,
@@ -374,6 +385,7 @@ extern int remove_mapping(struct address_space *mapping, struct page *page);
 extern unsigned long vm_total_pages;
 
 extern unsigned long reclaim_pages(struct list_head *page_list);
+extern unsigned long demote_isolated_pages(struct list_head *page_list);
 #ifdef CONFIG_NUMA
 extern int node_reclaim_mode;
 extern int sysctl_min_unmapped_ratio;
@@ -12,6 +12,9 @@
 #ifndef _ZPOOL_H_
 #define _ZPOOL_H_
 
+#include <linux/gfp.h>
+#include <linux/numa.h>
+
 struct zpool;
 
 struct zpool_ops {
@@ -49,7 +52,7 @@ void zpool_destroy_pool(struct zpool *pool);
 bool zpool_malloc_support_movable(struct zpool *pool);
 
 int zpool_malloc(struct zpool *pool, size_t size, gfp_t gfp,
-			unsigned long *handle);
+			unsigned long *handle, const int nid);
 
 void zpool_free(struct zpool *pool, unsigned long handle);
 
@@ -94,7 +97,7 @@ struct zpool_driver {
 
 	bool malloc_support_movable;
 	int (*malloc)(void *pool, size_t size, gfp_t gfp,
-				unsigned long *handle);
+				unsigned long *handle, const int nid);
 	void (*free)(void *pool, unsigned long handle);
 
 	int (*shrink)(void *pool, unsigned int pages,
@@ -113,4 +116,18 @@ int zpool_unregister_driver(struct zpool_driver *driver);
 
 bool zpool_evictable(struct zpool *pool);
 
+/**
+ * zpool_alloc_page() - Allocate a page to grow a pool with
+ * @nid:	The preferred node id, as passed to the malloc function.
+ * @gfp:	The gfp flags to allocate with.
+ *
+ * NUMA_NO_NODE keeps following the task's mempolicy, like alloc_page().
+ */
+static inline struct page *zpool_alloc_page(int nid, gfp_t gfp)
+{
+	if (nid == NUMA_NO_NODE)
+		return alloc_page(gfp);
+	return alloc_pages_node(nid, gfp, 0);
+}
+
 #endif
@@ -0,0 +1,23 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#ifndef _LINUX_ZSWAP_H
+#define _LINUX_ZSWAP_H
+
+#include <linux/list.h>
+#include <linux/spinlock.h>
+
+/*
+ * Compressed pages in zswap in the order they were stored: new entries
+ * go to the head, writeback takes the coldest ones from the tail.
+ */
+struct zswap_lru {
+	spinlock_t lock;
+	struct list_head list;
+};
+
+static inline void zswap_lru_init(struct zswap_lru *lru)
+{
+	spin_lock_init(&lru->lock);
+	INIT_LIST_HEAD(&lru->list);
+}
+
+#endif /* _LINUX_ZSWAP_H */
@@ -0,0 +1,104 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM memory_hotplug
+
+#if !defined(_TRACE_MEMORY_HOTPLUG_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_MEMORY_HOTPLUG_H
+
+#include <linux/types.h>
+#include <linux/math64.h>
+#include <linux/tracepoint.h>
+
+/* Throughput in MB/s of handling @nr_pages in @duration_ns */
+#define hotplug_mbps(nr_pages, duration_ns)				\
+	((duration_ns) ? div64_u64((u64)(nr_pages) << PAGE_SHIFT,	\
+				   div64_u64((duration_ns), 1000) ?: 1) : 0)
+
+TRACE_EVENT(mm_memmap_init_hotplug,
+
+	TP_PROTO(unsigned long start_pfn, unsigned long nr_pages, int nid,
+		 int nr_threads, u64 duration_ns),
+
+	TP_ARGS(start_pfn, nr_pages, nid, nr_threads, duration_ns),
+
+	TP_STRUCT__entry(
+		__field(unsigned long, start_pfn)
+		__field(unsigned long, nr_pages)
+		__field(int, nid)
+		__field(int, nr_threads)
+		__field(u64, duration_ns)
+		__field(u64, mbps)
+	),
+
+	TP_fast_assign(
+		__entry->start_pfn = start_pfn;
+		__entry->nr_pages = nr_pages;
+		__entry->nid = nid;
+		__entry->nr_threads = nr_threads;
+		__entry->duration_ns = duration_ns;
+		__entry->mbps = hotplug_mbps(nr_pages, duration_ns);
+	),
+
+	TP_printk("pfn=%lx nr_pages=%lu nid=%d threads=%d ns=%llu MB/s=%llu",
+		  __entry->start_pfn,
+		  __entry->nr_pages,
+		  __entry->nid,
+		  __entry->nr_threads,
+		  __entry->duration_ns,
+		  __entry->mbps)
+);
+
+DECLARE_EVENT_CLASS(mm_hotplug_range,
+
+	TP_PROTO(unsigned long start_pfn, unsigned long nr_pages, int nid,
+		 u64 duration_ns, int ret),
+
+	TP_ARGS(start_pfn, nr_pages, nid, duration_ns, ret),
+
+	TP_STRUCT__entry(
+		__field(unsigned long, start_pfn)
+		__field(unsigned long, nr_pages)
+		__field(int, nid)
+		__field(int, ret)
+		__field(u64, duration_ns)
+		__field(u64, mbps)
+	),
+
+	TP_fast_assign(
+		__entry->start_pfn = start_pfn;
+		__entry->nr_pages = nr_pages;
+		__entry->nid = nid;
+		__entry->ret = ret;
+		__entry->duration_ns = duration_ns;
+		__entry->mbps = ret ? 0 : hotplug_mbps(nr_pages, duration_ns);
+	),
+
+	TP_printk("pfn=%lx nr_pages=%lu nid=%d ret=%d ns=%llu MB/s=%llu",
+		  __entry->start_pfn,
+		  __entry->nr_pages,
+		  __entry->nid,
+		  __entry->ret,
+		  __entry->duration_ns,
+		  __entry->mbps)
+);
+
+DEFINE_EVENT(mm_hotplug_range, mm_online_pages,
+
+	TP_PROTO(unsigned long start_pfn, unsigned long nr_pages, int nid,
+		 u64 duration_ns, int ret),
+
+	TP_ARGS(start_pfn, nr_pages, nid, duration_ns, ret)
+);
+
+DEFINE_EVENT(mm_hotplug_range, mm_offline_pages,
+
+	TP_PROTO(unsigned long start_pfn, unsigned long nr_pages, int nid,
+		 u64 duration_ns, int ret),
+
+	TP_ARGS(start_pfn, nr_pages, nid, duration_ns, ret)
+);
+
+#endif /* _TRACE_MEMORY_HOTPLUG_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -22,6 +22,10 @@ struct io_uring_sqe {
 	union {
 		__u64	off;	/* offset into file */
 		__u64	addr2;
+		struct {
+			__u32	cmd_op;
+			__u32	__pad1;
+		};
 	};
 	union {
 		__u64	addr;	/* pointer to buffer or iovecs */
@@ -43,20 +47,23 @@ struct io_uring_sqe {
 		__u32		splice_flags;
 	};
 	__u64	user_data;	/* data to be passed back at completion time */
+	/* pack this to avoid bogus arm OABI complaints */
 	union {
-		struct {
-			/* pack this to avoid bogus arm OABI complaints */
-			union {
-				/* index into fixed buffers, if used */
-				__u16	buf_index;
-				/* for grouped buffer selection */
-				__u16	buf_group;
-			} __attribute__((packed));
-			/* personality to use, if used */
-			__u16	personality;
-			__s32	splice_fd_in;
-		};
-		__u64	__pad2[3];
+		/* index into fixed buffers, if used */
+		__u16	buf_index;
+		/* for grouped buffer selection */
+		__u16	buf_group;
+	} __attribute__((packed));
+	/* personality to use, if used */
+	__u16	personality;
+	__s32	splice_fd_in;
+	union {
+		__u64	__pad2[2];
+		/*
+		 * If the ring is set up with IORING_SETUP_SQE128, this is
+		 * where the 80 bytes of IORING_OP_URING_CMD payload start.
+		 */
+		__u8	cmd[0];
 	};
 };
 
@@ -93,7 +100,9 @@ enum {
 #define IORING_SETUP_SQ_AFF	(1U << 2)	/* sq_thread_cpu is valid */
 #define IORING_SETUP_CQSIZE	(1U << 3)	/* app defines CQ size */
 #define IORING_SETUP_CLAMP	(1U << 4)	/* clamp SQ/CQ ring sizes */
-#define IORING_SETUP_ATTACH_WQ	(1U << 5)	/* attach to existing wq */
+#define IORING_SETUP_ATTACH_WQ	(1U << 5)	/* attach to existing wq/sq thread */
+#define IORING_SETUP_SQE128	(1U << 6)	/* SQEs are 128 byte */
+#define IORING_SETUP_CQE32	(1U << 7)	/* CQEs are 32 byte */
 
 enum {
 	IORING_OP_NOP,
@@ -130,6 +139,7 @@ enum {
 	IORING_OP_PROVIDE_BUFFERS,
 	IORING_OP_REMOVE_BUFFERS,
 	IORING_OP_TEE,
+	IORING_OP_URING_CMD,
 
 	/* this goes last, obviously */
 	IORING_OP_LAST,
@@ -151,6 +161,30 @@ enum {
  */
 #define SPLICE_F_FD_IN_FIXED	(1U << 31) /* the last bit of __u32 */
 
+/*
+ * sqe->ioprio flags for IORING_OP_ACCEPT and IORING_OP_RECV
+ *
+ * IORING_ACCEPT_MULTISHOT	Keep accepting connections, posting a cqe
+ *				with IORING_CQE_F_MORE for each of them.
+ * IORING_RECV_MULTISHOT	Keep receiving into provided buffers, posting
+ *				a cqe with IORING_CQE_F_MORE for each of
+ *				them.  Requires IOSQE_BUFFER_SELECT and a
+ *				zero len: every receive fills a whole buffer.
+ * IORING_RECV_FIXED_BUF	Receive into a buffer registered with
+ *				IORING_REGISTER_BUFFERS.  sqe->buf_index
+ *				names the registered buffer, and addr/len
+ *				must lie in it.  With IOSQE_BUFFER_SELECT,
+ *				buf_index is also the group, and all the
+ *				buffers provided to group N must lie in
+ *				registered buffer N.  On IORING_SETUP_CQE32
+ *				rings, big_cqe[0] says where the data landed:
+ *				the registered buffer in the upper 32 bits and
+ *				the offset into it in the lower 32 bits.
+ */
+#define IORING_ACCEPT_MULTISHOT	(1U << 0)
+#define IORING_RECV_MULTISHOT	(1U << 0)
+#define IORING_RECV_FIXED_BUF	(1U << 1)
+
 /*
  * IO completion data structure (Completion Queue Entry)
  */
@@ -158,14 +192,23 @@ struct io_uring_cqe {
 	__u64	user_data;	/* sqe->data submission passed back */
 	__s32	res;		/* result code for this event */
 	__u32	flags;
+
+	/*
+	 * If the ring is set up with IORING_SETUP_CQE32, then this field
+	 * contains 16 bytes of padding, doubling the size of the CQE.
+	 */
+	__u64	big_cqe[];
 };
 
 /*
  * cqe->flags
  *
  * IORING_CQE_F_BUFFER	If set, the upper 16 bits are the buffer ID
+ * IORING_CQE_F_MORE	If set, the request stays armed and more cqes
+ *			will follow for it
  */
 #define IORING_CQE_F_BUFFER		(1U << 0)
+#define IORING_CQE_F_MORE		(1U << 1)
 
 enum {
 	IORING_CQE_BUFFER_SHIFT		= 16,
@@ -177,6 +220,8 @@ enum {
 #define IORING_OFF_SQ_RING		0ULL
 #define IORING_OFF_CQ_RING		0x8000000ULL
 #define IORING_OFF_SQES			0x10000000ULL
+#define IORING_OFF_PBUF_RING		0x80000000ULL
+#define IORING_OFF_PBUF_SHIFT		16
 
 /*
  * Filled with the offset for mmap(2)
@@ -263,6 +308,11 @@ struct io_uring_params {
 #define IORING_REGISTER_PROBE		8
 #define IORING_REGISTER_PERSONALITY	9
 #define IORING_UNREGISTER_PERSONALITY	10
+#define IORING_REGISTER_PBUF_RING	11
+#define IORING_UNREGISTER_PBUF_RING	12
+
+/* set/get max number of io-wq workers, arg is __u32[2] {bounded, unbounded} */
+#define IORING_REGISTER_IOWQ_MAX_WORKERS	13
 
 struct io_uring_files_update {
 	__u32 offset;
@@ -279,6 +329,43 @@ struct io_uring_probe_op {
 	__u32 resv2;
 };
 
+/*
+ * Argument for IORING_(UN)REGISTER_PBUF_RING.  The kernel allocates the
+ * ring, which the application maps at offset
+ * IORING_OFF_PBUF_RING + (bgid << IORING_OFF_PBUF_SHIFT).
+ */
+struct io_uring_buf_reg {
+	__u32	ring_entries;	/* power of 2, at most 32768 */
+	__u16	bgid;
+	__u16	pad;
+	__u64	resv[3];
+};
+
+struct io_uring_buf {
+	__u64	addr;
+	__u32	len;
+	__u16	bid;
+	__u16	resv;
+};
+
+/*
+ * Provided buffer ring.  The application fills in bufs[tail & mask] and
+ * publishes it with a store-release of tail; the kernel consumes entries
+ * from its private head and reports the selected bid in the cqe.  The tail
+ * overlays the resv field of the first entry.
+ */
+struct io_uring_buf_ring {
+	union {
+		struct {
+			__u64	resv1;
+			__u32	resv2;
+			__u16	resv3;
+			__u16	tail;
+		};
+		struct io_uring_buf	bufs[0];
+	};
+};
+
 struct io_uring_probe {
 	__u8 last_op;	/* last opcode supported */
 	__u8 ops_len;	/* length of ops[] array below */
@@ -50,6 +50,7 @@
 #include <linux/kprobes.h>
 #include <linux/kthread.h>
 #include <linux/membarrier.h>
+#include <linux/memory-tiers.h>
 #include <linux/migrate.h>
 #include <linux/mmu_context.h>
 #include <linux/nmi.h>
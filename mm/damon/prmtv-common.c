@@ -0,0 +1,130 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Common Primitives for Data Access Monitoring
+ */
+
+#include <linux/mm_inline.h>
+#include <linux/swap.h>
+
+#include "../internal.h"
+#include "prmtv-common.h"
+
+/*
+ * Get an online page for a pfn if it's in the LRU list.  Otherwise, returns
+ * NULL.
+ *
+ * The body of this function is stolen from the 'page_idle_get_page()'.  We
+ * steal rather than reuse it because the code is quite simple.
+ */
+struct page *damon_get_page(unsigned long pfn)
+{
+	struct page *page = pfn_to_online_page(pfn);
+
+	if (!page || !PageLRU(page) || !get_page_unless_zero(page))
+		return NULL;
+
+	if (unlikely(!PageLRU(page))) {
+		put_page(page);
+		page = NULL;
+	}
+	return page;
+}
+
+void damon_ptep_mkold(pte_t *pte, struct vm_area_struct *vma,
+		      unsigned long addr)
+{
+	bool referenced = false;
+	struct page *page = damon_get_page(pte_pfn(*pte));
+
+	if (!page)
+		return;
+
+	if (ptep_test_and_clear_young(vma, addr, pte))
+		referenced = true;
+
+#ifdef CONFIG_MMU_NOTIFIER
+	if (mmu_notifier_clear_young(vma->vm_mm, addr, addr + PAGE_SIZE))
+		referenced = true;
+#endif /* CONFIG_MMU_NOTIFIER */
+
+	/* Keep reclaim seeing the reference we have just cleared */
+	if (referenced)
+		set_page_young(page);
+
+	set_page_idle(page);
+	put_page(page);
+}
+
+void damon_pmdp_mkold(pmd_t *pmd, struct vm_area_struct *vma,
+		      unsigned long addr)
+{
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	bool referenced = false;
+	struct page *page = damon_get_page(pmd_pfn(*pmd));
+
+	if (!page)
+		return;
+
+	if (pmdp_test_and_clear_young(vma, addr, pmd))
+		referenced = true;
+
+#ifdef CONFIG_MMU_NOTIFIER
+	if (mmu_notifier_clear_young(vma->vm_mm, addr,
+				     addr + HPAGE_PMD_SIZE))
+		referenced = true;
+#endif /* CONFIG_MMU_NOTIFIER */
+
+	if (referenced)
+		set_page_young(page);
+
+	set_page_idle(page);
+	put_page(page);
+#endif /* CONFIG_TRANSPARENT_HUGEPAGE */
+}
+
+/*
+ * Isolate @page, which the caller holds a reference to, from the LRU onto
+ * @page_list for damon_apply_page_list().
+ */
+bool damon_isolate_page(struct page *page, struct list_head *page_list)
+{
+	ClearPageReferenced(page);
+	test_and_clear_page_young(page);
+	if (isolate_lru_page(page))
+		return false;
+
+	list_add(&page->lru, page_list);
+	return true;
+}
+
+/*
+ * Apply @action to the pages that damon_isolate_page() put on @page_list.
+ * Every page is back on the LRU, or freed, when this returns.
+ *
+ * Returns the number of bytes the action succeeded for.
+ */
+unsigned long damon_apply_page_list(struct list_head *page_list,
+				    enum damos_action action)
+{
+	unsigned long nr = 0;
+	struct page *page;
+
+	switch (action) {
+	case DAMOS_PAGEOUT:
+		nr = reclaim_pages(page_list);
+		break;
+	case DAMOS_DEMOTE:
+		nr = demote_isolated_pages(page_list);
+		break;
+	default:
+		break;
+	}
+
+	while (!list_empty(page_list)) {
+		page = lru_to_page(page_list);
+		list_del(&page->lru);
+		putback_lru_page(page);
+	}
+
+	return nr * PAGE_SIZE;
+}
@@ -241,6 +241,8 @@ static inline void __frontswap_clear(struct swap_info_struct *sis,
  * If frontswap already contains a page with matching swaptype and
  * offset, the frontswap implementation may either overwrite the data and
  * return success or invalidate the page from frontswap and return failure.
+ * A THP covers consecutive offsets and is stored either as a whole or not
+ * at all; its subpages are loaded and invalidated one by one.
  */
 int __frontswap_store(struct page *page)
 {
@@ -249,6 +251,7 @@ int __frontswap_store(struct page *page)
 	int type = swp_type(entry);
 	struct swap_info_struct *sis = swap_info[type];
 	pgoff_t offset = swp_offset(entry);
+	int i, nr = hpage_nr_pages(page);
 	struct frontswap_ops *ops;
 
 	VM_BUG_ON(!frontswap_ops);
@@ -261,10 +264,12 @@ int __frontswap_store(struct page *page)
 	 * and we can't rely on the new page replacing the old page as we may
 	 * not store to the same implementation that contains the old page.
 	 */
-	if (__frontswap_test(sis, offset)) {
-		__frontswap_clear(sis, offset);
-		for_each_frontswap_ops(ops)
-			ops->invalidate_page(type, offset);
+	for (i = 0; i < nr; i++) {
+		if (__frontswap_test(sis, offset + i)) {
+			__frontswap_clear(sis, offset + i);
+			for_each_frontswap_ops(ops)
+				ops->invalidate_page(type, offset + i);
+		}
 	}
 
 	/* Try to store in each implementation, until one succeeds. */
@@ -274,7 +279,8 @@ int __frontswap_store(struct page *page)
 			break;
 	}
 	if (ret == 0) {
-		__frontswap_set(sis, offset);
+		for (i = 0; i < nr; i++)
+			__frontswap_set(sis, offset + i);
 		inc_frontswap_succ_stores();
 	} else {
 		inc_frontswap_failed_stores();
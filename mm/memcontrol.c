@@ -59,6 +59,7 @@
 #include <linux/tracehook.h>
 #include <linux/psi.h>
 #include <linux/seq_buf.h>
+#include <linux/memory-tiers.h>
 #include "internal.h"
 #include <net/sock.h>
 #include <net/ip.h>
@@ -100,6 +101,7 @@ static bool do_memsw_account(void)
 
 #define THRESHOLDS_EVENTS_TARGET 128
 #define SOFTLIMIT_EVENTS_TARGET 1024
+#define TIER_EVENTS_TARGET 256
 
 /*
  * Cgroups above their limits are maintained in a RB-Tree, independent of
@@ -863,6 +865,9 @@ static bool mem_cgroup_event_ratelimit(struct mem_cgroup *memcg,
 		case MEM_CGROUP_TARGET_SOFTLIMIT:
 			next = val + SOFTLIMIT_EVENTS_TARGET;
 			break;
+		case MEM_CGROUP_TARGET_TIER:
+			next = val + TIER_EVENTS_TARGET;
+			break;
 		default:
 			break;
 		}
@@ -1442,6 +1447,8 @@ static char *memory_stat_format(struct mem_cgroup *memcg)
 	seq_buf_printf(&s, "pgsteal %lu\n",
 		       memcg_events(memcg, PGSTEAL_KSWAPD) +
 		       memcg_events(memcg, PGSTEAL_DIRECT));
+	seq_buf_printf(&s, "%s %lu\n", vm_event_name(PGSTEAL_PROACTIVE),
+		       memcg_events(memcg, PGSTEAL_PROACTIVE));
 	seq_buf_printf(&s, "%s %lu\n", vm_event_name(PGACTIVATE),
 		       memcg_events(memcg, PGACTIVATE));
 	seq_buf_printf(&s, "%s %lu\n", vm_event_name(PGDEACTIVATE),
@@ -2250,6 +2257,78 @@ static void high_work_func(struct work_struct *work)
 	reclaim_high(memcg, MEMCG_CHARGE_BATCH, GFP_KERNEL);
 }
 
+/*
+ * Top tier usage is the subtree's LRU pages on the top tier nodes, as
+ * already tracked by the hierarchical lruvec counters.
+ */
+static unsigned long mem_cgroup_tier0_usage(struct mem_cgroup *memcg)
+{
+	unsigned long nr = 0;
+	int nid;
+
+	for_each_node_state(nid, N_MEMORY) {
+		struct lruvec *lruvec;
+		enum lru_list lru;
+
+		if (!node_is_toptier(nid))
+			continue;
+
+		lruvec = mem_cgroup_lruvec(memcg, NODE_DATA(nid));
+		for_each_lru(lru)
+			nr += lruvec_page_state(lruvec, NR_LRU_BASE + lru);
+	}
+	return nr;
+}
+
+static unsigned long mem_cgroup_tier0_limit(struct mem_cgroup *memcg)
+{
+	return min(READ_ONCE(memcg->tier0_high), READ_ONCE(memcg->tier0_max));
+}
+
+static void tier_work_func(struct work_struct *work)
+{
+	struct mem_cgroup *memcg;
+	unsigned long usage, limit;
+
+	memcg = container_of(work, struct mem_cgroup, tier_work);
+	usage = mem_cgroup_tier0_usage(memcg);
+	limit = mem_cgroup_tier0_limit(memcg);
+	if (usage > limit)
+		try_to_demote_mem_cgroup_pages(memcg, usage - limit, GFP_KERNEL);
+}
+
+/*
+ * Exceeding the top tier limits never fails a charge and never frees
+ * anything: the excess is demoted to slower memory, in the background for
+ * tier0.high and synchronously, when the context allows, for tier0.max.
+ * Like reclaim_high(), the charging task only demotes a batch's worth and
+ * leaves the rest of the excess to the worker, so a large excess doesn't
+ * stall one unlucky allocation.
+ */
+static void mem_cgroup_handle_over_tier(struct mem_cgroup *memcg,
+					gfp_t gfp_mask)
+{
+	do {
+		unsigned long usage, max;
+
+		if (mem_cgroup_tier0_limit(memcg) == PAGE_COUNTER_MAX)
+			continue;
+
+		usage = mem_cgroup_tier0_usage(memcg);
+		if (usage <= mem_cgroup_tier0_limit(memcg))
+			continue;
+
+		max = READ_ONCE(memcg->tier0_max);
+		if (usage > max && gfpflags_allow_blocking(gfp_mask))
+			try_to_demote_mem_cgroup_pages(memcg,
+					min_t(unsigned long, usage - max,
+					      MEMCG_CHARGE_BATCH),
+					gfp_mask);
+		queue_work(system_unbound_wq, &memcg->tier_work);
+	} while ((memcg = parent_mem_cgroup(memcg)) &&
+		 !mem_cgroup_is_root(memcg));
+}
+
 /*
  * Clamp the maximum sleep time per allocation batch to 2 seconds. This is
  * enough to still cause a significant slowdown in most cases, while still
@@ -5011,6 +5090,7 @@ static struct mem_cgroup *mem_cgroup_alloc(void)
 		goto fail;
 
 	INIT_WORK(&memcg->high_work, high_work_func);
+	INIT_WORK(&memcg->tier_work, tier_work_func);
 	INIT_LIST_HEAD(&memcg->oom_notify);
 	mutex_init(&memcg->thresholds_lock);
 	spin_lock_init(&memcg->move_lock);
@@ -5031,6 +5111,9 @@ static struct mem_cgroup *mem_cgroup_alloc(void)
 	spin_lock_init(&memcg->deferred_split_queue.split_queue_lock);
 	INIT_LIST_HEAD(&memcg->deferred_split_queue.split_queue);
 	memcg->deferred_split_queue.split_queue_len = 0;
+#endif
+#ifdef CONFIG_ZSWAP
+	zswap_lru_init(&memcg->zswap_lru);
 #endif
 	idr_replace(&mem_cgroup_idr, memcg, memcg->id.id);
 	return memcg;
@@ -5054,6 +5137,11 @@ mem_cgroup_css_alloc(struct cgroup_subsys_state *parent_css)
 	page_counter_set_high(&memcg->memory, PAGE_COUNTER_MAX);
 	memcg->soft_limit = PAGE_COUNTER_MAX;
 	page_counter_set_high(&memcg->swap, PAGE_COUNTER_MAX);
+	memcg->tier0_high = PAGE_COUNTER_MAX;
+	memcg->tier0_max = PAGE_COUNTER_MAX;
+#ifdef CONFIG_ZSWAP
+	memcg->zswap_max = PAGE_COUNTER_MAX;
+#endif
 	if (parent) {
 		memcg->swappiness = mem_cgroup_swappiness(parent);
 		memcg->oom_kill_disable = parent->oom_kill_disable;
@@ -5175,6 +5263,7 @@ static void mem_cgroup_css_free(struct cgroup_subsys_state *css)
 
 	vmpressure_cleanup(&memcg->vmpressure);
 	cancel_work_sync(&memcg->high_work);
+	cancel_work_sync(&memcg->tier_work);
 	mem_cgroup_remove_from_trees(memcg);
 	memcg_free_shrinker_maps(memcg);
 	memcg_free_kmem(memcg);
@@ -5208,6 +5297,8 @@ static void mem_cgroup_css_reset(struct cgroup_subsys_state *css)
 	page_counter_set_high(&memcg->memory, PAGE_COUNTER_MAX);
 	memcg->soft_limit = PAGE_COUNTER_MAX;
 	page_counter_set_high(&memcg->swap, PAGE_COUNTER_MAX);
+	WRITE_ONCE(memcg->tier0_high, PAGE_COUNTER_MAX);
+	WRITE_ONCE(memcg->tier0_max, PAGE_COUNTER_MAX);
 	memcg_wb_domain_size_changed(memcg);
 }
 
@@ -6125,6 +6216,193 @@ static ssize_t memory_max_write(struct kernfs_open_file *of,
 	return nbytes;
 }
 
+/*
+ * "<size> [type=anon|type=file] [nodes=<list>]": reclaim @size bytes from
+ * the cgroup without touching its limits.  Fails with -EAGAIN if less could
+ * be reclaimed.  What was reclaimed shows up as pgsteal_proactive in
+ * memory.stat either way.
+ */
+static ssize_t memory_reclaim(struct kernfs_open_file *of, char *buf,
+			      size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	unsigned int nr_retries = MEM_CGROUP_RECLAIM_RETRIES;
+	unsigned int reclaim_options = MEMCG_RECLAIM_MAY_SWAP;
+	unsigned long nr_to_reclaim, nr_reclaimed = 0;
+	nodemask_t nodes, *nodemask = NULL;
+	char *size, *opt;
+	int err;
+
+	buf = strstrip(buf);
+	size = strsep(&buf, " ");
+	if (!*size)
+		return -EINVAL;
+	err = page_counter_memparse(size, "", &nr_to_reclaim);
+	if (err)
+		return err;
+
+	while ((opt = strsep(&buf, " ")) != NULL) {
+		if (!*opt)
+			continue;
+		if (!strcmp(opt, "type=anon")) {
+			reclaim_options |= MEMCG_RECLAIM_ANON_ONLY;
+		} else if (!strcmp(opt, "type=file")) {
+			reclaim_options &= ~MEMCG_RECLAIM_MAY_SWAP;
+		} else if (!strncmp(opt, "nodes=", 6)) {
+			if (nodelist_parse(opt + 6, nodes) ||
+			    !nodes_intersects(nodes, node_states[N_MEMORY]))
+				return -EINVAL;
+			nodemask = &nodes;
+		} else {
+			return -EINVAL;
+		}
+	}
+	if ((reclaim_options & MEMCG_RECLAIM_ANON_ONLY) &&
+	    !(reclaim_options & MEMCG_RECLAIM_MAY_SWAP))
+		return -EINVAL;
+
+	while (nr_reclaimed < nr_to_reclaim) {
+		unsigned long reclaimed;
+
+		if (signal_pending(current)) {
+			err = -EINTR;
+			break;
+		}
+
+		/*
+		 * This is the final attempt, drain percpu lru caches in the
+		 * hope of introducing more evictable pages.
+		 */
+		if (!nr_retries)
+			lru_add_drain_all();
+
+		reclaimed = try_to_free_mem_cgroup_pages_mask(memcg,
+					min(nr_to_reclaim - nr_reclaimed,
+					    SWAP_CLUSTER_MAX),
+					GFP_KERNEL, reclaim_options, nodemask);
+
+		if (!reclaimed && !nr_retries--) {
+			err = -EAGAIN;
+			break;
+		}
+		nr_reclaimed += reclaimed;
+	}
+
+	count_vm_events(PGSTEAL_PROACTIVE, nr_reclaimed);
+	count_memcg_events(memcg, PGSTEAL_PROACTIVE, nr_reclaimed);
+
+	return err ? err : nbytes;
+}
+
+static u64 memory_tier0_current_read(struct cgroup_subsys_state *css,
+				     struct cftype *cft)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(css);
+
+	return (u64)mem_cgroup_tier0_usage(memcg) * PAGE_SIZE;
+}
+
+static void memory_tier0_demote(struct mem_cgroup *memcg, unsigned long limit)
+{
+	unsigned int nr_retries = MEM_CGROUP_RECLAIM_RETRIES;
+
+	for (;;) {
+		unsigned long nr_pages = mem_cgroup_tier0_usage(memcg);
+
+		if (nr_pages <= limit)
+			break;
+
+		if (signal_pending(current))
+			break;
+
+		if (!try_to_demote_mem_cgroup_pages(memcg, nr_pages - limit,
+						    GFP_KERNEL) &&
+		    !nr_retries--)
+			break;
+	}
+}
+
+static int memory_tier0_high_show(struct seq_file *m, void *v)
+{
+	return seq_puts_memcg_tunable(m,
+		READ_ONCE(mem_cgroup_from_seq(m)->tier0_high));
+}
+
+static ssize_t memory_tier0_high_write(struct kernfs_open_file *of,
+				       char *buf, size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	unsigned long high;
+	int err;
+
+	buf = strstrip(buf);
+	err = page_counter_memparse(buf, "max", &high);
+	if (err)
+		return err;
+
+	WRITE_ONCE(memcg->tier0_high, high);
+	memory_tier0_demote(memcg, high);
+
+	return nbytes;
+}
+
+static int memory_tier0_max_show(struct seq_file *m, void *v)
+{
+	return seq_puts_memcg_tunable(m,
+		READ_ONCE(mem_cgroup_from_seq(m)->tier0_max));
+}
+
+static ssize_t memory_tier0_max_write(struct kernfs_open_file *of,
+				      char *buf, size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	unsigned long max;
+	int err;
+
+	buf = strstrip(buf);
+	err = page_counter_memparse(buf, "max", &max);
+	if (err)
+		return err;
+
+	WRITE_ONCE(memcg->tier0_max, max);
+	memory_tier0_demote(memcg, max);
+
+	return nbytes;
+}
+
+#ifdef CONFIG_ZSWAP
+static u64 memory_zswap_current_read(struct cgroup_subsys_state *css,
+				     struct cftype *cft)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(css);
+
+	return atomic_long_read(&memcg->zswap_size);
+}
+
+static int memory_zswap_max_show(struct seq_file *m, void *v)
+{
+	return seq_puts_memcg_tunable(m,
+		READ_ONCE(mem_cgroup_from_seq(m)->zswap_max));
+}
+
+static ssize_t memory_zswap_max_write(struct kernfs_open_file *of,
+				      char *buf, size_t nbytes, loff_t off)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_css(of_css(of));
+	unsigned long max;
+	int err;
+
+	buf = strstrip(buf);
+	err = page_counter_memparse(buf, "max", &max);
+	if (err)
+		return err;
+
+	WRITE_ONCE(memcg->zswap_max, max);
+
+	return nbytes;
+}
+#endif
+
 static void __memory_events_show(struct seq_file *m, atomic_long_t *events)
 {
 	seq_printf(m, "low %lu\n", atomic_long_read(&events[MEMCG_LOW]));
@@ -6164,6 +6442,64 @@ static int memory_stat_show(struct seq_file *m, void *v)
 	return 0;
 }
 
+#ifdef CONFIG_NUMA
+static const struct {
+	const char *name;
+	enum node_stat_item idx;
+} memory_numa_stats[] = {
+	{ "anon", NR_ANON_MAPPED },
+	{ "file", NR_FILE_PAGES },
+	{ "shmem", NR_SHMEM },
+	{ "file_mapped", NR_FILE_MAPPED },
+	{ "file_dirty", NR_FILE_DIRTY },
+	{ "file_writeback", NR_WRITEBACK },
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	{ "anon_thp", NR_ANON_THPS },
+#endif
+	{ "inactive_anon", NR_INACTIVE_ANON },
+	{ "active_anon", NR_ACTIVE_ANON },
+	{ "inactive_file", NR_INACTIVE_FILE },
+	{ "active_file", NR_ACTIVE_FILE },
+	{ "unevictable", NR_UNEVICTABLE },
+	{ "slab_reclaimable", NR_SLAB_RECLAIMABLE },
+	{ "slab_unreclaimable", NR_SLAB_UNRECLAIMABLE },
+};
+
+/*
+ * The per-node breakdown of memory.stat, read straight from the subtree's
+ * lruvec counters, in bytes.  Which nodes are top tier can be found in
+ * /sys/devices/virtual/memory_tiering.
+ */
+static int memory_numa_stat_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
+	int i, nid;
+
+	for (i = 0; i < ARRAY_SIZE(memory_numa_stats); i++) {
+		enum node_stat_item idx = memory_numa_stats[i].idx;
+
+		seq_printf(m, "%s", memory_numa_stats[i].name);
+		for_each_node_state(nid, N_MEMORY) {
+			struct lruvec *lruvec;
+			u64 size;
+
+			lruvec = mem_cgroup_lruvec(memcg, NODE_DATA(nid));
+			size = lruvec_page_state(lruvec, idx);
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+			if (idx == NR_ANON_THPS)
+				size *= HPAGE_PMD_SIZE;
+			else
+#endif
+				size *= PAGE_SIZE;
+			seq_printf(m, " N%d=%llu", nid, size);
+		}
+		seq_putc(m, '\n');
+	}
+
+	return 0;
+}
+#endif /* CONFIG_NUMA */
+
 static int memory_oom_group_show(struct seq_file *m, void *v)
 {
 	struct mem_cgroup *memcg = mem_cgroup_from_seq(m);
@@ -6225,6 +6561,40 @@ static struct cftype memory_files[] = {
 		.seq_show = memory_max_show,
 		.write = memory_max_write,
 	},
+	{
+		.name = "reclaim",
+		.write = memory_reclaim,
+	},
+	{
+		.name = "tier0.current",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = memory_tier0_current_read,
+	},
+	{
+		.name = "tier0.high",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = memory_tier0_high_show,
+		.write = memory_tier0_high_write,
+	},
+	{
+		.name = "tier0.max",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = memory_tier0_max_show,
+		.write = memory_tier0_max_write,
+	},
+#ifdef CONFIG_ZSWAP
+	{
+		.name = "zswap.current",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = memory_zswap_current_read,
+	},
+	{
+		.name = "zswap.max",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.seq_show = memory_zswap_max_show,
+		.write = memory_zswap_max_write,
+	},
+#endif
 	{
 		.name = "events",
 		.flags = CFTYPE_NOT_ON_ROOT,
@@ -6241,6 +6611,12 @@ static struct cftype memory_files[] = {
 		.name = "stat",
 		.seq_show = memory_stat_show,
 	},
+#ifdef CONFIG_NUMA
+	{
+		.name = "numa_stat",
+		.seq_show = memory_numa_stat_show,
+	},
+#endif
 	{
 		.name = "oom.group",
 		.flags = CFTYPE_NOT_ON_ROOT | CFTYPE_NS_DELEGATABLE,
@@ -6455,6 +6831,7 @@ int mem_cgroup_charge(struct page *page, struct mm_struct *mm, gfp_t gfp_mask)
 {
 	unsigned int nr_pages = hpage_nr_pages(page);
 	struct mem_cgroup *memcg = NULL;
+	bool check_tier;
 	int ret = 0;
 
 	if (mem_cgroup_disabled())
@@ -6495,8 +6872,13 @@ int mem_cgroup_charge(struct page *page, struct mm_struct *mm, gfp_t gfp_mask)
 	local_irq_disable();
 	mem_cgroup_charge_statistics(memcg, page, nr_pages);
 	memcg_check_events(memcg, page);
+	check_tier = node_is_toptier(page_to_nid(page)) &&
+		mem_cgroup_event_ratelimit(memcg, MEM_CGROUP_TARGET_TIER);
 	local_irq_enable();
 
+	if (unlikely(check_tier))
+		mem_cgroup_handle_over_tier(memcg, gfp_mask);
+
 	if (PageSwapCache(page)) {
 		swp_entry_t entry = { .val = page_private(page) };
 		/*
@@ -7195,3 +7577,59 @@ static int __init mem_cgroup_swap_init(void)
 subsys_initcall(mem_cgroup_swap_init);
 
 #endif /* CONFIG_MEMCG_SWAP */
+
+#ifdef CONFIG_ZSWAP
+/**
+ * mem_cgroup_zswap_get - get the memcg a page's zswap entry is charged to
+ * @page: the swapcache page being stored
+ *
+ * Returns the memcg with a reference held, or %NULL.  The reference is
+ * dropped with mem_cgroup_put() when the entry is freed.
+ */
+struct mem_cgroup *mem_cgroup_zswap_get(struct page *page)
+{
+	struct mem_cgroup *memcg;
+
+	if (mem_cgroup_disabled())
+		return NULL;
+
+	VM_BUG_ON_PAGE(!PageLocked(page), page);
+
+	memcg = page->mem_cgroup;
+	if (memcg)
+		css_get(&memcg->css);
+	return memcg;
+}
+
+/**
+ * mem_cgroup_may_zswap - check whether a memcg may store more in zswap
+ * @memcg: the memcg the new entry would be charged to
+ *
+ * Returns %false if @memcg or any of its ancestors is at its zswap.max.
+ */
+bool mem_cgroup_may_zswap(struct mem_cgroup *memcg)
+{
+	for (; memcg && memcg != root_mem_cgroup;
+	     memcg = parent_mem_cgroup(memcg)) {
+		unsigned long max = READ_ONCE(memcg->zswap_max);
+
+		if (max == PAGE_COUNTER_MAX)
+			continue;
+		if (atomic_long_read(&memcg->zswap_size) >= max * PAGE_SIZE)
+			return false;
+	}
+	return true;
+}
+
+void mem_cgroup_charge_zswap(struct mem_cgroup *memcg, size_t size)
+{
+	for (; memcg; memcg = parent_mem_cgroup(memcg))
+		atomic_long_add(size, &memcg->zswap_size);
+}
+
+void mem_cgroup_uncharge_zswap(struct mem_cgroup *memcg, size_t size)
+{
+	for (; memcg; memcg = parent_mem_cgroup(memcg))
+		atomic_long_sub(size, &memcg->zswap_size);
+}
+#endif /* CONFIG_ZSWAP */
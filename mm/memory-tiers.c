@@ -0,0 +1,981 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Memory tiers
+ *
+ * Nodes are grouped into memory tiers by the abstract distance of the
+ * memory type backing them: the smaller the abstract distance, the faster
+ * the memory and the higher the tier.  A node's memory type is derived from
+ * the HMAT access class 0 latency and bandwidth when the platform reports
+ * them, is otherwise taken from the driver that hot-added the memory (such
+ * as dax/kmem), and defaults to DRAM.
+ *
+ * Reclaim demotes pages to the next lower tier, NUMA balancing promotes
+ * them back to the top tier and the page allocator falls back to slower
+ * tiers only after the faster ones are exhausted.  A driver can also take
+ * its node out of the default fallback altogether, so that the node is
+ * only used by allocations that name it and by demotion.
+ */
+#include <linux/device.h>
+#include <linux/slab.h>
+#include <linux/lockdep.h>
+#include <linux/sysfs.h>
+#include <linux/kobject.h>
+#include <linux/memory.h>
+#include <linux/node.h>
+#include <linux/gfp.h>
+#include <linux/jump_label.h>
+#include <linux/memory-tiers.h>
+
+#include "internal.h"
+
+struct memory_tier {
+	/* hierarchy of memory tiers */
+	struct list_head list;
+	/* list of all memory types part of this tier */
+	struct list_head memory_types;
+	/*
+	 * start value of abstract distance. memory tier maps
+	 * an abstract distance  range,
+	 * adistance_start .. adistance_start + MEMTIER_CHUNK_SIZE
+	 */
+	int adistance_start;
+	struct device dev;
+	/* All the nodes that are part of all the lower memory tiers. */
+	nodemask_t lower_tier_mask;
+};
+
+struct demotion_nodes {
+	nodemask_t preferred;
+};
+
+struct node_memory_type_map {
+	struct memory_dev_type *memtype;
+	int map_count;
+};
+
+/*
+ * Zonelist penalty per memory tier, larger than any node distance so that
+ * the nodes of a slower tier always sort after those of a faster one.
+ */
+#define MEMTIER_NODE_PENALTY	256
+/*
+ * Cap on the abstract distance chunks that are penalized.  The zonelist
+ * builder multiplies the result by up to MAX_NUMNODES squared, which only
+ * stays within an int for values below 2048.
+ */
+#define MEMTIER_PENALTY_MAX_CHUNKS	4
+/* Run after the HMAT notifier has registered a new node's attributes */
+#define MEMTIER_HOTPLUG_PRI	1
+
+static DEFINE_MUTEX(memory_tier_lock);
+static LIST_HEAD(memory_tiers);
+/* Memory types registered by drivers, used without platform data */
+static struct node_memory_type_map node_memory_types[MAX_NUMNODES];
+/* Memory type each node's tier was established from */
+static struct memory_dev_type *node_memtype[MAX_NUMNODES];
+static struct memory_tier __rcu *node_memtier[MAX_NUMNODES];
+/* Memory types derived from HMAT performance attributes */
+static LIST_HEAD(perf_memory_types);
+static struct memory_dev_type *default_dram_type;
+
+/*
+ * Nodes the page allocator may fall back to for allocations that come
+ * without a nodemask.  The key is only enabled while some node is left out.
+ */
+nodemask_t node_default_alloc_nodes = NODE_MASK_ALL;
+DEFINE_STATIC_KEY_FALSE(node_default_alloc_restricted);
+
+static struct bus_type memory_tier_subsys = {
+	.name = "memory_tiering",
+	.dev_name = "memory_tier",
+};
+
+#ifdef CONFIG_MIGRATION
+static int top_tier_adistance;
+/*
+ * node_demotion[] examples:
+ *
+ * Example 1:
+ *
+ * Node 0 & 1 are CPU + DRAM nodes, node 2 & 3 are PMEM nodes.
+ *
+ * node distances:
+ * node   0    1    2    3
+ *    0  10   20   30   40
+ *    1  20   10   40   30
+ *    2  30   40   10   40
+ *    3  40   30   40   10
+ *
+ * memory_tiers0 = 0-1
+ * memory_tiers1 = 2-3
+ *
+ * node_demotion[0].preferred = 2
+ * node_demotion[1].preferred = 3
+ * node_demotion[2].preferred = <empty>
+ * node_demotion[3].preferred = <empty>
+ *
+ * Example 2:
+ *
+ * Node 0 & 1 are CPU + DRAM nodes, node 2 is memory-only DRAM node.
+ *
+ * node distances:
+ * node   0    1    2
+ *    0  10   20   30
+ *    1  20   10   30
+ *    2  30   30   10
+ *
+ * memory_tiers0 = 0-2
+ *
+ * node_demotion[0].preferred = <empty>
+ * node_demotion[1].preferred = <empty>
+ * node_demotion[2].preferred = <empty>
+ */
+static struct demotion_nodes *node_demotion __read_mostly;
+static int *node_promotion __read_mostly;
+#endif /* CONFIG_MIGRATION */
+
+static inline struct memory_tier *to_memory_tier(struct device *device)
+{
+	return container_of(device, struct memory_tier, dev);
+}
+
+static __always_inline nodemask_t get_memtier_nodemask(struct memory_tier *memtier)
+{
+	nodemask_t nodes = NODE_MASK_NONE;
+	struct memory_dev_type *memtype;
+
+	list_for_each_entry(memtype, &memtier->memory_types, tier_sibling)
+		nodes_or(nodes, nodes, memtype->nodes);
+
+	return nodes;
+}
+
+static void memory_tier_device_release(struct device *dev)
+{
+	struct memory_tier *tier = to_memory_tier(dev);
+	/*
+	 * synchronize_rcu in clear_node_memory_tier makes sure
+	 * we don't have rcu access to this memory tier.
+	 */
+	kfree(tier);
+}
+
+static ssize_t nodelist_show(struct device *dev,
+			     struct device_attribute *attr, char *buf)
+{
+	int ret;
+	nodemask_t nmask;
+
+	mutex_lock(&memory_tier_lock);
+	nmask = get_memtier_nodemask(to_memory_tier(dev));
+	ret = sprintf(buf, "%*pbl\n", nodemask_pr_args(&nmask));
+	mutex_unlock(&memory_tier_lock);
+	return ret;
+}
+static DEVICE_ATTR_RO(nodelist);
+
+static ssize_t adistance_start_show(struct device *dev,
+				    struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", to_memory_tier(dev)->adistance_start);
+}
+static DEVICE_ATTR_RO(adistance_start);
+
+static struct attribute *memtier_dev_attrs[] = {
+	&dev_attr_nodelist.attr,
+	&dev_attr_adistance_start.attr,
+	NULL
+};
+
+static const struct attribute_group memtier_dev_group = {
+	.attrs = memtier_dev_attrs,
+};
+
+static const struct attribute_group *memtier_dev_groups[] = {
+	&memtier_dev_group,
+	NULL
+};
+
+static struct memory_tier *find_create_memory_tier(struct memory_dev_type *memtype)
+{
+	int ret;
+	bool found_slot = false;
+	struct memory_tier *memtier, *new_memtier;
+	int adistance = memtype->adistance;
+	unsigned int memtier_adistance_chunk_size = MEMTIER_CHUNK_SIZE;
+
+	lockdep_assert_held_once(&memory_tier_lock);
+
+	adistance = round_down(adistance, memtier_adistance_chunk_size);
+	/*
+	 * If the memtype is already part of a memory tier,
+	 * just return that.
+	 */
+	if (!list_empty(&memtype->tier_sibling)) {
+		list_for_each_entry(memtier, &memory_tiers, list) {
+			if (adistance == memtier->adistance_start)
+				return memtier;
+		}
+		WARN_ON(1);
+		return ERR_PTR(-EINVAL);
+	}
+
+	list_for_each_entry(memtier, &memory_tiers, list) {
+		if (adistance == memtier->adistance_start) {
+			goto link_memtype;
+		} else if (adistance < memtier->adistance_start) {
+			found_slot = true;
+			break;
+		}
+	}
+
+	new_memtier = kzalloc(sizeof(struct memory_tier), GFP_KERNEL);
+	if (!new_memtier)
+		return ERR_PTR(-ENOMEM);
+
+	new_memtier->adistance_start = adistance;
+	INIT_LIST_HEAD(&new_memtier->list);
+	INIT_LIST_HEAD(&new_memtier->memory_types);
+	if (found_slot)
+		list_add_tail(&new_memtier->list, &memtier->list);
+	else
+		list_add_tail(&new_memtier->list, &memory_tiers);
+
+	new_memtier->dev.id = adistance >> MEMTIER_CHUNK_BITS;
+	new_memtier->dev.bus = &memory_tier_subsys;
+	new_memtier->dev.release = memory_tier_device_release;
+	new_memtier->dev.groups = memtier_dev_groups;
+
+	ret = device_register(&new_memtier->dev);
+	if (ret) {
+		list_del(&new_memtier->list);
+		put_device(&new_memtier->dev);
+		return ERR_PTR(ret);
+	}
+	memtier = new_memtier;
+
+link_memtype:
+	list_add(&memtype->tier_sibling, &memtier->memory_types);
+	return memtier;
+}
+
+static struct memory_tier *__node_get_memory_tier(int node)
+{
+	return rcu_dereference_check(node_memtier[node],
+				     lockdep_is_held(&memory_tier_lock));
+}
+
+/*
+ * Abstract distance of a node relative to the average of the nodes with
+ * CPUs, which are assumed to be DRAM: a node with half the bandwidth and
+ * twice the latency of DRAM ends up two tiers below it.
+ */
+int mt_calc_adistance(int node, int *adist)
+{
+	struct node_hmem_attrs perf, ref;
+	u64 latency = 0, bandwidth = 0, dist;
+	int nid, nr = 0;
+
+	if (node_get_perf_attrs(node, &perf, 0) ||
+	    !perf.read_latency || !perf.read_bandwidth)
+		return -ENODATA;
+
+	for_each_node_state(nid, N_MEMORY) {
+		if (!node_state(nid, N_CPU))
+			continue;
+		if (node_get_perf_attrs(nid, &ref, 0))
+			continue;
+		if (!ref.read_latency || !ref.read_bandwidth)
+			continue;
+		latency += ref.read_latency;
+		bandwidth += ref.read_bandwidth;
+		nr++;
+	}
+	if (!nr)
+		return -ENODATA;
+
+	latency = div_u64(latency, nr);
+	bandwidth = div_u64(bandwidth, nr);
+
+	dist = div64_u64(MEMTIER_ADISTANCE_DRAM * (u64)perf.read_latency,
+			 latency);
+	dist += div_u64(MEMTIER_ADISTANCE_DRAM * bandwidth,
+			perf.read_bandwidth);
+	*adist = min_t(u64, dist / 2, INT_MAX);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(mt_calc_adistance);
+
+/*
+ * The memory type of a node comes from its HMAT performance attributes
+ * when the platform reports them, otherwise from the type a driver
+ * registered for it, and finally defaults to DRAM.
+ */
+static struct memory_dev_type *node_resolve_memory_type(int node)
+{
+	struct memory_dev_type *memtype;
+	int adist;
+
+	if (!mt_calc_adistance(node, &adist)) {
+		memtype = mt_find_alloc_memory_type(adist, &perf_memory_types);
+		if (!IS_ERR(memtype))
+			return memtype;
+	}
+	if (node_memory_types[node].memtype)
+		return node_memory_types[node].memtype;
+	return default_dram_type;
+}
+
+static struct memory_tier *set_node_memory_tier(int node)
+{
+	struct memory_tier *memtier;
+	struct memory_dev_type *memtype;
+
+	lockdep_assert_held_once(&memory_tier_lock);
+
+	if (!node_state(node, N_MEMORY))
+		return ERR_PTR(-EINVAL);
+
+	memtype = node_resolve_memory_type(node);
+	node_set(node, memtype->nodes);
+	memtier = find_create_memory_tier(memtype);
+	if (IS_ERR(memtier)) {
+		node_clear(node, memtype->nodes);
+		return memtier;
+	}
+	node_memtype[node] = memtype;
+	rcu_assign_pointer(node_memtier[node], memtier);
+	return memtier;
+}
+
+static void destroy_memory_tier(struct memory_tier *memtier)
+{
+	list_del(&memtier->list);
+	device_unregister(&memtier->dev);
+}
+
+static bool clear_node_memory_tier(int node)
+{
+	bool cleared = false;
+	struct memory_tier *memtier;
+	struct memory_dev_type *memtype;
+
+	memtier = __node_get_memory_tier(node);
+	if (memtier) {
+		/*
+		 * Make sure that anybody looking at node_demotion[]
+		 * or node_memtier[] with rcu_read_lock() now observes
+		 * the tier of this node being cleared.
+		 */
+		rcu_assign_pointer(node_memtier[node], NULL);
+		synchronize_rcu();
+		memtype = node_memtype[node];
+		node_memtype[node] = NULL;
+		node_clear(node, memtype->nodes);
+		if (nodes_empty(memtype->nodes)) {
+			list_del_init(&memtype->tier_sibling);
+			if (list_empty(&memtier->memory_types))
+				destroy_memory_tier(memtier);
+		}
+		cleared = true;
+	}
+	return cleared;
+}
+
+/*
+ * How many abstract distance chunks the tier of @target starts below that
+ * of @node, capped at MEMTIER_PENALTY_MAX_CHUNKS and scaled so that it
+ * outweighs any node distance.  Tiers need not be adjacent chunks, so this
+ * is not the number of tiers in between.  The zonelist builder adds this to
+ * the distance so that allocations only fall back to slower memory after
+ * faster memory.
+ */
+int node_tier_penalty(int node, int target)
+{
+	struct memory_tier *memtier, *target_memtier;
+	int chunks = 0;
+
+	rcu_read_lock();
+	memtier = rcu_dereference(node_memtier[node]);
+	target_memtier = rcu_dereference(node_memtier[target]);
+	if (memtier && target_memtier &&
+	    target_memtier->adistance_start > memtier->adistance_start)
+		chunks = (target_memtier->adistance_start -
+			  memtier->adistance_start) >> MEMTIER_CHUNK_BITS;
+	rcu_read_unlock();
+
+	return min(chunks, MEMTIER_PENALTY_MAX_CHUNKS) * MEMTIER_NODE_PENALTY;
+}
+
+/**
+ * node_set_default_alloc() - Let a node serve allocations that don't ask for it
+ * @node: The node to change
+ * @enable: Whether the node takes part in the default allocation fallback
+ *
+ * With @enable false, allocations without a nodemask only land on @node if
+ * it is their preferred node.  Memory policies naming @node, explicit node
+ * allocations and demotion still use it.
+ */
+void node_set_default_alloc(int node, bool enable)
+{
+	mutex_lock(&memory_tier_lock);
+	if (enable)
+		node_set(node, node_default_alloc_nodes);
+	else
+		node_clear(node, node_default_alloc_nodes);
+
+	if (nodes_full(node_default_alloc_nodes))
+		static_branch_disable(&node_default_alloc_restricted);
+	else
+		static_branch_enable(&node_default_alloc_restricted);
+	mutex_unlock(&memory_tier_lock);
+}
+EXPORT_SYMBOL_GPL(node_set_default_alloc);
+
+#ifdef CONFIG_MIGRATION
+bool node_is_toptier(int node)
+{
+	bool toptier;
+	struct memory_tier *memtier;
+
+	rcu_read_lock();
+	memtier = rcu_dereference(node_memtier[node]);
+	if (!memtier) {
+		toptier = true;
+		goto out;
+	}
+	if (memtier->adistance_start <= top_tier_adistance)
+		toptier = true;
+	else
+		toptier = false;
+out:
+	rcu_read_unlock();
+	return toptier;
+}
+
+void node_get_allowed_targets(pg_data_t *pgdat, nodemask_t *targets)
+{
+	struct memory_tier *memtier;
+
+	/*
+	 * node_demotion[] is updated without excluding this
+	 * function from running.
+	 */
+	rcu_read_lock();
+	memtier = rcu_dereference(node_memtier[pgdat->node_id]);
+	if (memtier)
+		*targets = memtier->lower_tier_mask;
+	else
+		*targets = NODE_MASK_NONE;
+	rcu_read_unlock();
+}
+
+/**
+ * next_demotion_node() - Get the next node in the demotion path
+ * @node: The starting node to lookup the next node
+ *
+ * Return: node id for next memory node in the demotion path hierarchy
+ * from @node; NUMA_NO_NODE if @node is terminal.  This does not keep
+ * @node online or guarantee that it *continues* to be the next demotion
+ * target.
+ */
+int next_demotion_node(int node)
+{
+	struct demotion_nodes *nd;
+	int target;
+
+	if (!node_demotion)
+		return NUMA_NO_NODE;
+
+	nd = &node_demotion[node];
+
+	/*
+	 * node_demotion[] is updated without excluding this
+	 * function from running.
+	 *
+	 * Make sure to use RCU over entire code blocks if
+	 * node_demotion[] reads need to be consistent.
+	 */
+	rcu_read_lock();
+	/*
+	 * If there are multiple target nodes, just select one
+	 * target node randomly.
+	 *
+	 * In addition, we can also use round-robin to select
+	 * target node, but we should introduce another variable
+	 * for node_demotion[] to record last selected target node,
+	 * that may cause cache ping-pong due to the changing of
+	 * last target node. Or introducing per-cpu data to avoid
+	 * caching issue, which seems more complicated. So selecting
+	 * target node randomly seems better until now.
+	 */
+	target = node_random(&nd->preferred);
+	rcu_read_unlock();
+
+	return target;
+}
+
+/**
+ * next_promotion_node() - Get the next node in the promotion path
+ * @node: The starting node to lookup the next node
+ *
+ * Return: the nearest node in the next faster memory tier, or
+ * NUMA_NO_NODE if @node is already in the top tier.
+ */
+int next_promotion_node(int node)
+{
+	if (!node_promotion)
+		return NUMA_NO_NODE;
+
+	return READ_ONCE(node_promotion[node]);
+}
+
+static void disable_all_demotion_targets(void)
+{
+	struct memory_tier *memtier;
+	int node;
+
+	for_each_node_state(node, N_MEMORY) {
+		node_demotion[node].preferred = NODE_MASK_NONE;
+		WRITE_ONCE(node_promotion[node], NUMA_NO_NODE);
+		/*
+		 * We are holding memory_tier_lock, it is safe
+		 * to access node_memtier[].
+		 */
+		memtier = __node_get_memory_tier(node);
+		if (memtier)
+			memtier->lower_tier_mask = NODE_MASK_NONE;
+	}
+	/*
+	 * Ensure that the "disable" is visible across the system.
+	 * Readers will see either a combination of before+disable
+	 * state or disable+after.  They will never see before and
+	 * after state together.
+	 */
+	synchronize_rcu();
+}
+
+/* The nodes in @candidates that are nearest to @node */
+static nodemask_t nearest_nodes(int node, nodemask_t candidates)
+{
+	nodemask_t nearest = NODE_MASK_NONE;
+	int target, best_distance = -1;
+
+	for_each_node_mask(target, candidates) {
+		int distance = node_distance(node, target);
+
+		if (best_distance == -1 || distance < best_distance) {
+			best_distance = distance;
+			nearest = NODE_MASK_NONE;
+		}
+		if (distance == best_distance)
+			node_set(target, nearest);
+	}
+	return nearest;
+}
+
+/*
+ * Find an automatic demotion target for all memory
+ * nodes. Failing here is OK.  It might just indicate
+ * being at the end of a chain.
+ */
+static void establish_demotion_targets(void)
+{
+	struct memory_tier *memtier;
+	struct demotion_nodes *nd;
+	nodemask_t tier_nodes, lower_tier;
+	int node;
+
+	lockdep_assert_held_once(&memory_tier_lock);
+
+	if (!node_demotion || !node_promotion)
+		return;
+
+	disable_all_demotion_targets();
+
+	for_each_node_state(node, N_MEMORY) {
+		nd = &node_demotion[node];
+		memtier = __node_get_memory_tier(node);
+		if (!memtier)
+			continue;
+
+		/*
+		 * Demote to the nearest nodes of the next lower tier and
+		 * promote to the nearest node of the next higher one.
+		 */
+		if (!list_is_last(&memtier->list, &memory_tiers)) {
+			tier_nodes = get_memtier_nodemask(list_next_entry(memtier, list));
+			nodes_and(tier_nodes, tier_nodes, node_states[N_MEMORY]);
+			nd->preferred = nearest_nodes(node, tier_nodes);
+		}
+		if (!list_is_first(&memtier->list, &memory_tiers)) {
+			tier_nodes = get_memtier_nodemask(list_prev_entry(memtier, list));
+			nodes_and(tier_nodes, tier_nodes, node_states[N_MEMORY]);
+			tier_nodes = nearest_nodes(node, tier_nodes);
+			if (!nodes_empty(tier_nodes))
+				WRITE_ONCE(node_promotion[node],
+					   first_node(tier_nodes));
+		}
+	}
+	/*
+	 * Promotion is allowed from a memory tier to higher
+	 * memory tier only if the memory tier doesn't include
+	 * compute. We want to skip promotion from a memory tier,
+	 * if any node that is part of the memory tier have CPUs.
+	 * Once we detect such a memory tier, we consider that tier
+	 * as top tier from which promotion is not allowed.
+	 */
+	top_tier_adistance = 0;
+	list_for_each_entry_reverse(memtier, &memory_tiers, list) {
+		tier_nodes = get_memtier_nodemask(memtier);
+		nodes_and(tier_nodes, node_states[N_CPU], tier_nodes);
+		if (!nodes_empty(tier_nodes)) {
+			/*
+			 * abstract distance below the max value of this memtier
+			 * is considered toptier.
+			 */
+			top_tier_adistance = memtier->adistance_start +
+						MEMTIER_CHUNK_SIZE - 1;
+			break;
+		}
+	}
+	/*
+	 * Now build the lower_tier mask for each node collecting node mask from
+	 * all memory tier below it. This allows us to fallback demotion page
+	 * allocation to a set of nodes that is closer the above selected
+	 * preferred node.
+	 */
+	lower_tier = node_states[N_MEMORY];
+	list_for_each_entry(memtier, &memory_tiers, list) {
+		/*
+		 * Keep removing current tier from lower_tier nodes,
+		 * This will remove all nodes in current and above
+		 * memory tier from the lower_tier mask.
+		 */
+		tier_nodes = get_memtier_nodemask(memtier);
+		nodes_andnot(lower_tier, lower_tier, tier_nodes);
+		memtier->lower_tier_mask = lower_tier;
+	}
+
+	for_each_node_state(node, N_MEMORY) {
+		if (!nodes_empty(node_demotion[node].preferred))
+			pr_debug("demotion: node %d -> %*pbl\n", node,
+				 nodemask_pr_args(&node_demotion[node].preferred));
+	}
+}
+
+#else
+static inline void establish_demotion_targets(void) {}
+#endif /* CONFIG_MIGRATION */
+
+static void __init_node_memory_type(int node, struct memory_dev_type *memtype)
+{
+	if (!node_memory_types[node].memtype)
+		node_memory_types[node].memtype = memtype;
+	/*
+	 * for each device getting added in the same NUMA node
+	 * with this specific memtype, bump the map count. We
+	 * Only take memtype device reference once, so that
+	 * changing a node memtype can be done by droping the
+	 * only reference count taken here.
+	 */
+
+	if (node_memory_types[node].memtype == memtype) {
+		if (!node_memory_types[node].map_count++)
+			kref_get(&memtype->kref);
+	}
+}
+
+static void release_memtype(struct kref *kref)
+{
+	struct memory_dev_type *memtype;
+
+	memtype = container_of(kref, struct memory_dev_type, kref);
+	kfree(memtype);
+}
+
+struct memory_dev_type *alloc_memory_type(int adistance)
+{
+	struct memory_dev_type *memtype;
+
+	memtype = kmalloc(sizeof(*memtype), GFP_KERNEL);
+	if (!memtype)
+		return ERR_PTR(-ENOMEM);
+
+	memtype->adistance = adistance;
+	INIT_LIST_HEAD(&memtype->tier_sibling);
+	INIT_LIST_HEAD(&memtype->list);
+	memtype->nodes  = NODE_MASK_NONE;
+	kref_init(&memtype->kref);
+	return memtype;
+}
+EXPORT_SYMBOL_GPL(alloc_memory_type);
+
+void put_memory_type(struct memory_dev_type *memtype)
+{
+	kref_put(&memtype->kref, release_memtype);
+}
+EXPORT_SYMBOL_GPL(put_memory_type);
+
+/**
+ * init_node_memory_type() - Register the memory type of a node
+ * @node: The node the memory is added to
+ * @memtype: The memory type describing it
+ *
+ * Used by drivers that hot-add memory, before the memory is onlined.  The
+ * type only takes effect if the platform reports no performance data for
+ * @node.
+ */
+void init_node_memory_type(int node, struct memory_dev_type *memtype)
+{
+
+	mutex_lock(&memory_tier_lock);
+	__init_node_memory_type(node, memtype);
+	mutex_unlock(&memory_tier_lock);
+}
+EXPORT_SYMBOL_GPL(init_node_memory_type);
+
+void clear_node_memory_type(int node, struct memory_dev_type *memtype)
+{
+	mutex_lock(&memory_tier_lock);
+	if (node_memory_types[node].memtype == memtype || !memtype)
+		node_memory_types[node].map_count--;
+	/*
+	 * If we umapped all the attached devices to this node,
+	 * clear the node memory type.
+	 */
+	if (!node_memory_types[node].map_count) {
+		memtype = node_memory_types[node].memtype;
+		node_memory_types[node].memtype = NULL;
+		put_memory_type(memtype);
+	}
+	mutex_unlock(&memory_tier_lock);
+}
+EXPORT_SYMBOL_GPL(clear_node_memory_type);
+
+struct memory_dev_type *mt_find_alloc_memory_type(int adist,
+						  struct list_head *memory_types)
+{
+	struct memory_dev_type *mtype;
+
+	list_for_each_entry(mtype, memory_types, list)
+		if (mtype->adistance == adist)
+			return mtype;
+
+	mtype = alloc_memory_type(adist);
+	if (IS_ERR(mtype))
+		return mtype;
+
+	list_add(&mtype->list, memory_types);
+
+	return mtype;
+}
+EXPORT_SYMBOL_GPL(mt_find_alloc_memory_type);
+
+void mt_put_memory_types(struct list_head *memory_types)
+{
+	struct memory_dev_type *mtype, *mtn;
+
+	list_for_each_entry_safe(mtype, mtn, memory_types, list) {
+		list_del(&mtype->list);
+		put_memory_type(mtype);
+	}
+}
+EXPORT_SYMBOL_GPL(mt_put_memory_types);
+
+/*
+ * Re-resolve the memory type of every node.  Returns true if any node
+ * moved to a different tier.
+ */
+static bool refresh_node_memory_tiers(void)
+{
+	bool changed = false;
+	int node;
+
+	lockdep_assert_held_once(&memory_tier_lock);
+
+	for_each_node_state(node, N_MEMORY) {
+		struct memory_dev_type *memtype = node_resolve_memory_type(node);
+
+		if (memtype == node_memtype[node])
+			continue;
+		clear_node_memory_tier(node);
+		set_node_memory_tier(node);
+		changed = true;
+	}
+	return changed;
+}
+
+#ifdef CONFIG_MEMORY_HOTPLUG
+static int __meminit memtier_hotplug_callback(struct notifier_block *self,
+					      unsigned long action, void *_arg)
+{
+	struct memory_tier *memtier;
+	struct memory_notify *arg = _arg;
+
+	/*
+	 * Only update the node migration order when a node is
+	 * changing status, like online->offline.
+	 */
+	if (arg->status_change_nid < 0)
+		return notifier_from_errno(0);
+
+	switch (action) {
+	case MEM_OFFLINE:
+		mutex_lock(&memory_tier_lock);
+		if (clear_node_memory_tier(arg->status_change_nid))
+			establish_demotion_targets();
+		mutex_unlock(&memory_tier_lock);
+		break;
+	case MEM_ONLINE:
+		mutex_lock(&memory_tier_lock);
+		memtier = set_node_memory_tier(arg->status_change_nid);
+		if (!IS_ERR(memtier))
+			establish_demotion_targets();
+		mutex_unlock(&memory_tier_lock);
+		/*
+		 * The zonelists were rebuilt before the node had a tier,
+		 * redo them so that the new node sorts by its tier.
+		 */
+		if (!IS_ERR(memtier))
+			build_all_zonelists(NULL);
+		break;
+	}
+
+	return notifier_from_errno(0);
+}
+#endif /* CONFIG_MEMORY_HOTPLUG */
+
+static int __init memory_tier_init(void)
+{
+	int ret, node;
+	struct memory_tier *memtier;
+
+	ret = subsys_virtual_register(&memory_tier_subsys, NULL);
+	if (ret)
+		panic("%s() failed to register memory tier subsystem\n", __func__);
+
+#ifdef CONFIG_MIGRATION
+	node_demotion = kcalloc(nr_node_ids, sizeof(struct demotion_nodes),
+				GFP_KERNEL);
+	WARN_ON(!node_demotion);
+	node_promotion = kmalloc_array(nr_node_ids, sizeof(int), GFP_KERNEL);
+	WARN_ON(!node_promotion);
+	if (node_promotion)
+		for (node = 0; node < nr_node_ids; node++)
+			node_promotion[node] = NUMA_NO_NODE;
+#endif
+	mutex_lock(&memory_tier_lock);
+	/*
+	 * There is room for 4 faster memory tiers with smaller adistance
+	 * than the default DRAM tier.
+	 */
+	default_dram_type = alloc_memory_type(MEMTIER_ADISTANCE_DRAM);
+	if (IS_ERR(default_dram_type))
+		panic("%s() failed to allocate default DRAM tier\n", __func__);
+
+	/*
+	 * Look at all the existing N_MEMORY nodes and add them to
+	 * default memory tier or to a tier if we already have memory
+	 * types assigned.
+	 */
+	for_each_node_state(node, N_MEMORY) {
+		memtier = set_node_memory_tier(node);
+		if (IS_ERR(memtier))
+			/*
+			 * Continue with memtiers we are able to setup
+			 */
+			break;
+	}
+	establish_demotion_targets();
+	mutex_unlock(&memory_tier_lock);
+
+	hotplug_memory_notifier(memtier_hotplug_callback, MEMTIER_HOTPLUG_PRI);
+	return 0;
+}
+subsys_initcall(memory_tier_init);
+
+/*
+ * HMAT registers the node performance attributes at device_initcall time,
+ * so revisit the tiers of the boot time nodes once that has happened.
+ */
+static int __init memory_tier_late_init(void)
+{
+	bool changed;
+
+	mutex_lock(&memory_tier_lock);
+	changed = refresh_node_memory_tiers();
+	if (changed)
+		establish_demotion_targets();
+	mutex_unlock(&memory_tier_lock);
+
+	if (changed)
+		build_all_zonelists(NULL);
+	return 0;
+}
+late_initcall(memory_tier_late_init);
+
+bool numa_demotion_enabled __read_mostly;
+
+#ifdef CONFIG_MIGRATION
+#ifdef CONFIG_SYSFS
+static ssize_t numa_demotion_enabled_show(struct kobject *kobj,
+					  struct kobj_attribute *attr,
+					  char *buf)
+{
+	return sprintf(buf, "%s\n",
+		       numa_demotion_enabled ? "true" : "false");
+}
+
+static ssize_t numa_demotion_enabled_store(struct kobject *kobj,
+					   struct kobj_attribute *attr,
+					   const char *buf, size_t count)
+{
+	bool enabled;
+	int err;
+
+	err = kstrtobool(buf, &enabled);
+	if (err)
+		return err;
+
+	WRITE_ONCE(numa_demotion_enabled, enabled);
+	return count;
+}
+
+static struct kobj_attribute numa_demotion_enabled_attr =
+	__ATTR(demotion_enabled, 0644, numa_demotion_enabled_show,
+	       numa_demotion_enabled_store);
+
+static struct attribute *numa_attrs[] = {
+	&numa_demotion_enabled_attr.attr,
+	NULL,
+};
+
+static const struct attribute_group numa_attr_group = {
+	.attrs = numa_attrs,
+};
+
+static int __init numa_init_sysfs(void)
+{
+	int err;
+	struct kobject *numa_kobj;
+
+	numa_kobj = kobject_create_and_add("numa", mm_kobj);
+	if (!numa_kobj) {
+		pr_err("failed to create numa kobject\n");
+		return -ENOMEM;
+	}
+	err = sysfs_create_group(numa_kobj, &numa_attr_group);
+	if (err) {
+		pr_err("failed to register numa group\n");
+		goto delete_obj;
+	}
+	return 0;
+
+delete_obj:
+	kobject_put(numa_kobj);
+	return err;
+}
+subsys_initcall(numa_init_sysfs);
+#endif /* CONFIG_SYSFS */
+#endif /* CONFIG_MIGRATION */
@@ -36,12 +36,17 @@
 #include <linux/memblock.h>
 #include <linux/compaction.h>
 #include <linux/rmap.h>
+#include <linux/padata.h>
+#include <linux/ktime.h>
 
 #include <asm/tlbflush.h>
 
 #include "internal.h"
 #include "shuffle.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/memory_hotplug.h>
+
 /*
  * online_page_callback contains pointer to current page onlining function.
  * Initially it is generic_online_page(). If it is required it could be
@@ -83,6 +88,13 @@ static int __init setup_memhp_default_state(char *str)
 }
 __setup("memhp_default_state=", setup_memhp_default_state);
 
+/* For modules, which add memory through add_memory_driver_managed() */
+int mhp_get_default_online_type(void)
+{
+	return memhp_default_online_type;
+}
+EXPORT_SYMBOL_GPL(mhp_get_default_online_type);
+
 void mem_hotplug_begin(void)
 {
 	cpus_read_lock();
@@ -679,6 +691,90 @@ static void __meminit resize_pgdat_range(struct pglist_data *pgdat, unsigned lon
 	pgdat->node_spanned_pages = max(start_pfn + nr_pages, old_end_pfn) - pgdat->node_start_pfn;
 
 }
+
+#ifdef CONFIG_PADATA
+static void __meminit memmap_init_hotplug_chunk(unsigned long start_pfn,
+						unsigned long end_pfn,
+						void *arg)
+{
+	struct zone *zone = arg;
+
+	memmap_init_zone(end_pfn - start_pfn, zone_to_nid(zone),
+			 zone_idx(zone), start_pfn, MEMMAP_HOTPLUG, NULL);
+}
+
+/*
+ * Memory-only nodes, which is what hot-added memory usually is, borrow
+ * every online CPU.
+ */
+static int memmap_init_hotplug_threads(int nid)
+{
+	int nr_threads = cpumask_weight(cpumask_of_node(nid));
+
+	return nr_threads ? nr_threads : num_online_cpus();
+}
+
+/*
+ * Initialize the memmap of a hot-added range in section sized chunks on
+ * all the CPUs of the node, like deferred struct page init does at boot.
+ * Chunks are pageblock aligned, so the threads never share a pageblock.
+ */
+static int __meminit memmap_init_hotplug_mt(struct zone *zone,
+					    unsigned long start_pfn,
+					    unsigned long nr_pages)
+{
+	struct padata_mt_job job = {
+		.thread_fn	= memmap_init_hotplug_chunk,
+		.fn_arg		= zone,
+		.start		= start_pfn,
+		.size		= nr_pages,
+		.align		= PAGES_PER_SECTION,
+		.min_chunk	= PAGES_PER_SECTION,
+		.max_threads	= memmap_init_hotplug_threads(zone_to_nid(zone)),
+	};
+
+	/* The chunks must not race on it */
+	if (highest_memmap_pfn < start_pfn + nr_pages - 1)
+		highest_memmap_pfn = start_pfn + nr_pages - 1;
+
+	padata_do_multithreaded(&job);
+	return min_t(unsigned long, job.max_threads,
+		     max(nr_pages / PAGES_PER_SECTION, 1UL));
+}
+
+static bool memmap_init_hotplug_parallel(struct zone *zone,
+					 unsigned long nr_pages,
+					 struct vmem_altmap *altmap)
+{
+#ifdef CONFIG_ZONE_DEVICE
+	/* Device memmaps are initialized by memmap_init_zone_device() */
+	if (zone_idx(zone) == ZONE_DEVICE)
+		return false;
+#endif
+	return !altmap && nr_pages > PAGES_PER_SECTION;
+}
+#endif
+
+static void __meminit memmap_init_hotplug(struct zone *zone,
+					  unsigned long start_pfn,
+					  unsigned long nr_pages,
+					  struct vmem_altmap *altmap)
+{
+	u64 start = ktime_get_ns();
+	int nr_threads = 1;
+
+#ifdef CONFIG_PADATA
+	if (memmap_init_hotplug_parallel(zone, nr_pages, altmap))
+		nr_threads = memmap_init_hotplug_mt(zone, start_pfn, nr_pages);
+	else
+#endif
+		memmap_init_zone(nr_pages, zone_to_nid(zone), zone_idx(zone),
+				 start_pfn, MEMMAP_HOTPLUG, altmap);
+
+	trace_mm_memmap_init_hotplug(start_pfn, nr_pages, zone_to_nid(zone),
+				     nr_threads, ktime_get_ns() - start);
+}
+
 /*
  * Associate the pfn range with the given zone, initializing the memmaps
  * and resizing the pgdat/zone data to span the added pages. After this
@@ -688,7 +784,6 @@ void __ref move_pfn_range_to_zone(struct zone *zone, unsigned long start_pfn,
 		unsigned long nr_pages, struct vmem_altmap *altmap)
 {
 	struct pglist_data *pgdat = zone->zone_pgdat;
-	int nid = pgdat->node_id;
 	unsigned long flags;
 
 	clear_zone_contiguous(zone);
@@ -709,8 +804,7 @@ void __ref move_pfn_range_to_zone(struct zone *zone, unsigned long start_pfn,
 	 * expects the zone spans the pfn range. All the pages in the range
 	 * are reserved so nobody should be touching them so we should be safe
 	 */
-	memmap_init_zone(nr_pages, nid, zone_idx(zone), start_pfn,
-			MEMMAP_HOTPLUG, altmap);
+	memmap_init_hotplug(zone, start_pfn, nr_pages, altmap);
 
 	set_zone_contiguous(zone);
 }
@@ -772,8 +866,8 @@ struct zone * zone_for_pfn_range(int online_type, int nid, unsigned start_pfn,
 	return default_zone_for_pfn(nid, start_pfn, nr_pages);
 }
 
-int __ref online_pages(unsigned long pfn, unsigned long nr_pages,
-		       int online_type, int nid)
+static int __ref __online_pages(unsigned long pfn, unsigned long nr_pages,
+				int online_type, int nid)
 {
 	unsigned long flags;
 	unsigned long onlined_pages = 0;
@@ -852,6 +946,17 @@ int __ref online_pages(unsigned long pfn, unsigned long nr_pages,
 	mem_hotplug_done();
 	return ret;
 }
+
+int online_pages(unsigned long pfn, unsigned long nr_pages,
+		 int online_type, int nid)
+{
+	u64 start = ktime_get_ns();
+	int ret;
+
+	ret = __online_pages(pfn, nr_pages, online_type, nid);
+	trace_mm_online_pages(pfn, nr_pages, nid, ktime_get_ns() - start, ret);
+	return ret;
+}
 #endif /* CONFIG_MEMORY_HOTPLUG_SPARSE */
 
 static void reset_node_present_pages(pg_data_t *pgdat)
@@ -993,7 +1098,7 @@ static int check_hotplug_memory_range(u64 start, u64 size)
 
 static int online_memory_block(struct memory_block *mem, void *arg)
 {
-	mem->online_type = memhp_default_online_type;
+	mem->online_type = *(int *)arg;
 	return device_online(&mem->dev);
 }
 
@@ -1001,9 +1106,12 @@ static int online_memory_block(struct memory_block *mem, void *arg)
  * NOTE: The caller must call lock_device_hotplug() to serialize hotplug
  * and online/offline operations (triggered e.g. by sysfs).
  *
+ * The added memory blocks are onlined with @online_type (MMOP_*), and left
+ * offline for MMOP_OFFLINE.
+ *
  * we are OK calling __meminit stuff here - we have CONFIG_MEMORY_HOTPLUG
  */
-int __ref add_memory_resource(int nid, struct resource *res)
+int __ref add_memory_resource(int nid, struct resource *res, int online_type)
 {
 	struct mhp_params params = { .pgprot = PAGE_KERNEL };
 	u64 start, size;
@@ -1066,9 +1174,14 @@ int __ref add_memory_resource(int nid, struct resource *res)
 	/* device_online() will take the lock when calling online_pages() */
 	mem_hotplug_done();
 
-	/* online pages if requested */
-	if (memhp_default_online_type != MMOP_OFFLINE)
-		walk_memory_blocks(start, size, NULL, online_memory_block);
+	/*
+	 * online pages if requested: the whole range at once, block by block
+	 * if that fails so that as much of it as possible gets online
+	 */
+	if (online_type != MMOP_OFFLINE &&
+	    online_memory_block_range(start, size, online_type, nid))
+		walk_memory_blocks(start, size, &online_type,
+				   online_memory_block);
 
 	return ret;
 error:
@@ -1091,7 +1204,7 @@ int __ref __add_memory(int nid, u64 start, u64 size)
 	if (IS_ERR(res))
 		return PTR_ERR(res);
 
-	ret = add_memory_resource(nid, res);
+	ret = add_memory_resource(nid, res, memhp_default_online_type);
 	if (ret < 0)
 		release_memory_resource(res);
 	return ret;
@@ -1129,9 +1242,12 @@ EXPORT_SYMBOL_GPL(add_memory);
  *
  * The resource_name (visible via /proc/iomem) has to have the format
  * "System RAM ($DRIVER)".
+ *
+ * The driver picks how the memory is onlined with @online_type (MMOP_*),
+ * passing mhp_get_default_online_type() to follow the system default.
  */
 int add_memory_driver_managed(int nid, u64 start, u64 size,
-			      const char *resource_name)
+			      const char *resource_name, int online_type)
 {
 	struct resource *res;
 	int rc;
@@ -1149,7 +1265,7 @@ int add_memory_driver_managed(int nid, u64 start, u64 size,
 		goto out_unlock;
 	}
 
-	rc = add_memory_resource(nid, res);
+	rc = add_memory_resource(nid, res, online_type);
 	if (rc < 0)
 		release_memory_resource(res);
 
@@ -1585,7 +1701,14 @@ static int __ref __offline_pages(unsigned long start_pfn,
 
 int offline_pages(unsigned long start_pfn, unsigned long nr_pages)
 {
-	return __offline_pages(start_pfn, start_pfn + nr_pages);
+	int nid = pfn_to_nid(start_pfn);
+	u64 start = ktime_get_ns();
+	int ret;
+
+	ret = __offline_pages(start_pfn, start_pfn + nr_pages);
+	trace_mm_offline_pages(start_pfn, nr_pages, nid,
+			       ktime_get_ns() - start, ret);
+	return ret;
 }
 
 static int check_memblock_offlined_cb(struct memory_block *mem, void *arg)
@@ -19,12 +19,22 @@
  *                for anonymous memory. For process policy an process counter
  *                is used.
  *
+ * weighted interleave
+ *                Like interleave, but each node gets a number of consecutive
+ *                pages proportional to its weight.  The weights default to
+ *                the relative memory bandwidth the firmware reports for the
+ *                nodes, can be changed system wide through sysfs and can be
+ *                overridden per policy with MPOL_F_WEIGHTS.
+ *
  * bind           Only allocate memory on a specific set of nodes,
  *                no fallback.
  *                FIXME: memory is allocated starting with the first node
  *                to the last. It would be better if bind would truly restrict
  *                the allocation to memory nodes instead
  *
+ * preferred many Try a set of nodes first before normal fallback. This is
+ *                similar to preferred without the special case.
+ *
  * preferred       Try a specific node first before normal fallback.
  *                As a special case NUMA_NO_NODE here means do the allocation
  *                on the local CPU. This is normally identical to default,
@@ -99,6 +109,10 @@
 #include <linux/mmu_notifier.h>
 #include <linux/printk.h>
 #include <linux/swapops.h>
+#include <linux/gcd.h>
+#include <linux/node.h>
+#include <linux/memory.h>
+#include <linux/kobject.h>
 
 #include <asm/tlbflush.h>
 #include <linux/uaccess.h>
@@ -127,6 +141,41 @@ static struct mempolicy default_policy = {
 
 static struct mempolicy preferred_node_policy[MAX_NUMNODES];
 
+/*
+ * System wide weights for MPOL_WEIGHTED_INTERLEAVE, indexed by node id.
+ * Unless set through /sys/kernel/mm/mempolicy/weighted_interleave/, the
+ * weight of a node follows its HMAT read bandwidth relative to the fastest
+ * node, scaled to at most IW_DEFAULT_MAX_WEIGHT.  A zero entry counts as 1.
+ */
+#define IW_DEFAULT_MAX_WEIGHT	16
+static u8 iw_table[MAX_NUMNODES];
+/* Nodes whose weight was set by the administrator */
+static nodemask_t iw_table_user;
+static DEFINE_MUTEX(iw_table_lock);
+
+/* Per-node weights set with MPOL_F_WEIGHTS, shared by copies of a policy */
+struct mempolicy_weights {
+	refcount_t refcnt;
+	u8 weight[];
+};
+
+static void mpol_weights_put(struct mempolicy_weights *weights)
+{
+	if (weights && refcount_dec_and_test(&weights->refcnt))
+		kfree(weights);
+}
+
+static u8 get_il_weight(struct mempolicy *pol, int node)
+{
+	u8 weight = 0;
+
+	if (pol->il_weights)
+		weight = pol->il_weights->weight[node];
+	if (!weight)
+		weight = READ_ONCE(iw_table[node]);
+	return weight ? weight : 1;
+}
+
 /**
  * numa_map_to_online_node - Find closest online node
  * @nid: Node id to start the search
@@ -179,7 +228,7 @@ static const struct mempolicy_operations {
 
 static inline int mpol_store_user_nodemask(const struct mempolicy *pol)
 {
-	return pol->flags & MPOL_MODE_FLAGS;
+	return pol->flags & (MPOL_F_STATIC_NODES | MPOL_F_RELATIVE_NODES);
 }
 
 static void mpol_relative_nodemask(nodemask_t *ret, const nodemask_t *orig,
@@ -190,7 +239,7 @@ static void mpol_relative_nodemask(nodemask_t *ret, const nodemask_t *orig,
 	nodes_onto(*ret, tmp, *rel);
 }
 
-static int mpol_new_interleave(struct mempolicy *pol, const nodemask_t *nodes)
+static int mpol_new_nodemask(struct mempolicy *pol, const nodemask_t *nodes)
 {
 	if (nodes_empty(*nodes))
 		return -EINVAL;
@@ -209,14 +258,6 @@ static int mpol_new_preferred(struct mempolicy *pol, const nodemask_t *nodes)
 	return 0;
 }
 
-static int mpol_new_bind(struct mempolicy *pol, const nodemask_t *nodes)
-{
-	if (nodes_empty(*nodes))
-		return -EINVAL;
-	pol->v.nodes = *nodes;
-	return 0;
-}
-
 /*
  * mpol_set_nodemask is called after mpol_new() to set up the nodemask, if
  * any, for the new policy.  mpol_new() has already validated the nodes
@@ -305,6 +346,7 @@ static struct mempolicy *mpol_new(unsigned short mode, unsigned short flags,
 	atomic_set(&policy->refcnt, 1);
 	policy->mode = mode;
 	policy->flags = flags;
+	policy->il_weights = NULL;
 
 	return policy;
 }
@@ -314,6 +356,7 @@ void __mpol_put(struct mempolicy *p)
 {
 	if (!atomic_dec_and_test(&p->refcnt))
 		return;
+	mpol_weights_put(p->il_weights);
 	kmem_cache_free(policy_cache, p);
 }
 
@@ -416,7 +459,7 @@ static const struct mempolicy_operations mpol_ops[MPOL_MAX] = {
 		.rebind = mpol_rebind_default,
 	},
 	[MPOL_INTERLEAVE] = {
-		.create = mpol_new_interleave,
+		.create = mpol_new_nodemask,
 		.rebind = mpol_rebind_nodemask,
 	},
 	[MPOL_PREFERRED] = {
@@ -424,7 +467,15 @@ static const struct mempolicy_operations mpol_ops[MPOL_MAX] = {
 		.rebind = mpol_rebind_preferred,
 	},
 	[MPOL_BIND] = {
-		.create = mpol_new_bind,
+		.create = mpol_new_nodemask,
+		.rebind = mpol_rebind_nodemask,
+	},
+	[MPOL_WEIGHTED_INTERLEAVE] = {
+		.create = mpol_new_nodemask,
+		.rebind = mpol_rebind_nodemask,
+	},
+	[MPOL_PREFERRED_MANY] = {
+		.create = mpol_new_nodemask,
 		.rebind = mpol_rebind_nodemask,
 	},
 };
@@ -858,22 +909,31 @@ static int mbind_range(struct mm_struct *mm, unsigned long start,
 	return err;
 }
 
-/* Set the process memory policy */
+/*
+ * Set the process memory policy.  Consumes the reference on @weights, if
+ * any.
+ */
 static long do_set_mempolicy(unsigned short mode, unsigned short flags,
-			     nodemask_t *nodes)
+			     nodemask_t *nodes,
+			     struct mempolicy_weights *weights)
 {
 	struct mempolicy *new, *old;
 	NODEMASK_SCRATCH(scratch);
 	int ret;
 
-	if (!scratch)
+	if (!scratch) {
+		mpol_weights_put(weights);
 		return -ENOMEM;
+	}
 
 	new = mpol_new(mode, flags, nodes);
 	if (IS_ERR(new)) {
+		mpol_weights_put(weights);
 		ret = PTR_ERR(new);
 		goto out;
 	}
+	if (new)
+		new->il_weights = weights;
 
 	task_lock(current);
 	ret = mpol_set_nodemask(new, nodes, scratch);
@@ -884,8 +944,11 @@ static long do_set_mempolicy(unsigned short mode, unsigned short flags,
 	}
 	old = current->mempolicy;
 	current->mempolicy = new;
-	if (new && new->mode == MPOL_INTERLEAVE)
+	if (new && (new->mode == MPOL_INTERLEAVE ||
+		    new->mode == MPOL_WEIGHTED_INTERLEAVE)) {
 		current->il_prev = MAX_NUMNODES-1;
+		current->il_weight = 0;
+	}
 	task_unlock(current);
 	mpol_put(old);
 	ret = 0;
@@ -908,6 +971,8 @@ static void get_policy_nodemask(struct mempolicy *p, nodemask_t *nodes)
 	switch (p->mode) {
 	case MPOL_BIND:
 	case MPOL_INTERLEAVE:
+	case MPOL_WEIGHTED_INTERLEAVE:
+	case MPOL_PREFERRED_MANY:
 		*nodes = p->v.nodes;
 		break;
 	case MPOL_PREFERRED:
@@ -999,6 +1064,13 @@ static long do_get_mempolicy(int *policy, nodemask_t *nmask,
 		} else if (pol == current->mempolicy &&
 				pol->mode == MPOL_INTERLEAVE) {
 			*policy = next_node_in(current->il_prev, pol->v.nodes);
+		} else if (pol == current->mempolicy &&
+				pol->mode == MPOL_WEIGHTED_INTERLEAVE) {
+			if (current->il_weight)
+				*policy = current->il_prev;
+			else
+				*policy = next_node_in(current->il_prev,
+						       pol->v.nodes);
 		} else {
 			err = -EINVAL;
 			goto out;
@@ -1283,9 +1355,11 @@ static struct page *new_page(struct page *page, unsigned long start)
 }
 #endif
 
+/* Consumes the reference on @weights, if any */
 static long do_mbind(unsigned long start, unsigned long len,
 		     unsigned short mode, unsigned short mode_flags,
-		     nodemask_t *nmask, unsigned long flags)
+		     nodemask_t *nmask, struct mempolicy_weights *weights,
+		     unsigned long flags)
 {
 	struct mm_struct *mm = current->mm;
 	struct mempolicy *new;
@@ -1294,13 +1368,16 @@ static long do_mbind(unsigned long start, unsigned long len,
 	int ret;
 	LIST_HEAD(pagelist);
 
+	err = -EINVAL;
 	if (flags & ~(unsigned long)MPOL_MF_VALID)
-		return -EINVAL;
+		goto weights_out;
+	err = -EPERM;
 	if ((flags & MPOL_MF_MOVE_ALL) && !capable(CAP_SYS_NICE))
-		return -EPERM;
+		goto weights_out;
 
+	err = -EINVAL;
 	if (start & ~PAGE_MASK)
-		return -EINVAL;
+		goto weights_out;
 
 	if (mode == MPOL_DEFAULT)
 		flags &= ~MPOL_MF_STRICT;
@@ -1309,13 +1386,18 @@ static long do_mbind(unsigned long start, unsigned long len,
 	end = start + len;
 
 	if (end < start)
-		return -EINVAL;
+		goto weights_out;
+	err = 0;
 	if (end == start)
-		return 0;
+		goto weights_out;
 
 	new = mpol_new(mode, mode_flags, nmask);
-	if (IS_ERR(new))
-		return PTR_ERR(new);
+	if (IS_ERR(new)) {
+		err = PTR_ERR(new);
+		goto weights_out;
+	}
+	if (new)
+		new->il_weights = weights;
 
 	if (flags & MPOL_MF_LAZY)
 		new->flags |= MPOL_F_MOF;
@@ -1386,6 +1468,10 @@ static long do_mbind(unsigned long start, unsigned long len,
 mpol_out:
 	mpol_put(new);
 	return err;
+
+weights_out:
+	mpol_weights_put(weights);
+	return err;
 }
 
 /*
@@ -1470,10 +1556,71 @@ static int copy_nodes_to_user(unsigned long __user *mask, unsigned long maxnode,
 	return copy_to_user(mask, nodes_addr(*nodes), copy) ? -EFAULT : 0;
 }
 
+/*
+ * Copy MPOL_F_WEIGHTS weights from user space: one byte per node id, for
+ * @maxnode nodes.  The nodes with a non-zero weight make up the policy.
+ */
+static int get_il_weights(nodemask_t *nodes,
+			  struct mempolicy_weights **weights,
+			  const u8 __user *uweights, unsigned long maxnode)
+{
+	struct mempolicy_weights *w;
+	unsigned long nr, i;
+	u8 t;
+
+	nodes_clear(*nodes);
+	if (!uweights || !maxnode || maxnode > PAGE_SIZE)
+		return -EINVAL;
+
+	/* Nodes that cannot exist must not have a weight */
+	nr = min_t(unsigned long, maxnode, nr_node_ids);
+	for (i = nr; i < maxnode; i++) {
+		if (get_user(t, uweights + i))
+			return -EFAULT;
+		if (t)
+			return -EINVAL;
+	}
+
+	w = kzalloc(struct_size(w, weight, nr_node_ids), GFP_KERNEL);
+	if (!w)
+		return -ENOMEM;
+	if (copy_from_user(w->weight, uweights, nr)) {
+		kfree(w);
+		return -EFAULT;
+	}
+	refcount_set(&w->refcnt, 1);
+
+	for (i = 0; i < nr; i++)
+		if (w->weight[i])
+			node_set(i, *nodes);
+	*weights = w;
+	return 0;
+}
+
+/* Copy the nodes, or with MPOL_F_WEIGHTS the weights, of a new policy */
+static int get_policy_nodes(unsigned short mode, unsigned short flags,
+			    nodemask_t *nodes,
+			    struct mempolicy_weights **weights,
+			    const unsigned long __user *nmask,
+			    unsigned long maxnode)
+{
+	*weights = NULL;
+	if (!(flags & MPOL_F_WEIGHTS))
+		return get_nodes(nodes, nmask, maxnode);
+
+	/* Weights are per node id, they cannot follow a relative nodemask */
+	if (mode != MPOL_WEIGHTED_INTERLEAVE ||
+	    (flags & MPOL_F_RELATIVE_NODES))
+		return -EINVAL;
+	return get_il_weights(nodes, weights, (const u8 __user *)nmask,
+			      maxnode);
+}
+
 static long kernel_mbind(unsigned long start, unsigned long len,
 			 unsigned long mode, const unsigned long __user *nmask,
 			 unsigned long maxnode, unsigned int flags)
 {
+	struct mempolicy_weights *weights;
 	nodemask_t nodes;
 	int err;
 	unsigned short mode_flags;
@@ -1486,10 +1633,12 @@ static long kernel_mbind(unsigned long start, unsigned long len,
 	if ((mode_flags & MPOL_F_STATIC_NODES) &&
 	    (mode_flags & MPOL_F_RELATIVE_NODES))
 		return -EINVAL;
-	err = get_nodes(&nodes, nmask, maxnode);
+	err = get_policy_nodes(mode, mode_flags, &nodes, &weights, nmask,
+			       maxnode);
 	if (err)
 		return err;
-	return do_mbind(start, len, mode, mode_flags, &nodes, flags);
+	return do_mbind(start, len, mode, mode_flags & ~MPOL_F_WEIGHTS, &nodes,
+			weights, flags);
 }
 
 SYSCALL_DEFINE6(mbind, unsigned long, start, unsigned long, len,
@@ -1503,6 +1652,7 @@ SYSCALL_DEFINE6(mbind, unsigned long, start, unsigned long, len,
 static long kernel_set_mempolicy(int mode, const unsigned long __user *nmask,
 				 unsigned long maxnode)
 {
+	struct mempolicy_weights *weights;
 	int err;
 	nodemask_t nodes;
 	unsigned short flags;
@@ -1513,10 +1663,10 @@ static long kernel_set_mempolicy(int mode, const unsigned long __user *nmask,
 		return -EINVAL;
 	if ((flags & MPOL_F_STATIC_NODES) && (flags & MPOL_F_RELATIVE_NODES))
 		return -EINVAL;
-	err = get_nodes(&nodes, nmask, maxnode);
+	err = get_policy_nodes(mode, flags, &nodes, &weights, nmask, maxnode);
 	if (err)
 		return err;
-	return do_set_mempolicy(mode, flags, &nodes);
+	return do_set_mempolicy(mode, flags & ~MPOL_F_WEIGHTS, &nodes, weights);
 }
 
 SYSCALL_DEFINE3(set_mempolicy, int, mode, const unsigned long __user *, nmask,
@@ -1697,6 +1847,11 @@ COMPAT_SYSCALL_DEFINE3(set_mempolicy, int, mode, compat_ulong_t __user *, nmask,
 	unsigned long nr_bits, alloc_size;
 	DECLARE_BITMAP(bm, MAX_NUMNODES);
 
+	/* An array of weights has the same layout for compat tasks */
+	if (mode & MPOL_F_WEIGHTS)
+		return kernel_set_mempolicy(mode,
+				(const unsigned long __user *)nmask, maxnode);
+
 	nr_bits = min_t(unsigned long, maxnode-1, MAX_NUMNODES);
 	alloc_size = ALIGN(nr_bits, BITS_PER_LONG) / 8;
 
@@ -1719,6 +1874,12 @@ COMPAT_SYSCALL_DEFINE6(mbind, compat_ulong_t, start, compat_ulong_t, len,
 	unsigned long nr_bits, alloc_size;
 	nodemask_t bm;
 
+	/* An array of weights has the same layout for compat tasks */
+	if (mode & MPOL_F_WEIGHTS)
+		return kernel_mbind(start, len, mode,
+				(const unsigned long __user *)nmask, maxnode,
+				flags);
+
 	nr_bits = min_t(unsigned long, maxnode-1, MAX_NUMNODES);
 	alloc_size = ALIGN(nr_bits, BITS_PER_LONG) / 8;
 
@@ -1919,12 +2080,35 @@ static int policy_node(gfp_t gfp, struct mempolicy *policy,
 	return nd;
 }
 
+/*
+ * Do dynamic weighted interleaving for a process: stay on a node for as
+ * many allocations as its weight before moving on to the next one.
+ */
+static unsigned int weighted_interleave_nodes(struct mempolicy *policy)
+{
+	struct task_struct *me = current;
+	unsigned int node = me->il_prev;
+
+	if (!me->il_weight || !node_isset(node, policy->v.nodes)) {
+		node = next_node_in(node, policy->v.nodes);
+		if (node == MAX_NUMNODES)
+			return node;
+		me->il_prev = node;
+		me->il_weight = get_il_weight(policy, node);
+	}
+	me->il_weight--;
+	return node;
+}
+
 /* Do dynamic interleaving for a process */
 static unsigned interleave_nodes(struct mempolicy *policy)
 {
 	unsigned next;
 	struct task_struct *me = current;
 
+	if (policy->mode == MPOL_WEIGHTED_INTERLEAVE)
+		return weighted_interleave_nodes(policy);
+
 	next = next_node_in(me->il_prev, policy->v.nodes);
 	if (next < MAX_NUMNODES)
 		me->il_prev = next;
@@ -1955,9 +2139,11 @@ unsigned int mempolicy_slab_node(void)
 		return policy->v.preferred_node;
 
 	case MPOL_INTERLEAVE:
+	case MPOL_WEIGHTED_INTERLEAVE:
 		return interleave_nodes(policy);
 
-	case MPOL_BIND: {
+	case MPOL_BIND:
+	case MPOL_PREFERRED_MANY: {
 		struct zoneref *z;
 
 		/*
@@ -1977,6 +2163,33 @@ unsigned int mempolicy_slab_node(void)
 	}
 }
 
+/*
+ * Do static weighted interleaving for a VMA with known offset @n.  Each
+ * node covers as many consecutive offsets as its weight.
+ */
+static unsigned int weighted_offset_il_node(struct mempolicy *pol,
+					    unsigned long n)
+{
+	unsigned int weight_total = 0, weight;
+	unsigned long target;
+	int nid;
+
+	for_each_node_mask(nid, pol->v.nodes)
+		weight_total += get_il_weight(pol, nid);
+	if (!weight_total)
+		return numa_node_id();
+
+	target = n % weight_total;
+	for_each_node_mask(nid, pol->v.nodes) {
+		weight = get_il_weight(pol, nid);
+		if (target < weight)
+			return nid;
+		target -= weight;
+	}
+	/* The weights changed under us */
+	return first_node(pol->v.nodes);
+}
+
 /*
  * Do static interleaving for a VMA with known offset @n.  Returns the n'th
  * node in pol->v.nodes (starting from n=0), wrapping around if n exceeds the
@@ -1989,6 +2202,9 @@ static unsigned offset_il_node(struct mempolicy *pol, unsigned long n)
 	int i;
 	int nid;
 
+	if (pol->mode == MPOL_WEIGHTED_INTERLEAVE)
+		return weighted_offset_il_node(pol, n);
+
 	if (!nnodes)
 		return numa_node_id();
 	target = (unsigned int)n % nnodes;
@@ -2031,8 +2247,9 @@ static inline unsigned interleave_nid(struct mempolicy *pol,
  *
  * Returns a nid suitable for a huge page allocation and a pointer
  * to the struct mempolicy for conditional unref after allocation.
- * If the effective policy is 'BIND, returns a pointer to the mempolicy's
- * @nodemask for filtering the zonelist.
+ * If the effective policy is 'BIND or 'PREFERRED_MANY, returns a pointer to
+ * the mempolicy's @nodemask for filtering the zonelist.  The caller falls
+ * back to all nodes for 'PREFERRED_MANY.
  *
  * Must be protected by read_mems_allowed_begin()
  */
@@ -2044,12 +2261,14 @@ int huge_node(struct vm_area_struct *vma, unsigned long addr, gfp_t gfp_flags,
 	*mpol = get_vma_policy(vma, addr);
 	*nodemask = NULL;	/* assume !MPOL_BIND */
 
-	if (unlikely((*mpol)->mode == MPOL_INTERLEAVE)) {
+	if (unlikely((*mpol)->mode == MPOL_INTERLEAVE ||
+		     (*mpol)->mode == MPOL_WEIGHTED_INTERLEAVE)) {
 		nid = interleave_nid(*mpol, vma, addr,
 					huge_page_shift(hstate_vma(vma)));
 	} else {
 		nid = policy_node(gfp_flags, *mpol, numa_node_id());
-		if ((*mpol)->mode == MPOL_BIND)
+		if ((*mpol)->mode == MPOL_BIND ||
+		    (*mpol)->mode == MPOL_PREFERRED_MANY)
 			*nodemask = &(*mpol)->v.nodes;
 	}
 	return nid;
@@ -2092,6 +2311,8 @@ bool init_nodemask_of_mempolicy(nodemask_t *mask)
 
 	case MPOL_BIND:
 	case MPOL_INTERLEAVE:
+	case MPOL_WEIGHTED_INTERLEAVE:
+	case MPOL_PREFERRED_MANY:
 		*mask =  mempolicy->v.nodes;
 		break;
 
@@ -2129,15 +2350,18 @@ bool mempolicy_nodemask_intersects(struct task_struct *tsk,
 
 	switch (mempolicy->mode) {
 	case MPOL_PREFERRED:
+	case MPOL_PREFERRED_MANY:
 		/*
-		 * MPOL_PREFERRED and MPOL_F_LOCAL are only preferred nodes to
-		 * allocate from, they may fallback to other nodes when oom.
+		 * MPOL_PREFERRED, MPOL_PREFERRED_MANY and MPOL_F_LOCAL are
+		 * only preferred nodes to allocate from, they may fallback to
+		 * other nodes when oom.
 		 * Thus, it's possible for tsk to have allocated memory from
 		 * nodes in mask.
 		 */
 		break;
 	case MPOL_BIND:
 	case MPOL_INTERLEAVE:
+	case MPOL_WEIGHTED_INTERLEAVE:
 		ret = nodes_intersects(mempolicy->v.nodes, *mask);
 		break;
 	default:
@@ -2167,6 +2391,25 @@ static struct page *alloc_page_interleave(gfp_t gfp, unsigned order,
 	return page;
 }
 
+/*
+ * Allocate from the preferred nodes without reclaim first, and only then
+ * from any node the way the default policy would.
+ */
+static struct page *alloc_pages_preferred_many(gfp_t gfp, unsigned int order,
+					       int nid, struct mempolicy *pol)
+{
+	struct page *page;
+	gfp_t preferred_gfp;
+
+	preferred_gfp = gfp | __GFP_NOWARN;
+	preferred_gfp &= ~(__GFP_DIRECT_RECLAIM | __GFP_NOFAIL);
+	page = __alloc_pages_nodemask(preferred_gfp, order, nid, &pol->v.nodes);
+	if (!page)
+		page = __alloc_pages(gfp, order, nid);
+
+	return page;
+}
+
 /**
  * 	alloc_pages_vma	- Allocate a page for a VMA.
  *
@@ -2201,7 +2444,8 @@ alloc_pages_vma(gfp_t gfp, int order, struct vm_area_struct *vma,
 
 	pol = get_vma_policy(vma, addr);
 
-	if (pol->mode == MPOL_INTERLEAVE) {
+	if (pol->mode == MPOL_INTERLEAVE ||
+	    pol->mode == MPOL_WEIGHTED_INTERLEAVE) {
 		unsigned nid;
 
 		nid = interleave_nid(pol, vma, addr, PAGE_SHIFT + order);
@@ -2210,6 +2454,12 @@ alloc_pages_vma(gfp_t gfp, int order, struct vm_area_struct *vma,
 		goto out;
 	}
 
+	if (unlikely(pol->mode == MPOL_PREFERRED_MANY)) {
+		page = alloc_pages_preferred_many(gfp, order, node, pol);
+		mpol_cond_put(pol);
+		goto out;
+	}
+
 	if (unlikely(IS_ENABLED(CONFIG_TRANSPARENT_HUGEPAGE) && hugepage)) {
 		int hpage_node = node;
 
@@ -2286,8 +2536,12 @@ struct page *alloc_pages_current(gfp_t gfp, unsigned order)
 	 * No reference counting needed for current->mempolicy
 	 * nor system default_policy
 	 */
-	if (pol->mode == MPOL_INTERLEAVE)
+	if (pol->mode == MPOL_INTERLEAVE ||
+	    pol->mode == MPOL_WEIGHTED_INTERLEAVE)
 		page = alloc_page_interleave(gfp, order, interleave_nodes(pol));
+	else if (unlikely(pol->mode == MPOL_PREFERRED_MANY))
+		page = alloc_pages_preferred_many(gfp, order, numa_node_id(),
+						  pol);
 	else
 		page = __alloc_pages_nodemask(gfp, order,
 				policy_node(gfp, pol, numa_node_id()),
@@ -2333,6 +2587,8 @@ struct mempolicy *__mpol_dup(struct mempolicy *old)
 		task_unlock(current);
 	} else
 		*new = *old;
+	if (new->il_weights)
+		refcount_inc(&new->il_weights->refcnt);
 
 	if (current_cpuset_is_being_rebound()) {
 		nodemask_t mems = cpuset_mems_allowed(current);
@@ -2355,9 +2611,19 @@ bool __mpol_equal(struct mempolicy *a, struct mempolicy *b)
 		if (!nodes_equal(a->w.user_nodemask, b->w.user_nodemask))
 			return false;
 
+	if (a->il_weights != b->il_weights) {
+		if (!a->il_weights || !b->il_weights)
+			return false;
+		if (memcmp(a->il_weights->weight, b->il_weights->weight,
+			   nr_node_ids))
+			return false;
+	}
+
 	switch (a->mode) {
 	case MPOL_BIND:
 	case MPOL_INTERLEAVE:
+	case MPOL_WEIGHTED_INTERLEAVE:
+	case MPOL_PREFERRED_MANY:
 		return !!nodes_equal(a->v.nodes, b->v.nodes);
 	case MPOL_PREFERRED:
 		/* a's ->flags is the same as b's */
@@ -2498,6 +2764,7 @@ int mpol_misplaced(struct page *page, struct vm_area_struct *vma, unsigned long
 
 	switch (pol->mode) {
 	case MPOL_INTERLEAVE:
+	case MPOL_WEIGHTED_INTERLEAVE:
 		pgoff = vma->vm_pgoff;
 		pgoff += (addr - vma->vm_start) >> PAGE_SHIFT;
 		polnid = offset_il_node(pol, pgoff);
@@ -2511,6 +2778,7 @@ int mpol_misplaced(struct page *page, struct vm_area_struct *vma, unsigned long
 		break;
 
 	case MPOL_BIND:
+	case MPOL_PREFERRED_MANY:
 
 		/*
 		 * allows binding to multiple nodes.
@@ -2628,6 +2896,8 @@ static int shared_policy_replace(struct shared_policy *sp, unsigned long start,
 
 				*mpol_new = *n->policy;
 				atomic_set(&mpol_new->refcnt, 1);
+				if (mpol_new->il_weights)
+					refcount_inc(&mpol_new->il_weights->refcnt);
 				sp_node_init(n_new, end, n->end, mpol_new);
 				n->end = start;
 				sp_insert(sp, n_new);
@@ -2663,6 +2933,8 @@ static int shared_policy_replace(struct shared_policy *sp, unsigned long start,
 	mpol_new = kmem_cache_alloc(policy_cache, GFP_KERNEL);
 	if (!mpol_new)
 		goto err_out;
+	atomic_set(&mpol_new->refcnt, 1);
+	mpol_new->il_weights = NULL;
 	goto restart;
 }
 
@@ -2852,7 +3124,7 @@ void __init numa_policy_init(void)
 	if (unlikely(nodes_empty(interleave_nodes)))
 		node_set(prefer, interleave_nodes);
 
-	if (do_set_mempolicy(MPOL_INTERLEAVE, 0, &interleave_nodes))
+	if (do_set_mempolicy(MPOL_INTERLEAVE, 0, &interleave_nodes, NULL))
 		pr_err("%s: interleaving failed\n", __func__);
 
 	check_numabalancing_enable();
@@ -2861,8 +3133,227 @@ void __init numa_policy_init(void)
 /* Reset policy of current process to default */
 void numa_default_policy(void)
 {
-	do_set_mempolicy(MPOL_DEFAULT, 0, NULL);
+	do_set_mempolicy(MPOL_DEFAULT, 0, NULL, NULL);
+}
+
+/*
+ * Derive the weighted interleave weight of every node the administrator
+ * has not set from its HMAT read bandwidth.  Nodes without bandwidth data
+ * get a weight of 1, which makes them plain interleave nodes.
+ */
+static void iw_table_update(void)
+{
+	struct node_hmem_attrs perf;
+	unsigned int max_bw = 0;
+	unsigned long div = 0;
+	int nid;
+
+	mutex_lock(&iw_table_lock);
+	for_each_node_state(nid, N_MEMORY) {
+		if (!node_get_perf_attrs(nid, &perf, 0))
+			max_bw = max(max_bw, perf.read_bandwidth);
+	}
+
+	for_each_node(nid) {
+		u8 weight = 1;
+
+		if (node_isset(nid, iw_table_user))
+			continue;
+		if (!node_state(nid, N_MEMORY)) {
+			WRITE_ONCE(iw_table[nid], weight);
+			continue;
+		}
+		if (max_bw && !node_get_perf_attrs(nid, &perf, 0) &&
+		    perf.read_bandwidth)
+			weight = clamp_t(unsigned int,
+				DIV_ROUND_CLOSEST(perf.read_bandwidth *
+						  IW_DEFAULT_MAX_WEIGHT, max_bw),
+				1, IW_DEFAULT_MAX_WEIGHT);
+		WRITE_ONCE(iw_table[nid], weight);
+		div = gcd(div, weight);
+	}
+
+	/*
+	 * Keep the runs on each node as short as the ratios allow.  Memoryless
+	 * nodes are never interleaved onto, so their weight of 1 must not hold
+	 * the divisor down.
+	 */
+	if (div > 1) {
+		for_each_node_state(nid, N_MEMORY) {
+			if (!node_isset(nid, iw_table_user))
+				WRITE_ONCE(iw_table[nid], iw_table[nid] / div);
+		}
+	}
+	mutex_unlock(&iw_table_lock);
+}
+
+#ifdef CONFIG_MEMORY_HOTPLUG
+/* Runs after the HMAT notifier has registered a new node's attributes */
+static int iw_table_callback(struct notifier_block *self,
+			     unsigned long action, void *arg)
+{
+	struct memory_notify *mnb = arg;
+
+	if (mnb->status_change_nid < 0)
+		return notifier_from_errno(0);
+
+	switch (action) {
+	case MEM_ONLINE:
+	case MEM_OFFLINE:
+		iw_table_update();
+		break;
+	}
+
+	return notifier_from_errno(0);
+}
+#endif /* CONFIG_MEMORY_HOTPLUG */
+
+#ifdef CONFIG_SYSFS
+struct iw_node_attr {
+	struct kobj_attribute kobj_attr;
+	int nid;
+};
+
+static struct iw_node_attr *iw_node_attrs[MAX_NUMNODES];
+
+static ssize_t iw_node_show(struct kobject *kobj, struct kobj_attribute *attr,
+			    char *buf)
+{
+	struct iw_node_attr *node_attr;
+	u8 weight;
+
+	node_attr = container_of(attr, struct iw_node_attr, kobj_attr);
+	weight = READ_ONCE(iw_table[node_attr->nid]);
+	return sprintf(buf, "%u\n", weight ? weight : 1);
+}
+
+/* Writing 0 goes back to the weight derived from the node's bandwidth */
+static ssize_t iw_node_store(struct kobject *kobj, struct kobj_attribute *attr,
+			     const char *buf, size_t count)
+{
+	struct iw_node_attr *node_attr;
+	u8 weight;
+	int err;
+
+	node_attr = container_of(attr, struct iw_node_attr, kobj_attr);
+	err = kstrtou8(buf, 0, &weight);
+	if (err)
+		return err;
+
+	mutex_lock(&iw_table_lock);
+	if (weight) {
+		node_set(node_attr->nid, iw_table_user);
+		WRITE_ONCE(iw_table[node_attr->nid], weight);
+	} else {
+		node_clear(node_attr->nid, iw_table_user);
+	}
+	mutex_unlock(&iw_table_lock);
+
+	if (!weight)
+		iw_table_update();
+	return count;
+}
+
+static int __init iw_add_node_attr(struct kobject *kobj, int nid)
+{
+	struct iw_node_attr *node_attr;
+	char *name;
+	int err;
+
+	node_attr = kzalloc(sizeof(*node_attr), GFP_KERNEL);
+	if (!node_attr)
+		return -ENOMEM;
+
+	name = kasprintf(GFP_KERNEL, "node%d", nid);
+	if (!name) {
+		kfree(node_attr);
+		return -ENOMEM;
+	}
+
+	sysfs_attr_init(&node_attr->kobj_attr.attr);
+	node_attr->kobj_attr.attr.name = name;
+	node_attr->kobj_attr.attr.mode = 0644;
+	node_attr->kobj_attr.show = iw_node_show;
+	node_attr->kobj_attr.store = iw_node_store;
+	node_attr->nid = nid;
+
+	err = sysfs_create_file(kobj, &node_attr->kobj_attr.attr);
+	if (err) {
+		kfree(name);
+		kfree(node_attr);
+		return err;
+	}
+
+	iw_node_attrs[nid] = node_attr;
+	return 0;
+}
+
+static void __init iw_remove_node_attrs(struct kobject *kobj)
+{
+	struct iw_node_attr *node_attr;
+	int nid;
+
+	for_each_node_state(nid, N_POSSIBLE) {
+		node_attr = iw_node_attrs[nid];
+		if (!node_attr)
+			continue;
+		sysfs_remove_file(kobj, &node_attr->kobj_attr.attr);
+		kfree(node_attr->kobj_attr.attr.name);
+		kfree(node_attr);
+		iw_node_attrs[nid] = NULL;
+	}
+}
+
+static int __init mempolicy_sysfs_init(void)
+{
+	struct kobject *mempolicy_kobj, *wi_kobj;
+	int nid, err;
+
+	mempolicy_kobj = kobject_create_and_add("mempolicy", mm_kobj);
+	if (!mempolicy_kobj)
+		return -ENOMEM;
+
+	wi_kobj = kobject_create_and_add("weighted_interleave", mempolicy_kobj);
+	if (!wi_kobj) {
+		err = -ENOMEM;
+		goto err_put_mempolicy;
+	}
+
+	for_each_node_state(nid, N_POSSIBLE) {
+		err = iw_add_node_attr(wi_kobj, nid);
+		if (err) {
+			pr_err("failed to add weighted interleave attribute for node %d\n",
+			       nid);
+			goto err_remove_attrs;
+		}
+	}
+	return 0;
+
+err_remove_attrs:
+	iw_remove_node_attrs(wi_kobj);
+	kobject_put(wi_kobj);
+err_put_mempolicy:
+	kobject_put(mempolicy_kobj);
+	return err;
+}
+#else
+static inline int mempolicy_sysfs_init(void)
+{
+	return 0;
+}
+#endif /* CONFIG_SYSFS */
+
+/*
+ * HMAT registers the node performance attributes at device_initcall time,
+ * so the default weights can only be derived after that.
+ */
+static int __init mempolicy_weights_init(void)
+{
+	iw_table_update();
+	hotplug_memory_notifier(iw_table_callback, 1);
+	return mempolicy_sysfs_init();
 }
+late_initcall(mempolicy_weights_init);
 
 /*
  * Parse and format mempolicy from/to strings
@@ -2878,6 +3369,8 @@ static const char * const policy_modes[] =
 	[MPOL_BIND]       = "bind",
 	[MPOL_INTERLEAVE] = "interleave",
 	[MPOL_LOCAL]      = "local",
+	[MPOL_WEIGHTED_INTERLEAVE] = "weighted_interleave",
+	[MPOL_PREFERRED_MANY]  = "prefer_many",
 };
 
 
@@ -2936,6 +3429,7 @@ int mpol_parse_str(char *str, struct mempolicy **mpol)
 		}
 		break;
 	case MPOL_INTERLEAVE:
+	case MPOL_WEIGHTED_INTERLEAVE:
 		/*
 		 * Default to online nodes with memory if no nodelist
 		 */
@@ -2958,6 +3452,7 @@ int mpol_parse_str(char *str, struct mempolicy **mpol)
 			err = 0;
 		goto out;
 	case MPOL_BIND:
+	case MPOL_PREFERRED_MANY:
 		/*
 		 * Insist on a nodelist
 		 */
@@ -3047,6 +3542,8 @@ void mpol_to_str(char *buffer, int maxlen, struct mempolicy *pol)
 		break;
 	case MPOL_BIND:
 	case MPOL_INTERLEAVE:
+	case MPOL_WEIGHTED_INTERLEAVE:
+	case MPOL_PREFERRED_MANY:
 		nodes = pol->v.nodes;
 		break;
 	default:
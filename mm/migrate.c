@@ -49,6 +49,9 @@
 #include <linux/sched/mm.h>
 #include <linux/ptrace.h>
 #include <linux/oom.h>
+#include <linux/sched/sysctl.h>
+#include <linux/memory-tiers.h>
+#include <linux/workqueue.h>
 
 #include <asm/tlbflush.h>
 
@@ -1403,6 +1406,362 @@ static int unmap_and_move_huge_page(new_page_t get_new_page,
 	return rc;
 }
 
+/*
+ * Batched migration of plain anonymous pages.
+ *
+ * unmap_and_move() takes one page at a time through unmap, copy and remap,
+ * so every page pays for its own TLB shootdown and a serial copy.  Here a
+ * whole batch is unmapped first with a single deferred TLB flush, the
+ * contents of all pages are then copied in one go, spread over several
+ * threads when that is worth it, and only then are the migration entries
+ * replaced by the new pages.
+ *
+ * Only pages that nobody but their page tables can reach are handled: the
+ * new page is not visible to anyone until remove_migration_ptes(), so it is
+ * fine to move the page state before the contents.  Pages in the page or
+ * swap cache, hugetlb, KSM and non-LRU movable pages, and any page whose
+ * lock cannot be taken without blocking, are left on the list for the
+ * one page at a time loop in migrate_pages().
+ */
+#define NR_MAX_BATCHED_MIGRATION	512
+
+/* Do not bother spreading the copy for less than this many base pages */
+#define MIGRATE_COPY_MIN_PAGES		32
+
+int sysctl_migrate_copy_threads __read_mostly = 4;
+static struct workqueue_struct *migrate_copy_wq;
+
+struct migrate_copy_work {
+	struct work_struct work;
+	struct list_head *src_pages;
+	struct list_head *dst_pages;
+	/* range of base pages, counted across the whole batch */
+	unsigned long start;
+	unsigned long end;
+};
+
+static void migrate_copy_range(struct list_head *src_pages,
+			       struct list_head *dst_pages,
+			       unsigned long start, unsigned long end)
+{
+	struct page *page, *newpage;
+	unsigned long idx = 0;
+	int i, nr;
+
+	newpage = list_first_entry(dst_pages, struct page, lru);
+	list_for_each_entry(page, src_pages, lru) {
+		if (idx >= end)
+			break;
+
+		nr = hpage_nr_pages(page);
+		for (i = 0; i < nr; i++) {
+			if (idx + i < start || idx + i >= end)
+				continue;
+			cond_resched();
+			copy_highpage(newpage + i, page + i);
+		}
+		idx += nr;
+		newpage = list_next_entry(newpage, lru);
+	}
+}
+
+static void migrate_copy_work_fn(struct work_struct *work)
+{
+	struct migrate_copy_work *mcw;
+
+	mcw = container_of(work, struct migrate_copy_work, work);
+	migrate_copy_range(mcw->src_pages, mcw->dst_pages,
+			   mcw->start, mcw->end);
+}
+
+/*
+ * Copy the contents of @nr_pages base pages from @src_pages to the matching
+ * entries of @dst_pages.  Large batches are split into chunks that run on
+ * the migrate_copy workqueue close to the destination node, with the
+ * caller doing the first chunk itself.
+ */
+static void migrate_copy_pages(struct list_head *src_pages,
+			       struct list_head *dst_pages,
+			       unsigned long nr_pages)
+{
+	struct migrate_copy_work *works = NULL;
+	unsigned long chunk;
+	unsigned int nr_works, i;
+	int nid;
+
+	nr_works = min_t(unsigned long, READ_ONCE(sysctl_migrate_copy_threads),
+			 nr_pages / MIGRATE_COPY_MIN_PAGES);
+	if (nr_works > 1 && migrate_copy_wq)
+		works = kmalloc_array(nr_works, sizeof(*works),
+				      GFP_NOWAIT | __GFP_NOWARN);
+	if (!works) {
+		migrate_copy_range(src_pages, dst_pages, 0, nr_pages);
+		return;
+	}
+
+	nid = page_to_nid(list_first_entry(dst_pages, struct page, lru));
+	chunk = DIV_ROUND_UP(nr_pages, nr_works);
+	for (i = 0; i < nr_works; i++) {
+		works[i].src_pages = src_pages;
+		works[i].dst_pages = dst_pages;
+		works[i].start = i * chunk;
+		works[i].end = min(nr_pages, (i + 1) * chunk);
+		INIT_WORK(&works[i].work, migrate_copy_work_fn);
+		if (i)
+			queue_work_node(nid, migrate_copy_wq, &works[i].work);
+	}
+
+	migrate_copy_range(src_pages, dst_pages, works[0].start, works[0].end);
+	for (i = 1; i < nr_works; i++)
+		flush_work(&works[i].work);
+	kfree(works);
+}
+
+/*
+ * The anon_vma and whether the page was mapped are needed again after the
+ * copy, stash them in the private field of the new page meanwhile.
+ */
+static void __migrate_page_record(struct page *newpage, int page_was_mapped,
+				  struct anon_vma *anon_vma)
+{
+	set_page_private(newpage, (unsigned long)anon_vma | page_was_mapped);
+}
+
+static void __migrate_page_extract(struct page *newpage, int *page_was_mapped,
+				   struct anon_vma **anon_vma)
+{
+	unsigned long private = page_private(newpage);
+
+	*anon_vma = (struct anon_vma *)(private & ~1UL);
+	*page_was_mapped = private & 1;
+	set_page_private(newpage, 0);
+}
+
+static bool migrate_page_batchable(struct page *page)
+{
+	if (PageHuge(page) || __PageMovable(page) || PageKsm(page))
+		return false;
+	if (!PageAnon(page) || page_mapping(page))
+		return false;
+	if (PageTransHuge(page) && !thp_migration_supported())
+		return false;
+	/* Pages freed under us are dealt with by unmap_and_move() */
+	return page_count(page) > 1;
+}
+
+/*
+ * Lock @page, allocate its new page and replace its ptes with migration
+ * entries, leaving the TLB flush to the caller.  Both pages stay locked.
+ */
+static int migrate_page_unmap(new_page_t get_new_page,
+			      free_page_t put_new_page, unsigned long private,
+			      struct page *page, struct page **newpagep)
+{
+	struct anon_vma *anon_vma;
+	struct page *newpage;
+	int page_was_mapped = 0;
+
+	if (!trylock_page(page))
+		return -EAGAIN;
+
+	if (unlikely(page_mapping(page) || PageWriteback(page))) {
+		unlock_page(page);
+		return -EAGAIN;
+	}
+
+	newpage = get_new_page(page, private);
+	if (!newpage) {
+		unlock_page(page);
+		return -ENOMEM;
+	}
+
+	anon_vma = page_get_anon_vma(page);
+	if (unlikely(!trylock_page(newpage))) {
+		if (anon_vma)
+			put_anon_vma(anon_vma);
+		unlock_page(page);
+		if (put_new_page)
+			put_new_page(newpage, private);
+		else
+			put_page(newpage);
+		return -EAGAIN;
+	}
+
+	if (page_mapped(page)) {
+		VM_BUG_ON_PAGE(!anon_vma, page);
+		try_to_unmap(page, TTU_MIGRATION | TTU_IGNORE_MLOCK |
+				   TTU_IGNORE_ACCESS | TTU_BATCH_FLUSH);
+		page_was_mapped = 1;
+	}
+
+	__migrate_page_record(newpage, page_was_mapped, anon_vma);
+	*newpagep = newpage;
+	return MIGRATEPAGE_SUCCESS;
+}
+
+/* Undo migrate_page_unmap() for a page that could not be moved */
+static void migrate_page_undo(struct page *page, struct page *newpage,
+			      free_page_t put_new_page, unsigned long private)
+{
+	struct anon_vma *anon_vma;
+	int page_was_mapped;
+
+	__migrate_page_extract(newpage, &page_was_mapped, &anon_vma);
+	if (page_was_mapped)
+		remove_migration_ptes(page, page, false);
+	unlock_page(newpage);
+	if (anon_vma)
+		put_anon_vma(anon_vma);
+	unlock_page(page);
+
+	if (put_new_page)
+		put_new_page(newpage, private);
+	else
+		put_page(newpage);
+}
+
+/* Map the new page in place of the old one and release the old page */
+static void migrate_page_done(struct page *page, struct page *newpage,
+			      enum migrate_reason reason)
+{
+	struct anon_vma *anon_vma;
+	int page_was_mapped;
+
+	__migrate_page_extract(newpage, &page_was_mapped, &anon_vma);
+	flush_dcache_page(newpage);
+	if (page_was_mapped)
+		remove_migration_ptes(page, newpage, false);
+	unlock_page(newpage);
+	if (anon_vma)
+		put_anon_vma(anon_vma);
+	unlock_page(page);
+
+	set_page_owner_migrate_reason(newpage, reason);
+	putback_lru_page(newpage);
+
+	list_del(&page->lru);
+	mod_node_page_state(page_pgdat(page), NR_ISOLATED_ANON +
+			page_is_file_lru(page), -hpage_nr_pages(page));
+	put_page(page);
+}
+
+/*
+ * Move the pages on @src_pages, which migrate_page_unmap() has already
+ * unmapped, to the pages on @dst_pages.  Pages that cannot be moved are
+ * restored and put on @failed.  Returns the number of pages migrated.
+ */
+static int migrate_pages_batch_move(struct list_head *src_pages,
+				    struct list_head *dst_pages,
+				    struct list_head *failed,
+				    free_page_t put_new_page,
+				    unsigned long private,
+				    enum migrate_reason reason)
+{
+	struct page *page, *page2, *newpage, *newpage2;
+	unsigned long nr_pages = 0;
+	int nr_succeeded = 0;
+	int rc;
+
+	/* One TLB shootdown for everything migrate_page_unmap() did */
+	try_to_unmap_flush();
+
+	newpage = list_first_entry(dst_pages, struct page, lru);
+	list_for_each_entry_safe(page, page2, src_pages, lru) {
+		newpage2 = list_next_entry(newpage, lru);
+
+		rc = -EAGAIN;
+		if (!page_mapped(page))
+			rc = move_to_new_page(newpage, page,
+					      MIGRATE_SYNC_NO_COPY);
+		if (rc == MIGRATEPAGE_SUCCESS) {
+			nr_pages += hpage_nr_pages(page);
+		} else {
+			list_del(&newpage->lru);
+			migrate_page_undo(page, newpage, put_new_page, private);
+			list_move_tail(&page->lru, failed);
+		}
+		newpage = newpage2;
+	}
+
+	if (!nr_pages)
+		return 0;
+
+	migrate_copy_pages(src_pages, dst_pages, nr_pages);
+
+	list_for_each_entry_safe(page, page2, src_pages, lru) {
+		newpage = list_first_entry(dst_pages, struct page, lru);
+		list_del(&newpage->lru);
+		migrate_page_done(page, newpage, reason);
+		nr_succeeded++;
+	}
+
+	return nr_succeeded;
+}
+
+/*
+ * Migrate what can be batched off @from.  Everything else, including pages
+ * that failed here, is left on @from.  Returns the number of pages
+ * migrated.
+ */
+static int migrate_pages_batch(struct list_head *from, new_page_t get_new_page,
+			       free_page_t put_new_page, unsigned long private,
+			       enum migrate_reason reason)
+{
+	LIST_HEAD(skipped);
+	struct page *page, *page2, *newpage;
+	int nr_succeeded = 0;
+	bool stop = false;
+	int rc;
+
+	while (!list_empty(from) && !stop) {
+		LIST_HEAD(src_pages);
+		LIST_HEAD(dst_pages);
+		int nr_batched = 0;
+
+		list_for_each_entry_safe(page, page2, from, lru) {
+			if (!migrate_page_batchable(page)) {
+				list_move_tail(&page->lru, &skipped);
+				continue;
+			}
+
+			rc = migrate_page_unmap(get_new_page, put_new_page,
+						private, page, &newpage);
+			if (rc == -ENOMEM) {
+				/* Let unmap_and_move() split THPs and retry */
+				stop = true;
+				break;
+			}
+			if (rc) {
+				list_move_tail(&page->lru, &skipped);
+				continue;
+			}
+
+			list_move_tail(&page->lru, &src_pages);
+			list_add_tail(&newpage->lru, &dst_pages);
+			if (++nr_batched == NR_MAX_BATCHED_MIGRATION)
+				break;
+		}
+
+		if (nr_batched)
+			nr_succeeded += migrate_pages_batch_move(&src_pages,
+					&dst_pages, &skipped, put_new_page,
+					private, reason);
+		cond_resched();
+	}
+
+	list_splice(&skipped, from);
+	return nr_succeeded;
+}
+
+static int __init migrate_copy_init(void)
+{
+	migrate_copy_wq = alloc_workqueue("migrate_copy",
+					  WQ_UNBOUND | WQ_MEM_RECLAIM, 0);
+	WARN_ON(!migrate_copy_wq);
+	return 0;
+}
+subsys_initcall(migrate_copy_init);
+
 /*
  * migrate_pages - migrate the pages specified in a list, to the free pages
  *		   supplied as the target for the page migration
@@ -1440,6 +1799,15 @@ int migrate_pages(struct list_head *from, new_page_t get_new_page,
 	if (!swapwrite)
 		current->flags |= PF_SWAPWRITE;
 
+	/*
+	 * Batch what can be batched first, the loop below picks up whatever
+	 * is left with the usual retry and THP splitting logic.
+	 */
+	if (mode != MIGRATE_SYNC_NO_COPY && reason != MR_MEMORY_FAILURE)
+		nr_succeeded = migrate_pages_batch(from, get_new_page,
+						   put_new_page, private,
+						   reason);
+
 	for(pass = 0; pass < 10 && retry; pass++) {
 		retry = 0;
 
@@ -1942,8 +2310,23 @@ static int numamigrate_isolate_page(pg_data_t *pgdat, struct page *page)
 	VM_BUG_ON_PAGE(compound_order(page) && !PageTransHuge(page), page);
 
 	/* Avoid migrating to a node that is nearly full */
-	if (!migrate_balanced_pgdat(pgdat, compound_nr(page)))
+	if (!migrate_balanced_pgdat(pgdat, compound_nr(page))) {
+		int z;
+
+		if (!(sysctl_numa_balancing_mode & NUMA_BALANCING_MEMORY_TIERING))
+			return 0;
+		/*
+		 * Let kswapd make room on the fast node for the promotion,
+		 * demoting its cold pages to the slow node in turn.
+		 */
+		for (z = pgdat->nr_zones - 1; z >= 0; z--) {
+			if (populated_zone(pgdat->node_zones + z))
+				break;
+		}
+		wakeup_kswapd(pgdat->node_zones + z, 0,
+			      compound_order(page), ZONE_MOVABLE);
 		return 0;
+	}
 
 	if (isolate_lru_page(page))
 		return 0;
@@ -1990,6 +2373,9 @@ int migrate_misplaced_page(struct page *page, struct vm_area_struct *vma,
 	pg_data_t *pgdat = NODE_DATA(node);
 	int isolated;
 	int nr_remaining;
+	int nr_pages = hpage_nr_pages(page);
+	bool promotion = !node_is_toptier(page_to_nid(page)) &&
+			 node_is_toptier(node);
 	LIST_HEAD(migratepages);
 
 	/*
@@ -2023,8 +2409,12 @@ int migrate_misplaced_page(struct page *page, struct vm_area_struct *vma,
 			putback_lru_page(page);
 		}
 		isolated = 0;
-	} else
+	} else {
 		count_vm_numa_event(NUMA_PAGE_MIGRATE);
+		if (sysctl_numa_balancing_mode & NUMA_BALANCING_MEMORY_TIERING &&
+		    promotion)
+			mod_node_page_state(pgdat, PGPROMOTE_SUCCESS, nr_pages);
+	}
 	BUG_ON(!list_empty(&migratepages));
 	return isolated;
 
@@ -2145,6 +2535,10 @@ int migrate_misplaced_transhuge_page(struct mm_struct *mm,
 
 	count_vm_events(PGMIGRATE_SUCCESS, HPAGE_PMD_NR);
 	count_vm_numa_events(NUMA_PAGE_MIGRATE, HPAGE_PMD_NR);
+	if (sysctl_numa_balancing_mode & NUMA_BALANCING_MEMORY_TIERING &&
+	    !node_is_toptier(page_to_nid(page)) && node_is_toptier(node))
+		mod_node_page_state(NODE_DATA(node), PGPROMOTE_SUCCESS,
+				    HPAGE_PMD_NR);
 
 	mod_node_page_state(page_pgdat(page),
 			NR_ISOLATED_ANON + page_lru,
@@ -69,6 +69,7 @@
 #include <linux/nmi.h>
 #include <linux/psi.h>
 #include <linux/padata.h>
+#include <linux/memory-tiers.h>
 
 #include <asm/sections.h>
 #include <asm/tlbflush.h>
@@ -4759,6 +4760,21 @@ __alloc_pages_slowpath(gfp_t gfp_mask, unsigned int order,
 	return page;
 }
 
+/*
+ * Allocations that don't pass a nodemask are kept off the nodes taken out of
+ * the default fallback, unless they prefer such a node themselves.
+ */
+static inline nodemask_t *default_alloc_nodemask(int preferred_nid,
+						 nodemask_t *nodemask)
+{
+#ifdef CONFIG_NUMA
+	if (static_branch_unlikely(&node_default_alloc_restricted) &&
+	    !nodemask && node_isset(preferred_nid, node_default_alloc_nodes))
+		return &node_default_alloc_nodes;
+#endif
+	return nodemask;
+}
+
 static inline bool prepare_alloc_pages(gfp_t gfp_mask, unsigned int order,
 		int preferred_nid, nodemask_t *nodemask,
 		struct alloc_context *ac, gfp_t *alloc_mask,
@@ -4766,7 +4782,7 @@ static inline bool prepare_alloc_pages(gfp_t gfp_mask, unsigned int order,
 {
 	ac->highest_zoneidx = gfp_zone(gfp_mask);
 	ac->zonelist = node_zonelist(preferred_nid, gfp_mask);
-	ac->nodemask = nodemask;
+	ac->nodemask = default_alloc_nodemask(preferred_nid, nodemask);
 	ac->migratetype = gfp_migratetype(gfp_mask);
 
 	if (cpusets_enabled()) {
@@ -4858,7 +4874,7 @@ __alloc_pages_nodemask(gfp_t gfp_mask, unsigned int order, int preferred_nid,
 	 * Restore the original nodemask if it was potentially replaced with
 	 * &cpuset_current_mems_allowed to optimize the fast-path attempt.
 	 */
-	ac.nodemask = nodemask;
+	ac.nodemask = default_alloc_nodemask(preferred_nid, nodemask);
 
 	page = __alloc_pages_slowpath(alloc_mask, order, &ac);
 
@@ -5612,7 +5628,8 @@ static int node_load[MAX_NUMNODES];
  * according to the distance array (which contains arbitrary distance values
  * from each node to each node in the system), and should also prefer nodes
  * with no CPUs, since presumably they'll have very little allocation pressure
- * on them otherwise.
+ * on them otherwise.  Nodes in slower memory tiers come after all the nodes
+ * of faster tiers, regardless of distance.
  *
  * Return: node id of the found node or %NUMA_NO_NODE if no node is found.
  */
@@ -5638,6 +5655,9 @@ static int find_next_best_node(int node, nodemask_t *used_node_mask)
 		/* Use the distance array to find the distance */
 		val = node_distance(node, n);
 
+		/* Fall back to slower memory tiers last */
+		val += node_tier_penalty(node, n);
+
 		/* Penalize nodes under us ("prefer the next node") */
 		val += (n < node);
 
@@ -51,6 +51,11 @@
 #include <linux/printk.h>
 #include <linux/dax.h>
 #include <linux/psi.h>
+#include <linux/migrate.h>
+#include <linux/memory-tiers.h>
+#include <linux/pagewalk.h>
+#include <linux/mmu_notifier.h>
+#include <linux/debugfs.h>
 
 #include <asm/tlbflush.h>
 #include <asm/div64.h>
@@ -101,6 +106,15 @@ struct scan_control {
 	/* Can pages be swapped as part of reclaim? */
 	unsigned int may_swap:1;
 
+	/* Proactive reclaim asked for anon pages only */
+	unsigned int anon_only:1;
+
+	/* Can cold pages be migrated to a slower node instead of freed? */
+	unsigned int no_demotion:1;
+
+	/* Only demote, never free: memcg fast tier limit enforcement */
+	unsigned int demote_only:1;
+
 	/*
 	 * Cgroups are not reclaimed below their configured memory.low,
 	 * unless we threaten to OOM. If any cgroups are skipped due to
@@ -293,6 +307,41 @@ static bool writeback_throttling_sane(struct scan_control *sc)
 }
 #endif
 
+static bool can_demote(int nid, struct scan_control *sc)
+{
+	if (!numa_demotion_enabled)
+		return false;
+	if (sc->no_demotion)
+		return false;
+	/*
+	 * Demotion moves the charge along with the page, so it does not
+	 * help a cgroup that is over its limit, only one that is over its
+	 * fast tier limit.
+	 */
+	if (cgroup_reclaim(sc) && !sc->demote_only)
+		return false;
+
+	return next_demotion_node(nid) != NUMA_NO_NODE;
+}
+
+/*
+ * Anonymous pages can be reclaimed either by swapping them out or, when
+ * the node has a slower memory tier below it, by demoting them there.
+ */
+static bool can_reclaim_anon_pages(struct mem_cgroup *memcg, int nid,
+				   struct scan_control *sc)
+{
+	if (memcg == NULL) {
+		if (get_nr_swap_pages() > 0)
+			return true;
+	} else {
+		if (mem_cgroup_get_nr_swap_pages(memcg) > 0)
+			return true;
+	}
+
+	return can_demote(nid, sc);
+}
+
 /*
  * This misses isolated pages which are not accounted for to save counters.
  * As the data only determines if reclaim or compaction continues, it is
@@ -1069,6 +1118,99 @@ static void page_check_dirty_writeback(struct page *page,
 		mapping->a_ops->is_dirty_writeback(page, dirty, writeback);
 }
 
+struct demote_control {
+	int nid;
+	/* Nodes of all the tiers below the demoting node */
+	nodemask_t allowed;
+	unsigned int nr_demoted;
+};
+
+static struct page *alloc_demote_page(struct page *page, unsigned long private)
+{
+	struct demote_control *dc = (struct demote_control *)private;
+	struct page *newpage;
+	unsigned int order = 0;
+	/*
+	 * Only take free memory from the lower tiers, waking their kswapd if
+	 * needed. Reclaim of the target must not recurse from here.
+	 */
+	gfp_t gfp_mask = (GFP_HIGHUSER_MOVABLE & ~__GFP_RECLAIM) |
+			 __GFP_THISNODE | __GFP_NOWARN | __GFP_NOMEMALLOC |
+			 GFP_NOWAIT;
+
+	if (PageTransHuge(page)) {
+		gfp_mask = GFP_TRANSHUGE_LIGHT | __GFP_THISNODE;
+		order = HPAGE_PMD_ORDER;
+	}
+
+	/*
+	 * Try the preferred target first and fall back to the other nodes
+	 * of the lower tiers, nearest first, once it is full.
+	 */
+	newpage = alloc_pages_node(dc->nid, gfp_mask, order);
+	if (!newpage && !nodes_empty(dc->allowed))
+		newpage = __alloc_pages_nodemask(gfp_mask & ~__GFP_THISNODE,
+						 order, dc->nid, &dc->allowed);
+	if (!newpage)
+		return NULL;
+
+	if (PageTransHuge(newpage))
+		prep_transhuge_page(newpage);
+	dc->nr_demoted += hpage_nr_pages(newpage);
+	return newpage;
+}
+
+static void free_demote_page(struct page *newpage, unsigned long private)
+{
+	struct demote_control *dc = (struct demote_control *)private;
+
+	dc->nr_demoted -= hpage_nr_pages(newpage);
+	put_page(newpage);
+}
+
+/*
+ * Take pages on @demote_pages and attempt to demote them to another node.
+ * Pages which are not demoted are left on @demote_pages, except for those
+ * that migrate_pages() gave up on permanently, which it puts back on the
+ * LRU itself.
+ */
+static unsigned int demote_page_list(struct list_head *demote_pages,
+				     struct pglist_data *pgdat)
+{
+	struct demote_control dc = {
+		.nid = next_demotion_node(pgdat->node_id),
+	};
+	struct page *page;
+
+	if (list_empty(demote_pages))
+		return 0;
+
+	if (dc.nid == NUMA_NO_NODE)
+		return 0;
+	node_get_allowed_targets(pgdat, &dc.allowed);
+
+	/*
+	 * The caller has accounted these pages as isolated, and so does
+	 * migrate_pages() drop that accounting for every page it is done
+	 * with. Balance it for the duration of the migration.
+	 */
+	list_for_each_entry(page, demote_pages, lru)
+		mod_node_page_state(pgdat, NR_ISOLATED_ANON +
+				    page_is_file_lru(page),
+				    hpage_nr_pages(page));
+
+	/* Demotion ignores all cpuset and mempolicy settings */
+	migrate_pages(demote_pages, alloc_demote_page, free_demote_page,
+		      (unsigned long)&dc, MIGRATE_ASYNC, MR_DEMOTION);
+
+	list_for_each_entry(page, demote_pages, lru)
+		mod_node_page_state(pgdat, NR_ISOLATED_ANON +
+				    page_is_file_lru(page),
+				    -hpage_nr_pages(page));
+
+	return dc.nr_demoted;
+}
+
 /*
  * shrink_page_list() returns the number of reclaimed pages
  */
@@ -1081,12 +1223,17 @@ static unsigned int shrink_page_list(struct list_head *page_list,
 {
 	LIST_HEAD(ret_pages);
 	LIST_HEAD(free_pages);
+	LIST_HEAD(demote_pages);
 	unsigned int nr_reclaimed = 0;
+	unsigned int nr_demoted;
 	unsigned int pgactivate = 0;
+	bool do_demote_pass;
 
 	memset(stat, 0, sizeof(*stat));
 	cond_resched();
+	do_demote_pass = can_demote(pgdat->node_id, sc);
 
+retry:
 	while (!list_empty(page_list)) {
 		struct address_space *mapping;
 		struct page *page;
@@ -1235,6 +1382,21 @@ static unsigned int shrink_page_list(struct list_head *page_list,
 			; /* try to reclaim the page below */
 		}
 
+		/*
+		 * Before reclaiming the page, try to relocate
+		 * its contents to another node.
+		 */
+		if (do_demote_pass &&
+		    (thp_migration_supported() || !PageTransHuge(page))) {
+			list_add(&page->lru, &demote_pages);
+			unlock_page(page);
+			continue;
+		}
+
+		/* Pages which cannot be demoted stay where they are */
+		if (sc->demote_only)
+			goto keep_locked;
+
 		/*
 		 * Anonymous process memory has backing store?
 		 * Try to allocate it some swap space here.
@@ -1482,6 +1644,22 @@ static unsigned int shrink_page_list(struct list_head *page_list,
 		list_add(&page->lru, &ret_pages);
 		VM_BUG_ON_PAGE(PageLRU(page) || PageUnevictable(page), page);
 	}
+	/* 'page_list' is always empty here */
+
+	/* Migrate pages selected for demotion */
+	nr_demoted = demote_page_list(&demote_pages, pgdat);
+	if (current_is_kswapd())
+		count_vm_events(PGDEMOTE_KSWAPD, nr_demoted);
+	else
+		count_vm_events(PGDEMOTE_DIRECT, nr_demoted);
+	nr_reclaimed += nr_demoted;
+	/* Pages that could not be demoted are still in @demote_pages */
+	if (!list_empty(&demote_pages)) {
+		/* Pages which failed to demoted go back on @page_list for retry: */
+		list_splice_init(&demote_pages, page_list);
+		do_demote_pass = false;
+		goto retry;
+	}
 
 	pgactivate = stat->nr_activate[0] + stat->nr_activate[1];
 
@@ -1502,6 +1680,7 @@ unsigned int reclaim_clean_pages_from_list(struct zone *zone,
 		.gfp_mask = GFP_KERNEL,
 		.priority = DEF_PRIORITY,
 		.may_unmap = 1,
+		.no_demotion = 1,
 	};
 	struct reclaim_stat stat;
 	unsigned int nr_reclaimed;
@@ -1868,8 +2047,8 @@ static unsigned noinline_for_stack move_pages_to_lru(struct lruvec *lruvec,
 		lru = page_lru(page);
 
 		nr_pages = hpage_nr_pages(page);
-		update_lru_size(lruvec, lru, page_zonenum(page), nr_pages);
-		list_move(&page->lru, &lruvec->lists[lru]);
+		list_del(&page->lru);
+		add_page_to_lru_list(page, lruvec, lru);
 
 		if (put_page_testzero(page)) {
 			__ClearPageLRU(page);
@@ -2113,6 +2292,7 @@ unsigned long reclaim_pages(struct list_head *page_list)
 		.may_writepage = 1,
 		.may_unmap = 1,
 		.may_swap = 1,
+		.no_demotion = 1,
 	};
 
 	while (!list_empty(page_list)) {
@@ -2156,6 +2336,36 @@ unsigned long reclaim_pages(struct list_head *page_list)
 	return nr_reclaimed;
 }
 
+/*
+ * Demote the isolated pages on @page_list, which may come from any node, to
+ * the next lower tier of their node.  The pages that are not demoted are put
+ * back on the LRU.  Returns the number of demoted base pages.
+ */
+unsigned long demote_isolated_pages(struct list_head *page_list)
+{
+	unsigned long nr_demoted = 0;
+	LIST_HEAD(node_page_list);
+	struct page *page, *next;
+	int nid;
+
+	while (!list_empty(page_list)) {
+		nid = page_to_nid(lru_to_page(page_list));
+		list_for_each_entry_safe(page, next, page_list, lru) {
+			if (page_to_nid(page) == nid)
+				list_move(&page->lru, &node_page_list);
+		}
+
+		nr_demoted += demote_page_list(&node_page_list, NODE_DATA(nid));
+		while (!list_empty(&node_page_list)) {
+			page = lru_to_page(&node_page_list);
+			list_del(&page->lru);
+			putback_lru_page(page);
+		}
+	}
+
+	return nr_demoted;
+}
+
 static unsigned long shrink_list(enum lru_list lru, unsigned long nr_to_scan,
 				 struct lruvec *lruvec, struct scan_control *sc)
 {
@@ -2245,8 +2455,19 @@ static void get_scan_count(struct lruvec *lruvec, struct scan_control *sc,
 	unsigned long ap, fp;
 	enum lru_list lru;
 
+	if (sc->anon_only) {
+		if (!can_reclaim_anon_pages(memcg, lruvec_pgdat(lruvec)->node_id,
+					    sc)) {
+			memset(nr, 0, NR_LRU_LISTS * sizeof(*nr));
+			return;
+		}
+		scan_balance = SCAN_ANON;
+		goto out;
+	}
+
 	/* If we have no swap space, do not bother scanning anon pages. */
-	if (!sc->may_swap || mem_cgroup_get_nr_swap_pages(memcg) <= 0) {
+	if (!sc->may_swap ||
+	    !can_reclaim_anon_pages(memcg, lruvec_pgdat(lruvec)->node_id, sc)) {
 		scan_balance = SCAN_FILE;
 		goto out;
 	}
@@ -2420,6 +2641,646 @@ static void get_scan_count(struct lruvec *lruvec, struct scan_control *sc,
 	}
 }
 
+#ifdef CONFIG_LRU_GEN
+/*
+ * Multi-gen LRU
+ *
+ * Aging opens a new youngest generation and walks the page tables of the
+ * mms that ran since the previous walk, moving every page it finds
+ * accessed into the new generation through activate_page().  Eviction
+ * isolates pages from the tail of the oldest generation and hands them to
+ * shrink_page_list() like shrink_inactive_list() does.  Only the few pages
+ * that reach the oldest generation get an rmap walk, the active list scan
+ * with its rmap walk of every active page is gone.
+ */
+
+DEFINE_STATIC_KEY_MAYBE(CONFIG_LRU_GEN_ENABLED, lru_gen_key);
+
+static int __init setup_lru_gen(char *str)
+{
+	bool enable;
+
+	if (kstrtobool(str, &enable))
+		return 0;
+
+	if (enable)
+		static_branch_enable(&lru_gen_key);
+	else
+		static_branch_disable(&lru_gen_key);
+	return 1;
+}
+__setup("lru_gen=", setup_lru_gen);
+
+/* how many pages eviction looks at per batch, under lru_lock */
+#define LRU_GEN_SCAN_BATCH	(SWAP_CLUSTER_MAX * 8)
+
+static struct {
+	spinlock_t		lock;
+	struct list_head	head;
+	unsigned long		nr;
+} lru_gen_mm_list = {
+	.lock = __SPIN_LOCK_UNLOCKED(lru_gen_mm_list.lock),
+	.head = LIST_HEAD_INIT(lru_gen_mm_list.head),
+};
+
+void lru_gen_add_mm(struct mm_struct *mm)
+{
+	if (!lru_gen_enabled())
+		return;
+
+	mm->lru_gen.bitmap = ~0UL;
+	spin_lock(&lru_gen_mm_list.lock);
+	list_add_tail(&mm->lru_gen.list, &lru_gen_mm_list.head);
+	lru_gen_mm_list.nr++;
+	spin_unlock(&lru_gen_mm_list.lock);
+}
+
+void lru_gen_del_mm(struct mm_struct *mm)
+{
+	if (!lru_gen_enabled())
+		return;
+
+	spin_lock(&lru_gen_mm_list.lock);
+	list_del(&mm->lru_gen.list);
+	lru_gen_mm_list.nr--;
+	spin_unlock(&lru_gen_mm_list.lock);
+}
+
+void lru_gen_init_lruvec(struct lruvec *lruvec)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int gen, type, zone;
+
+	lrugen->max_seq = MIN_NR_GENS;
+	for (gen = 0; gen < MAX_NR_GENS; gen++) {
+		lrugen->timestamps[gen] = jiffies;
+		for (type = 0; type < ANON_AND_FILE; type++)
+			for (zone = 0; zone < MAX_NR_ZONES; zone++)
+				INIT_LIST_HEAD(&lrugen->lists[gen][type][zone]);
+	}
+}
+
+/*
+ * Pages of other lruvecs keep their accessed bit, their own aging or the
+ * rmap walk at eviction still needs to see it.
+ */
+static bool lru_gen_page_ours(struct page *page, struct lruvec *lruvec)
+{
+	struct pglist_data *pgdat = lruvec_pgdat(lruvec);
+
+	page = compound_head(page);
+	if (!PageLRU(page) || PageUnevictable(page))
+		return false;
+	if (page_pgdat(page) != pgdat)
+		return false;
+	return mem_cgroup_page_lruvec(page, pgdat) == lruvec;
+}
+
+static int lru_gen_pmd_entry(pmd_t *pmd, unsigned long addr,
+			     unsigned long end, struct mm_walk *args)
+{
+	struct lruvec *lruvec = args->private;
+	struct vm_area_struct *vma = args->vma;
+	pte_t *orig_pte, *pte;
+	spinlock_t *ptl;
+
+#ifdef CONFIG_TRANSPARENT_HUGEPAGE
+	ptl = pmd_trans_huge_lock(pmd, vma);
+	if (ptl) {
+		pmd_t orig_pmd = *pmd;
+
+		if (pmd_trans_huge(orig_pmd) && !is_huge_zero_pmd(orig_pmd) &&
+		    pmd_young(orig_pmd) &&
+		    lru_gen_page_ours(pmd_page(orig_pmd), lruvec) &&
+		    pmdp_clear_young_notify(vma, addr, pmd))
+			activate_page(pmd_page(orig_pmd));
+		spin_unlock(ptl);
+		return 0;
+	}
+#endif
+
+	if (pmd_trans_unstable(pmd))
+		return 0;
+
+	orig_pte = pte = pte_offset_map_lock(args->mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		pte_t ptent = *pte;
+		struct page *page;
+
+		if (!pte_present(ptent) || !pte_young(ptent))
+			continue;
+
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page || !lru_gen_page_ours(page, lruvec))
+			continue;
+
+		if (ptep_clear_young_notify(vma, addr, pte))
+			activate_page(page);
+	}
+	pte_unmap_unlock(orig_pte, ptl);
+	cond_resched();
+
+	return 0;
+}
+
+static int lru_gen_test_walk(unsigned long start, unsigned long end,
+			     struct mm_walk *args)
+{
+	struct vm_area_struct *vma = args->vma;
+
+	/* mlocked pages are unevictable, the rest has no LRU pages */
+	if ((vma->vm_flags & (VM_LOCKED | VM_SPECIAL)) ||
+	    is_vm_hugetlb_page(vma))
+		return 1;
+	return 0;
+}
+
+static const struct mm_walk_ops lru_gen_walk_ops = {
+	.pmd_entry		= lru_gen_pmd_entry,
+	.test_walk		= lru_gen_test_walk,
+};
+
+static bool lru_gen_mm_ours(struct mm_struct *mm, struct lruvec *lruvec)
+{
+#ifdef CONFIG_MEMCG
+	struct mem_cgroup *memcg = lruvec_memcg(lruvec);
+	struct task_struct *owner;
+	bool ours;
+
+	if (mem_cgroup_disabled())
+		return true;
+
+	rcu_read_lock();
+	owner = rcu_dereference(mm->owner);
+	ours = owner && mem_cgroup_from_task(owner) == memcg;
+	rcu_read_unlock();
+	return ours;
+#else
+	return true;
+#endif
+}
+
+/*
+ * Walk the page tables of the mms of @lruvec's memcg that ran since the
+ * last walk for @lruvec's node.  The list is rotated as it is walked so that concurrent
+ * walkers and new mms don't make anyone start over; a walk that misses an
+ * mm only costs an rmap walk at eviction.
+ */
+static void lru_gen_walk_mms(struct lruvec *lruvec)
+{
+	unsigned long nr = READ_ONCE(lru_gen_mm_list.nr);
+	int bit = lruvec_pgdat(lruvec)->node_id % BITS_PER_LONG;
+	struct mm_struct *mm;
+
+	while (nr--) {
+		spin_lock(&lru_gen_mm_list.lock);
+		if (list_empty(&lru_gen_mm_list.head)) {
+			spin_unlock(&lru_gen_mm_list.lock);
+			break;
+		}
+		mm = list_first_entry(&lru_gen_mm_list.head, struct mm_struct,
+				      lru_gen.list);
+		list_move_tail(&mm->lru_gen.list, &lru_gen_mm_list.head);
+		if (!test_bit(bit, &mm->lru_gen.bitmap) ||
+		    !lru_gen_mm_ours(mm, lruvec) || !mmget_not_zero(mm))
+			mm = NULL;
+		spin_unlock(&lru_gen_mm_list.lock);
+
+		if (!mm)
+			continue;
+
+		if (down_read_trylock(&mm->mmap_sem)) {
+			clear_bit(bit, &mm->lru_gen.bitmap);
+			if (mm->highest_vm_end)
+				walk_page_range(mm, 0, mm->highest_vm_end,
+						&lru_gen_walk_ops, lruvec);
+			up_read(&mm->mmap_sem);
+		}
+		/* don't tear down an exiting mm from reclaim */
+		mmput_async(mm);
+
+		if (fatal_signal_pending(current))
+			break;
+		cond_resched();
+	}
+}
+
+/* Move @page into generation @gen, to the tail if @tail */
+static void lru_gen_move_page(struct lruvec *lruvec, struct page *page,
+			      int gen, bool tail)
+{
+	int old_gen = page_lru_gen(page);
+	int type = page_is_file_lru(page);
+	int zone = page_zonenum(page);
+	int nr_pages = hpage_nr_pages(page);
+	struct list_head *head = &lruvec->lrugen.lists[gen][type][zone];
+
+	VM_BUG_ON_PAGE(old_gen < 0, page);
+
+	set_mask_bits(&page->flags, LRU_GEN_MASK, (gen + 1UL) << LRU_GEN_PGOFF);
+	lru_gen_update_size(lruvec, type, zone, old_gen, -nr_pages);
+	lru_gen_update_size(lruvec, type, zone, gen, nr_pages);
+	if (tail)
+		list_move_tail(&page->lru, head);
+	else
+		list_move(&page->lru, head);
+}
+
+static void lru_gen_try_inc_min_seq(struct lruvec *lruvec, int type)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int zone;
+
+	lockdep_assert_held(&lruvec_pgdat(lruvec)->lru_lock);
+
+	while (lrugen->min_seq[type] + MIN_NR_GENS <= lrugen->max_seq) {
+		int gen = lru_gen_from_seq(lrugen->min_seq[type]);
+
+		for (zone = 0; zone < MAX_NR_ZONES; zone++)
+			if (!list_empty(&lrugen->lists[gen][type][zone]))
+				return;
+		WRITE_ONCE(lrugen->min_seq[type], lrugen->min_seq[type] + 1);
+	}
+}
+
+/*
+ * Merge the oldest generation of @type into the next one, a batch at a
+ * time.  Needed when the pages can't be evicted, e.g. anon without swap.
+ * Returns true once the oldest generation is gone.
+ */
+static bool lru_gen_fold_oldest(struct lruvec *lruvec, int type)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int old_gen = lru_gen_from_seq(lrugen->min_seq[type]);
+	int new_gen = lru_gen_from_seq(lrugen->min_seq[type] + 1);
+	int batch = LRU_GEN_SCAN_BATCH;
+	int zone;
+
+	for (zone = 0; zone < MAX_NR_ZONES; zone++) {
+		struct list_head *head = &lrugen->lists[old_gen][type][zone];
+
+		while (!list_empty(head)) {
+			/* oldest pages stay oldest, at the tail */
+			lru_gen_move_page(lruvec, lru_to_page(head), new_gen,
+					  true);
+			if (!--batch)
+				return false;
+		}
+	}
+
+	WRITE_ONCE(lrugen->min_seq[type], lrugen->min_seq[type] + 1);
+	return true;
+}
+
+/*
+ * Open a new youngest generation.  The previous second youngest one stops
+ * counting as active.  Returns false if someone else aged @lruvec first.
+ */
+static bool lru_gen_inc_max_seq(struct lruvec *lruvec, unsigned long max_seq)
+{
+	struct pglist_data *pgdat = lruvec_pgdat(lruvec);
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int gen, type, zone;
+
+	spin_lock_irq(&pgdat->lru_lock);
+
+	for (type = 0; type < ANON_AND_FILE; type++) {
+		lru_gen_try_inc_min_seq(lruvec, type);
+		while (lrugen->max_seq == max_seq &&
+		       max_seq - lrugen->min_seq[type] + 1 >= MAX_NR_GENS) {
+			if (lru_gen_fold_oldest(lruvec, type))
+				continue;
+			spin_unlock_irq(&pgdat->lru_lock);
+			cond_resched();
+			spin_lock_irq(&pgdat->lru_lock);
+		}
+	}
+
+	if (lrugen->max_seq != max_seq) {
+		spin_unlock_irq(&pgdat->lru_lock);
+		return false;
+	}
+
+	gen = lru_gen_from_seq(max_seq - 1);
+	for (type = 0; type < ANON_AND_FILE; type++) {
+		enum lru_list lru = type * LRU_FILE;
+
+		for (zone = 0; zone < MAX_NR_ZONES; zone++) {
+			long nr_pages = lrugen->nr_pages[gen][type][zone];
+
+			if (!nr_pages)
+				continue;
+			update_lru_size(lruvec, lru + LRU_ACTIVE, zone, -nr_pages);
+			update_lru_size(lruvec, lru, zone, nr_pages);
+		}
+	}
+
+	gen = lru_gen_from_seq(max_seq + 1);
+	lrugen->timestamps[gen] = jiffies;
+	WRITE_ONCE(lrugen->max_seq, max_seq + 1);
+
+	spin_unlock_irq(&pgdat->lru_lock);
+	return true;
+}
+
+static void lru_gen_age(struct lruvec *lruvec)
+{
+	if (!lru_gen_inc_max_seq(lruvec, READ_ONCE(lruvec->lrugen.max_seq)))
+		return;
+
+	lru_gen_walk_mms(lruvec);
+	/* land the promotions of this walk in the new generation */
+	lru_add_drain();
+}
+
+static unsigned long lru_gen_isolate(struct lruvec *lruvec,
+				     struct scan_control *sc, int type,
+				     struct list_head *dst,
+				     unsigned long *nr_scanned)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	isolate_mode_t mode = sc->may_unmap ? 0 : ISOLATE_UNMAPPED;
+	unsigned long nr_taken = 0, scanned = 0;
+	int gen, zone;
+
+	lru_gen_try_inc_min_seq(lruvec, type);
+	if (lrugen->min_seq[type] + MIN_NR_GENS > lrugen->max_seq)
+		goto out;
+
+	gen = lru_gen_from_seq(lrugen->min_seq[type]);
+	for (zone = sc->reclaim_idx; zone >= 0; zone--) {
+		struct list_head *head = &lrugen->lists[gen][type][zone];
+
+		while (!list_empty(head) && scanned < LRU_GEN_SCAN_BATCH &&
+		       nr_taken < SWAP_CLUSTER_MAX) {
+			struct page *page = lru_to_page(head);
+			int nr_pages = hpage_nr_pages(page);
+
+			VM_BUG_ON_PAGE(page_lru_gen(page) < 0, page);
+
+			scanned += nr_pages;
+			if (__isolate_lru_page(page, mode)) {
+				/* busy or mapped, have another look later */
+				list_move(&page->lru, head);
+				continue;
+			}
+
+			lru_gen_del_page(lruvec, page);
+			list_add(&page->lru, dst);
+			nr_taken += nr_pages;
+		}
+	}
+out:
+	*nr_scanned = scanned;
+	return nr_taken;
+}
+
+/* Evict from the oldest generation of @type, see shrink_inactive_list() */
+static unsigned long lru_gen_evict(struct lruvec *lruvec,
+				   struct scan_control *sc, int type,
+				   unsigned long *nr_scanned)
+{
+	struct pglist_data *pgdat = lruvec_pgdat(lruvec);
+	unsigned long nr_reclaimed, nr_taken;
+	struct reclaim_stat stat;
+	enum vm_event_item item;
+	LIST_HEAD(page_list);
+
+	*nr_scanned = 0;
+	if (too_many_isolated(pgdat, type, sc))
+		return 0;
+
+	spin_lock_irq(&pgdat->lru_lock);
+
+	nr_taken = lru_gen_isolate(lruvec, sc, type, &page_list, nr_scanned);
+
+	__mod_node_page_state(pgdat, NR_ISOLATED_ANON + type, nr_taken);
+	item = current_is_kswapd() ? PGSCAN_KSWAPD : PGSCAN_DIRECT;
+	if (!cgroup_reclaim(sc))
+		__count_vm_events(item, *nr_scanned);
+	__count_memcg_events(lruvec_memcg(lruvec), item, *nr_scanned);
+	__count_vm_events(PGSCAN_ANON + type, *nr_scanned);
+
+	spin_unlock_irq(&pgdat->lru_lock);
+
+	if (nr_taken == 0)
+		return 0;
+
+	nr_reclaimed = shrink_page_list(&page_list, pgdat, sc, 0,
+				&stat, false);
+
+	spin_lock_irq(&pgdat->lru_lock);
+
+	move_pages_to_lru(lruvec, &page_list);
+
+	__mod_node_page_state(pgdat, NR_ISOLATED_ANON + type, -nr_taken);
+	lru_note_cost(lruvec, type, stat.nr_pageout);
+	item = current_is_kswapd() ? PGSTEAL_KSWAPD : PGSTEAL_DIRECT;
+	if (!cgroup_reclaim(sc))
+		__count_vm_events(item, nr_reclaimed);
+	__count_memcg_events(lruvec_memcg(lruvec), item, nr_reclaimed);
+	__count_vm_events(PGSTEAL_ANON + type, nr_reclaimed);
+
+	spin_unlock_irq(&pgdat->lru_lock);
+
+	mem_cgroup_uncharge_list(&page_list);
+	free_unref_page_list(&page_list);
+
+	if (stat.nr_unqueued_dirty == nr_taken)
+		wakeup_flusher_threads(WB_REASON_VMSCAN);
+
+	sc->nr.dirty += stat.nr_dirty;
+	sc->nr.congested += stat.nr_congested;
+	sc->nr.unqueued_dirty += stat.nr_unqueued_dirty;
+	sc->nr.writeback += stat.nr_writeback;
+	sc->nr.immediate += stat.nr_immediate;
+	sc->nr.taken += nr_taken;
+	if (type)
+		sc->nr.file_taken += nr_taken;
+
+	return nr_reclaimed;
+}
+
+static unsigned long lru_gen_nr_oldest(struct lruvec *lruvec,
+				       struct scan_control *sc, int type)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	int gen = lru_gen_from_seq(READ_ONCE(lrugen->min_seq[type]));
+	unsigned long nr = 0;
+	int zone;
+
+	for (zone = 0; zone <= sc->reclaim_idx; zone++)
+		nr += max(READ_ONCE(lrugen->nr_pages[gen][type][zone]), 0L);
+	return nr;
+}
+
+/*
+ * Evict the type whose oldest generation is older.  On a tie, weigh the
+ * pages in the oldest generations by swappiness.
+ */
+static int lru_gen_pick_type(struct lruvec *lruvec, struct scan_control *sc,
+			     int swappiness)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	unsigned long anon_seq = READ_ONCE(lrugen->min_seq[0]);
+	unsigned long file_seq = READ_ONCE(lrugen->min_seq[1]);
+
+	if (sc->anon_only)
+		return 0;
+	if (!swappiness)
+		return 1;
+	if (anon_seq != file_seq)
+		return anon_seq > file_seq;
+
+	return lru_gen_nr_oldest(lruvec, sc, 0) * swappiness <
+	       lru_gen_nr_oldest(lruvec, sc, 1) * (200 - swappiness);
+}
+
+static bool lru_gen_should_age(struct lruvec *lruvec, int type)
+{
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+
+	return READ_ONCE(lrugen->min_seq[type]) + MIN_NR_GENS >
+	       READ_ONCE(lrugen->max_seq);
+}
+
+static void lru_gen_shrink_lruvec(struct lruvec *lruvec,
+				  struct scan_control *sc)
+{
+	struct mem_cgroup *memcg = lruvec_memcg(lruvec);
+	int nid = lruvec_pgdat(lruvec)->node_id;
+	unsigned long nr_to_reclaim = sc->nr_to_reclaim;
+	unsigned long nr_reclaimed = 0, nr_to_scan, scanned = 0;
+	struct blk_plug plug;
+	int swappiness = 0;
+	enum lru_list lru;
+
+	if (sc->may_swap && can_reclaim_anon_pages(memcg, nid, sc))
+		swappiness = mem_cgroup_swappiness(memcg);
+	else if (sc->anon_only)
+		return;
+
+	nr_to_scan = 0;
+	for_each_evictable_lru(lru) {
+		if (is_file_lru(lru) ? !sc->anon_only : swappiness)
+			nr_to_scan += lruvec_lru_size(lruvec, lru,
+						      sc->reclaim_idx);
+	}
+	nr_to_scan = max(nr_to_scan >> sc->priority, SWAP_CLUSTER_MAX);
+
+	blk_start_plug(&plug);
+	while (scanned < nr_to_scan && nr_reclaimed < nr_to_reclaim) {
+		int type = lru_gen_pick_type(lruvec, sc, swappiness);
+		unsigned long nr_scanned = 0;
+		int tries;
+
+		for (tries = 0; tries < ANON_AND_FILE; tries++) {
+			if (lru_gen_should_age(lruvec, type))
+				lru_gen_age(lruvec);
+
+			nr_reclaimed += lru_gen_evict(lruvec, sc, type,
+						      &nr_scanned);
+			if (nr_scanned || !swappiness || sc->anon_only)
+				break;
+			type = !type;
+		}
+		if (!nr_scanned)
+			break;
+
+		scanned += nr_scanned;
+		cond_resched();
+	}
+	blk_finish_plug(&plug);
+
+	sc->nr_scanned += scanned;
+	sc->nr_reclaimed += nr_reclaimed;
+}
+
+static void lru_gen_show_lruvec(struct seq_file *m, struct lruvec *lruvec)
+{
+	struct pglist_data *pgdat = lruvec_pgdat(lruvec);
+	struct lru_gen_struct *lrugen = &lruvec->lrugen;
+	unsigned long seq, min_seq, max_seq;
+
+	spin_lock_irq(&pgdat->lru_lock);
+
+	max_seq = lrugen->max_seq;
+	min_seq = min(lrugen->min_seq[0], lrugen->min_seq[1]);
+	seq_printf(m, " node %5d\n", pgdat->node_id);
+
+	for (seq = min_seq; seq <= max_seq; seq++) {
+		int gen = lru_gen_from_seq(seq);
+		long nr[ANON_AND_FILE] = {};
+		int type, zone;
+
+		for (type = 0; type < ANON_AND_FILE; type++) {
+			if (seq < lrugen->min_seq[type])
+				continue;
+			for (zone = 0; zone < MAX_NR_ZONES; zone++)
+				nr[type] += lrugen->nr_pages[gen][type][zone];
+		}
+
+		seq_printf(m, " %10lu %10u %10ld %10ld\n", seq,
+			   jiffies_to_msecs(jiffies - lrugen->timestamps[gen]),
+			   nr[0], nr[1]);
+	}
+
+	spin_unlock_irq(&pgdat->lru_lock);
+}
+
+/*
+ * One block per memcg and node:
+ *   memcg <id> <path>
+ *    node <nid>
+ *     <seq> <age in ms> <anon pages> <file pages>
+ * from the oldest generation to the youngest.
+ */
+static int lru_gen_show(struct seq_file *m, void *v)
+{
+	struct mem_cgroup *memcg;
+	char *path;
+	int nid;
+
+	path = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!path)
+		return -ENOMEM;
+
+	memcg = mem_cgroup_iter(NULL, NULL, NULL);
+	do {
+		strcpy(path, "/");
+#ifdef CONFIG_MEMCG
+		if (memcg)
+			cgroup_path(memcg->css.cgroup, path, PATH_MAX);
+#endif
+		seq_printf(m, "memcg %5hu %s\n", mem_cgroup_id(memcg), path);
+		for_each_node_state(nid, N_MEMORY)
+			lru_gen_show_lruvec(m, mem_cgroup_lruvec(memcg,
+								 NODE_DATA(nid)));
+		cond_resched();
+	} while ((memcg = mem_cgroup_iter(NULL, memcg, NULL)));
+
+	kfree(path);
+	return 0;
+}
+DEFINE_SHOW_ATTRIBUTE(lru_gen);
+
+static int __init init_lru_gen(void)
+{
+	if (lru_gen_enabled())
+		debugfs_create_file("lru_gen", 0444, NULL, NULL, &lru_gen_fops);
+	return 0;
+}
+late_initcall(init_lru_gen);
+
+#else /* !CONFIG_LRU_GEN */
+
+static void lru_gen_shrink_lruvec(struct lruvec *lruvec,
+				  struct scan_control *sc)
+{
+}
+
+#endif /* CONFIG_LRU_GEN */
+
 static void shrink_lruvec(struct lruvec *lruvec, struct scan_control *sc)
 {
 	unsigned long nr[NR_LRU_LISTS];
@@ -2431,6 +3292,11 @@ static void shrink_lruvec(struct lruvec *lruvec, struct scan_control *sc)
 	struct blk_plug plug;
 	bool scan_adjusted;
 
+	if (lru_gen_enabled()) {
+		lru_gen_shrink_lruvec(lruvec, sc);
+		return;
+	}
+
 	get_scan_count(lruvec, sc, nr);
 
 	/* Record the original scan target for proportional adjustments later */
@@ -2529,7 +3395,9 @@ static void shrink_lruvec(struct lruvec *lruvec, struct scan_control *sc)
 	 * Even if we did not try to evict anon pages at all, we want to
 	 * rebalance the anon lru active/inactive ratio.
 	 */
-	if (total_swap_pages && inactive_is_low(lruvec, LRU_INACTIVE_ANON))
+	if (can_reclaim_anon_pages(lruvec_memcg(lruvec),
+				   lruvec_pgdat(lruvec)->node_id, sc) &&
+	    inactive_is_low(lruvec, LRU_INACTIVE_ANON))
 		shrink_active_list(SWAP_CLUSTER_MAX, lruvec,
 				   sc, LRU_ACTIVE_ANON);
 }
@@ -2599,7 +3467,7 @@ static inline bool should_continue_reclaim(struct pglist_data *pgdat,
 	 */
 	pages_for_compaction = compact_gap(sc->order);
 	inactive_lru_pages = node_page_state(pgdat, NR_INACTIVE_FILE);
-	if (get_nr_swap_pages() > 0)
+	if (can_reclaim_anon_pages(NULL, pgdat->node_id, sc))
 		inactive_lru_pages += node_page_state(pgdat, NR_INACTIVE_ANON);
 
 	return inactive_lru_pages > pages_for_compaction;
@@ -2652,8 +3520,9 @@ static void shrink_node_memcgs(pg_data_t *pgdat, struct scan_control *sc)
 
 		shrink_lruvec(lruvec, sc);
 
-		shrink_slab(sc->gfp_mask, pgdat->node_id, memcg,
-			    sc->priority);
+		if (!sc->demote_only)
+			shrink_slab(sc->gfp_mask, pgdat->node_id, memcg,
+				    sc->priority);
 
 		/* Record the group's reclaim efficiency */
 		vmpressure(sc->gfp_mask, memcg, false,
@@ -3309,10 +4178,22 @@ unsigned long mem_cgroup_shrink_node(struct mem_cgroup *memcg,
 	return sc.nr_reclaimed;
 }
 
-unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
-					   unsigned long nr_pages,
-					   gfp_t gfp_mask,
-					   bool may_swap)
+/**
+ * try_to_free_mem_cgroup_pages_mask - reclaim from a cgroup with restrictions
+ * @memcg: cgroup to reclaim from, including its descendants
+ * @nr_pages: number of pages to reclaim
+ * @gfp_mask: allocation context
+ * @reclaim_options: MEMCG_RECLAIM_MAY_SWAP to include anon pages,
+ *	MEMCG_RECLAIM_ANON_ONLY to leave file pages alone
+ * @nodemask: nodes to reclaim from, NULL for all
+ *
+ * Returns the number of pages reclaimed.
+ */
+unsigned long try_to_free_mem_cgroup_pages_mask(struct mem_cgroup *memcg,
+						unsigned long nr_pages,
+						gfp_t gfp_mask,
+						unsigned int reclaim_options,
+						nodemask_t *nodemask)
 {
 	unsigned long nr_reclaimed;
 	unsigned long pflags;
@@ -3323,17 +4204,24 @@ unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
 				(GFP_HIGHUSER_MOVABLE & ~GFP_RECLAIM_MASK),
 		.reclaim_idx = MAX_NR_ZONES - 1,
 		.target_mem_cgroup = memcg,
+		.nodemask = nodemask,
 		.priority = DEF_PRIORITY,
 		.may_writepage = !laptop_mode,
 		.may_unmap = 1,
-		.may_swap = may_swap,
+		.may_swap = !!(reclaim_options & MEMCG_RECLAIM_MAY_SWAP),
+		.anon_only = !!(reclaim_options & MEMCG_RECLAIM_ANON_ONLY),
 	};
 	/*
 	 * Traverse the ZONELIST_FALLBACK zonelist of the current node to put
 	 * equal pressure on all the nodes. This is based on the assumption that
 	 * the reclaim does not bail out early.
 	 */
-	struct zonelist *zonelist = node_zonelist(numa_node_id(), sc.gfp_mask);
+	int nid = numa_node_id();
+	struct zonelist *zonelist;
+
+	if (nodemask && !node_isset(nid, *nodemask))
+		nid = first_node(*nodemask);
+	zonelist = node_zonelist(nid, sc.gfp_mask);
 
 	set_task_reclaim_state(current, &sc.reclaim_state);
 
@@ -3352,6 +4240,84 @@ unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
 
 	return nr_reclaimed;
 }
+
+unsigned long try_to_free_mem_cgroup_pages(struct mem_cgroup *memcg,
+					   unsigned long nr_pages,
+					   gfp_t gfp_mask,
+					   bool may_swap)
+{
+	return try_to_free_mem_cgroup_pages_mask(memcg, nr_pages, gfp_mask,
+					may_swap ? MEMCG_RECLAIM_MAY_SWAP : 0,
+					NULL);
+}
+
+/**
+ * try_to_demote_mem_cgroup_pages - move a cgroup's cold pages off the top tier
+ * @memcg: cgroup over its fast tier limit
+ * @nr_pages: number of pages to demote
+ * @gfp_mask: allocation context
+ *
+ * Scans the LRUs of @memcg and its descendants on the top tier nodes and
+ * demotes their cold pages to the next slower tier.  Nothing is freed, so
+ * the cgroup's total charge is unchanged.
+ *
+ * Returns the number of pages demoted.
+ */
+unsigned long try_to_demote_mem_cgroup_pages(struct mem_cgroup *memcg,
+					     unsigned long nr_pages,
+					     gfp_t gfp_mask)
+{
+	unsigned long nr_demoted;
+	unsigned long pflags;
+	unsigned int noreclaim_flag;
+	nodemask_t nodes = NODE_MASK_NONE;
+	struct scan_control sc = {
+		.nr_to_reclaim = max(nr_pages, SWAP_CLUSTER_MAX),
+		.gfp_mask = (current_gfp_context(gfp_mask) & GFP_RECLAIM_MASK) |
+				(GFP_HIGHUSER_MOVABLE & ~GFP_RECLAIM_MASK),
+		.reclaim_idx = MAX_NR_ZONES - 1,
+		.target_mem_cgroup = memcg,
+		.nodemask = &nodes,
+		.priority = DEF_PRIORITY,
+		.may_unmap = 1,
+		.may_swap = 1,
+		.demote_only = 1,
+	};
+	struct zonelist *zonelist;
+	int nid;
+
+	if (!numa_demotion_enabled)
+		return 0;
+
+	for_each_node_state(nid, N_MEMORY) {
+		if (node_is_toptier(nid) &&
+		    next_demotion_node(nid) != NUMA_NO_NODE)
+			node_set(nid, nodes);
+	}
+	if (nodes_empty(nodes))
+		return 0;
+
+	nid = node_isset(numa_node_id(), nodes) ? numa_node_id() :
+						  first_node(nodes);
+	zonelist = node_zonelist(nid, sc.gfp_mask);
+
+	set_task_reclaim_state(current, &sc.reclaim_state);
+
+	trace_mm_vmscan_memcg_reclaim_begin(0, sc.gfp_mask);
+
+	psi_memstall_enter(&pflags);
+	noreclaim_flag = memalloc_noreclaim_save();
+
+	nr_demoted = do_try_to_free_pages(zonelist, &sc);
+
+	memalloc_noreclaim_restore(noreclaim_flag);
+	psi_memstall_leave(&pflags);
+
+	trace_mm_vmscan_memcg_reclaim_end(nr_demoted);
+	set_task_reclaim_state(current, NULL);
+
+	return nr_demoted;
+}
 #endif
 
 static void age_active_anon(struct pglist_data *pgdat,
@@ -3360,7 +4326,11 @@ static void age_active_anon(struct pglist_data *pgdat,
 	struct mem_cgroup *memcg;
 	struct lruvec *lruvec;
 
-	if (!total_swap_pages)
+	/* the multi-gen LRU ages on demand when evicting */
+	if (lru_gen_enabled())
+		return;
+
+	if (!can_reclaim_anon_pages(NULL, pgdat->node_id, sc))
 		return;
 
 	lruvec = mem_cgroup_lruvec(NULL, pgdat);
@@ -4008,6 +4978,7 @@ unsigned long shrink_all_memory(unsigned long nr_to_reclaim)
 		.may_writepage = 1,
 		.may_unmap = 1,
 		.may_swap = 1,
+		.no_demotion = 1,
 		.hibernation_mode = 1,
 	};
 	struct zonelist *zonelist = node_zonelist(numa_node_id(), sc.gfp_mask);
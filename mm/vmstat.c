@@ -1172,6 +1172,10 @@ const char * const vmstat_text[] = {
 	"nr_kernel_misc_reclaimable",
 	"nr_foll_pin_acquired",
 	"nr_foll_pin_released",
+#ifdef CONFIG_NUMA_BALANCING
+	"pgpromote_success",
+	"pgpromote_candidate",
+#endif
 
 	/* enum writeback_stat_item counters */
 	"nr_dirty_threshold",
@@ -1207,6 +1211,7 @@ const char * const vmstat_text[] = {
 	"pgscan_file",
 	"pgsteal_anon",
 	"pgsteal_file",
+	"pgsteal_proactive",
 
 #ifdef CONFIG_NUMA
 	"zone_reclaim_failed",
@@ -1234,6 +1239,8 @@ const char * const vmstat_text[] = {
 #ifdef CONFIG_MIGRATION
 	"pgmigrate_success",
 	"pgmigrate_fail",
+	"pgdemote_kswapd",
+	"pgdemote_direct",
 #endif
 #ifdef CONFIG_COMPACTION
 	"compact_migrate_scanned",
@@ -1076,6 +1076,7 @@ static void z3fold_destroy_pool(struct z3fold_pool *pool)
  * @size:	size in bytes of the desired allocation
  * @gfp:	gfp flags used if the pool needs to grow
  * @handle:	handle of the new allocation
+ * @nid:	preferred node id used if the pool needs to grow
  *
  * This function will attempt to find a free region in the pool large enough to
  * satisfy the allocation request.  A search of the unbuddied lists is
@@ -1090,7 +1091,7 @@ static void z3fold_destroy_pool(struct z3fold_pool *pool)
  * a new page.
  */
 static int z3fold_alloc(struct z3fold_pool *pool, size_t size, gfp_t gfp,
-			unsigned long *handle)
+			unsigned long *handle, const int nid)
 {
 	int chunks = size_to_chunks(size);
 	struct z3fold_header *zhdr = NULL;
@@ -1156,7 +1157,7 @@ static int z3fold_alloc(struct z3fold_pool *pool, size_t size, gfp_t gfp,
 		}
 	}
 	if (!page)
-		page = alloc_page(gfp);
+		page = zpool_alloc_page(nid, gfp);
 
 	if (!page)
 		return -ENOMEM;
@@ -1733,9 +1734,9 @@ static void z3fold_zpool_destroy(void *pool)
 }
 
 static int z3fold_zpool_malloc(void *pool, size_t size, gfp_t gfp,
-			unsigned long *handle)
+			unsigned long *handle, const int nid)
 {
-	return z3fold_alloc(pool, size, gfp, handle);
+	return z3fold_alloc(pool, size, gfp, handle, nid);
 }
 static void z3fold_zpool_free(void *pool, unsigned long handle)
 {
@@ -158,9 +158,9 @@ static void zbud_zpool_destroy(void *pool)
 }
 
 static int zbud_zpool_malloc(void *pool, size_t size, gfp_t gfp,
-			unsigned long *handle)
+			unsigned long *handle, const int nid)
 {
-	return zbud_alloc(pool, size, gfp, handle);
+	return zbud_alloc(pool, size, gfp, handle, nid);
 }
 static void zbud_zpool_free(void *pool, unsigned long handle)
 {
@@ -338,6 +338,7 @@ void zbud_destroy_pool(struct zbud_pool *pool)
  * @size:	size in bytes of the desired allocation
  * @gfp:	gfp flags used if the pool needs to grow
  * @handle:	handle of the new allocation
+ * @nid:	preferred node id used if the pool needs to grow
  *
  * This function will attempt to find a free region in the pool large enough to
  * satisfy the allocation request.  A search of the unbuddied lists is
@@ -352,7 +353,7 @@ void zbud_destroy_pool(struct zbud_pool *pool)
  * a new page.
  */
 int zbud_alloc(struct zbud_pool *pool, size_t size, gfp_t gfp,
-			unsigned long *handle)
+			unsigned long *handle, const int nid)
 {
 	int chunks, i, freechunks;
 	struct zbud_header *zhdr = NULL;
@@ -383,7 +384,7 @@ int zbud_alloc(struct zbud_pool *pool, size_t size, gfp_t gfp,
 
 	/* Couldn't find unbuddied zbud page, create new one */
 	spin_unlock(&pool->lock);
-	page = alloc_page(gfp);
+	page = zpool_alloc_page(nid, gfp);
 	if (!page)
 		return -ENOMEM;
 	spin_lock(&pool->lock);
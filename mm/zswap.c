@@ -24,8 +24,10 @@
 #include <linux/rbtree.h>
 #include <linux/swap.h>
 #include <linux/crypto.h>
+#include <linux/scatterlist.h>
 #include <linux/mempool.h>
 #include <linux/zpool.h>
+#include <linux/memcontrol.h>
 
 #include <linux/mm_types.h>
 #include <linux/page-flags.h>
@@ -34,6 +36,8 @@
 #include <linux/pagemap.h>
 #include <linux/workqueue.h>
 
+#include <crypto/acompress.h>
+
 /*********************************
 * statistics
 **********************************/
@@ -53,10 +57,12 @@ static atomic_t zswap_same_filled_pages = ATOMIC_INIT(0);
 
 /* Pool limit was hit (see zswap_max_pool_percent) */
 static u64 zswap_pool_limit_hit;
-/* Pages written back when pool limit was reached */
+/* Pages written back to the swap device by the shrinker */
 static u64 zswap_written_back_pages;
-/* Store failed due to a reclaim failure after pool limit was reached */
+/* Shrinker could not write back enough to get below the limits */
 static u64 zswap_reject_reclaim_fail;
+/* Store failed because the cgroup's zswap.max was reached */
+static u64 zswap_reject_memcg_limit;
 /* Compressed page was too big for the allocator to (optimally) store */
 static u64 zswap_reject_compress_poor;
 /* Store failed because underlying allocator could not get memory */
@@ -68,6 +74,7 @@ static u64 zswap_duplicate_entry;
 
 /* Shrinker work queue */
 static struct workqueue_struct *shrink_wq;
+static struct work_struct zswap_shrink_work;
 /* Pool limit was hit, we need to calm down */
 static bool zswap_pool_reached_full;
 
@@ -113,7 +120,10 @@ module_param_cb(zpool, &zswap_zpool_param_ops, &zswap_zpool_type, 0644);
 static unsigned int zswap_max_pool_percent = 20;
 module_param_named(max_pool_percent, zswap_max_pool_percent, uint, 0644);
 
-/* The threshold for accepting new pages after the max_pool_percent was hit */
+/*
+ * The threshold for accepting new pages after the max_pool_percent was hit.
+ * Above it, the shrinker writes back the coldest entries in the background.
+ */
 static unsigned int zswap_accept_thr_percent = 90; /* of max pool size */
 module_param_named(accept_threshold_percent, zswap_accept_thr_percent,
 		   uint, 0644);
@@ -123,17 +133,48 @@ static bool zswap_same_filled_pages_enabled = true;
 module_param_named(same_filled_pages_enabled, zswap_same_filled_pages_enabled,
 		   bool, 0644);
 
+/*
+ * NUMA node the compressed pool grows on, e.g. a CPU-less far memory node,
+ * instead of the local one.  Loads copy an object out of it into a per-cpu
+ * buffer and decompress that.  Only zsmalloc can use ZONE_MOVABLE memory,
+ * see zswap_pool_node().
+ */
+static int zswap_node = NUMA_NO_NODE;
+static int zswap_node_param_set(const char *, const struct kernel_param *);
+static struct kernel_param_ops zswap_node_param_ops = {
+	.set =		zswap_node_param_set,
+	.get =		param_get_int,
+};
+module_param_cb(node, &zswap_node_param_ops, &zswap_node, 0644);
+
 /*********************************
 * data structures
 **********************************/
 
+/* Pages compressed together, as one batch of requests, by a store */
+#define ZSWAP_BATCH	8
+
+/*
+ * Per-cpu compression state of a pool.  The mutex serializes users of the
+ * requests and buffers, which may sleep waiting for an async implementation,
+ * against each other and against the CPU going offline and freeing them.
+ */
+struct crypto_acomp_ctx {
+	struct crypto_acomp *acomp;
+	struct acomp_req *req[ZSWAP_BATCH];
+	struct crypto_wait wait[ZSWAP_BATCH];
+	struct scatterlist input[ZSWAP_BATCH];
+	struct scatterlist output[ZSWAP_BATCH];
+	u8 *buffer[ZSWAP_BATCH];
+	struct mutex mutex;
+};
+
 struct zswap_pool {
 	struct zpool *zpool;
-	struct crypto_comp * __percpu *tfm;
+	struct crypto_acomp_ctx __percpu *acomp_ctx;
 	struct kref kref;
 	struct list_head list;
 	struct work_struct release_work;
-	struct work_struct shrink_work;
 	struct hlist_node node;
 	char tfm_name[CRYPTO_MAX_ALG_NAME];
 };
@@ -145,7 +186,8 @@ struct zswap_pool {
  * page within zswap.
  *
  * rbnode - links the entry into red-black tree for the appropriate swap type
- * offset - the swap offset for the entry.  Index into the red-black tree.
+ * swpentry - the swap entry of the page.  Its offset indexes the red-black
+ *            tree.
  * refcount - the number of outstanding reference to the entry. This is needed
  *            to protect against premature freeing of the entry by code
  *            concurrent calls to load, invalidate, and writeback.  The lock
@@ -154,15 +196,20 @@ struct zswap_pool {
  *            be held, there is no reason to also make refcount atomic.
  * length - the length in bytes of the compressed page data.  Needed during
  *          decompression. For a same value filled page length is 0.
+ * lru - links the entry into the zswap LRU of its memcg.  Same value filled
+ *       pages take up no pool space and are never on an LRU.
+ * memcg - the memcg the compressed data is charged to, or NULL
  * pool - the zswap_pool the entry's data is in
  * handle - zpool allocation handle that stores the compressed page data
  * value - value of the same-value filled pages which have same content
  */
 struct zswap_entry {
 	struct rb_node rbnode;
-	pgoff_t offset;
+	swp_entry_t swpentry;
 	int refcount;
 	unsigned int length;
+	struct list_head lru;
+	struct mem_cgroup *memcg;
 	struct zswap_pool *pool;
 	union {
 		unsigned long handle;
@@ -170,10 +217,6 @@ struct zswap_entry {
 	};
 };
 
-struct zswap_header {
-	swp_entry_t swpentry;
-};
-
 /*
  * The tree lock in the zswap_tree struct protects a few things:
  * - the rbtree
@@ -186,6 +229,12 @@ struct zswap_tree {
 
 static struct zswap_tree *zswap_trees[MAX_SWAPFILES];
 
+/*
+ * Entries not charged to any memcg.  The lock of an LRU nests inside the
+ * tree lock.
+ */
+static struct zswap_lru zswap_global_lru;
+
 /* RCU-protected iteration */
 static LIST_HEAD(zswap_pools);
 /* protects zswap_pools list modification */
@@ -210,13 +259,31 @@ static bool zswap_has_pool;
 	pr_debug("%s pool %s/%s\n", msg, (p)->tfm_name,		\
 		 zpool_get_type((p)->zpool))
 
-static int zswap_writeback_entry(struct zpool *pool, unsigned long handle);
 static int zswap_pool_get(struct zswap_pool *pool);
 static void zswap_pool_put(struct zswap_pool *pool);
 
-static const struct zpool_ops zswap_zpool_ops = {
-	.evict = zswap_writeback_entry
-};
+static int zswap_pool_node(struct zswap_pool *pool)
+{
+	int nid = READ_ONCE(zswap_node);
+
+	if (nid == NUMA_NO_NODE)
+		return nid;
+	/* dax/kmem nodes come and go, fall back to the local node */
+	if (!node_state(nid, N_MEMORY))
+		return NUMA_NO_NODE;
+	/*
+	 * Only zsmalloc allocates __GFP_MOVABLE.  zbud and z3fold can't use
+	 * a node that only has ZONE_MOVABLE, which is how dax/kmem usually
+	 * onlines far memory, and would just fall back to another node.
+	 */
+	if (!zpool_malloc_support_movable(pool->zpool) &&
+	    !node_state(nid, N_NORMAL_MEMORY)) {
+		pr_warn_once("node %d only has movable memory, which %s can't use\n",
+			     nid, zpool_get_type(pool->zpool));
+		return NUMA_NO_NODE;
+	}
+	return nid;
+}
 
 static bool zswap_is_full(void)
 {
@@ -270,6 +337,8 @@ static struct zswap_entry *zswap_entry_cache_alloc(gfp_t gfp)
 		return NULL;
 	entry->refcount = 1;
 	RB_CLEAR_NODE(&entry->rbnode);
+	INIT_LIST_HEAD(&entry->lru);
+	entry->memcg = NULL;
 	return entry;
 }
 
@@ -288,9 +357,9 @@ static struct zswap_entry *zswap_rb_search(struct rb_root *root, pgoff_t offset)
 
 	while (node) {
 		entry = rb_entry(node, struct zswap_entry, rbnode);
-		if (entry->offset > offset)
+		if (swp_offset(entry->swpentry) > offset)
 			node = node->rb_left;
-		else if (entry->offset < offset)
+		else if (swp_offset(entry->swpentry) < offset)
 			node = node->rb_right;
 		else
 			return entry;
@@ -307,13 +376,14 @@ static int zswap_rb_insert(struct rb_root *root, struct zswap_entry *entry,
 {
 	struct rb_node **link = &root->rb_node, *parent = NULL;
 	struct zswap_entry *myentry;
+	pgoff_t offset = swp_offset(entry->swpentry);
 
 	while (*link) {
 		parent = *link;
 		myentry = rb_entry(parent, struct zswap_entry, rbnode);
-		if (myentry->offset > entry->offset)
+		if (swp_offset(myentry->swpentry) > offset)
 			link = &(*link)->rb_left;
-		else if (myentry->offset < entry->offset)
+		else if (swp_offset(myentry->swpentry) < offset)
 			link = &(*link)->rb_right;
 		else {
 			*dupentry = myentry;
@@ -333,6 +403,34 @@ static void zswap_rb_erase(struct rb_root *root, struct zswap_entry *entry)
 	}
 }
 
+/*********************************
+* lru functions
+**********************************/
+static struct zswap_lru *zswap_lru_of(struct mem_cgroup *memcg)
+{
+	return memcg ? mem_cgroup_zswap_lru(memcg) : &zswap_global_lru;
+}
+
+/* caller must hold the tree lock */
+static void zswap_lru_add(struct zswap_entry *entry)
+{
+	struct zswap_lru *lru = zswap_lru_of(entry->memcg);
+
+	spin_lock(&lru->lock);
+	list_add(&entry->lru, &lru->list);
+	spin_unlock(&lru->lock);
+}
+
+/* caller must hold the tree lock */
+static void zswap_lru_del(struct zswap_entry *entry)
+{
+	struct zswap_lru *lru = zswap_lru_of(entry->memcg);
+
+	spin_lock(&lru->lock);
+	list_del_init(&entry->lru);
+	spin_unlock(&lru->lock);
+}
+
 /*
  * Carries out the common pattern of freeing and entry's zpool allocation,
  * freeing the entry itself, and decrementing the number of stored pages.
@@ -342,6 +440,9 @@ static void zswap_free_entry(struct zswap_entry *entry)
 	if (!entry->length)
 		atomic_dec(&zswap_same_filled_pages);
 	else {
+		zswap_lru_del(entry);
+		mem_cgroup_uncharge_zswap(entry->memcg, entry->length);
+		mem_cgroup_put(entry->memcg);
 		zpool_free(entry->pool->zpool, entry->handle);
 		zswap_pool_put(entry->pool);
 	}
@@ -387,59 +488,103 @@ static struct zswap_entry *zswap_entry_find_get(struct rb_root *root,
 /*********************************
 * per-cpu code
 **********************************/
-static DEFINE_PER_CPU(u8 *, zswap_dstmem);
-
-static int zswap_dstmem_prepare(unsigned int cpu)
-{
-	u8 *dst;
-
-	dst = kmalloc_node(PAGE_SIZE * 2, GFP_KERNEL, cpu_to_node(cpu));
-	if (!dst)
-		return -ENOMEM;
-
-	per_cpu(zswap_dstmem, cpu) = dst;
-	return 0;
-}
-
-static int zswap_dstmem_dead(unsigned int cpu)
+static int zswap_cpu_comp_dead(unsigned int cpu, struct hlist_node *node)
 {
-	u8 *dst;
-
-	dst = per_cpu(zswap_dstmem, cpu);
-	kfree(dst);
-	per_cpu(zswap_dstmem, cpu) = NULL;
-
+	struct zswap_pool *pool = hlist_entry(node, struct zswap_pool, node);
+	struct crypto_acomp_ctx *acomp_ctx = per_cpu_ptr(pool->acomp_ctx, cpu);
+	struct acomp_req *req[ZSWAP_BATCH];
+	u8 *buffer[ZSWAP_BATCH];
+	struct crypto_acomp *acomp;
+	int i;
+
+	/* take it away from users under the mutex, free it outside */
+	mutex_lock(&acomp_ctx->mutex);
+	for (i = 0; i < ZSWAP_BATCH; i++) {
+		req[i] = acomp_ctx->req[i];
+		acomp_ctx->req[i] = NULL;
+		buffer[i] = acomp_ctx->buffer[i];
+		acomp_ctx->buffer[i] = NULL;
+	}
+	acomp = acomp_ctx->acomp;
+	acomp_ctx->acomp = NULL;
+	mutex_unlock(&acomp_ctx->mutex);
+
+	for (i = 0; i < ZSWAP_BATCH; i++) {
+		if (req[i])
+			acomp_request_free(req[i]);
+		kfree(buffer[i]);
+	}
+	if (!IS_ERR_OR_NULL(acomp))
+		crypto_free_acomp(acomp);
 	return 0;
 }
 
 static int zswap_cpu_comp_prepare(unsigned int cpu, struct hlist_node *node)
 {
 	struct zswap_pool *pool = hlist_entry(node, struct zswap_pool, node);
-	struct crypto_comp *tfm;
+	struct crypto_acomp_ctx *acomp_ctx = per_cpu_ptr(pool->acomp_ctx, cpu);
+	struct crypto_acomp *acomp;
+	struct acomp_req *req;
+	int i;
 
-	if (WARN_ON(*per_cpu_ptr(pool->tfm, cpu)))
+	if (WARN_ON(acomp_ctx->acomp))
 		return 0;
 
-	tfm = crypto_alloc_comp(pool->tfm_name, 0, 0);
-	if (IS_ERR_OR_NULL(tfm)) {
-		pr_err("could not alloc crypto comp %s : %ld\n",
-		       pool->tfm_name, PTR_ERR(tfm));
-		return -ENOMEM;
+	acomp = crypto_alloc_acomp(pool->tfm_name, 0, 0);
+	if (IS_ERR(acomp)) {
+		pr_err("could not alloc crypto acomp %s : %ld\n",
+		       pool->tfm_name, PTR_ERR(acomp));
+		return PTR_ERR(acomp);
 	}
-	*per_cpu_ptr(pool->tfm, cpu) = tfm;
+	mutex_lock(&acomp_ctx->mutex);
+	acomp_ctx->acomp = acomp;
+
+	for (i = 0; i < ZSWAP_BATCH; i++) {
+		/* compressed data can be larger than the page */
+		acomp_ctx->buffer[i] = kmalloc_node(PAGE_SIZE * 2, GFP_KERNEL,
+						    cpu_to_node(cpu));
+		if (!acomp_ctx->buffer[i])
+			goto fail;
+
+		req = acomp_request_alloc(acomp);
+		if (!req) {
+			pr_err("could not alloc crypto acomp_request %s\n",
+			       pool->tfm_name);
+			goto fail;
+		}
+		acomp_ctx->req[i] = req;
+
+		crypto_init_wait(&acomp_ctx->wait[i]);
+		acomp_request_set_callback(req, CRYPTO_TFM_REQ_MAY_BACKLOG,
+					   crypto_req_done,
+					   &acomp_ctx->wait[i]);
+	}
+	mutex_unlock(&acomp_ctx->mutex);
 	return 0;
+
+fail:
+	mutex_unlock(&acomp_ctx->mutex);
+	zswap_cpu_comp_dead(cpu, node);
+	return -ENOMEM;
 }
 
-static int zswap_cpu_comp_dead(unsigned int cpu, struct hlist_node *node)
+/*
+ * Locks the acomp_ctx of the current CPU.  The task may be migrated before
+ * it gets the mutex, and the CPU it came from may go offline and free its
+ * ctx in the meantime.  Nobody else uses a dead CPU's ctx, so just retry on
+ * the CPU the task ended up on.
+ */
+static struct crypto_acomp_ctx *zswap_acomp_ctx_lock(struct zswap_pool *pool)
 {
-	struct zswap_pool *pool = hlist_entry(node, struct zswap_pool, node);
-	struct crypto_comp *tfm;
-
-	tfm = *per_cpu_ptr(pool->tfm, cpu);
-	if (!IS_ERR_OR_NULL(tfm))
-		crypto_free_comp(tfm);
-	*per_cpu_ptr(pool->tfm, cpu) = NULL;
-	return 0;
+	struct crypto_acomp_ctx *acomp_ctx;
+
+	for (;;) {
+		acomp_ctx = raw_cpu_ptr(pool->acomp_ctx);
+		mutex_lock(&acomp_ctx->mutex);
+		if (likely(acomp_ctx->req[0]))
+			return acomp_ctx;
+		mutex_unlock(&acomp_ctx->mutex);
+	}
 }
 
 /*********************************
@@ -479,24 +624,6 @@ static struct zswap_pool *zswap_pool_current_get(void)
 	return pool;
 }
 
-static struct zswap_pool *zswap_pool_last_get(void)
-{
-	struct zswap_pool *pool, *last = NULL;
-
-	rcu_read_lock();
-
-	list_for_each_entry_rcu(pool, &zswap_pools, list)
-		last = pool;
-	WARN_ONCE(!last && zswap_has_pool,
-		  "%s: no page storage pool!\n", __func__);
-	if (!zswap_pool_get(last))
-		last = NULL;
-
-	rcu_read_unlock();
-
-	return last;
-}
-
 /* type and compressor must be null-terminated */
 static struct zswap_pool *zswap_pool_find_get(char *type, char *compressor)
 {
@@ -518,22 +645,12 @@ static struct zswap_pool *zswap_pool_find_get(char *type, char *compressor)
 	return NULL;
 }
 
-static void shrink_worker(struct work_struct *w)
-{
-	struct zswap_pool *pool = container_of(w, typeof(*pool),
-						shrink_work);
-
-	if (zpool_shrink(pool->zpool, 1, NULL))
-		zswap_reject_reclaim_fail++;
-	zswap_pool_put(pool);
-}
-
 static struct zswap_pool *zswap_pool_create(char *type, char *compressor)
 {
 	struct zswap_pool *pool;
 	char name[38]; /* 'zswap' + 32 char (max) num + \0 */
 	gfp_t gfp = __GFP_NORETRY | __GFP_NOWARN | __GFP_KSWAPD_RECLAIM;
-	int ret;
+	int ret, cpu;
 
 	if (!zswap_has_pool) {
 		/* if either are unset, pool initialization failed, and we
@@ -553,7 +670,7 @@ static struct zswap_pool *zswap_pool_create(char *type, char *compressor)
 	/* unique name for each pool specifically required by zsmalloc */
 	snprintf(name, 38, "zswap%x", atomic_inc_return(&zswap_pools_count));
 
-	pool->zpool = zpool_create_pool(type, name, gfp, &zswap_zpool_ops);
+	pool->zpool = zpool_create_pool(type, name, gfp, NULL);
 	if (!pool->zpool) {
 		pr_err("%s zpool not available\n", type);
 		goto error;
@@ -561,11 +678,13 @@ static struct zswap_pool *zswap_pool_create(char *type, char *compressor)
 	pr_debug("using %s zpool\n", zpool_get_type(pool->zpool));
 
 	strlcpy(pool->tfm_name, compressor, sizeof(pool->tfm_name));
-	pool->tfm = alloc_percpu(struct crypto_comp *);
-	if (!pool->tfm) {
+	pool->acomp_ctx = alloc_percpu(struct crypto_acomp_ctx);
+	if (!pool->acomp_ctx) {
 		pr_err("percpu alloc failed\n");
 		goto error;
 	}
+	for_each_possible_cpu(cpu)
+		mutex_init(&per_cpu_ptr(pool->acomp_ctx, cpu)->mutex);
 
 	ret = cpuhp_state_add_instance(CPUHP_MM_ZSWP_POOL_PREPARE,
 				       &pool->node);
@@ -578,14 +697,13 @@ static struct zswap_pool *zswap_pool_create(char *type, char *compressor)
 	 */
 	kref_init(&pool->kref);
 	INIT_LIST_HEAD(&pool->list);
-	INIT_WORK(&pool->shrink_work, shrink_worker);
 
 	zswap_pool_debug("created", pool);
 
 	return pool;
 
 error:
-	free_percpu(pool->tfm);
+	free_percpu(pool->acomp_ctx);
 	if (pool->zpool)
 		zpool_destroy_pool(pool->zpool);
 	kfree(pool);
@@ -596,14 +714,14 @@ static __init struct zswap_pool *__zswap_pool_create_fallback(void)
 {
 	bool has_comp, has_zpool;
 
-	has_comp = crypto_has_comp(zswap_compressor, 0, 0);
+	has_comp = crypto_has_acomp(zswap_compressor, 0, 0);
 	if (!has_comp && strcmp(zswap_compressor,
 				CONFIG_ZSWAP_COMPRESSOR_DEFAULT)) {
 		pr_err("compressor %s not available, using default %s\n",
 		       zswap_compressor, CONFIG_ZSWAP_COMPRESSOR_DEFAULT);
 		param_free_charp(&zswap_compressor);
 		zswap_compressor = CONFIG_ZSWAP_COMPRESSOR_DEFAULT;
-		has_comp = crypto_has_comp(zswap_compressor, 0, 0);
+		has_comp = crypto_has_acomp(zswap_compressor, 0, 0);
 	}
 	if (!has_comp) {
 		pr_err("default compressor %s not available\n",
@@ -639,7 +757,7 @@ static void zswap_pool_destroy(struct zswap_pool *pool)
 	zswap_pool_debug("destroying", pool);
 
 	cpuhp_state_remove_instance(CPUHP_MM_ZSWP_POOL_PREPARE, &pool->node);
-	free_percpu(pool->tfm);
+	free_percpu(pool->acomp_ctx);
 	zpool_destroy_pool(pool->zpool);
 	kfree(pool);
 }
@@ -723,7 +841,7 @@ static int __zswap_param_set(const char *val, const struct kernel_param *kp,
 		}
 		type = s;
 	} else if (!compressor) {
-		if (!crypto_has_comp(s, 0, 0)) {
+		if (!crypto_has_acomp(s, 0, 0)) {
 			pr_err("compressor %s not available\n", s);
 			return -ENOENT;
 		}
@@ -774,7 +892,7 @@ static int __zswap_param_set(const char *val, const struct kernel_param *kp,
 		 * failed, maybe both compressor and zpool params were bad.
 		 * Allow changing this param, so pool creation will succeed
 		 * when the other param is changed. We already verified this
-		 * param is ok in the zpool_has_pool() or crypto_has_comp()
+		 * param is ok in the zpool_has_pool() or crypto_has_acomp()
 		 * checks above.
 		 */
 		ret = param_set_charp(s, kp);
@@ -816,6 +934,23 @@ static int zswap_enabled_param_set(const char *val,
 	return param_set_bool(val, kp);
 }
 
+static int zswap_node_param_set(const char *val,
+				const struct kernel_param *kp)
+{
+	int nid, ret;
+
+	ret = kstrtoint(val, 0, &nid);
+	if (ret)
+		return ret;
+
+	/* the node may not be online yet, this is checked on allocation */
+	if (nid != NUMA_NO_NODE && (nid < 0 || nid >= MAX_NUMNODES))
+		return -EINVAL;
+
+	WRITE_ONCE(zswap_node, nid);
+	return 0;
+}
+
 /*********************************
 * writeback code
 **********************************/
@@ -856,6 +991,35 @@ static int zswap_get_swap_cache_page(swp_entry_t entry,
 	return ZSWAP_SWAPCACHE_EXIST;
 }
 
+static void zswap_decompress(struct zswap_entry *entry, struct page *page)
+{
+	struct crypto_acomp_ctx *acomp_ctx;
+	struct acomp_req *req;
+	u8 *src;
+	int ret;
+
+	acomp_ctx = zswap_acomp_ctx_lock(entry->pool);
+	req = acomp_ctx->req[0];
+
+	/* zpool mappings may not sleep, decompress from a copy */
+	src = zpool_map_handle(entry->pool->zpool, entry->handle, ZPOOL_MM_RO);
+	memcpy(acomp_ctx->buffer[0], src, entry->length);
+	zpool_unmap_handle(entry->pool->zpool, entry->handle);
+
+	sg_init_one(&acomp_ctx->input[0], acomp_ctx->buffer[0], entry->length);
+	sg_init_table(&acomp_ctx->output[0], 1);
+	sg_set_page(&acomp_ctx->output[0], page, PAGE_SIZE, 0);
+	acomp_request_set_params(req, &acomp_ctx->input[0],
+				 &acomp_ctx->output[0], entry->length,
+				 PAGE_SIZE);
+	ret = crypto_wait_req(crypto_acomp_decompress(req),
+			      &acomp_ctx->wait[0]);
+	BUG_ON(ret);
+	BUG_ON(req->dlen != PAGE_SIZE);
+
+	mutex_unlock(&acomp_ctx->mutex);
+}
+
 /*
  * Attempts to free an entry by adding a page to the swap cache,
  * decompressing the entry data into the page, and issuing a
@@ -867,41 +1031,19 @@ static int zswap_get_swap_cache_page(swp_entry_t entry,
  * in the first place.  After the page has been decompressed into
  * the swap cache, the compressed version stored by zswap can be
  * freed.
+ *
+ * The caller holds a reference on the entry, which is dropped here.
  */
-static int zswap_writeback_entry(struct zpool *pool, unsigned long handle)
+static int zswap_writeback_entry(struct zswap_tree *tree,
+				 struct zswap_entry *entry)
 {
-	struct zswap_header *zhdr;
-	swp_entry_t swpentry;
-	struct zswap_tree *tree;
-	pgoff_t offset;
-	struct zswap_entry *entry;
+	swp_entry_t swpentry = entry->swpentry;
 	struct page *page;
-	struct crypto_comp *tfm;
-	u8 *src, *dst;
-	unsigned int dlen;
 	int ret;
 	struct writeback_control wbc = {
 		.sync_mode = WB_SYNC_NONE,
 	};
 
-	/* extract swpentry from data */
-	zhdr = zpool_map_handle(pool, handle, ZPOOL_MM_RO);
-	swpentry = zhdr->swpentry; /* here */
-	tree = zswap_trees[swp_type(swpentry)];
-	offset = swp_offset(swpentry);
-
-	/* find and ref zswap entry */
-	spin_lock(&tree->lock);
-	entry = zswap_entry_find_get(&tree->rbroot, offset);
-	if (!entry) {
-		/* entry was invalidated */
-		spin_unlock(&tree->lock);
-		zpool_unmap_handle(pool, handle);
-		return 0;
-	}
-	spin_unlock(&tree->lock);
-	BUG_ON(offset != entry->offset);
-
 	/* try to allocate swap cache page */
 	switch (zswap_get_swap_cache_page(swpentry, &page)) {
 	case ZSWAP_SWAPCACHE_FAIL: /* no memory or invalidate happened */
@@ -915,17 +1057,7 @@ static int zswap_writeback_entry(struct zpool *pool, unsigned long handle)
 		goto fail;
 
 	case ZSWAP_SWAPCACHE_NEW: /* page is locked */
-		/* decompress */
-		dlen = PAGE_SIZE;
-		src = (u8 *)zhdr + sizeof(struct zswap_header);
-		dst = kmap_atomic(page);
-		tfm = *get_cpu_ptr(entry->pool->tfm);
-		ret = crypto_comp_decompress(tfm, src, entry->length,
-					     dst, &dlen);
-		put_cpu_ptr(entry->pool->tfm);
-		kunmap_atomic(dst);
-		BUG_ON(ret);
-		BUG_ON(dlen != PAGE_SIZE);
+		zswap_decompress(entry, page);
 
 		/* page is up to date */
 		SetPageUptodate(page);
@@ -950,11 +1082,11 @@ static int zswap_writeback_entry(struct zpool *pool, unsigned long handle)
 	*     because invalidate happened during writeback
 	*  search the tree and free the entry if find entry
 	*/
-	if (entry == zswap_rb_search(&tree->rbroot, offset))
+	if (entry == zswap_rb_search(&tree->rbroot, swp_offset(swpentry)))
 		zswap_entry_put(tree, entry);
 	spin_unlock(&tree->lock);
 
-	goto end;
+	return 0;
 
 	/*
 	* if we get here due to ZSWAP_SWAPCACHE_EXIST
@@ -968,11 +1100,103 @@ static int zswap_writeback_entry(struct zpool *pool, unsigned long handle)
 	zswap_entry_put(tree, entry);
 	spin_unlock(&tree->lock);
 
-end:
-	zpool_unmap_handle(pool, handle);
 	return ret;
 }
 
+/*
+ * Writes back the coldest entry of @lru.  Returns -ENOENT if the LRU is
+ * empty, and -EAGAIN if the entry is being invalidated or its tree is busy.
+ */
+static int zswap_shrink_lru(struct zswap_lru *lru)
+{
+	struct zswap_entry *entry;
+	struct zswap_tree *tree;
+
+	spin_lock(&lru->lock);
+	if (list_empty(&lru->list)) {
+		spin_unlock(&lru->lock);
+		return -ENOENT;
+	}
+	entry = list_last_entry(&lru->list, struct zswap_entry, lru);
+	/*
+	 * Rotate it, so that an entry which can't be written back right now
+	 * isn't picked again on the next round.  Entries are only freed off
+	 * the LRU, so it stays valid for as long as the lru lock is held.
+	 */
+	list_move(&entry->lru, &lru->list);
+	tree = zswap_trees[swp_type(entry->swpentry)];
+
+	/* the tree lock nests outside the lru lock */
+	if (!spin_trylock(&tree->lock)) {
+		spin_unlock(&lru->lock);
+		return -EAGAIN;
+	}
+	spin_unlock(&lru->lock);
+
+	/* invalidated, and only still around for a load or writeback */
+	if (RB_EMPTY_NODE(&entry->rbnode)) {
+		spin_unlock(&tree->lock);
+		return -EAGAIN;
+	}
+	zswap_entry_get(entry);
+	spin_unlock(&tree->lock);
+
+	return zswap_writeback_entry(tree, entry);
+}
+
+/* Entries written back from one LRU before moving on to the next */
+#define ZSWAP_SHRINK_BATCH	16
+
+static bool zswap_should_shrink(struct mem_cgroup *memcg)
+{
+	return !zswap_can_accept() || !mem_cgroup_may_zswap(memcg);
+}
+
+/* Returns the number of entries of @memcg that were written back. */
+static int zswap_shrink_memcg(struct mem_cgroup *memcg)
+{
+	struct zswap_lru *lru = zswap_lru_of(memcg);
+	int nr_scan = ZSWAP_SHRINK_BATCH;
+	int nr_written = 0;
+	int ret;
+
+	while (nr_scan-- && zswap_should_shrink(memcg)) {
+		ret = zswap_shrink_lru(lru);
+		if (ret == -ENOENT)
+			break;
+		if (!ret)
+			nr_written++;
+	}
+	return nr_written;
+}
+
+/*
+ * Writes back the coldest entries until the pool is below the accept
+ * threshold and every memcg is within its zswap.max.  Cgroups are walked
+ * round-robin, a batch at a time, so one cgroup's cold data doesn't pay
+ * for another's.
+ */
+static void shrink_worker(struct work_struct *w)
+{
+	struct mem_cgroup *memcg;
+	int nr_written;
+
+	do {
+		nr_written = 0;
+		memcg = mem_cgroup_iter(NULL, NULL, NULL);
+		do {
+			nr_written += zswap_shrink_memcg(memcg);
+			cond_resched();
+		} while ((memcg = mem_cgroup_iter(NULL, memcg, NULL)));
+		/* with memcg disabled, the walk above was the global LRU */
+		if (!mem_cgroup_disabled())
+			nr_written += zswap_shrink_memcg(NULL);
+	} while (nr_written);
+
+	if (!zswap_can_accept())
+		zswap_reject_reclaim_fail++;
+}
+
 static int zswap_is_page_same_filled(void *ptr, unsigned long *value)
 {
 	unsigned int pos;
@@ -998,26 +1222,165 @@ static void zswap_fill_page(void *ptr, unsigned long value)
 /*********************************
 * frontswap hooks
 **********************************/
-/* attempts to compress and store an single page */
-static int zswap_frontswap_store(unsigned type, pgoff_t offset,
-				struct page *page)
+static void zswap_frontswap_invalidate_page(unsigned type, pgoff_t offset);
+
+/*
+ * Compresses and stores @nr (at most ZSWAP_BATCH) consecutive pages.  All
+ * compression requests are submitted before waiting on any of them, so an
+ * asynchronous implementation can work through the batch in parallel.
+ */
+static int zswap_store_batch(struct zswap_tree *tree, unsigned type,
+			     pgoff_t offset, struct page *page, int nr,
+			     struct zswap_pool *pool)
 {
-	struct zswap_tree *tree = zswap_trees[type];
+	struct zswap_entry *entries[ZSWAP_BATCH] = { NULL };
+	int errors[ZSWAP_BATCH];
+	unsigned long same_filled = 0;
+	struct crypto_acomp_ctx *acomp_ctx;
 	struct zswap_entry *entry, *dupentry;
-	struct crypto_comp *tfm;
-	int ret;
-	unsigned int hlen, dlen = PAGE_SIZE;
 	unsigned long handle, value;
+	unsigned int dlen;
 	char *buf;
-	u8 *src, *dst;
-	struct zswap_header zhdr = { .swpentry = swp_entry(type, offset) };
+	u8 *src;
 	gfp_t gfp;
+	int nid = zswap_pool_node(pool);
+	int i, ret = 0;
+
+	/* allocate entries */
+	for (i = 0; i < nr; i++) {
+		entry = zswap_entry_cache_alloc(GFP_KERNEL);
+		if (!entry) {
+			zswap_reject_kmemcache_fail++;
+			ret = -ENOMEM;
+			goto freeentries;
+		}
+		entry->swpentry = swp_entry(type, offset + i);
+		entry->length = 0;
+		entries[i] = entry;
+
+		if (zswap_same_filled_pages_enabled) {
+			src = kmap_atomic(page + i);
+			if (zswap_is_page_same_filled(src, &value)) {
+				entry->value = value;
+				same_filled |= BIT(i);
+			}
+			kunmap_atomic(src);
+		}
+	}
 
-	/* THP isn't supported */
-	if (PageTransHuge(page)) {
-		ret = -EINVAL;
-		goto reject;
+	acomp_ctx = zswap_acomp_ctx_lock(pool);
+
+	/* compress */
+	for (i = 0; i < nr; i++) {
+		if (same_filled & BIT(i))
+			continue;
+		sg_init_table(&acomp_ctx->input[i], 1);
+		sg_set_page(&acomp_ctx->input[i], page + i, PAGE_SIZE, 0);
+		sg_init_one(&acomp_ctx->output[i], acomp_ctx->buffer[i],
+			    PAGE_SIZE * 2);
+		acomp_request_set_params(acomp_ctx->req[i],
+					 &acomp_ctx->input[i],
+					 &acomp_ctx->output[i],
+					 PAGE_SIZE, PAGE_SIZE * 2);
+		errors[i] = crypto_acomp_compress(acomp_ctx->req[i]);
+	}
+
+	/* store */
+	gfp = __GFP_NORETRY | __GFP_NOWARN | __GFP_KSWAPD_RECLAIM;
+	if (zpool_malloc_support_movable(pool->zpool))
+		gfp |= __GFP_HIGHMEM | __GFP_MOVABLE;
+	for (i = 0; i < nr; i++) {
+		if (same_filled & BIT(i))
+			continue;
+		/* every request must complete, even after a failure */
+		errors[i] = crypto_wait_req(errors[i], &acomp_ctx->wait[i]);
+		if (ret)
+			continue;
+		if (errors[i]) {
+			ret = -EINVAL;
+			continue;
+		}
+
+		dlen = acomp_ctx->req[i]->dlen;
+		ret = zpool_malloc(pool->zpool, dlen, gfp, &handle, nid);
+		if (ret == -ENOSPC) {
+			zswap_reject_compress_poor++;
+			continue;
+		}
+		if (ret) {
+			zswap_reject_alloc_fail++;
+			continue;
+		}
+		buf = zpool_map_handle(pool->zpool, handle, ZPOOL_MM_RW);
+		memcpy(buf, acomp_ctx->buffer[i], dlen);
+		zpool_unmap_handle(pool->zpool, handle);
+
+		/* populate entry; the caller holds a pool reference */
+		entry = entries[i];
+		kref_get(&pool->kref);
+		entry->pool = pool;
+		entry->memcg = mem_cgroup_zswap_get(compound_head(page));
+		entry->handle = handle;
+		entry->length = dlen;
+		mem_cgroup_charge_zswap(entry->memcg, dlen);
+	}
+
+	mutex_unlock(&acomp_ctx->mutex);
+	if (ret)
+		goto freeentries;
+
+	/* map */
+	spin_lock(&tree->lock);
+	for (i = 0; i < nr; i++) {
+		entry = entries[i];
+		do {
+			ret = zswap_rb_insert(&tree->rbroot, entry, &dupentry);
+			if (ret == -EEXIST) {
+				zswap_duplicate_entry++;
+				/* remove from rbtree */
+				zswap_rb_erase(&tree->rbroot, dupentry);
+				zswap_entry_put(tree, dupentry);
+			}
+		} while (ret == -EEXIST);
+		if (entry->length)
+			zswap_lru_add(entry);
+		else
+			atomic_inc(&zswap_same_filled_pages);
+	}
+	spin_unlock(&tree->lock);
+
+	/* update stats */
+	atomic_add(nr, &zswap_stored_pages);
+	zswap_update_total_size();
+
+	return 0;
+
+freeentries:
+	for (i = 0; i < nr && entries[i]; i++) {
+		entry = entries[i];
+		if (entry->length) {
+			mem_cgroup_uncharge_zswap(entry->memcg, entry->length);
+			mem_cgroup_put(entry->memcg);
+			zpool_free(pool->zpool, entry->handle);
+			zswap_pool_put(pool);
+		}
+		zswap_entry_cache_free(entry);
 	}
+	return ret;
+}
+
+/*
+ * attempts to compress and store a single page, or all subpages of a THP.
+ * A THP is either stored as a whole or not at all.
+ */
+static int zswap_frontswap_store(unsigned type, pgoff_t offset,
+				struct page *page)
+{
+	struct zswap_tree *tree = zswap_trees[type];
+	struct mem_cgroup *memcg;
+	struct zswap_pool *pool;
+	int i, nr = hpage_nr_pages(page);
+	int ret;
 
 	if (!zswap_enabled || !tree) {
 		ret = -ENODEV;
@@ -1026,13 +1389,9 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 
 	/* reclaim space if needed */
 	if (zswap_is_full()) {
-		struct zswap_pool *pool;
-
 		zswap_pool_limit_hit++;
 		zswap_pool_reached_full = true;
-		pool = zswap_pool_last_get();
-		if (pool)
-			queue_work(shrink_wq, &pool->shrink_work);
+		queue_work(shrink_wq, &zswap_shrink_work);
 		ret = -ENOMEM;
 		goto reject;
 	}
@@ -1045,96 +1404,44 @@ static int zswap_frontswap_store(unsigned type, pgoff_t offset,
 			zswap_pool_reached_full = false;
 	}
 
-	/* allocate entry */
-	entry = zswap_entry_cache_alloc(GFP_KERNEL);
-	if (!entry) {
-		zswap_reject_kmemcache_fail++;
+	memcg = mem_cgroup_zswap_get(page);
+	if (!mem_cgroup_may_zswap(memcg)) {
+		mem_cgroup_put(memcg);
+		zswap_reject_memcg_limit++;
+		queue_work(shrink_wq, &zswap_shrink_work);
 		ret = -ENOMEM;
 		goto reject;
 	}
+	mem_cgroup_put(memcg);
 
-	if (zswap_same_filled_pages_enabled) {
-		src = kmap_atomic(page);
-		if (zswap_is_page_same_filled(src, &value)) {
-			kunmap_atomic(src);
-			entry->offset = offset;
-			entry->length = 0;
-			entry->value = value;
-			atomic_inc(&zswap_same_filled_pages);
-			goto insert_entry;
-		}
-		kunmap_atomic(src);
-	}
-
-	/* if entry is successfully added, it keeps the reference */
-	entry->pool = zswap_pool_current_get();
-	if (!entry->pool) {
+	/* entries take their own references */
+	pool = zswap_pool_current_get();
+	if (!pool) {
 		ret = -EINVAL;
-		goto freepage;
+		goto reject;
 	}
 
-	/* compress */
-	dst = get_cpu_var(zswap_dstmem);
-	tfm = *get_cpu_ptr(entry->pool->tfm);
-	src = kmap_atomic(page);
-	ret = crypto_comp_compress(tfm, src, PAGE_SIZE, dst, &dlen);
-	kunmap_atomic(src);
-	put_cpu_ptr(entry->pool->tfm);
-	if (ret) {
-		ret = -EINVAL;
-		goto put_dstmem;
+	for (i = 0; i < nr; i += ZSWAP_BATCH) {
+		ret = zswap_store_batch(tree, type, offset + i, page + i,
+					min_t(int, nr - i, ZSWAP_BATCH), pool);
+		if (ret)
+			break;
 	}
+	zswap_pool_put(pool);
 
-	/* store */
-	hlen = zpool_evictable(entry->pool->zpool) ? sizeof(zhdr) : 0;
-	gfp = __GFP_NORETRY | __GFP_NOWARN | __GFP_KSWAPD_RECLAIM;
-	if (zpool_malloc_support_movable(entry->pool->zpool))
-		gfp |= __GFP_HIGHMEM | __GFP_MOVABLE;
-	ret = zpool_malloc(entry->pool->zpool, hlen + dlen, gfp, &handle);
-	if (ret == -ENOSPC) {
-		zswap_reject_compress_poor++;
-		goto put_dstmem;
-	}
 	if (ret) {
-		zswap_reject_alloc_fail++;
-		goto put_dstmem;
+		/* drop the part of the THP that did get stored */
+		while (i > 0)
+			zswap_frontswap_invalidate_page(type, offset + --i);
+		goto reject;
 	}
-	buf = zpool_map_handle(entry->pool->zpool, handle, ZPOOL_MM_RW);
-	memcpy(buf, &zhdr, hlen);
-	memcpy(buf + hlen, dst, dlen);
-	zpool_unmap_handle(entry->pool->zpool, handle);
-	put_cpu_var(zswap_dstmem);
-
-	/* populate entry */
-	entry->offset = offset;
-	entry->handle = handle;
-	entry->length = dlen;
-
-insert_entry:
-	/* map */
-	spin_lock(&tree->lock);
-	do {
-		ret = zswap_rb_insert(&tree->rbroot, entry, &dupentry);
-		if (ret == -EEXIST) {
-			zswap_duplicate_entry++;
-			/* remove from rbtree */
-			zswap_rb_erase(&tree->rbroot, dupentry);
-			zswap_entry_put(tree, dupentry);
-		}
-	} while (ret == -EEXIST);
-	spin_unlock(&tree->lock);
 
-	/* update stats */
-	atomic_inc(&zswap_stored_pages);
-	zswap_update_total_size();
+	/* write back the coldest entries before the pool fills up */
+	if (!zswap_can_accept())
+		queue_work(shrink_wq, &zswap_shrink_work);
 
 	return 0;
 
-put_dstmem:
-	put_cpu_var(zswap_dstmem);
-	zswap_pool_put(entry->pool);
-freepage:
-	zswap_entry_cache_free(entry);
 reject:
 	return ret;
 }
@@ -1148,10 +1455,7 @@ static int zswap_frontswap_load(unsigned type, pgoff_t offset,
 {
 	struct zswap_tree *tree = zswap_trees[type];
 	struct zswap_entry *entry;
-	struct crypto_comp *tfm;
-	u8 *src, *dst;
-	unsigned int dlen;
-	int ret;
+	u8 *dst;
 
 	/* find */
 	spin_lock(&tree->lock);
@@ -1170,18 +1474,7 @@ static int zswap_frontswap_load(unsigned type, pgoff_t offset,
 		goto freeentry;
 	}
 
-	/* decompress */
-	dlen = PAGE_SIZE;
-	src = zpool_map_handle(entry->pool->zpool, entry->handle, ZPOOL_MM_RO);
-	if (zpool_evictable(entry->pool->zpool))
-		src += sizeof(struct zswap_header);
-	dst = kmap_atomic(page);
-	tfm = *get_cpu_ptr(entry->pool->tfm);
-	ret = crypto_comp_decompress(tfm, src, entry->length, dst, &dlen);
-	put_cpu_ptr(entry->pool->tfm);
-	kunmap_atomic(dst);
-	zpool_unmap_handle(entry->pool->zpool, entry->handle);
-	BUG_ON(ret);
+	zswap_decompress(entry, page);
 
 freeentry:
 	spin_lock(&tree->lock);
@@ -1276,6 +1569,8 @@ static int __init zswap_debugfs_init(void)
 			   zswap_debugfs_root, &zswap_pool_limit_hit);
 	debugfs_create_u64("reject_reclaim_fail", 0444,
 			   zswap_debugfs_root, &zswap_reject_reclaim_fail);
+	debugfs_create_u64("reject_memcg_limit", 0444,
+			   zswap_debugfs_root, &zswap_reject_memcg_limit);
 	debugfs_create_u64("reject_alloc_fail", 0444,
 			   zswap_debugfs_root, &zswap_reject_alloc_fail);
 	debugfs_create_u64("reject_kmemcache_fail", 0444,
@@ -1324,13 +1619,6 @@ static int __init init_zswap(void)
 		goto cache_fail;
 	}
 
-	ret = cpuhp_setup_state(CPUHP_MM_ZSWP_MEM_PREPARE, "mm/zswap:prepare",
-				zswap_dstmem_prepare, zswap_dstmem_dead);
-	if (ret) {
-		pr_err("dstmem alloc failed\n");
-		goto dstmem_fail;
-	}
-
 	ret = cpuhp_setup_state_multi(CPUHP_MM_ZSWP_POOL_PREPARE,
 				      "mm/zswap_pool:prepare",
 				      zswap_cpu_comp_prepare,
@@ -1349,6 +1637,8 @@ static int __init init_zswap(void)
 		zswap_enabled = false;
 	}
 
+	zswap_lru_init(&zswap_global_lru);
+	INIT_WORK(&zswap_shrink_work, shrink_worker);
 	shrink_wq = create_workqueue("zswap-shrink");
 	if (!shrink_wq)
 		goto fallback_fail;
@@ -1362,8 +1652,6 @@ static int __init init_zswap(void)
 	if (pool)
 		zswap_pool_destroy(pool);
 hp_fail:
-	cpuhp_remove_state(CPUHP_MM_ZSWP_MEM_PREPARE);
-dstmem_fail:
 	zswap_entry_cache_destroy();
 cache_fail:
 	/* if built-in, we aren't unloaded on failure; don't allow use */
@@ -3,6 +3,7 @@
 
 #include <linux/limits.h>
 #include <linux/oom.h>
+#include <dirent.h>
 #include <fcntl.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -679,6 +680,101 @@ static int test_memcg_max(const char *root)
 	return ret;
 }
 
+/*
+ * Demotion needs to be enabled and there has to be a memory tier below
+ * the top one.
+ */
+static bool has_demotion_target(void)
+{
+	char buf[16] = "";
+	struct dirent *ent;
+	int nr_tiers = 0;
+	FILE *f;
+	DIR *dir;
+
+	f = fopen("/sys/kernel/mm/numa/demotion_enabled", "r");
+	if (!f)
+		return false;
+	if (!fgets(buf, sizeof(buf), f))
+		buf[0] = '\0';
+	fclose(f);
+	if (strcmp(buf, "true\n"))
+		return false;
+
+	dir = opendir("/sys/devices/virtual/memory_tiering");
+	if (!dir)
+		return false;
+	while ((ent = readdir(dir)))
+		if (!strncmp(ent->d_name, "memory_tier", strlen("memory_tier")))
+			nr_tiers++;
+	closedir(dir);
+
+	return nr_tiers > 1;
+}
+
+/*
+ * This test checks that memory.tier0.high and memory.tier0.max don't
+ * reclaim anything: exceeding them only demotes memory to a slower
+ * tier, so a 50M allocation is fully charged with a 30M tier0 limit,
+ * and no more than 30M of it stays in the top tier.
+ * Also checks that memory.numa_stat accounts for it.
+ */
+static int test_memcg_tier0(const char *root)
+{
+	int ret = KSFT_FAIL;
+	char *memcg;
+	long current, tier0;
+
+	if (!has_demotion_target())
+		return KSFT_SKIP;
+
+	memcg = cg_name(root, "memcg_test");
+	if (!memcg)
+		goto cleanup;
+
+	if (cg_create(memcg))
+		goto cleanup;
+
+	if (cg_read_strcmp(memcg, "memory.tier0.high", "max\n"))
+		goto cleanup;
+
+	if (cg_read_strcmp(memcg, "memory.tier0.max", "max\n"))
+		goto cleanup;
+
+	if (is_swap_enabled() && cg_write(memcg, "memory.swap.max", "0"))
+		goto cleanup;
+
+	if (cg_write(memcg, "memory.tier0.high", "20M"))
+		goto cleanup;
+
+	if (cg_write(memcg, "memory.tier0.max", "30M"))
+		goto cleanup;
+
+	if (cg_run(memcg, alloc_anon_50M_check, NULL))
+		goto cleanup;
+
+	if (cg_run_nowait(memcg, alloc_anon_noexit, (void *)MB(50)) < 0)
+		goto cleanup;
+	sleep(1);
+
+	current = cg_read_long(memcg, "memory.current");
+	tier0 = cg_read_long(memcg, "memory.tier0.current");
+	if (current < MB(50) || tier0 < 0 || tier0 > MB(30))
+		goto cleanup;
+
+	if (cg_read_strstr(memcg, "memory.numa_stat", "anon N"))
+		goto cleanup;
+
+	ret = KSFT_PASS;
+
+cleanup:
+	cg_killall(memcg);
+	cg_destroy(memcg);
+	free(memcg);
+
+	return ret;
+}
+
 static int alloc_anon_50M_check_swap(const char *cgroup, void *arg)
 {
 	long mem_max = (long)arg;
@@ -1181,6 +1277,7 @@ struct memcg_test {
 	T(test_memcg_low),
 	T(test_memcg_high),
 	T(test_memcg_max),
+	T(test_memcg_tier0),
 	T(test_memcg_oom_events),
 	T(test_memcg_swap_max),
 	T(test_memcg_sock),
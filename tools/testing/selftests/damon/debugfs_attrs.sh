@@ -0,0 +1,117 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+
+# Kselftest framework requirement - SKIP code is 4.
+ksft_skip=4
+
+test_write_result() {
+	file=$1
+	content=$2
+	orig_content=$3
+	expect_reason=$4
+	expected=$5
+
+	echo "$content" > "$file"
+	if [ $? -ne "$expected" ]
+	then
+		echo "writing $content to $file doesn't return $expected"
+		echo "expected because: $expect_reason"
+		echo "$orig_content" > "$file"
+		exit 1
+	fi
+}
+
+test_write_succ() {
+	test_write_result "$1" "$2" "$3" "$4" 0
+}
+
+test_write_fail() {
+	test_write_result "$1" "$2" "$3" "$4" 1
+}
+
+test_content() {
+	file=$1
+	orig_content=$2
+	expected=$3
+	expect_reason=$4
+
+	content=$(cat "$file")
+	if [ "$content" != "$expected" ]
+	then
+		echo "reading $file expected $expected but $content"
+		echo "expected because: $expect_reason"
+		echo "$orig_content" > "$file"
+		exit 1
+	fi
+}
+
+source ./_chk_dependency.sh
+
+# Test attrs file
+# ===============
+
+file="$DBGFS/attrs"
+orig_content=$(cat "$file")
+
+test_write_succ "$file" "1 2 3 4 5" "$orig_content" "valid input"
+test_write_fail "$file" "1 2 3 4" "$orig_content" "no enough fields"
+test_write_fail "$file" "1 2 3 5 4" "$orig_content" \
+	"min_nr_regions > max_nr_regions"
+test_content "$file" "$orig_content" "1 2 3 4 5" "successfully written"
+echo "$orig_content" > "$file"
+
+# Test schemes file
+# =================
+
+file="$DBGFS/schemes"
+orig_content=$(cat "$file")
+
+test_write_succ "$file" "1 2 3 4 5 6 4 0 1000" \
+	"$orig_content" "valid input"
+test_write_succ "$file" "1 2 3 4 5 6 4 0 1000
+10 20 0 0 5 6 5 0 0" "$orig_content" "multi lines"
+test_write_succ "$file" "" "$orig_content" "disabling"
+test_write_fail "$file" "2 1 2 1 10 1 3 0 1000" "$orig_content" \
+	"min is bigger than max"
+test_write_fail "$file" "1 2 3 4 5 6 99 0 1000" "$orig_content" \
+	"wrong action"
+echo "$orig_content" > "$file"
+
+# Test target_ids file
+# ====================
+
+file="$DBGFS/target_ids"
+orig_content=$(cat "$file")
+
+test_write_succ "$file" "$$" "$orig_content" "valid input"
+test_content "$file" "$orig_content" "$$" "successfully written"
+test_write_succ "$file" "$$ abc 4" "$orig_content" "still valid input"
+test_content "$file" "$orig_content" "$$" "non-integer was there"
+test_write_fail "$file" "999999999" "$orig_content" "no such process"
+test_write_succ "$file" "paddr" "$orig_content" "all memory nodes"
+test_write_succ "$file" "paddr 0" "$orig_content" "node 0"
+test_content "$file" "$orig_content" "paddr 0" "successfully written"
+test_write_fail "$file" "paddr 9999" "$orig_content" "invalid node id"
+test_write_succ "$file" "" "$orig_content" "empty input"
+test_content "$file" "$orig_content" "" "empty input written"
+echo "$orig_content" > "$file"
+
+# Test init_regions file
+# ======================
+
+file="$DBGFS/init_regions"
+orig_content=$(cat "$file")
+
+echo "$$" > "$DBGFS/target_ids"
+test_write_succ "$file" "$$ 100 200
+$$ 300 400" "$orig_content" "valid input"
+test_content "$file" "$orig_content" "$$ 100 200
+$$ 300 400" "successfully written"
+test_write_fail "$file" "$$ 300 400
+$$ 100 200" "$orig_content" "regions not sorted"
+test_write_fail "$file" "$$ 100 200
+$$ 150 250" "$orig_content" "overlapping regions"
+test_write_fail "$file" "4242 100 200" "$orig_content" "unknown target"
+echo "" > "$DBGFS/target_ids"
+
+echo "PASS"
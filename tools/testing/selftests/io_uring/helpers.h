@@ -0,0 +1,133 @@
+/* SPDX-License-Identifier: GPL-2.0 */
+/*
+ * A minimal io_uring ring on top of the raw syscalls, for tests that use
+ * 64 byte sqes.  32 byte cqes are handled, as they take up two slots.
+ */
+#ifndef __SELFTESTS_IO_URING_HELPERS_H
+#define __SELFTESTS_IO_URING_HELPERS_H
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+
+struct ring {
+	int fd;
+	unsigned int flags;
+	unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned int *cq_head, *cq_tail, *cq_mask;
+	struct io_uring_sqe *sqes;
+	struct io_uring_cqe *cqes;
+	unsigned int sqe_tail;
+};
+
+static inline int ring_setup(struct ring *ring, unsigned int entries,
+			     unsigned int flags)
+{
+	unsigned int cqe_slots = flags & IORING_SETUP_CQE32 ? 2 : 1;
+	struct io_uring_params p;
+	size_t sq_size, cq_size;
+	void *sq_ptr, *cq_ptr;
+
+	memset(ring, 0, sizeof(*ring));
+	memset(&p, 0, sizeof(p));
+	p.flags = flags;
+	ring->fd = syscall(__NR_io_uring_setup, entries, &p);
+	if (ring->fd < 0)
+		return -errno;
+	ring->flags = flags;
+
+	sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	cq_size = p.cq_off.cqes +
+		  p.cq_entries * cqe_slots * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (cq_size > sq_size)
+			sq_size = cq_size;
+		cq_size = sq_size;
+	}
+
+	sq_ptr = mmap(NULL, sq_size, PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (sq_ptr == MAP_FAILED)
+		return -errno;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		cq_ptr = sq_ptr;
+	} else {
+		cq_ptr = mmap(NULL, cq_size, PROT_READ | PROT_WRITE,
+			      MAP_SHARED | MAP_POPULATE, ring->fd,
+			      IORING_OFF_CQ_RING);
+		if (cq_ptr == MAP_FAILED)
+			return -errno;
+	}
+
+	ring->sqes = mmap(NULL, p.sq_entries * sizeof(struct io_uring_sqe),
+			  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			  ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		return -errno;
+
+	ring->sq_head = sq_ptr + p.sq_off.head;
+	ring->sq_tail = sq_ptr + p.sq_off.tail;
+	ring->sq_mask = sq_ptr + p.sq_off.ring_mask;
+	ring->sq_array = sq_ptr + p.sq_off.array;
+	ring->cq_head = cq_ptr + p.cq_off.head;
+	ring->cq_tail = cq_ptr + p.cq_off.tail;
+	ring->cq_mask = cq_ptr + p.cq_off.ring_mask;
+	ring->cqes = cq_ptr + p.cq_off.cqes;
+	ring->sqe_tail = *ring->sq_tail;
+	return 0;
+}
+
+/* A zeroed sqe, queued by the next ring_submit() */
+static inline struct io_uring_sqe *ring_get_sqe(struct ring *ring)
+{
+	unsigned int index = ring->sqe_tail++ & *ring->sq_mask;
+	struct io_uring_sqe *sqe = &ring->sqes[index];
+
+	memset(sqe, 0, sizeof(*sqe));
+	ring->sq_array[index] = index;
+	return sqe;
+}
+
+/* Submit all queued sqes and wait for @wait_nr completions */
+static inline int ring_submit(struct ring *ring, unsigned int wait_nr)
+{
+	unsigned int to_submit = ring->sqe_tail - *ring->sq_tail;
+	int ret;
+
+	__atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+	ret = syscall(__NR_io_uring_enter, ring->fd, to_submit, wait_nr,
+		      wait_nr ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+	return ret < 0 ? -errno : ret;
+}
+
+/*
+ * Copy the oldest cqe to @out and consume it.  @out must have room for a
+ * 32 byte cqe on IORING_SETUP_CQE32 rings.  Returns -EAGAIN if there is none.
+ */
+static inline int ring_pop_cqe(struct ring *ring, struct io_uring_cqe *out)
+{
+	unsigned int slots = ring->flags & IORING_SETUP_CQE32 ? 2 : 1;
+	unsigned int head = *ring->cq_head;
+
+	if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+		return -EAGAIN;
+	memcpy(out, &ring->cqes[(head & *ring->cq_mask) * slots],
+	       slots * sizeof(*out));
+	__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+	return 0;
+}
+
+static inline int ring_register(struct ring *ring, unsigned int opcode,
+				void *arg, unsigned int nr_args)
+{
+	int ret;
+
+	ret = syscall(__NR_io_uring_register, ring->fd, opcode, arg, nr_args);
+	return ret < 0 ? -errno : ret;
+}
+
+#endif /* __SELFTESTS_IO_URING_HELPERS_H */
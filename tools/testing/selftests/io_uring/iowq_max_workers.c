@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * IORING_REGISTER_IOWQ_MAX_WORKERS: zero counts only query a limit, and
+ * every call hands back the limits that were in place before it.
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../kselftest.h"
+#include "helpers.h"
+
+static int max_workers(struct ring *ring, __u32 bounded, __u32 unbounded,
+		       __u32 *prev)
+{
+	prev[0] = bounded;
+	prev[1] = unbounded;
+	return ring_register(ring, IORING_REGISTER_IOWQ_MAX_WORKERS, prev, 2);
+}
+
+int main(void)
+{
+	__u32 dflt[2], cur[2], prev[2];
+	struct ring ring;
+	int ret;
+
+	ksft_print_header();
+	ksft_set_plan(5);
+
+	ret = ring_setup(&ring, 8, 0);
+	if (ret)
+		ksft_exit_fail_msg("ring setup: %s\n", strerror(-ret));
+
+	ret = max_workers(&ring, 0, 0, dflt);
+	if (ret == -EINVAL)
+		ksft_exit_skip("no IORING_REGISTER_IOWQ_MAX_WORKERS\n");
+	if (ret)
+		ksft_exit_fail_msg("query: %s\n", strerror(-ret));
+	if (!dflt[0] || !dflt[1])
+		ksft_test_result_fail("query: limits %u %u\n", dflt[0], dflt[1]);
+	else
+		ksft_test_result_pass("query\n");
+
+	/* a query changes nothing */
+	ret = max_workers(&ring, 0, 0, cur);
+	if (ret || cur[0] != dflt[0] || cur[1] != dflt[1])
+		ksft_test_result_fail("query again: ret %d limits %u %u, expected %u %u\n",
+				      ret, cur[0], cur[1], dflt[0], dflt[1]);
+	else
+		ksft_test_result_pass("query again\n");
+
+	/* setting both returns the defaults, and a query the new limits */
+	ret = max_workers(&ring, 1, 2, prev);
+	if (!ret)
+		ret = max_workers(&ring, 0, 0, cur);
+	if (ret || prev[0] != dflt[0] || prev[1] != dflt[1] ||
+	    cur[0] != 1 || cur[1] != 2)
+		ksft_test_result_fail("set: ret %d previous %u %u current %u %u\n",
+				      ret, prev[0], prev[1], cur[0], cur[1]);
+	else
+		ksft_test_result_pass("set\n");
+
+	/* a zero count leaves that limit alone */
+	ret = max_workers(&ring, 3, 0, prev);
+	if (!ret)
+		ret = max_workers(&ring, 0, 0, cur);
+	if (ret || prev[0] != 1 || prev[1] != 2 ||
+	    cur[0] != 3 || cur[1] != 2)
+		ksft_test_result_fail("set bounded only: ret %d previous %u %u current %u %u\n",
+				      ret, prev[0], prev[1], cur[0], cur[1]);
+	else
+		ksft_test_result_pass("set bounded only\n");
+
+	/* negative counts and a wrong nr_args are refused */
+	prev[0] = -1;
+	prev[1] = 0;
+	ret = ring_register(&ring, IORING_REGISTER_IOWQ_MAX_WORKERS, prev, 2);
+	if (ret == -EINVAL)
+		ret = ring_register(&ring, IORING_REGISTER_IOWQ_MAX_WORKERS,
+				    cur, 1);
+	if (ret != -EINVAL)
+		ksft_test_result_fail("invalid: ret %d\n", ret);
+	else
+		ksft_test_result_pass("invalid\n");
+
+	close(ring.fd);
+	ksft_exit_pass();
+}
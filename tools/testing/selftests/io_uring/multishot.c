@@ -0,0 +1,271 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * IORING_ACCEPT_MULTISHOT and IORING_RECV_MULTISHOT over loopback TCP: one
+ * sqe keeps posting cqes with IORING_CQE_F_MORE until it runs out of
+ * buffers or is cancelled, and its last cqe comes without the flag.
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+
+#include "../kselftest.h"
+#include "helpers.h"
+
+#define PBUF_SIZE	64
+#define PBUF_NR		4
+#define PBUF_GROUP	1
+#define NR_CONN		3
+
+static int tcp_listen(struct sockaddr_in *addr)
+{
+	socklen_t len = sizeof(*addr);
+	int lfd;
+
+	memset(addr, 0, sizeof(*addr));
+	addr->sin_family = AF_INET;
+	addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0 || bind(lfd, (struct sockaddr *)addr, sizeof(*addr)) ||
+	    listen(lfd, NR_CONN) ||
+	    getsockname(lfd, (struct sockaddr *)addr, &len))
+		ksft_exit_fail_msg("listen: %s\n", strerror(errno));
+	return lfd;
+}
+
+static int tcp_connect(struct sockaddr_in *addr)
+{
+	int fd;
+
+	fd = socket(AF_INET, SOCK_STREAM, 0);
+	if (fd < 0 || connect(fd, (struct sockaddr *)addr, sizeof(*addr)))
+		ksft_exit_fail_msg("connect: %s\n", strerror(errno));
+	return fd;
+}
+
+static void fill(char *buf, int len, int seed)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = i * 7 + seed;
+}
+
+/* Wait for @nr cqes and copy them to @cqes */
+static int reap(struct ring *ring, struct io_uring_cqe *cqes, int nr)
+{
+	int ret, i;
+
+	ret = ring_submit(ring, nr);
+	if (ret < 0)
+		return ret;
+	for (i = 0; i < nr; i++) {
+		ret = ring_pop_cqe(ring, &cqes[i]);
+		if (ret)
+			return ret;
+	}
+	return 0;
+}
+
+/* Unknown sqe->ioprio bits have always been ignored by recv */
+static void test_recv_ioprio(struct ring *ring, int srv, int cli)
+{
+	struct io_uring_sqe *sqe;
+	struct io_uring_cqe cqe;
+	char buf[16];
+	int ret;
+
+	sqe = ring_get_sqe(ring);
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = srv;
+	sqe->ioprio = 1U << 7;
+	sqe->addr = (unsigned long)buf;
+	sqe->len = sizeof(buf);
+
+	if (send(cli, "ping", 4, 0) != 4)
+		ksft_exit_fail_msg("send: %s\n", strerror(errno));
+	ret = reap(ring, &cqe, 1);
+	if (ret)
+		ksft_exit_fail_msg("recv: %s\n", strerror(-ret));
+	if (cqe.res != 4 || memcmp(buf, "ping", 4))
+		ksft_test_result_fail("recv unknown ioprio: res %d\n", cqe.res);
+	else
+		ksft_test_result_pass("recv unknown ioprio\n");
+}
+
+static void test_recv_multishot(struct ring *ring, int srv, int cli)
+{
+	struct io_uring_cqe cqes[PBUF_NR + 1];
+	char data[PBUF_NR * PBUF_SIZE];
+	struct io_uring_sqe *sqe;
+	bool seen[PBUF_NR] = { };
+	char *pbufs;
+	int ret, bid, i;
+
+	pbufs = calloc(PBUF_NR, PBUF_SIZE);
+	if (!pbufs)
+		ksft_exit_fail_msg("out of memory\n");
+
+	sqe = ring_get_sqe(ring);
+	sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+	sqe->fd = PBUF_NR;
+	sqe->addr = (unsigned long)pbufs;
+	sqe->len = PBUF_SIZE;
+	sqe->buf_group = PBUF_GROUP;
+	ret = reap(ring, cqes, 1);
+	if (ret || cqes[0].res < 0)
+		ksft_exit_fail_msg("provide buffers: %s\n",
+				   strerror(ret ? -ret : -cqes[0].res));
+
+	sqe = ring_get_sqe(ring);
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = srv;
+	sqe->flags = IOSQE_BUFFER_SELECT;
+	sqe->ioprio = IORING_RECV_MULTISHOT;
+	sqe->buf_group = PBUF_GROUP;
+	ret = ring_submit(ring, 0);
+	if (ret < 0)
+		ksft_exit_fail_msg("submit recv: %s\n", strerror(-ret));
+
+	/* Enough to fill every buffer: one cqe each, then -ENOBUFS */
+	fill(data, sizeof(data), 3);
+	if (send(cli, data, sizeof(data), 0) != sizeof(data))
+		ksft_exit_fail_msg("send: %s\n", strerror(errno));
+
+	ret = reap(ring, cqes, 1);
+	if (ret)
+		ksft_exit_fail_msg("recv multishot: %s\n", strerror(-ret));
+	if (cqes[0].res == -EINVAL) {
+		ksft_test_result_skip("no IORING_RECV_MULTISHOT\n");
+		goto out;
+	}
+	ret = reap(ring, cqes + 1, PBUF_NR);
+	if (ret)
+		ksft_exit_fail_msg("recv multishot: %s\n", strerror(-ret));
+
+	for (i = 0; i < PBUF_NR; i++) {
+		bid = cqes[i].flags >> IORING_CQE_BUFFER_SHIFT;
+		if (cqes[i].res != PBUF_SIZE ||
+		    !(cqes[i].flags & IORING_CQE_F_MORE) ||
+		    !(cqes[i].flags & IORING_CQE_F_BUFFER) ||
+		    bid >= PBUF_NR || seen[bid] ||
+		    memcmp(pbufs + bid * PBUF_SIZE, data + i * PBUF_SIZE,
+			   PBUF_SIZE)) {
+			ksft_test_result_fail("recv multishot: cqe %d res %d flags %x\n",
+					      i, cqes[i].res, cqes[i].flags);
+			goto out;
+		}
+		seen[bid] = true;
+	}
+	if (cqes[PBUF_NR].res != -ENOBUFS ||
+	    (cqes[PBUF_NR].flags & IORING_CQE_F_MORE))
+		ksft_test_result_fail("recv multishot: last res %d flags %x\n",
+				      cqes[PBUF_NR].res, cqes[PBUF_NR].flags);
+	else
+		ksft_test_result_pass("recv multishot\n");
+out:
+	free(pbufs);
+}
+
+static void test_accept_multishot(struct ring *ring)
+{
+	struct io_uring_cqe cqes[NR_CONN + 2];
+	struct io_uring_sqe *sqe;
+	struct sockaddr_in addr;
+	int cli[NR_CONN];
+	int lfd, ret, i;
+
+	lfd = tcp_listen(&addr);
+
+	sqe = ring_get_sqe(ring);
+	sqe->opcode = IORING_OP_ACCEPT;
+	sqe->fd = lfd;
+	sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+	sqe->user_data = 1;
+	ret = ring_submit(ring, 0);
+	if (ret < 0)
+		ksft_exit_fail_msg("submit accept: %s\n", strerror(-ret));
+
+	for (i = 0; i < NR_CONN; i++)
+		cli[i] = tcp_connect(&addr);
+
+	ret = reap(ring, cqes, 1);
+	if (ret)
+		ksft_exit_fail_msg("accept multishot: %s\n", strerror(-ret));
+	if (cqes[0].res == -EINVAL) {
+		ksft_test_result_skip("no IORING_ACCEPT_MULTISHOT\n");
+		goto out;
+	}
+	ret = reap(ring, cqes + 1, NR_CONN - 1);
+	if (ret)
+		ksft_exit_fail_msg("accept multishot: %s\n", strerror(-ret));
+
+	/* Still armed after the last connection, until it is cancelled */
+	sqe = ring_get_sqe(ring);
+	sqe->opcode = IORING_OP_ASYNC_CANCEL;
+	sqe->addr = 1;
+	sqe->user_data = 2;
+	ret = reap(ring, cqes + NR_CONN, 2);
+	if (ret)
+		ksft_exit_fail_msg("cancel accept: %s\n", strerror(-ret));
+
+	for (i = 0; i < NR_CONN; i++) {
+		if (cqes[i].user_data != 1 || cqes[i].res < 0 ||
+		    !(cqes[i].flags & IORING_CQE_F_MORE)) {
+			ksft_test_result_fail("accept multishot: cqe %d res %d flags %x\n",
+					      i, cqes[i].res, cqes[i].flags);
+			goto out;
+		}
+		close(cqes[i].res);
+	}
+	for (i = NR_CONN; i < NR_CONN + 2; i++) {
+		if (cqes[i].user_data == 1 &&
+		    (cqes[i].flags & IORING_CQE_F_MORE)) {
+			ksft_test_result_fail("accept multishot: still armed after cancel\n");
+			goto out;
+		}
+	}
+	ksft_test_result_pass("accept multishot\n");
+out:
+	for (i = 0; i < NR_CONN; i++)
+		close(cli[i]);
+	close(lfd);
+}
+
+int main(void)
+{
+	struct sockaddr_in addr;
+	struct ring ring;
+	int lfd, srv, cli, ret;
+
+	ksft_print_header();
+	ksft_set_plan(3);
+
+	ret = ring_setup(&ring, 16, 0);
+	if (ret)
+		ksft_exit_fail_msg("ring setup: %s\n", strerror(-ret));
+
+	lfd = tcp_listen(&addr);
+	cli = tcp_connect(&addr);
+	srv = accept(lfd, NULL, NULL);
+	if (srv < 0)
+		ksft_exit_fail_msg("accept: %s\n", strerror(errno));
+	close(lfd);
+
+	test_recv_ioprio(&ring, srv, cli);
+	test_recv_multishot(&ring, srv, cli);
+	test_accept_multishot(&ring);
+
+	close(cli);
+	close(srv);
+	close(ring.fd);
+	ksft_exit_pass();
+}
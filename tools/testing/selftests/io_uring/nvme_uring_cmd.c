@@ -0,0 +1,282 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Issue NVMe I/O commands through IORING_OP_URING_CMD on an NVMe
+ * controller char device and check what comes back in the 32 byte CQEs,
+ * once from an interrupt driven ring and once from an IOPOLL one.
+ *
+ * The namespace is overwritten with a test pattern, so only run this on a
+ * scratch namespace, such as the nvme-loop one nvme_uring_cmd.sh sets up.
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <linux/nvme_ioctl.h>
+
+#include "../kselftest.h"
+
+#define QUEUE_DEPTH	4
+#define BUF_SIZE	16384
+
+#define NVME_ADMIN_IDENTIFY	0x06
+#define NVME_CMD_WRITE		0x01
+#define NVME_CMD_READ		0x02
+#define NVME_CMD_INVALID	0x7f
+
+struct ring {
+	int fd;
+	unsigned int *sq_head, *sq_tail, *sq_mask, *sq_array;
+	unsigned int *cq_head, *cq_tail, *cq_mask;
+	void *sqes;
+	void *cqes;
+};
+
+static int ring_setup(struct ring *ring, unsigned int flags)
+{
+	struct io_uring_params p;
+	size_t sq_size, cq_size;
+	void *sq_ptr, *cq_ptr;
+
+	memset(&p, 0, sizeof(p));
+	p.flags = IORING_SETUP_SQE128 | IORING_SETUP_CQE32 | flags;
+	ring->fd = syscall(__NR_io_uring_setup, QUEUE_DEPTH, &p);
+	if (ring->fd < 0)
+		return -errno;
+
+	sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+	cq_size = p.cq_off.cqes + p.cq_entries * 2 * sizeof(struct io_uring_cqe);
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		if (cq_size > sq_size)
+			sq_size = cq_size;
+		cq_size = sq_size;
+	}
+
+	sq_ptr = mmap(NULL, sq_size, PROT_READ | PROT_WRITE,
+		      MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+	if (sq_ptr == MAP_FAILED)
+		return -errno;
+
+	if (p.features & IORING_FEAT_SINGLE_MMAP) {
+		cq_ptr = sq_ptr;
+	} else {
+		cq_ptr = mmap(NULL, cq_size, PROT_READ | PROT_WRITE,
+			      MAP_SHARED | MAP_POPULATE, ring->fd,
+			      IORING_OFF_CQ_RING);
+		if (cq_ptr == MAP_FAILED)
+			return -errno;
+	}
+
+	ring->sqes = mmap(NULL, p.sq_entries * 2 * sizeof(struct io_uring_sqe),
+			  PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+			  ring->fd, IORING_OFF_SQES);
+	if (ring->sqes == MAP_FAILED)
+		return -errno;
+
+	ring->sq_head = sq_ptr + p.sq_off.head;
+	ring->sq_tail = sq_ptr + p.sq_off.tail;
+	ring->sq_mask = sq_ptr + p.sq_off.ring_mask;
+	ring->sq_array = sq_ptr + p.sq_off.array;
+	ring->cq_head = cq_ptr + p.cq_off.head;
+	ring->cq_tail = cq_ptr + p.cq_off.tail;
+	ring->cq_mask = cq_ptr + p.cq_off.ring_mask;
+	ring->cqes = cq_ptr + p.cq_off.cqes;
+	return 0;
+}
+
+/*
+ * Submit one NVME_URING_CMD_IO command, wait for it and copy its 32 byte
+ * completion to @out.
+ */
+static int uring_cmd(struct ring *ring, int fd, struct nvme_uring_cmd *cmd,
+		     struct io_uring_cqe *out)
+{
+	unsigned int tail = *ring->sq_tail, head, index;
+	struct io_uring_sqe *sqe;
+	struct io_uring_cqe *cqe;
+
+	/* with SQE128 and CQE32, each entry takes up two slots */
+	index = tail & *ring->sq_mask;
+	sqe = ring->sqes + index * 2 * sizeof(struct io_uring_sqe);
+	memset(sqe, 0, 2 * sizeof(*sqe));
+	sqe->opcode = IORING_OP_URING_CMD;
+	sqe->fd = fd;
+	sqe->cmd_op = NVME_URING_CMD_IO;
+	sqe->user_data = tail;
+	memcpy(sqe->cmd, cmd, sizeof(*cmd));
+
+	ring->sq_array[index] = index;
+	__atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+
+	if (syscall(__NR_io_uring_enter, ring->fd, 1, 1,
+		    IORING_ENTER_GETEVENTS, NULL, 0) < 0)
+		return -errno;
+
+	head = *ring->cq_head;
+	if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+		return -EAGAIN;
+	cqe = ring->cqes + (head & *ring->cq_mask) * 2 * sizeof(*cqe);
+	memcpy(out, cqe, 2 * sizeof(*cqe));
+	__atomic_store_n(ring->cq_head, head + 1, __ATOMIC_RELEASE);
+
+	if (out->user_data != tail)
+		return -EBADMSG;
+	return 0;
+}
+
+/* The LBA size of @nsid, from the formatted LBA format of Identify Namespace */
+static int lba_size(int fd, int nsid)
+{
+	struct nvme_admin_cmd cmd;
+	unsigned char *id;
+	int ret, lbaf;
+
+	if (posix_memalign((void **)&id, 4096, 4096))
+		return -ENOMEM;
+
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.opcode = NVME_ADMIN_IDENTIFY;
+	cmd.nsid = nsid;
+	cmd.addr = (__u64)(unsigned long)id;
+	cmd.data_len = 4096;
+
+	ret = ioctl(fd, NVME_IOCTL_ADMIN_CMD, &cmd);
+	if (ret < 0)
+		ret = -errno;
+	else if (ret > 0)
+		ret = -EIO;
+	else {
+		lbaf = id[26] & 0xf;
+		ret = 1 << id[128 + lbaf * 4 + 2];
+	}
+	free(id);
+	return ret;
+}
+
+static void run_tests(const char *name, struct ring *ring, int fd, int nsid,
+		      int lbs, char *wbuf, char *rbuf)
+{
+	__u64 cqe_buf[4];
+	struct io_uring_cqe *cqe = (struct io_uring_cqe *)cqe_buf;
+	struct nvme_uring_cmd cmd;
+	int ret;
+
+	/* Write the pattern: NVMe status 0, completion dword 0 */
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.opcode = NVME_CMD_WRITE;
+	cmd.nsid = nsid;
+	cmd.addr = (__u64)(unsigned long)wbuf;
+	cmd.data_len = BUF_SIZE;
+	cmd.cdw12 = BUF_SIZE / lbs - 1;
+
+	memset(cqe_buf, 0xff, sizeof(cqe_buf));
+	ret = uring_cmd(ring, fd, &cmd, cqe);
+	if (ret)
+		ksft_exit_fail_msg("%s write: %s\n", name, strerror(-ret));
+	if (cqe->res == -EOPNOTSUPP || cqe->res == -ENOTTY)
+		ksft_exit_skip("%s: no uring_cmd support\n", name);
+
+	if (cqe->res || cqe->big_cqe[0])
+		ksft_test_result_fail("%s write: res %d result %llu\n", name,
+				      cqe->res,
+				      (unsigned long long)cqe->big_cqe[0]);
+	else
+		ksft_test_result_pass("%s write\n", name);
+
+	/* Read it back */
+	memset(rbuf, 0, BUF_SIZE);
+	cmd.opcode = NVME_CMD_READ;
+	cmd.addr = (__u64)(unsigned long)rbuf;
+
+	memset(cqe_buf, 0xff, sizeof(cqe_buf));
+	ret = uring_cmd(ring, fd, &cmd, cqe);
+	if (ret)
+		ksft_exit_fail_msg("%s read: %s\n", name, strerror(-ret));
+
+	if (cqe->res || cqe->big_cqe[0] || memcmp(rbuf, wbuf, BUF_SIZE))
+		ksft_test_result_fail("%s read: res %d result %llu data %s\n",
+				      name, cqe->res,
+				      (unsigned long long)cqe->big_cqe[0],
+				      memcmp(rbuf, wbuf, BUF_SIZE) ?
+				      "differs" : "matches");
+	else
+		ksft_test_result_pass("%s read\n", name);
+
+	/* An unknown opcode completes with a positive NVMe status */
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.opcode = NVME_CMD_INVALID;
+	cmd.nsid = nsid;
+
+	memset(cqe_buf, 0xff, sizeof(cqe_buf));
+	ret = uring_cmd(ring, fd, &cmd, cqe);
+	if (ret)
+		ksft_exit_fail_msg("%s invalid opcode: %s\n", name,
+				   strerror(-ret));
+
+	if (cqe->res <= 0)
+		ksft_test_result_fail("%s invalid opcode: res %d\n", name,
+				      cqe->res);
+	else
+		ksft_test_result_pass("%s invalid opcode\n", name);
+}
+
+int main(int argc, char **argv)
+{
+	struct ring ring, poll_ring;
+	char *wbuf, *rbuf;
+	int fd, nsid, lbs, ret, i;
+
+	if (argc != 3)
+		ksft_exit_fail_msg("usage: %s <nvme controller char device> <nsid>\n",
+				   argv[0]);
+
+	ksft_print_header();
+	ksft_set_plan(6);
+
+	fd = open(argv[1], O_RDWR);
+	if (fd < 0)
+		ksft_exit_fail_msg("open %s: %s\n", argv[1], strerror(errno));
+
+	nsid = atoi(argv[2]);
+	lbs = lba_size(fd, nsid);
+	if (lbs < 0)
+		ksft_exit_fail_msg("identify namespace %d: %s\n", nsid,
+				   strerror(-lbs));
+	if (BUF_SIZE % lbs)
+		ksft_exit_skip("LBA size %d is too large\n", lbs);
+
+	ret = ring_setup(&ring, 0);
+	if (ret == -EINVAL)
+		ksft_exit_skip("no SQE128/CQE32 rings\n");
+	if (ret)
+		ksft_exit_fail_msg("ring setup: %s\n", strerror(-ret));
+	ret = ring_setup(&poll_ring, IORING_SETUP_IOPOLL);
+	if (ret)
+		ksft_exit_fail_msg("IOPOLL ring setup: %s\n", strerror(-ret));
+
+	if (posix_memalign((void **)&wbuf, 4096, BUF_SIZE) ||
+	    posix_memalign((void **)&rbuf, 4096, BUF_SIZE))
+		ksft_exit_fail_msg("out of memory\n");
+	for (i = 0; i < BUF_SIZE; i++)
+		wbuf[i] = i * 7 + 1;
+
+	run_tests("irq", &ring, fd, nsid, lbs, wbuf, rbuf);
+
+	/* a different pattern, so stale data from the first pass shows */
+	for (i = 0; i < BUF_SIZE; i++)
+		wbuf[i] = i * 13 + 5;
+
+	run_tests("iopoll", &poll_ring, fd, nsid, lbs, wbuf, rbuf);
+
+	close(poll_ring.fd);
+	close(ring.fd);
+	close(fd);
+	ksft_exit_pass();
+}
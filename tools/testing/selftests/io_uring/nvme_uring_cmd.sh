@@ -0,0 +1,90 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Export a file-backed namespace over nvme-loop, connect to it and run
+# nvme_uring_cmd on the controller char device.
+#
+# nvme-loop has no poll queues, so its IOPOLL pass only covers the ring
+# side.  To poll a real poll queue, load nvme with poll_queues=N and pass
+# the controller char device and nsid of a scratch namespace instead:
+#
+#	./nvme_uring_cmd.sh /dev/nvme1 1
+#
+# The namespace is overwritten either way.
+
+ksft_skip=4
+
+NQN=kselftest-nvme-uring-cmd
+NVMET=/sys/kernel/config/nvmet
+SUBSYS=$NVMET/subsystems/$NQN
+PORT=$NVMET/ports/4242
+backing=""
+ctrl=""
+
+cleanup()
+{
+	[ -n "$ctrl" ] && echo 1 > /sys/class/nvme/$ctrl/delete_controller
+	rm -f $PORT/subsystems/$NQN
+	[ -d $PORT ] && rmdir $PORT
+	if [ -d $SUBSYS ]; then
+		echo 0 > $SUBSYS/namespaces/1/enable
+		rmdir $SUBSYS/namespaces/1
+		rmdir $SUBSYS
+	fi
+	[ -n "$backing" ] && rm -f $backing
+}
+
+if [ $UID -ne 0 ]; then
+	echo "SKIP: must be run as root"
+	exit $ksft_skip
+fi
+
+if [ $# -eq 2 ]; then
+	exec ./nvme_uring_cmd "$1" "$2"
+fi
+
+modprobe -q nvme-loop
+if [ ! -d $NVMET ] || [ ! -c /dev/nvme-fabrics ]; then
+	echo "SKIP: nvme-loop is not available"
+	exit $ksft_skip
+fi
+
+trap cleanup EXIT
+
+backing=$(mktemp) || exit 1
+truncate -s 64M $backing || exit 1
+
+mkdir $SUBSYS || exit 1
+echo 1 > $SUBSYS/attr_allow_any_host
+mkdir $SUBSYS/namespaces/1
+echo $backing > $SUBSYS/namespaces/1/device_path
+echo 1 > $SUBSYS/namespaces/1/enable || exit 1
+
+mkdir $PORT || exit 1
+echo loop > $PORT/addr_trtype
+ln -s $SUBSYS $PORT/subsystems/$NQN || exit 1
+
+echo "transport=loop,nqn=$NQN" > /dev/nvme-fabrics || exit 1
+
+for c in /sys/class/nvme/nvme*; do
+	if [ "$(cat $c/subsysnqn 2>/dev/null)" = "$NQN" ]; then
+		ctrl=$(basename $c)
+		break
+	fi
+done
+if [ -z "$ctrl" ]; then
+	echo "FAIL: no controller for $NQN"
+	exit 1
+fi
+
+# wait for the namespace scan, the char device works with multipath too
+for i in $(seq 50); do
+	ls -d /sys/class/nvme/$ctrl/nvme*n1 > /dev/null 2>&1 && break
+	sleep 0.1
+done
+if [ ! -c /dev/$ctrl ]; then
+	echo "FAIL: no char device for $ctrl"
+	exit 1
+fi
+
+./nvme_uring_cmd /dev/$ctrl 1
@@ -0,0 +1,196 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * IORING_OP_RECV with IORING_RECV_FIXED_BUF over a loopback TCP connection:
+ * the data has to land in the registered buffer, and the 32 byte cqe has to
+ * say where.
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "../kselftest.h"
+#include "helpers.h"
+
+#define REG_SIZE	65536
+#define PBUF_BASE	8192
+#define PBUF_SIZE	1024
+#define PBUF_NR		4
+
+static char *reg;
+
+static void tcp_pair(int *srv, int *cli)
+{
+	struct sockaddr_in addr = {
+		.sin_family = AF_INET,
+		.sin_addr.s_addr = htonl(INADDR_LOOPBACK),
+	};
+	socklen_t len = sizeof(addr);
+	int lfd;
+
+	lfd = socket(AF_INET, SOCK_STREAM, 0);
+	if (lfd < 0 || bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    listen(lfd, 1) ||
+	    getsockname(lfd, (struct sockaddr *)&addr, &len))
+		ksft_exit_fail_msg("listen: %s\n", strerror(errno));
+
+	*cli = socket(AF_INET, SOCK_STREAM, 0);
+	if (*cli < 0 || connect(*cli, (struct sockaddr *)&addr, sizeof(addr)))
+		ksft_exit_fail_msg("connect: %s\n", strerror(errno));
+	*srv = accept(lfd, NULL, NULL);
+	if (*srv < 0)
+		ksft_exit_fail_msg("accept: %s\n", strerror(errno));
+	close(lfd);
+}
+
+static void fill(char *buf, int len, int seed)
+{
+	int i;
+
+	for (i = 0; i < len; i++)
+		buf[i] = i * 7 + seed;
+}
+
+/* Queue a fixed buffer receive, send @len bytes, and reap its cqe */
+static int recv_fixed(struct ring *ring, int srv, int cli, __u64 addr,
+		      int len, bool select, struct io_uring_cqe *cqe)
+{
+	struct io_uring_sqe *sqe;
+	char data[PBUF_SIZE];
+	int ret;
+
+	sqe = ring_get_sqe(ring);
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = srv;
+	sqe->ioprio = IORING_RECV_FIXED_BUF;
+	/* registered buffer 0, which is also buffer group 0 */
+	sqe->buf_index = 0;
+	sqe->len = PBUF_SIZE;
+	if (select)
+		sqe->flags = IOSQE_BUFFER_SELECT;
+	else
+		sqe->addr = addr;
+
+	ret = ring_submit(ring, 0);
+	if (ret < 0)
+		return ret;
+
+	fill(data, len, len);
+	if (send(cli, data, len, 0) != len)
+		return -errno;
+
+	ret = ring_submit(ring, 1);
+	if (ret < 0)
+		return ret;
+	return ring_pop_cqe(ring, cqe);
+}
+
+static bool check(const char *name, struct io_uring_cqe *cqe, int len,
+		  __u64 off)
+{
+	char data[PBUF_SIZE];
+
+	fill(data, len, len);
+	if (cqe->res != len || cqe->big_cqe[0] != off ||
+	    memcmp(reg + off, data, len)) {
+		ksft_test_result_fail("%s: res %d landed at %llu, expected %d at %llu\n",
+				      name, cqe->res,
+				      (unsigned long long)cqe->big_cqe[0],
+				      len, (unsigned long long)off);
+		return false;
+	}
+	return true;
+}
+
+int main(void)
+{
+	__u64 cqe_buf[4];
+	struct io_uring_cqe *cqe = (struct io_uring_cqe *)cqe_buf;
+	struct io_uring_sqe *sqe;
+	struct ring ring;
+	struct iovec iov;
+	int srv, cli, ret, bid;
+
+	ksft_print_header();
+	ksft_set_plan(3);
+
+	ret = ring_setup(&ring, 8, IORING_SETUP_CQE32);
+	if (ret == -EINVAL)
+		ksft_exit_skip("no CQE32 rings\n");
+	if (ret)
+		ksft_exit_fail_msg("ring setup: %s\n", strerror(-ret));
+
+	if (posix_memalign((void **)&reg, 4096, REG_SIZE))
+		ksft_exit_fail_msg("out of memory\n");
+	memset(reg, 0, REG_SIZE);
+	iov.iov_base = reg;
+	iov.iov_len = REG_SIZE;
+	ret = ring_register(&ring, IORING_REGISTER_BUFFERS, &iov, 1);
+	if (ret)
+		ksft_exit_fail_msg("register buffers: %s\n", strerror(-ret));
+
+	tcp_pair(&srv, &cli);
+
+	/* Into an address of the registered buffer */
+	ret = recv_fixed(&ring, srv, cli, (unsigned long)reg + 1000, 100,
+			 false, cqe);
+	if (ret)
+		ksft_exit_fail_msg("recv: %s\n", strerror(-ret));
+	if (cqe->res == -EINVAL)
+		ksft_exit_skip("no IORING_RECV_FIXED_BUF\n");
+	if (check("recv fixed", cqe, 100, 1000))
+		ksft_test_result_pass("recv fixed\n");
+
+	/* Running past the end of the registered buffer is refused */
+	memset(cqe_buf, 0, sizeof(cqe_buf));
+	sqe = ring_get_sqe(&ring);
+	sqe->opcode = IORING_OP_RECV;
+	sqe->fd = srv;
+	sqe->ioprio = IORING_RECV_FIXED_BUF;
+	sqe->addr = (unsigned long)reg + REG_SIZE - 10;
+	sqe->len = 100;
+	ret = ring_submit(&ring, 1);
+	if (ret < 0 || ring_pop_cqe(&ring, cqe))
+		ksft_exit_fail_msg("recv out of range: %s\n", strerror(-ret));
+	if (cqe->res != -EFAULT)
+		ksft_test_result_fail("recv out of range: res %d\n", cqe->res);
+	else
+		ksft_test_result_pass("recv out of range\n");
+
+	/* Provided buffers carved out of the registered buffer */
+	sqe = ring_get_sqe(&ring);
+	sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+	sqe->fd = PBUF_NR;
+	sqe->addr = (unsigned long)reg + PBUF_BASE;
+	sqe->len = PBUF_SIZE;
+	sqe->off = 0;
+	sqe->buf_group = 0;
+	ret = ring_submit(&ring, 1);
+	if (ret < 0 || ring_pop_cqe(&ring, cqe) || cqe->res < 0)
+		ksft_exit_fail_msg("provide buffers: %s\n",
+				   strerror(ret < 0 ? -ret : -cqe->res));
+
+	ret = recv_fixed(&ring, srv, cli, 0, 200, true, cqe);
+	if (ret)
+		ksft_exit_fail_msg("recv select: %s\n", strerror(-ret));
+	bid = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+	if (!(cqe->flags & IORING_CQE_F_BUFFER) || bid >= PBUF_NR)
+		ksft_test_result_fail("recv fixed select: flags %x\n",
+				      cqe->flags);
+	else if (check("recv fixed select", cqe, 200,
+		       PBUF_BASE + bid * PBUF_SIZE))
+		ksft_test_result_pass("recv fixed select\n");
+
+	close(cli);
+	close(srv);
+	close(ring.fd);
+	ksft_exit_pass();
+}
@@ -0,0 +1,115 @@
+#!/bin/bash
+# SPDX-License-Identifier: GPL-2.0
+#
+# Measure memory hotplug throughput by hot-adding a device-dax instance
+# through dax/kmem, offlining and hot-removing it again.
+#
+# usage: hotplug_bench.sh <daxX.Y> [iterations] [online_type]
+#
+# online_type is written to the device's online_type attribute and defaults
+# to online_movable, which is what lets the memory be offlined again.  The
+# device must be bound to device_dax when the benchmark starts, and is left
+# that way.
+
+# Kselftest framework requirement - SKIP code is 4.
+ksft_skip=4
+
+SYSFS_DAX=/sys/bus/dax
+SYSFS_MEM=/sys/devices/system/memory
+TRACING=/sys/kernel/debug/tracing
+
+dev=$1
+iterations=${2:-3}
+online_type=${3:-online_movable}
+
+if [ $UID != 0 ]; then
+	echo "Must be run as root"
+	exit $ksft_skip
+fi
+
+if [ -z "$dev" ] || [ ! -d $SYSFS_DAX/devices/$dev ]; then
+	echo "usage: $0 <daxX.Y> [iterations] [online_type]"
+	exit $ksft_skip
+fi
+
+if [ ! -d $SYSFS_DAX/drivers/kmem ]; then
+	echo "dax/kmem driver is not loaded"
+	exit $ksft_skip
+fi
+
+now_ns()
+{
+	date +%s%N
+}
+
+# GB/s for $1 bytes in $2 ns
+gbps()
+{
+	awk -v b=$1 -v ns=$2 'BEGIN { printf "%.2f", ns ? b / ns : 0 }'
+}
+
+# The memory blocks the device was hot-added as
+dev_memory_blocks()
+{
+	local start end block_size first last i
+
+	start=$(grep -i " : $dev\$" /proc/iomem | head -1 | cut -d- -f1)
+	end=$(grep -i " : $dev\$" /proc/iomem | head -1 | cut -d- -f2 | \
+	      cut -d' ' -f1)
+	block_size=$((0x$(cat $SYSFS_MEM/block_size_bytes)))
+	first=$((0x$start / block_size))
+	last=$((0x$end / block_size))
+	for ((i = first; i <= last; i++)); do
+		[ -d $SYSFS_MEM/memory$i ] && echo memory$i
+	done
+}
+
+size=$(cat $SYSFS_DAX/devices/$dev/size)
+echo "$online_type" > $SYSFS_DAX/devices/$dev/online_type || exit 1
+
+if [ -d $TRACING/events/memory_hotplug ]; then
+	echo > $TRACING/trace
+	echo 1 > $TRACING/events/memory_hotplug/enable
+fi
+
+for ((iter = 1; iter <= iterations; iter++)); do
+	echo $dev > $SYSFS_DAX/drivers/device_dax/unbind
+
+	start=$(now_ns)
+	if ! echo $dev > $SYSFS_DAX/drivers/kmem/new_id; then
+		echo $dev > $SYSFS_DAX/drivers/device_dax/bind
+		echo "hot-adding $dev failed"
+		exit 1
+	fi
+	add_ns=$(($(now_ns) - start))
+
+	start=$(now_ns)
+	for block in $(dev_memory_blocks); do
+		# A block that stays online would make the numbers meaningless
+		# and the remove below fail, so stop here.  The device is left
+		# bound to kmem.
+		if ! echo offline > $SYSFS_MEM/$block/state; then
+			echo "offlining $block of $dev failed"
+			exit 1
+		fi
+	done
+	offline_ns=$(($(now_ns) - start))
+
+	start=$(now_ns)
+	echo $dev > $SYSFS_DAX/drivers/kmem/unbind
+	remove_ns=$(($(now_ns) - start))
+
+	echo $dev > $SYSFS_DAX/drivers/kmem/remove_id
+	echo $dev > $SYSFS_DAX/drivers/device_dax/bind
+
+	echo "$iter: $((size >> 20)) MB" \
+	     "add+online $(gbps $size $add_ns) GB/s," \
+	     "offline $(gbps $size $offline_ns) GB/s," \
+	     "remove $(gbps $size $remove_ns) GB/s"
+done
+
+if [ -d $TRACING/events/memory_hotplug ]; then
+	echo 0 > $TRACING/events/memory_hotplug/enable
+	grep -E "mm_(memmap_init_hotplug|online_pages|offline_pages)" \
+		$TRACING/trace | tail -20
+fi
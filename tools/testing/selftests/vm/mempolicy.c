@@ -0,0 +1,184 @@
+// SPDX-License-Identifier: GPL-2.0
+/*
+ * Tests for the set_mempolicy() and mbind() modes that go beyond the
+ * classic interleave/bind/preferred policies: weighted interleave and
+ * preferred many.
+ *
+ * Only node 0 is assumed to exist, so these check the ABI rather than the
+ * placement across nodes.
+ */
+#define _GNU_SOURCE
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+
+#include "../kselftest.h"
+
+#define NR_PAGES	8
+
+static long page_size;
+
+static long set_mempolicy(int mode, const void *nmask, unsigned long maxnode)
+{
+	return syscall(__NR_set_mempolicy, mode, nmask, maxnode);
+}
+
+static long get_mempolicy(int *mode, unsigned long *nmask,
+			  unsigned long maxnode, void *addr, unsigned long flags)
+{
+	return syscall(__NR_get_mempolicy, mode, nmask, maxnode, addr, flags);
+}
+
+static long mbind(void *addr, unsigned long len, int mode, const void *nmask,
+		  unsigned long maxnode, unsigned int flags)
+{
+	return syscall(__NR_mbind, addr, len, mode, nmask, maxnode, flags);
+}
+
+static void report(int pass, const char *name)
+{
+	if (pass)
+		ksft_test_result_pass("%s\n", name);
+	else
+		ksft_test_result_fail("%s: %s\n", name, strerror(errno));
+}
+
+/* All the pages of a freshly faulted mapping must land on node 0 */
+static int touch_and_check_node0(char *p)
+{
+	int i, node;
+
+	for (i = 0; i < NR_PAGES; i++) {
+		p[i * page_size] = 1;
+		if (get_mempolicy(&node, NULL, 0, p + i * page_size,
+				  MPOL_F_NODE | MPOL_F_ADDR))
+			return 0;
+		if (node != 0)
+			return 0;
+	}
+	return 1;
+}
+
+static void test_weighted_interleave(void)
+{
+	unsigned long nodes = 1;
+	int mode;
+
+	report(!set_mempolicy(MPOL_WEIGHTED_INTERLEAVE, &nodes,
+			      sizeof(nodes) * 8) &&
+	       !get_mempolicy(&mode, NULL, 0, NULL, 0) &&
+	       mode == MPOL_WEIGHTED_INTERLEAVE,
+	       "weighted interleave with system weights");
+}
+
+static void test_weighted_interleave_weights(void)
+{
+	unsigned char weights[2] = { 3, 0 };
+	unsigned char none[2] = { 0, 0 };
+	char *p;
+
+	report(!set_mempolicy(MPOL_WEIGHTED_INTERLEAVE | MPOL_F_WEIGHTS,
+			      weights, 1),
+	       "weighted interleave with task weights");
+
+	p = mmap(NULL, NR_PAGES * page_size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		ksft_exit_fail_msg("mmap: %s\n", strerror(errno));
+	report(touch_and_check_node0(p), "task weights fault path");
+	munmap(p, NR_PAGES * page_size);
+
+	errno = 0;
+	report(set_mempolicy(MPOL_INTERLEAVE | MPOL_F_WEIGHTS, weights, 1) &&
+	       errno == EINVAL, "weights rejected for plain interleave");
+
+	errno = 0;
+	report(set_mempolicy(MPOL_WEIGHTED_INTERLEAVE | MPOL_F_WEIGHTS,
+			     none, 2) && errno == EINVAL,
+	       "all zero weights rejected");
+
+	errno = 0;
+	report(set_mempolicy(MPOL_WEIGHTED_INTERLEAVE | MPOL_F_WEIGHTS |
+			     MPOL_F_RELATIVE_NODES, weights, 1) &&
+	       errno == EINVAL, "weights rejected with relative nodes");
+
+	set_mempolicy(MPOL_DEFAULT, NULL, 0);
+}
+
+static void test_weighted_interleave_mbind(void)
+{
+	unsigned char weights[1] = { 2 };
+	int mode;
+	char *p;
+
+	p = mmap(NULL, NR_PAGES * page_size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		ksft_exit_fail_msg("mmap: %s\n", strerror(errno));
+
+	report(!mbind(p, NR_PAGES * page_size,
+		      MPOL_WEIGHTED_INTERLEAVE | MPOL_F_WEIGHTS, weights, 1, 0) &&
+	       !get_mempolicy(&mode, NULL, 0, p, MPOL_F_ADDR) &&
+	       mode == MPOL_WEIGHTED_INTERLEAVE,
+	       "mbind weighted interleave with task weights");
+	report(touch_and_check_node0(p), "mbind weights fault path");
+
+	munmap(p, NR_PAGES * page_size);
+}
+
+static void test_preferred_many(void)
+{
+	unsigned long nodes = 1, none = 0;
+	int mode;
+	char *p;
+
+	report(!set_mempolicy(MPOL_PREFERRED_MANY, &nodes,
+			      sizeof(nodes) * 8) &&
+	       !get_mempolicy(&mode, NULL, 0, NULL, 0) &&
+	       mode == MPOL_PREFERRED_MANY,
+	       "preferred many");
+
+	errno = 0;
+	report(set_mempolicy(MPOL_PREFERRED_MANY, &none, sizeof(none) * 8) &&
+	       errno == EINVAL, "preferred many rejects empty nodemask");
+
+	set_mempolicy(MPOL_DEFAULT, NULL, 0);
+
+	p = mmap(NULL, NR_PAGES * page_size, PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (p == MAP_FAILED)
+		ksft_exit_fail_msg("mmap: %s\n", strerror(errno));
+
+	report(!mbind(p, NR_PAGES * page_size, MPOL_PREFERRED_MANY, &nodes,
+		      sizeof(nodes) * 8, 0) &&
+	       !get_mempolicy(&mode, NULL, 0, p, MPOL_F_ADDR) &&
+	       mode == MPOL_PREFERRED_MANY,
+	       "mbind preferred many");
+	report(touch_and_check_node0(p), "mbind preferred many fault path");
+
+	munmap(p, NR_PAGES * page_size);
+}
+
+int main(void)
+{
+	int mode;
+
+	page_size = sysconf(_SC_PAGESIZE);
+
+	ksft_print_header();
+	if (get_mempolicy(&mode, NULL, 0, NULL, 0) && errno == ENOSYS)
+		ksft_exit_skip("NUMA policies not supported\n");
+
+	ksft_set_plan(12);
+	test_weighted_interleave();
+	test_weighted_interleave_weights();
+	test_weighted_interleave_mbind();
+	test_preferred_many();
+
+	ksft_print_cnts();
+	return ksft_get_fail_cnt() ? ksft_exit_fail() : ksft_exit_pass();
+}